@@ -3,6 +3,7 @@
 #include "GLFW/glfw3.h"
 //#include "vulkan/vulkan.hpp"
 #include "hp/logging.hpp"
+#include "hp/frame_pipeline.hpp"
 #include "hp/vk/window.hpp"
 
 hp::vk::generic_buffer *sbo;
@@ -16,6 +17,10 @@ struct vertex {
     glm::vec3 col;
 };
 
+struct frame_state {
+    double time;
+};
+
 static void recreate_callback(::vk::Extent2D new_extent) {
     inst->clear_recording();
     inst->rec_bind_shader(shaders);
@@ -99,10 +104,18 @@ int main() {
         inst->rec_draw_indexed(ibo.get_num_indices());
         inst->save_recording();
 
-        while (!inst->should_close()) {
-            glfwPollEvents();
-            inst->draw_frame();
-        }
+        // Simulates the next frame while the current one is drawn.
+        double time = 0;
+        hp::frame_pipeline<frame_state> pipeline;
+        pipeline.run([]() { return !inst->should_close(); },
+                     [&time](frame_state &state, const hp::frame_info &frame) {
+                         time += frame.delta;
+                         state.time = time;
+                     },
+                     [](const frame_state &, const hp::frame_info &) {
+                         glfwPollEvents();
+                         inst->draw_frame();
+                     });
 
         delete inst;
 
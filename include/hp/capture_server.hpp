@@ -0,0 +1,187 @@
+/**
+ * @file capture_server.hpp
+ * @brief Loopback TCP server that streams a running `profiler_session` to a client, such as `HephaestusTraceCapture`.
+ * @details Enabled with `profiler_session::serve_live()`. A client connects to `127.0.0.1:<port>` and sends newline
+ *          terminated text commands:
+ *          - `start`: Begin a capture. Events recorded from now on are streamed as a fresh binary trace.
+ *          - `stop`: End the capture. The server sends the remaining events, then an end frame.
+ *          - `filter <a>,<b>,...`: Only stream zones whose name or category contains one of the substrings.
+ *                                  `filter` without arguments streams every zone. Applies immediately, even mid-capture.
+ *          - `status`: Reply with the capture state, the filters and the number of events dropped so far.
+ *          The server replies with frames: A type byte, a 4 byte little endian payload length, and the payload.
+ *          - `T`: Trace bytes. The payloads of one capture concatenated form a binary trace (See `trace_format.hpp`).
+ *          - `E`: The capture ended. Empty payload.
+ *          - `M`: Human readable reply to a command, or an error. Starts with `ok` or `error`.
+ *          Only one client is served at a time; Others wait in the backlog until it disconnects. Disconnecting also
+ *          ends the capture. The server only listens on the loopback interface.
+ */
+
+#pragma once
+
+#ifndef __HEPHAESTUS_CAPTURE_SERVER_HPP
+/**
+ * @def __HEPHAESTUS_CAPTURE_SERVER_HPP
+ * @brief This macro is defined if `capture_server.hpp` has been included.
+ */
+#define __HEPHAESTUS_CAPTURE_SERVER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/streambuf.hpp>
+
+#include "trace_format.hpp"
+
+namespace hp {
+    struct profile_result;
+
+    class event_buffer;
+
+    /**
+     * @class capture_server
+     * @brief Serves live captures of a `profiler_session`. See `capture_server.hpp` for the protocol.
+     * @details Networking runs on a thread of its own, so a slow or stuck client never blocks the session. Encoding
+     *          happens on the session's writer thread, and only while a capture is running.
+     *          If the client falls more than `max_queued_bytes` behind, the capture is ended with an error message
+     *          instead of growing without bound.
+     */
+    class capture_server {
+    public:
+        /**
+         * @var static constexpr size_t max_queued_bytes
+         * @brief Maximum number of bytes waiting to be sent before a capture is ended.
+         */
+        static constexpr size_t max_queued_bytes = 64u << 20u;
+
+        /**
+         * @var static constexpr size_t chunk_size
+         * @brief Trace bytes are sent in frames of about this size, or whenever the session's writer flushes.
+         */
+        static constexpr size_t chunk_size = 64u << 10u;
+
+        /**
+         * @fn capture_server(const trace::header &head, uint16_t port)
+         * @brief Start listening on `127.0.0.1:port`. Check `is_listening()` for success.
+         * @param head Header every capture starts with. Its timestamps must be in nanoseconds.
+         * @param port Port to listen on, or 0 to let the OS pick one (See `get_port()`).
+         */
+        capture_server(const trace::header &head, uint16_t port);
+
+        /**
+         * @fn ~capture_server()
+         * @brief Disconnect the client and stop the networking thread.
+         */
+        ~capture_server();
+
+        capture_server(const capture_server &other) = delete; ///< @private
+        capture_server &operator=(const capture_server &other) = delete; ///< @private
+
+        /**
+         * @fn [[nodiscard]] inline bool is_listening() const
+         * @brief Query if the server is accepting connections.
+         */
+        [[nodiscard]] inline bool is_listening() const {
+            return listening;
+        }
+
+        /**
+         * @fn [[nodiscard]] inline uint16_t get_port() const
+         * @brief Query the port the server listens on.
+         */
+        [[nodiscard]] inline uint16_t get_port() const {
+            return port;
+        }
+
+        /**
+         * @fn [[nodiscard]] inline size_t dropped_events() const
+         * @brief Query the number of events lost because a client couldn't keep up.
+         */
+        [[nodiscard]] inline size_t dropped_events() const {
+            return dropped.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @fn bool sync()
+         * @brief Apply commands received since the last call. Writer thread only.
+         * @return True if a capture is running, i.e. events should be passed to `write_event()`.
+         */
+        bool sync();
+
+        /**
+         * @fn void write_event(const profile_result &res, long long start, long long end, const event_buffer &buf)
+         * @brief Stream an event, if it passes the filters. Writer thread only; Only call it if `sync()` returned true.
+         * @param start Start of the event in nanoseconds.
+         * @param end End of the event in nanoseconds.
+         */
+        void write_event(const profile_result &res, long long start, long long end, const event_buffer &buf);
+
+        /**
+         * @fn void write_counter(const trace::counter &ctr)
+         * @brief Stream a counter sample, if it passes the filters. Writer thread only, like `write_event()`.
+         * @param ctr The sample, with its time in nanoseconds.
+         */
+        void write_counter(const trace::counter &ctr);
+
+        /**
+         * @fn void flush()
+         * @brief Hand everything written so far to the networking thread. Writer thread only.
+         */
+        void flush();
+
+    private:
+        void begin_capture(); ///< @private Writer thread.
+        void end_capture(const char *error); ///< @private Writer thread.
+        bool zone_passes(uint32_t zone); ///< @private Writer thread.
+        void define_zone(uint32_t zone); ///< @private Writer thread.
+        void post_frame(char type, const char *data, size_t size, uint32_t epoch); ///< @private Any thread.
+
+        void accept(); ///< @private Networking thread, as are all below.
+        void read_command(); ///< @private
+        void handle_command(const std::string &line); ///< @private
+        void reply(const std::string &msg); ///< @private
+        void enqueue(std::string frame); ///< @private
+        void write_next(); ///< @private
+        void disconnect(); ///< @private
+
+        trace::header head; ///< @private
+        uint16_t port = 0; ///< @private
+        bool listening = false; ///< @private
+
+        boost::asio::io_context io; ///< @private
+        boost::asio::ip::tcp::acceptor acceptor; ///< @private
+        boost::asio::ip::tcp::socket client; ///< @private
+        boost::asio::streambuf commands; ///< @private
+        std::deque<std::string> out_queue; ///< @private Networking thread only.
+        std::thread io_thread; ///< @private
+
+        std::mutex mtx; ///< @private Guards the requested state below.
+        bool want_capture = false; ///< @private
+        uint32_t epoch = 0; ///< @private Bumped on every `start` and disconnect, so stale frames are dropped.
+        std::vector<std::string> filters; ///< @private
+        uint32_t filter_gen = 0; ///< @private
+        std::atomic<uint32_t> state_gen{0}; ///< @private Bumped on every change, so `sync()` is cheap otherwise.
+        std::atomic<size_t> queued{0}; ///< @private Bytes posted to, but not yet sent by, the networking thread.
+        std::atomic<size_t> dropped{0}; ///< @private
+
+        uint32_t seen_gen = 0; ///< @private Writer thread only, as is everything below.
+        uint32_t seen_filter_gen = 0; ///< @private
+        bool capturing = false; ///< @private
+        uint32_t capture_epoch = 0; ///< @private
+        std::vector<std::string> active_filters; ///< @private
+        std::vector<uint8_t> zone_filter; ///< @private Per zone id: 0 unknown, 1 streamed, 2 filtered out.
+        trace::encoder encoder; ///< @private
+        std::unordered_set<size_t> named_threads; ///< @private
+        fmt::memory_buffer live; ///< @private
+        size_t live_events = 0; ///< @private Events in `live`, counted as dropped if it can't be sent.
+    };
+}
+
+#endif //__HEPHAESTUS_CAPTURE_SERVER_HPP
@@ -0,0 +1,118 @@
+/**
+ * @file clock.hpp
+ * @brief Low-overhead, nanosecond resolution clock used for profiling.
+ * @details On x86 CPUs with an invariant TSC, reading the clock is a single `rdtsc`/`rdtscp` instruction, and ticks
+ *          are converted to nanoseconds later using a calibration against `std::chrono::steady_clock`.
+ *          Everywhere else the clock falls back to `std::chrono::steady_clock` and a tick is one nanosecond.
+ *          Ticks read from `std::chrono::steady_clock` carry `steady_tag`, so ticks taken before `calibrate()` switched
+ *          to the TSC still convert correctly afterwards.
+ */
+
+#pragma once
+
+#ifndef __HEPHAESTUS_CLOCK_HPP
+/**
+ * @def __HEPHAESTUS_CLOCK_HPP
+ * @brief This macro is defined if `clock.hpp` has been included.
+ */
+#define __HEPHAESTUS_CLOCK_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+/**
+ * @def HP_CLOCK_HAS_TSC
+ * @brief Defined if the target architecture has a time stamp counter that `hp::clock` can use.
+ */
+#define HP_CLOCK_HAS_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+namespace hp::clock {
+    /**
+     * @var constexpr uint64_t steady_tag
+     * @brief Bit set in every tick read from `std::chrono::steady_clock` rather than the TSC. `to_ns()` strips it.
+     */
+    constexpr uint64_t steady_tag = 1ull << 63u;
+
+    /**
+     * @var extern std::atomic<bool> tsc_active
+     * @brief `true` if `ticks()` reads the TSC, `false` if it reads `std::chrono::steady_clock`.
+     * @details Set once by `calibrate()`, after the calibration it publishes. Don't modify it.
+     */
+    extern std::atomic<bool> tsc_active;
+
+    /**
+     * @fn void calibrate()
+     * @brief Detect an invariant TSC and measure its frequency against `std::chrono::steady_clock`.
+     * @details Blocks for about 10 milliseconds the first time it is called, and returns immediately afterwards.
+     *          `profiler_session`'s constructor calls this, so you only need to call it yourself if you use the clock
+     *          without a session.
+     */
+    void calibrate();
+
+    /**
+     * @fn inline uint64_t ticks()
+     * @brief Read the clock. Convert the result with `to_ns()`.
+     * @note Not ordered with surrounding instructions. Use `ticks_ordered()` for the end of a timed region.
+     */
+    inline uint64_t ticks() {
+#ifdef HP_CLOCK_HAS_TSC
+        if (tsc_active.load(std::memory_order_acquire)) {
+            return __rdtsc();
+        }
+#endif
+        return steady_tag | static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    /**
+     * @fn inline uint64_t ticks_ordered()
+     * @brief Read the clock after all previous instructions have executed (`rdtscp`), so they are part of the time.
+     */
+    inline uint64_t ticks_ordered() {
+#ifdef HP_CLOCK_HAS_TSC
+        if (tsc_active.load(std::memory_order_acquire)) {
+            unsigned aux;
+            return __rdtscp(&aux);
+        }
+#endif
+        return ticks();
+    }
+
+    /**
+     * @fn long long to_ns(uint64_t tick)
+     * @brief Convert a value returned by `ticks()` to nanoseconds on the `std::chrono::steady_clock` timeline.
+     * @details Works for ticks taken before and after `calibrate()`.
+     */
+    long long to_ns(uint64_t tick);
+
+    /**
+     * @fn uint64_t from_ns(long long ns)
+     * @brief Convert nanoseconds on the `std::chrono::steady_clock` timeline back to ticks. The inverse of `to_ns()`.
+     * @details For timestamps taken elsewhere, such as on the GPU, that need to go through the profiler.
+     */
+    uint64_t from_ns(long long ns);
+
+    /**
+     * @fn inline long long now_ns()
+     * @brief Read the clock and convert it to nanoseconds. Convenience for code that isn't performance critical.
+     */
+    inline long long now_ns() {
+        return to_ns(ticks());
+    }
+
+    /**
+     * @fn double ns_per_tick()
+     * @brief Query the calibrated length of a tick in nanoseconds. Is exactly 1 if the TSC isn't used.
+     */
+    double ns_per_tick();
+}
+
+#endif //__HEPHAESTUS_CLOCK_HPP
@@ -13,9 +13,12 @@
  */
 #define __HEPHAESTUS_CONFIG_HPP
 
-#undef NDEBUG
-
-#ifdef NDEBUG
+/*
+ * The debug configuration is used unless `HP_RELEASE_CONFIG` is defined (`-DHP_RELEASE_CONFIG=ON` with CMake). It
+ * doesn't follow `NDEBUG`, as CMake builds Release by default. Logging can be quieted at runtime without a rebuild;
+ * See `hp::configure_logging()`.
+ */
+#ifdef HP_RELEASE_CONFIG
 /**
  * @def HP_DEBUG_MODE_ACTIVE
  * @brief Convenience flag for enabling/disabling debug mode, or toggling tons of settings at once.
@@ -57,12 +60,12 @@
 /**
  * @def HP_ASYNC_LOGGING_ENABLED
  * @brief Global flag to enable/disable asynchronous logging. See `logging.hpp`.
- * @details Disabled by default. (Rebuild required).
- * @warning Does yield faster logging, but if the program terminates unexpectedly, then not all messages may be logged.
- *          Then you would spend hours debugging when your program seemingly terminates at random points.
+ * @details Enabled by default. Logging macros then only copy their arguments, and a background thread formats and
+ *          writes them. (Rebuild required).
+ * @warning Pending messages are written at exit, in `std::terminate()` and by `hp::flush_logs()`, but a crash (like a
+ *          segfault) loses the last few milliseconds of messages. Disable it when hunting those.
  */
-#define HP_ASYNC_LOGGING_ENABLED  // Here so documentation is generated.
-#undef HP_ASYNC_LOGGING_ENABLED
+#define HP_ASYNC_LOGGING_ENABLED
 
 /**
  * @def HP_VK_VALIDATION_LAYERS_ENABLED
@@ -74,6 +77,22 @@
  */
 #define HP_VK_VALIDATION_LAYERS_ENABLED
 
+/**
+ * @def HP_MEMORY_TRACKING_ENABLED
+ * @brief Global flag to enable/disable memory counters in profiler traces. See `memory_tracking.hpp`.
+ * @details Enabled by default. Costs a few atomic operations per tracked allocation. (Rebuild required.)
+ */
+#define HP_MEMORY_TRACKING_ENABLED
+
+/**
+ * @def HP_TRACK_GLOBAL_NEW
+ * @brief Replace the global `operator new` and `operator delete` to count every heap allocation of the program.
+ * @details Disabled by default, as it adds a small header to every allocation. Requires `HP_MEMORY_TRACKING_ENABLED`.
+ *          (Rebuild required.)
+ */
+#define HP_TRACK_GLOBAL_NEW  // Here so documentation is generated.
+#undef HP_TRACK_GLOBAL_NEW
+
 #else
 // Insert custom values here for release
 
@@ -117,6 +136,20 @@
  */
 #undef HP_VK_VALIDATION_LAYERS_ENABLED
 
+/**
+ * @def HP_MEMORY_TRACKING_ENABLED
+ * @brief Global flag to enable/disable memory counters in profiler traces. See `memory_tracking.hpp`.
+ * @details Disabled in release. Costs a few atomic operations per tracked allocation if enabled. (Rebuild required.)
+ */
+#undef HP_MEMORY_TRACKING_ENABLED
+
+/**
+ * @def HP_TRACK_GLOBAL_NEW
+ * @brief Replace the global `operator new` and `operator delete` to count every heap allocation of the program.
+ * @details Disabled by default. Requires `HP_MEMORY_TRACKING_ENABLED`. (Rebuild required.)
+ */
+#undef HP_TRACK_GLOBAL_NEW
+
 #endif
 
 /*
@@ -132,6 +165,14 @@ namespace hp {
          */
         const int max_frames_in_flight = 2;
 
+        /**
+         * @var const char *const pipeline_cache_file
+         * @brief File the pipeline cache of a `window` is loaded from at startup, and saved to when it is destroyed.
+         * @details Relative to the working directory. Set to `nullptr` to never touch the disk; Pipelines are then
+         *          still shared between the shaders of a window, but compiled again on every run.
+         */
+        const char *const pipeline_cache_file = "hp_pipeline_cache.bin";
+
 #ifdef HP_VK_VALIDATION_LAYERS_ENABLED
         /**
          * @var const bool validation_layers_enabled
@@ -175,6 +216,20 @@ namespace hp {
     const bool profiling_enabled = false;
 #endif
 
+#ifdef HP_MEMORY_TRACKING_ENABLED
+    /**
+     * @var const bool memory_tracking_enabled
+     * @brief `true` if `HP_MEMORY_TRACKING_ENABLED` is defined, otherwise `false`.
+     */
+    const bool memory_tracking_enabled = true;
+#else
+    /**
+     * @var const bool memory_tracking_enabled
+     * @brief `true` if `HP_MEMORY_TRACKING_ENABLED` is defined, otherwise `false`.
+     */
+    const bool memory_tracking_enabled = false;
+#endif
+
 #ifdef HP_LOGGING_ENABLED
     /**
      * @var const bool logging_enabled
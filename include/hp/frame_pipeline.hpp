@@ -0,0 +1,216 @@
+/**
+ * @file frame_pipeline.hpp
+ * @brief A main loop that simulates frame N+1 on its own thread while frame N is rendered.
+ * @details The simulation thread writes every frame's render state into a snapshot slot and hands it to the render
+ *          thread, then goes on with the next frame on a free slot. There is one slot more than the pipeline depth,
+ *          so with the default depth of `vk::max_frames_in_flight` the state is triple buffered: One snapshot being
+ *          rendered, one waiting, and one being simulated. Neither side ever touches a slot the other one holds.
+ */
+
+#pragma once
+
+#ifndef __HEPHAESTUS_FRAME_PIPELINE_HPP
+/**
+ * @def __HEPHAESTUS_FRAME_PIPELINE_HPP
+ * @brief This macro is defined if `frame_pipeline.hpp` has been included.
+ */
+#define __HEPHAESTUS_FRAME_PIPELINE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "config.hpp"
+#include "multithreading.hpp"
+#include "profiling.hpp"
+#include "queues.hpp"
+
+namespace hp {
+    /**
+     * @struct frame_info
+     * @brief Describes the frame a `frame_pipeline` stage is working on.
+     */
+    struct frame_info {
+        uint64_t index; ///< Number of the frame, counting from `0`.
+        double delta; ///< Seconds between the starts of this frame's and the previous frame's simulation.
+    };
+
+    /**
+     * @class frame_pipeline
+     * @brief Runs the simulation and the rendering of consecutive frames concurrently, on two threads.
+     * @details `State` is the snapshot of everything rendering a frame needs, and is filled in by the simulation
+     *          stage. The simulation's own state should live elsewhere, like in the simulate callable: Slots are
+     *          reused, and hold whatever the frame `depth + 1` frames ago wrote into them.
+     *          Example Usage:
+     *          ```
+     *          struct snapshot { std::vector<glm::mat4> transforms; };
+     *          hp::frame_pipeline<snapshot> pipeline;
+     *          pipeline.run([&]() { return !inst->should_close(); },
+     *                       [&](snapshot &out, const hp::frame_info &frame) { world.step(frame.delta); world.write(out); },
+     *                       [&](const snapshot &in, const hp::frame_info &) { glfwPollEvents(); inst->draw_frame(); });
+     *          ```
+     * @note `State` must be default constructible.
+     */
+    template<typename State>
+    class frame_pipeline {
+    public:
+        /**
+         * @fn explicit frame_pipeline(size_t depth = vk::max_frames_in_flight)
+         * @brief Construct a pipeline.
+         * @param depth Most frames the simulation may run ahead of the frame being rendered. At least `1`.
+         */
+        explicit frame_pipeline(size_t depth = vk::max_frames_in_flight)
+                : slots(std::max<size_t>(depth, 1) + 1), ready(queue_capacity(slots.size())),
+                  free(queue_capacity(slots.size())) {}
+
+        frame_pipeline(const frame_pipeline &other) = delete; ///< @private
+        frame_pipeline &operator=(const frame_pipeline &other) = delete; ///< @private
+
+        /**
+         * @fn template<typename Running, typename Simulate, typename Render> void run(Running &&running, Simulate &&simulate, Render &&render)
+         * @brief Run the loop until `running()` returns `false`.
+         * @details `render` and `running` are called on the calling thread, which should be the one owning the
+         *          window, as GLFW wants events polled on the main thread. `simulate` is called on a thread of its
+         *          own, named "Simulation". Stages and their waits for each other show up in the profiler as the
+         *          zones "Simulate", "Render", "Wait for Render" and "Wait for Simulation".
+         * @param running Callable returning `false` once the loop should end. Called before every rendered frame.
+         * @param simulate Callable taking a `State &` to fill in and a `const frame_info &`.
+         * @param render Callable taking a `const State &` and a `const frame_info &`.
+         */
+        template<typename Running, typename Simulate, typename Render>
+        void run(Running &&running, Simulate &&simulate, Render &&render) {
+            size_t slot;
+            while (ready.try_pop(slot)) {}
+            while (free.try_pop(slot)) {}
+            for (slot = 0; slot < slots.size(); slot++) {
+                free.try_push(slot);
+            }
+            stopping = false;
+
+            std::thread sim([this, &simulate]() { simulate_loop(simulate); });
+
+            while (running()) {
+                {
+                    HP_PROFILE_SCOPE_EX("Wait for Simulation", "frame", 0);
+                    slot = take(ready);
+                }
+
+                {
+                    HP_PROFILE_SCOPE_EX("Render", "frame", 0);
+                    render(static_cast<const State &>(slots[slot].state), slots[slot].info);
+                }
+                give(free, slot);
+            }
+
+            {
+                std::lock_guard<std::mutex> lg(mtx);
+                stopping = true;
+            }
+            cv.notify_all();
+            sim.join();
+        }
+
+        /**
+         * @fn [[nodiscard]] inline size_t depth() const
+         * @brief Query the most frames the simulation may run ahead of rendering.
+         */
+        [[nodiscard]] inline size_t depth() const {
+            return slots.size() - 1;
+        }
+
+    private:
+        struct slot_data { ///< @private
+            State state; ///< @private
+            frame_info info{}; ///< @private
+        };
+
+        std::vector<slot_data> slots; ///< @private
+        spsc_queue<size_t> ready; ///< @private Simulated slots, oldest first. Simulation to render thread.
+        spsc_queue<size_t> free; ///< @private Rendered slots. Render to simulation thread.
+        std::mutex mtx; ///< @private Only held for sleeping and waking, never while a stage runs.
+        std::condition_variable cv; ///< @private
+        std::atomic<bool> stopping{false}; ///< @private
+
+        /**
+         * @fn static size_t queue_capacity(size_t count)
+         * @private
+         * @brief Round a slot count up to the power of two `spsc_queue` wants.
+         */
+        static size_t queue_capacity(size_t count) {
+            size_t capacity = 1;
+            while (capacity < count) {
+                capacity <<= 1;
+            }
+            return capacity;
+        }
+
+        /**
+         * @fn size_t take(spsc_queue<size_t> &queue)
+         * @private
+         * @brief Pop a slot, sleeping until there is one. Returns `slots.size()` if stopped meanwhile.
+         */
+        size_t take(spsc_queue<size_t> &queue) {
+            size_t slot;
+            if (queue.try_pop(slot)) {
+                return slot;
+            }
+
+            std::unique_lock<std::mutex> lk(mtx);
+            bool popped = false;
+            cv.wait(lk, [&]() { return (popped = queue.try_pop(slot)) || stopping; });
+            return popped ? slot : slots.size();
+        }
+
+        /**
+         * @fn void give(spsc_queue<size_t> &queue, size_t slot)
+         * @private
+         * @brief Push a slot, and wake the other side in case it is waiting for one.
+         */
+        void give(spsc_queue<size_t> &queue, size_t slot) {
+            queue.try_push(slot);  // Never full; There are only as many slots as either queue holds.
+            {
+                std::lock_guard<std::mutex> lg(mtx);  // So the push can't slip in between the waiter's check and sleep.
+            }
+            cv.notify_all();
+        }
+
+        /**
+         * @fn template<typename Simulate> void simulate_loop(Simulate &simulate)
+         * @private
+         * @brief Body of the simulation thread: Simulate into free slots until stopped.
+         */
+        template<typename Simulate>
+        void simulate_loop(Simulate &simulate) {
+            configure_thread("Simulation", thread_priority::high);
+
+            auto last = std::chrono::steady_clock::now();
+            for (uint64_t index = 0; !stopping; index++) {
+                size_t slot;
+                {
+                    HP_PROFILE_SCOPE_EX("Wait for Render", "frame", 0);
+                    slot = take(free);
+                }
+                if (slot == slots.size()) {
+                    return;
+                }
+
+                const auto now = std::chrono::steady_clock::now();
+                slots[slot].info = {index, std::chrono::duration<double>(now - last).count()};
+                last = now;
+
+                {
+                    HP_PROFILE_SCOPE_EX("Simulate", "frame", 0);
+                    simulate(slots[slot].state, static_cast<const frame_info &>(slots[slot].info));
+                }
+                give(ready, slot);
+            }
+        }
+    };
+}
+
+#endif //__HEPHAESTUS_FRAME_PIPELINE_HPP
@@ -3,6 +3,11 @@
  * @brief This file defines logging functionality.
  * @details This file also includes `"spdlog/fmt/fmt.h"` which enables anyone who includes this file to access `fmt::fmt()`.
  *          See https://fmt.dev/latest/index.html.
+ *          With `HP_ASYNC_LOGGING_ENABLED`, logging macros don't format on the calling thread: They copy a pointer to
+ *          their call site, the format string and the raw arguments into a per-thread ring, and a background thread
+ *          formats and writes them to the spdlog sinks set up by `init_logging()`.
+ *          Every message belongs to a `log_module`, which has a level that can be changed at runtime, from the
+ *          `HP_LOG` environment variable, or from a config file. See `configure_logging()`.
  */
 
 #pragma once
@@ -16,6 +21,8 @@
 
 #include "config.hpp"
 #include "hp.hpp"
+#include "clock.hpp"
+#include "queues.hpp"
 
 #include "boost/current_function.hpp"
 
@@ -31,9 +38,14 @@
 #include "spdlog/sinks/syslog_sink.h"
 #endif
 
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
 
 namespace hp {
     /**
@@ -93,12 +105,382 @@ namespace hp {
      * @brief Initialize Hephaestus logging (which uses SPDLOG).
      * @details Call this function before logging anything, as any logs before a call to this function is lost.
      *          This function initializes SPDLOG, so see https://github.com/gabime/spdlog.
+     *          Applies the filters in the file named by the `HP_LOG_CONFIG` environment variable (watching it for
+     *          changes), then the ones in the `HP_LOG` environment variable. See `configure_logging()`.
      *
      * @param use_single_file If true, `latest.log` would be created and logged to.
      * @param use_unique_file If true, a logfile with the current datetime as a name under directory `logs` would be created and logged to.
      *                        If the directory `logs` doesn't exist, it would be treated as if this parameter was set to false.
      */
     void init_logging(bool use_single_file = true, bool use_unique_file = false);
+
+    /**
+     * @enum log_module
+     * @brief Parts of the program whose messages can be filtered separately.
+     * @details A message's module is derived from the file it is logged in at compile time:
+     *          - `shaders`: `hp/vk/shaders.*`
+     *          - `buffers`: `hp/vk/buffers.*`
+     *          - `profiling`: The profiler, GPU profiler, traces, capture server, clock and memory tracking.
+     *          - `vk`: The rest of `hp/vk/`.
+     *          - `threading`: The job system, task graphs, parallel algorithms, queues, tasks and the frame pipeline.
+     *          - `core`: The rest of Hephaestus.
+     *          - `app`: Everything outside of Hephaestus.
+     */
+    enum class log_module : uint8_t {
+        core, vk, shaders, buffers, threading, profiling, app
+    };
+
+    /**
+     * @var constexpr size_t log_module_count
+     * @brief Number of `log_module`s.
+     */
+    constexpr size_t log_module_count = 7;
+
+    /**
+     * @fn void set_log_level(spdlog::level::level_enum level)
+     * @brief Set the lowest level logged for every module. Takes effect immediately, on every thread.
+     */
+    void set_log_level(spdlog::level::level_enum level);
+
+    /**
+     * @fn void set_log_level(log_module module, spdlog::level::level_enum level)
+     * @brief Set the lowest level logged for one module. `spdlog::level::off` silences it.
+     */
+    void set_log_level(log_module module, spdlog::level::level_enum level);
+
+    /**
+     * @fn spdlog::level::level_enum get_log_level(log_module module)
+     * @brief Query the lowest level logged for a module.
+     */
+    spdlog::level::level_enum get_log_level(log_module module);
+
+    /**
+     * @fn void set_log_rate_limit(uint32_t per_second)
+     * @brief Set how many info and warning messages each logging macro invocation may log per second.
+     * @details Messages beyond that are dropped. The next message from the same place after the second is over is
+     *          preceded by the number dropped. Trace and debug messages are meant to be verbose, and errors and fatal
+     *          messages too important to drop, so neither is limited. Defaults to `10`; `0` turns the limit off.
+     */
+    void set_log_rate_limit(uint32_t per_second);
+
+    /**
+     * @fn bool configure_logging(const std::string &filters)
+     * @brief Apply filters from a string, like `"info,vk=debug,shaders=off,rate=20"`.
+     * @details Filters are separated by commas, whitespace or new lines, and applied in order:
+     *          - `<level>` sets the level of every module;
+     *          - `<module>=<level>` sets the level of one module;
+     *          - `rate=<n>` calls `set_log_rate_limit(n)`.
+     *          Levels are `trace`, `debug`, `info`, `warn`, `fatal` (or `critical`) and `off`. Everything after a `#` on
+     *          a line is a comment.
+     * @return False if any filter was invalid. The valid ones are applied anyway.
+     */
+    bool configure_logging(const std::string &filters);
+
+    /**
+     * @fn bool load_log_config(const std::string &path, bool watch = true)
+     * @brief Apply the filters in a file. See `configure_logging()`.
+     * @param watch If true, the logging thread applies the file again whenever it changes, checking once a second.
+     *              Only with `HP_ASYNC_LOGGING_ENABLED`.
+     * @return False if the file couldn't be read or had invalid filters.
+     */
+    bool load_log_config(const std::string &path, bool watch = true);
+
+    /**
+     * @fn void flush_logs()
+     * @brief Block until every message logged before the call has been written and the sinks are flushed.
+     * @details Called by `quit_logging()`, and before `std::terminate()` runs its previous handler. Only does anything
+     *          with `HP_ASYNC_LOGGING_ENABLED`.
+     */
+    void flush_logs();
+
+    /**
+     * @fn void quit_logging()
+     * @brief Write all pending messages and stop the logging thread. Later messages are written on the calling
+     *        thread.
+     * @details Registered with `std::atexit()` by `init_logging()`, so calling it yourself is optional.
+     */
+    void quit_logging();
+
+    namespace detail {
+        /**
+         * @struct log_site
+         * @private
+         * @brief Static description of one logging macro invocation.
+         */
+        struct log_site {
+            spdlog::level::level_enum level; ///< @private
+            log_module module; ///< @private
+            const char *file; ///< @private
+            const char *func; ///< @private
+            int line; ///< @private
+            std::atomic<long long> window_start{0}; ///< @private Start of the current rate limit second, in ns.
+            std::atomic<uint32_t> window_count{0}; ///< @private Messages so far in that second.
+        };
+
+        /**
+         * @fn constexpr bool path_contains(const char *path, const char *part)
+         * @private
+         * @brief `strstr()` for compile time, treating `\\` as `/`.
+         */
+        constexpr bool path_contains(const char *path, const char *part) {
+            for (; *path != '\0'; path++) {
+                const char *a = path, *b = part;
+                while (*b != '\0' && (*a == *b || (*a == '\\' && *b == '/'))) {
+                    a++;
+                    b++;
+                }
+                if (*b == '\0') {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * @fn constexpr log_module module_of(const char *file)
+         * @private
+         * @brief Find the module a source file belongs to. See `log_module`.
+         */
+        constexpr log_module module_of(const char *file) {
+            if (path_contains(file, "hp/vk/shaders")) return log_module::shaders;
+            if (path_contains(file, "hp/vk/buffers")) return log_module::buffers;
+            if (path_contains(file, "hp/vk/gpu_profiler") || path_contains(file, "hp/profiling") ||
+                path_contains(file, "hp/trace_format") || path_contains(file, "hp/capture_server") ||
+                path_contains(file, "hp/clock") || path_contains(file, "hp/memory_tracking")) {
+                return log_module::profiling;
+            }
+            if (path_contains(file, "hp/vk/")) return log_module::vk;
+            if (path_contains(file, "hp/multithreading") || path_contains(file, "hp/task") ||
+                path_contains(file, "hp/parallel") || path_contains(file, "hp/queues") ||
+                path_contains(file, "hp/frame_pipeline")) {
+                return log_module::threading;
+            }
+            if (path_contains(file, "include/hp/") || path_contains(file, "src/hp/")) return log_module::core;
+            return log_module::app;
+        }
+
+        /**
+         * @var extern std::atomic<uint8_t> log_levels[log_module_count]
+         * @private
+         * @brief The lowest level logged for each module.
+         */
+        extern std::atomic<uint8_t> log_levels[log_module_count];
+
+        /**
+         * @var extern std::atomic<uint32_t> log_rate_limit
+         * @private
+         * @brief See `set_log_rate_limit()`.
+         */
+        extern std::atomic<uint32_t> log_rate_limit;
+
+        /**
+         * @fn bool log_rate_check(log_site &site, uint32_t limit)
+         * @private
+         * @brief Count a message against its site's limit for the current second.
+         * @return False if it should be dropped.
+         */
+        bool log_rate_check(log_site &site, uint32_t limit);
+
+        /**
+         * @fn inline bool log_enabled(log_site &site)
+         * @private
+         * @brief Check a message against its module's level, and the rate limit.
+         */
+        inline bool log_enabled(log_site &site) {
+            if (site.level < log_levels[static_cast<size_t>(site.module)].load(std::memory_order_relaxed)) {
+                return false;
+            }
+            if (site.level >= spdlog::level::info && site.level < spdlog::level::err) {
+                const uint32_t limit = log_rate_limit.load(std::memory_order_relaxed);
+                return limit == 0 || log_rate_check(site, limit);
+            }
+            return true;
+        }
+
+        /**
+         * @var constexpr size_t log_record_size
+         * @private
+         * @brief Size of a `log_record` in bytes. Messages whose arguments don't fit are formatted on the calling thread.
+         */
+        constexpr size_t log_record_size = 256;
+
+        /**
+         * @struct log_record
+         * @private
+         * @brief One message in a thread's log ring: Either a format string, a decoder, and the encoded arguments, or a
+         *        message already formatted on the calling thread.
+         */
+        struct log_record {
+            const log_site *site; ///< @private
+            const char *format; ///< @private `nullptr` if `formatted` holds the message.
+            std::string (*decode)(const char *format, const char *args); ///< @private
+            std::string *formatted; ///< @private Owned by the record; Deleted once written.
+            uint64_t ticks; ///< @private
+            char args[log_record_size - 5 * sizeof(void *)]; ///< @private
+        };
+
+        /**
+         * @var extern std::atomic<bool> log_thread_running
+         * @private
+         * @brief `true` while the logging thread takes records. Otherwise messages are written synchronously.
+         */
+        extern std::atomic<bool> log_thread_running;
+
+        /**
+         * @fn void push_log(const log_record &rec)
+         * @private
+         * @brief Push a record onto the calling thread's log ring, waiting for space if it is full.
+         */
+        void push_log(const log_record &rec);
+
+        /**
+         * @fn void write_log(const log_site &site, std::string_view message)
+         * @private
+         * @brief Write a formatted message to the sinks on the calling thread.
+         */
+        void write_log(const log_site &site, std::string_view message);
+
+        /**
+         * @var template<typename T> constexpr bool log_arg_is_string
+         * @private
+         * @brief `true` for arguments copied as their characters: C strings, `std::string`, `std::string_view`, ...
+         */
+        template<typename T>
+        constexpr bool log_arg_is_string = std::is_convertible_v<const T &, std::string_view>;
+
+        /**
+         * @var template<typename T> constexpr bool log_arg_deferrable
+         * @private
+         * @brief `true` for arguments that can be copied into a `log_record` and formatted later.
+         */
+        template<typename T>
+        constexpr bool log_arg_deferrable = log_arg_is_string<T> || std::is_trivially_copyable_v<T>;
+
+        /**
+         * @private
+         * @brief The type an encoded argument decodes into: Strings are viewed in place within the record.
+         */
+        template<typename T>
+        using log_arg_t = std::conditional_t<log_arg_is_string<T>, std::string_view, T>;
+
+        /**
+         * @fn template<typename T> size_t log_arg_size(const T &arg)
+         * @private
+         * @brief Number of bytes an argument takes in a record.
+         */
+        template<typename T>
+        size_t log_arg_size(const T &arg) {
+            if constexpr (log_arg_is_string<T>) {
+                return sizeof(uint32_t) + std::string_view(arg).size();
+            } else {
+                return sizeof(T);
+            }
+        }
+
+        /**
+         * @fn template<typename T> char *encode_log_arg(char *out, const T &arg)
+         * @private
+         * @brief Copy an argument into a record.
+         * @return Where the next argument goes.
+         */
+        template<typename T>
+        char *encode_log_arg(char *out, const T &arg) {
+            if constexpr (log_arg_is_string<T>) {
+                const std::string_view str(arg);
+                const auto len = static_cast<uint32_t>(str.size());
+                std::memcpy(out, &len, sizeof(len));
+                std::memcpy(out + sizeof(len), str.data(), len);
+                return out + sizeof(len) + len;
+            } else {
+                std::memcpy(out, &arg, sizeof(T));
+                return out + sizeof(T);
+            }
+        }
+
+        /**
+         * @fn template<typename T> log_arg_t<T> decode_log_arg(const char *&in)
+         * @private
+         * @brief Read back an argument written by `encode_log_arg()`.
+         */
+        template<typename T>
+        log_arg_t<T> decode_log_arg(const char *&in) {
+            if constexpr (log_arg_is_string<T>) {
+                uint32_t len;
+                std::memcpy(&len, in, sizeof(len));
+                const std::string_view str(in + sizeof(len), len);
+                in += sizeof(len) + len;
+                return str;
+            } else {
+                T arg;
+                std::memcpy(&arg, in, sizeof(T));
+                in += sizeof(T);
+                return arg;
+            }
+        }
+
+        /**
+         * @fn template<typename... Args> std::string decode_log(const char *format, const char *args)
+         * @private
+         * @brief Decode the arguments of a record and format the message. Runs on the logging thread.
+         */
+        template<typename... Args>
+        std::string decode_log(const char *format, [[maybe_unused]] const char *args) {
+            // Braced initialization evaluates left to right, in the order the arguments were encoded.
+            const std::tuple<log_arg_t<Args>...> values{decode_log_arg<Args>(args)...};
+            return std::apply([format](const auto &...vals) {
+                return fmt::vformat(format, fmt::make_format_args(vals...));
+            }, values);
+        }
+
+        /**
+         * @fn constexpr bool is_literal_format(const char *args_text)
+         * @private
+         * @brief Check the source text of a logging macro's arguments, as stringized by `HP_LOG`, for a format that is
+         *        a string literal.
+         * @details An array argument alone could also be a buffer on the stack, which may be gone by the time the
+         *          logging thread formats the message.
+         */
+        constexpr bool is_literal_format(const char *args_text) {
+            return args_text[0] == '"';
+        }
+
+        /**
+         * @fn template<bool Literal, typename S, typename... Args> void log_message(log_site &site, const S &format, const Args &...args)
+         * @private
+         * @brief Log a message. If the format is a string literal (`Literal`, see `is_literal_format()`), only copies
+         *        the arguments unless they are too big or not trivially copyable. Otherwise formats right away, since
+         *        the format may not outlive the call.
+         */
+        template<bool Literal, typename S, typename... Args>
+        void log_message(log_site &site, const S &format, const Args &...args) {
+            if (!log_enabled(site)) {
+                return;
+            }
+
+            if constexpr (Literal && std::is_array_v<S> && (log_arg_deferrable<Args> && ...)) {
+                if (log_thread_running.load(std::memory_order_relaxed) &&
+                    (size_t(0) + ... + log_arg_size(args)) <= sizeof(log_record::args)) {
+                    log_record rec;  // NOLINT: Only the encoded bytes of `args` are ever read.
+                    rec.site = &site;
+                    rec.format = format;
+                    rec.decode = &decode_log<Args...>;
+                    rec.formatted = nullptr;
+                    rec.ticks = clock::ticks();
+                    char *out = rec.args;
+                    ((out = encode_log_arg(out, args)), ...);
+                    push_log(rec);
+                    return;
+                }
+            }
+
+            std::string message = fmt::vformat(format, fmt::make_format_args(args...));
+            if (log_thread_running.load(std::memory_order_relaxed)) {
+                push_log(log_record{&site, nullptr, nullptr, new std::string(std::move(message)), clock::ticks(), {}});
+            } else {
+                write_log(site, message);
+            }
+        }
+    }
 }
 
 /**
@@ -110,53 +492,70 @@ namespace hp {
 
 #ifdef HP_LOGGING_ENABLED
 
+/**
+ * @def HP_LOG(lvl, ...)
+ * @brief Log a message at an `SPDLOG_LEVEL_*` level. Used by the other logging macros.
+ * @details Like spdlog's macros, compiles to nothing below `SPDLOG_ACTIVE_LEVEL`. Messages below their module's
+ *          runtime level only cost a load and a branch. With `HP_ASYNC_LOGGING_ENABLED`, if the format is a string
+ *          literal written right in the invocation and the arguments are strings or trivially copyable, the calling
+ *          thread only copies them into its log ring, which costs tens of nanoseconds. Any other format, like a
+ *          `char` buffer, is formatted on the calling thread.
+ */
+#define HP_LOG(lvl, ...) do { \
+        if (SPDLOG_ACTIVE_LEVEL <= (lvl)) { \
+            static ::hp::detail::log_site __hp_log_site{static_cast<spdlog::level::level_enum>(lvl), \
+                    ::hp::detail::module_of(__FILE__), __FILE__, BOOST_CURRENT_FUNCTION, __LINE__}; \
+            ::hp::detail::log_message<::hp::detail::is_literal_format(#__VA_ARGS__)>(__hp_log_site, __VA_ARGS__); \
+        } \
+    } while (false)
+
 /**
  * @def HP_TRACE
- * @brief Logging macro aliases to `SPDLOG_TRACE`. See the [spdlog documentation](https://github.com/gabime/spdlog/wiki/1.-QuickStart#logging-macros).
+ * @brief Logging macro at `SPDLOG_LEVEL_TRACE`. See `HP_LOG`.
  * @details This macro would be disabled (ie. `#define HP_TRACE(...)`) if `HP_LOGGING_ENABLED` is not defined.
  *          Example usage: `HP_TRACE("Logging message! Values: {}, {}, {}", 2, 3.1415, "Test");`
  */
-#define HP_TRACE SPDLOG_TRACE
+#define HP_TRACE(...) HP_LOG(SPDLOG_LEVEL_TRACE, __VA_ARGS__)
 
 /**
  * @def HP_DEBUG
- * @brief Logging macro aliases to `SPDLOG_DEBUG`. See the [spdlog documentation](https://github.com/gabime/spdlog/wiki/1.-QuickStart#logging-macros).
+ * @brief Logging macro at `SPDLOG_LEVEL_DEBUG`. See `HP_LOG`.
  * @details This macro would be disabled (ie. `#define HP_DEBUG(...)`) if `HP_LOGGING_ENABLED` is not defined.
  *          Example usage: `HP_DEBUG("Logging message! Values: {}, {}, {}", 2, 3.1415, "Test");`
  */
-#define HP_DEBUG SPDLOG_DEBUG
+#define HP_DEBUG(...) HP_LOG(SPDLOG_LEVEL_DEBUG, __VA_ARGS__)
 
 /**
  * @def HP_INFO
- * @brief Logging macro aliases to `SPDLOG_INFO`. See the [spdlog documentation](https://github.com/gabime/spdlog/wiki/1.-QuickStart#logging-macros).
+ * @brief Logging macro at `SPDLOG_LEVEL_INFO`. See `HP_LOG`.
  * @details This macro would be disabled (ie. `#define HP_INFO(...)`) if `HP_LOGGING_ENABLED` is not defined.
  *          Example usage: `HP_INFO("Logging message! Values: {}, {}, {}", 2, 3.1415, "Test");`
  */
-#define HP_INFO SPDLOG_INFO
+#define HP_INFO(...) HP_LOG(SPDLOG_LEVEL_INFO, __VA_ARGS__)
 
 /**
  * @def HP_WARN
- * @brief Logging macro aliases to `SPDLOG_WARN`. See the [spdlog documentation](https://github.com/gabime/spdlog/wiki/1.-QuickStart#logging-macros).
+ * @brief Logging macro at `SPDLOG_LEVEL_WARN`. See `HP_LOG`.
  * @details This macro would be disabled (ie. `#define HP_WARN(...)`) if `HP_LOGGING_ENABLED` is not defined.
  *          Example usage: `HP_WARN("Logging message! Values: {}, {}, {}", 2, 3.1415, "Test");`
  */
-#define HP_WARN SPDLOG_WARN
+#define HP_WARN(...) HP_LOG(SPDLOG_LEVEL_WARN, __VA_ARGS__)
 
 /**
  * @def HP_FATAL
- * @brief Logging macro aliases to `SPDLOG_CRITICAL`. See the [spdlog documentation](https://github.com/gabime/spdlog/wiki/1.-QuickStart#logging-macros).
+ * @brief Logging macro at `SPDLOG_LEVEL_CRITICAL`. See `HP_LOG`.
  * @details This macro would be disabled (ie. `#define HP_FATAL(...)`) if `HP_LOGGING_ENABLED` is not defined.
  *          Example usage: `HP_FATAL("Logging message! Values: {}, {}, {}", 2, 3.1415, "Test");`
  */
-#define HP_FATAL SPDLOG_CRITICAL
+#define HP_FATAL(...) HP_LOG(SPDLOG_LEVEL_CRITICAL, __VA_ARGS__)
 
 /**
  * @def HP_CRITICAL
- * @brief Logging macro aliases to `SPDLOG_CRITICAL`. See the [spdlog documentation](https://github.com/gabime/spdlog/wiki/1.-QuickStart#logging-macros).
+ * @brief Logging macro at `SPDLOG_LEVEL_CRITICAL`. See `HP_LOG`.
  * @details This macro would be disabled (ie. `#define HP_CRITICAL(...)`) if `HP_LOGGING_ENABLED` is not defined.
  *          Example usage: `HP_CRITICAL("Logging message! Values: {}, {}, {}", 2, 3.1415, "Test");`
  */
-#define HP_CRITICAL SPDLOG_CRITICAL
+#define HP_CRITICAL(...) HP_LOG(SPDLOG_LEVEL_CRITICAL, __VA_ARGS__)
 
 #else
 
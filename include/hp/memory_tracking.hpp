@@ -0,0 +1,150 @@
+/**
+ * @file memory_tracking.hpp
+ * @brief Counters of heap and device memory, sampled into profiler traces once per frame.
+ * @details Every tracked call site gets a `memory_counter`, named after the call site. Allocations and frees only
+ *          update atomics; Once per frame, `profiler_session::frame_end()` samples every counter that changed into the
+ *          `default_session`, where they show up as counter tracks (`"ph": "C"` in Chrome trace JSON), lined up with
+ *          the zones of the same frame. Each sample has the bytes still allocated, the peak during the frame and the
+ *          number of allocations made during the frame.
+ *          Track allocations with `HP_TRACK_ALLOC` and `HP_TRACK_FREE`, which compile to nothing unless
+ *          `HP_MEMORY_TRACKING_ENABLED` is defined. Define `HP_TRACK_GLOBAL_NEW` as well to count every
+ *          `operator new` of the program under `"operator new"`. See `config.hpp`.
+ */
+
+#pragma once
+
+#ifndef __HEPHAESTUS_MEMORY_TRACKING_HPP
+/**
+ * @def __HEPHAESTUS_MEMORY_TRACKING_HPP
+ * @brief This macro is defined if `memory_tracking.hpp` has been included.
+ */
+#define __HEPHAESTUS_MEMORY_TRACKING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "config.hpp"
+#include "profiling.hpp"
+
+namespace hp {
+    /**
+     * @class memory_counter
+     * @brief Live bytes, peak bytes and allocation count of one call site. Updating it never allocates or locks.
+     * @details Counters register themselves on construction and are never unregistered, so they *MUST* have static
+     *          storage duration. Get them from `intern_memory_counter()`, or through `HP_TRACK_ALLOC`.
+     */
+    class memory_counter {
+    public:
+        /**
+         * @fn memory_counter(const char *name, const char *category, const char *file, unsigned line)
+         * @brief Construct and register a counter. Doesn't allocate, so it is safe inside `operator new`.
+         * @param name Name of the counter in traces. Must outlive the program, like a string literal.
+         * @param category Category of the counter, such as `"heap"` or `"device"`. Must outlive the program.
+         * @param file Source file of the call site, or `""` if unknown.
+         * @param line Source line of the call site, or 0 if unknown.
+         */
+        memory_counter(const char *name, const char *category, const char *file, unsigned line);
+
+        memory_counter(const memory_counter &other) = delete; ///< @private
+        memory_counter &operator=(const memory_counter &other) = delete; ///< @private
+
+        /**
+         * @fn inline void on_alloc(size_t bytes)
+         * @brief Count an allocation. Thread safe.
+         */
+        inline void on_alloc(size_t bytes) {
+            const auto live = live_bytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed) +
+                              static_cast<int64_t>(bytes);
+            frame_allocs.fetch_add(1, std::memory_order_relaxed);
+
+            int64_t peak = peak_bytes.load(std::memory_order_relaxed);
+            while (live > peak && !peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+        }
+
+        /**
+         * @fn inline void on_free(size_t bytes)
+         * @brief Count a free of memory counted by `on_alloc()`. Thread safe.
+         */
+        inline void on_free(size_t bytes) {
+            live_bytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+        }
+
+        /**
+         * @fn [[nodiscard]] inline int64_t bytes() const
+         * @brief Query the number of bytes allocated and not yet freed.
+         */
+        [[nodiscard]] inline int64_t bytes() const {
+            return live_bytes.load(std::memory_order_relaxed);
+        }
+
+        const char *const name; ///< Name of the counter in traces.
+        const char *const category; ///< Category of the counter in traces.
+        const char *const file; ///< Source file of the call site.
+        const unsigned line; ///< Source line of the call site.
+
+    private:
+        friend void sample_memory_counters(profiler_session *session, uint32_t frame, uint64_t time);
+
+        std::atomic<int64_t> live_bytes{0}; ///< @private
+        std::atomic<int64_t> peak_bytes{0}; ///< @private Reset to `live_bytes` by every sample.
+        std::atomic<uint64_t> frame_allocs{0}; ///< @private Reset to 0 by every sample.
+        memory_counter *next = nullptr; ///< @private Intrusive list of every counter.
+
+        const zone_desc *zone = nullptr; ///< @private Registered by the first sample. Only touched by the sampler.
+        int64_t last_bytes = 0; ///< @private Last sample, only touched by the sampler.
+        int64_t last_peak = 0; ///< @private
+        uint64_t last_allocs = 0; ///< @private
+    };
+
+    /**
+     * @fn memory_counter &intern_memory_counter(const char *name, const char *category, const char *file = "", unsigned line = 0)
+     * @brief Find or create the counter with a name, so an allocation and its free can be counted in different places.
+     * @details Takes a lock, so keep the returned reference (a function-local `static` is ideal). The first call for
+     *          a name sets its category and source location.
+     */
+    memory_counter &intern_memory_counter(const char *name, const char *category, const char *file = "",
+                                          unsigned line = 0);
+
+    /**
+     * @fn void sample_memory_counters(profiler_session *session, uint32_t frame, uint64_t time)
+     * @brief Record every counter that changed since the last sample to a session, and start a new frame peak.
+     * @details Called by `profiler_session::frame_end()`; There is no need to call it yourself in loops that mark
+     *          frames. Call it from one thread at a time.
+     * @param session Session to record to. Counters are still reset if it is `nullptr`.
+     * @param frame Frame the samples end.
+     * @param time Time of the samples in `hp::clock` ticks.
+     */
+    void sample_memory_counters(profiler_session *session, uint32_t frame, uint64_t time);
+}
+
+#ifdef HP_MEMORY_TRACKING_ENABLED
+/**
+ * @def HP_TRACK_ALLOC
+ * @brief Count an allocation of `bytes` to the counter called `name`.
+ * @details The counter is looked up only the first time the line runs.
+ *          Example Usage: `HP_TRACK_ALLOC("window::new_buffer", "heap", sizeof(generic_buffer));`
+ */
+#define HP_TRACK_ALLOC(name, category, bytes) do { static ::hp::memory_counter &HP_CONCAT(__hp_mem_, __LINE__) = ::hp::intern_memory_counter(name, category, __FILE__, __LINE__); HP_CONCAT(__hp_mem_, __LINE__).on_alloc(bytes); } while (false)
+
+/**
+ * @def HP_TRACK_FREE
+ * @brief Count a free of `bytes` to the counter called `name`. Use the same name as the matching `HP_TRACK_ALLOC`.
+ */
+#define HP_TRACK_FREE(name, category, bytes) do { static ::hp::memory_counter &HP_CONCAT(__hp_mem_, __LINE__) = ::hp::intern_memory_counter(name, category, __FILE__, __LINE__); HP_CONCAT(__hp_mem_, __LINE__).on_free(bytes); } while (false)
+#else
+
+/**
+ * @def HP_TRACK_ALLOC
+ * @brief Count an allocation of `bytes` to the counter called `name`.
+ */
+#define HP_TRACK_ALLOC(name, category, bytes) do {} while (false)
+
+/**
+ * @def HP_TRACK_FREE
+ * @brief Count a free of `bytes` to the counter called `name`.
+ */
+#define HP_TRACK_FREE(name, category, bytes) do {} while (false)
+#endif
+
+#endif //__HEPHAESTUS_MEMORY_TRACKING_HPP
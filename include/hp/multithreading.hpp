@@ -1,6 +1,6 @@
 /**
  * @file multithreading.hpp
- * @brief Provide thread pool functionality using boost.
+ * @brief Provide thread pool functionality: A work-stealing job system for CPU work, and a boost pool for blocking IO.
  */
 
 #pragma once
@@ -12,33 +12,639 @@
  */
 #define __HEPHAESTUS_MULTITHREADING_HPP
 
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include <boost/asio/io_service.hpp>
 #include <boost/bind.hpp>
 #include <boost/thread/thread.hpp>
 
+#include "queues.hpp"
+
 namespace hp {
+    /**
+     * @class work_stealing_deque
+     * @brief Chase-Lev work-stealing deque: The owning thread pushes and pops at the bottom, any thread steals from the top.
+     * @details Lock-free, and grows when full. Outgrown arrays are kept until the deque is destroyed, since a thief may
+     *          still be reading from them. Follows "Correct and Efficient Work-Stealing for Weak Memory Models"
+     *          (Lê, Pop, Cohen, Zappa Nardelli; PPoPP 2013).
+     * @note `T` must be trivially copyable, and `T{}` is returned for "nothing". Pointers are ideal.
+     */
+    template<typename T>
+    class work_stealing_deque {
+    public:
+        /**
+         * @fn explicit work_stealing_deque(size_t capacity = 1024)
+         * @brief Construct an empty deque.
+         * @param capacity Initial capacity. Must be a power of two.
+         */
+        explicit work_stealing_deque(size_t capacity = 1024) {
+            rings.emplace_back(std::make_unique<ring>(capacity));
+            buf.store(rings.back().get(), std::memory_order_relaxed);
+        }
+
+        work_stealing_deque(const work_stealing_deque &other) = delete; ///< @private
+        work_stealing_deque &operator=(const work_stealing_deque &other) = delete; ///< @private
+
+        /**
+         * @fn void push(T item)
+         * @brief Push an item to the bottom. Owning thread only.
+         */
+        void push(T item) {
+            const int64_t b = bottom.load(std::memory_order_relaxed);
+            const int64_t t = top.load(std::memory_order_acquire);
+            ring *arr = buf.load(std::memory_order_relaxed);
+            if (b - t > static_cast<int64_t>(arr->mask)) {
+                arr = grow(arr, b, t);
+            }
+
+            arr->put(b, item);
+            bottom.store(b + 1, std::memory_order_release);  // Publishes the item, and whatever it points to.
+        }
+
+        /**
+         * @fn T pop()
+         * @brief Pop the most recently pushed item. Owning thread only.
+         * @return The item, or `T{}` if the deque is empty or a thief took the last item.
+         */
+        T pop() {
+            const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            ring *arr = buf.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+
+            T item{};
+            if (t <= b) {
+                item = arr->get(b);
+                if (t == b) {  // Last item: Race the thieves for it.
+                    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                     std::memory_order_relaxed)) {
+                        item = T{};
+                    }
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                }
+            } else {
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return item;
+        }
+
+        /**
+         * @fn T steal()
+         * @brief Take the least recently pushed item. Any thread.
+         * @return The item, or `T{}` if the deque is empty or another thread got there first.
+         */
+        T steal() {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t b = bottom.load(std::memory_order_acquire);
+
+            if (t < b) {
+                ring *arr = buf.load(std::memory_order_acquire);
+                T item = arr->get(t);
+                if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    return item;
+                }
+            }
+            return T{};
+        }
+
+        /**
+         * @fn [[nodiscard]] inline bool empty() const
+         * @brief Query if the deque looks empty. Only a hint while other threads use it.
+         */
+        [[nodiscard]] inline bool empty() const {
+            return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static_assert(std::is_trivially_copyable<T>::value, "work_stealing_deque items must be trivially copyable!");
+
+        struct ring { ///< @private
+            size_t mask; ///< @private
+            std::unique_ptr<std::atomic<T>[]> slots; ///< @private
+
+            explicit ring(size_t capacity) : mask(capacity - 1), slots(new std::atomic<T>[capacity]) {}
+
+            inline T get(int64_t i) const { ///< @private
+                return slots[static_cast<size_t>(i) & mask].load(std::memory_order_relaxed);
+            }
+
+            inline void put(int64_t i, T item) { ///< @private
+                slots[static_cast<size_t>(i) & mask].store(item, std::memory_order_relaxed);
+            }
+        };
+
+        ring *grow(ring *old, int64_t b, int64_t t) { ///< @private
+            rings.emplace_back(std::make_unique<ring>((old->mask + 1) * 2));
+            ring *arr = rings.back().get();
+            for (int64_t i = t; i < b; i++) {
+                arr->put(i, old->get(i));
+            }
+            buf.store(arr, std::memory_order_release);
+            return arr;
+        }
+
+        alignas(64) std::atomic<int64_t> top{0}; ///< @private
+        alignas(64) std::atomic<int64_t> bottom{0}; ///< @private
+        alignas(64) std::atomic<ring *> buf{nullptr}; ///< @private
+        std::vector<std::unique_ptr<ring>> rings; ///< @private Owning thread only.
+    };
+
+    class job_system;
+
+    struct job_pool;
+
+    struct job_fiber;
+
+    /**
+     * @class job_counter
+     * @brief Counts unfinished jobs, so a group of jobs can be waited on with `job_system::wait()`.
+     * @details Pass the same counter to several `job_system::submit()` calls to join on all of them. Reusable once
+     *          it reaches zero. Must outlive the jobs counted by it.
+     *          It also works as a latch for work that isn't a job: `add()` before starting it, and `signal()` once
+     *          it's done.
+     */
+    class job_counter {
+    public:
+        /**
+         * @fn inline void add(uint32_t n = 1)
+         * @brief Count `n` more things to wait for. Call it before they can possibly finish.
+         */
+        inline void add(uint32_t n = 1) {
+            pending.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        /**
+         * @fn inline void signal(uint32_t n = 1)
+         * @brief Mark `n` things counted by `add()` as finished.
+         */
+        inline void signal(uint32_t n = 1) {
+            pending.fetch_sub(n, std::memory_order_release);
+        }
+
+        /**
+         * @fn [[nodiscard]] inline bool done() const
+         * @brief Query if every job counted by this counter has finished.
+         */
+        [[nodiscard]] inline bool done() const {
+            return pending.load(std::memory_order_acquire) == 0;
+        }
+
+        /**
+         * @fn [[nodiscard]] inline uint32_t count() const
+         * @brief Query the number of unfinished jobs.
+         */
+        [[nodiscard]] inline uint32_t count() const {
+            return pending.load(std::memory_order_acquire);
+        }
+
+    private:
+        friend class job_system;
+
+        std::atomic<uint32_t> pending{0}; ///< @private
+    };
+
+    /**
+     * @struct job_waiter
+     * @brief Something waiting for a condition, like a suspended fiber or coroutine. See `job_system::park()`.
+     * @details Must stay alive and in place from `park()` until `resume` is called.
+     */
+    struct job_waiter {
+        /**
+         * @var bool (*ready)(job_waiter &w)
+         * @brief Query if done waiting. Called by polling workers, so it must be cheap, thread safe and never wait.
+         */
+        bool (*ready)(job_waiter &w) = nullptr;
+
+        /**
+         * @var void (*resume)(job_waiter &w)
+         * @brief Called from a job once `ready` returned true.
+         */
+        void (*resume)(job_waiter &w) = nullptr;
+
+        job_waiter *next = nullptr; ///< @private
+    };
+
+    /**
+     * @class job
+     * @brief A unit of work for the `job_system`. Allocated from per-thread pools by `job_system::submit()`.
+     * @details Exactly two cache lines. Callables of up to `inline_size` bytes are stored in the job itself; Larger
+     *          ones are allocated with `new`. Jobs from `job_system::submit_fiber()` run on a fiber of their own.
+     */
+    class alignas(64) job {
+    public:
+        /**
+         * @var static constexpr size_t inline_size
+         * @brief Largest callable stored in the job without a separate allocation.
+         */
+        static constexpr size_t inline_size = 88;
+
+    private:
+        friend class job_system;
+
+        friend struct job_pool;
+
+        using invoke_fn = void (*)(job &); ///< @private Runs and destroys the callable.
+
+        template<typename F>
+        static void invoke_inline(job &j) { ///< @private
+            F &fn = *std::launder(reinterpret_cast<F *>(j.storage));
+            fn();
+            fn.~F();
+        }
+
+        template<typename F>
+        static void invoke_heap(job &j) { ///< @private
+            std::unique_ptr<F> fn(*std::launder(reinterpret_cast<F **>(j.storage)));
+            (*fn)();
+        }
+
+        invoke_fn invoke = nullptr; ///< @private
+        job_counter *counter = nullptr; ///< @private
+        job_pool *pool = nullptr; ///< @private Pool the job is returned to.
+        job *next = nullptr; ///< @private Free list link.
+        alignas(std::max_align_t) unsigned char storage[inline_size]; ///< @private
+        bool fiber = false; ///< @private Run on a fiber, so it can suspend.
+    };
+
+    /**
+     * @enum thread_priority
+     * @brief Scheduling priority of a thread, relative to the process's other threads.
+     */
+    enum class thread_priority {
+        low, ///< Background work that may wait, like asset streaming. Nice 10 on Linux, utility QoS on macOS.
+        normal, ///< The OS's default.
+        high ///< Work frames wait on. Nice -5 on Linux, which needs `CAP_SYS_NICE`; User interactive QoS on macOS.
+    };
+
+    /**
+     * @fn bool configure_thread(const std::string &name, thread_priority priority = thread_priority::normal, int cpu = -1)
+     * @brief Name the calling thread (see `hp::set_thread_name()`), set its priority, and optionally pin it to a CPU.
+     * @details Workers are configured with this when they start. Call it on the render thread too, and keep the
+     *          workers off its CPU with `worker_options::cpus`.
+     * @param cpu Index of the CPU to run on, or `-1` to let the OS choose. Not supported on macOS, which has no hard
+     *            affinity.
+     * @return False if the priority or the pinning couldn't be applied. A warning is logged then.
+     */
+    bool configure_thread(const std::string &name, thread_priority priority = thread_priority::normal, int cpu = -1);
+
+    /**
+     * @struct worker_options
+     * @brief How a `job_system` sets up its workers.
+     */
+    struct worker_options {
+        /**
+         * @var std::string name
+         * @brief Workers are named `"<name> <index>"`, for debuggers and profiler traces.
+         */
+        std::string name = "Worker";
+
+        /**
+         * @var thread_priority priority
+         * @brief Priority of every worker.
+         */
+        thread_priority priority = thread_priority::normal;
+
+        /**
+         * @var std::vector<int> cpus
+         * @brief CPUs to pin the workers to: Worker `i` runs on `cpus[i % cpus.size()]`. Empty to not pin them.
+         */
+        std::vector<int> cpus;
+
+        /**
+         * @var bool numa_local
+         * @brief Allocate each worker's deque and job pool on the worker itself, after pinning it.
+         * @details Relies on the OS placing memory on the NUMA node of the CPU that first touches it, as Linux and
+         *          Windows do by default. Only useful together with `cpus`.
+         */
+        bool numa_local = false;
+    };
+
+    /**
+     * @class job_system
+     * @brief Work-stealing thread pool for short CPU jobs, with one worker per core.
+     * @details Every worker has its own `work_stealing_deque`: Jobs submitted from a worker go to its own deque and
+     *          are popped newest-first (cache friendly), while idle workers steal the oldest jobs of others.
+     *          Jobs submitted from other threads go to a shared lock-free `mpmc_queue`. Idle workers spin briefly, then sleep until
+     *          new work is submitted. Jobs come from per-thread pools, so submitting doesn't allocate once warm.
+     *          Jobs must not throw, and must not block for long; Use `hp::io_service` for blocking IO.
+     *
+     *          Jobs submitted with `submit_fiber()` run on a fiber with a stack of their own instead. When such a job
+     *          waits, with `wait()`, `wait_until()` or `wait_io()`, it is suspended and the worker runs other jobs.
+     *          Suspended fibers are parked, see `park()`: Workers poll the conditions they wait for between jobs, and
+     *          queue the fibers to be resumed, maybe on another worker, once they hold. Fibers and their stacks are pooled.
+     */
+    class job_system {
+    public:
+        /**
+         * @var static constexpr size_t fiber_stack_size
+         * @brief Stack size of fibers, in bytes. Stacks are followed by a guard page.
+         */
+        static constexpr size_t fiber_stack_size = 256u << 10u;
+
+        /**
+         * @fn explicit job_system(unsigned num_workers = 0, const worker_options &options = worker_options())
+         * @brief Start the workers, and wait until they are set up.
+         * @param num_workers Number of worker threads. If `0`, one less than the number of hardware threads, as the
+         *                    thread calling `wait()` helps run jobs too.
+         * @param options Names, priority and placement of the workers.
+         */
+        explicit job_system(unsigned num_workers = 0, const worker_options &options = worker_options());
+
+        /**
+         * @fn ~job_system()
+         * @brief Run every job that was submitted, then join the workers.
+         */
+        ~job_system();
+
+        job_system(const job_system &other) = delete; ///< @private
+        job_system &operator=(const job_system &other) = delete; ///< @private
+
+        /**
+         * @fn template<typename F> void submit(F &&fn, job_counter *counter = nullptr)
+         * @brief Queue a callable to run on a worker. Thread safe.
+         * @param fn Callable taking no arguments. Moved or copied into the job.
+         * @param counter Counter to count the job with until it finishes, or `nullptr`. See `wait()`.
+         */
+        template<typename F>
+        void submit(F &&fn, job_counter *counter = nullptr) {
+            push(make_job(std::forward<F>(fn), counter, false));
+        }
+
+        /**
+         * @fn template<typename F> void submit_fiber(F &&fn, job_counter *counter = nullptr)
+         * @brief Queue a callable to run on a fiber, so it can suspend while waiting instead of blocking its worker.
+         * @details Use it for jobs that wait on the GPU or IO. Starting a fiber costs a context switch and a lock,
+         *          so prefer `submit()` for jobs that never wait. Thread safe.
+         *          Example Usage:
+         *          ```
+         *          hp::jobs->submit_fiber([&]() { win->copy_buffer(staging, dest, true); finish_upload(); });
+         *          ```
+         * @param fn Callable taking no arguments. Moved or copied into the job.
+         * @param counter Counter to count the job with until it finishes, or `nullptr`. See `wait()`.
+         */
+        template<typename F>
+        void submit_fiber(F &&fn, job_counter *counter = nullptr) {
+            push(make_job(std::forward<F>(fn), counter, true));
+        }
+
+        /**
+         * @fn void wait(const job_counter &counter)
+         * @brief Wait until every job counted by `counter` has finished.
+         * @details Suspends the calling fiber if called from a job of `submit_fiber()`. Otherwise runs other jobs
+         *          until the counter is done.
+         */
+        void wait(const job_counter &counter);
+
+        /**
+         * @fn template<typename P> void wait_until(P &&ready)
+         * @brief Wait until a condition holds, like `wait()`.
+         * @details Suspended fibers get their condition checked by whichever worker polls, so it must be cheap,
+         *          thread safe, and must not wait itself, like querying a `vk::Fence`'s status.
+         * @param ready Callable taking no arguments and returning true once done waiting.
+         */
+        template<typename P>
+        void wait_until(P &&ready) {
+            using pred_type = std::remove_reference_t<P>;
+            wait_condition(condition{[](void *pred) { return static_cast<bool>((*static_cast<pred_type *>(pred))()); },
+                                     const_cast<void *>(static_cast<const void *>(&ready))});
+        }
+
+        /**
+         * @fn void park(job_waiter &w)
+         * @brief Have the workers poll `w.ready` between jobs, and run `w.resume` as a job once it returns true.
+         * @details This is how suspended fibers wait, and how to wait without a thread or fiber of one's own. Thread
+         *          safe.
+         */
+        void park(job_waiter &w);
+
+        /**
+         * @fn [[nodiscard]] bool in_fiber() const
+         * @brief Query if the calling code runs in a job of `submit_fiber()`, of any job system, so waiting suspends.
+         */
+        [[nodiscard]] bool in_fiber() const;
+
+        /**
+         * @fn bool run_one()
+         * @brief Run one queued job on the calling thread, if there is one.
+         * @return True if a job was run.
+         */
+        bool run_one();
+
+        /**
+         * @fn [[nodiscard]] inline unsigned worker_count() const
+         * @brief Query the number of worker threads.
+         */
+        [[nodiscard]] inline unsigned worker_count() const {
+            return static_cast<unsigned>(workers.size());
+        }
+
+        /**
+         * @fn int current_worker() const
+         * @brief Query the index of the calling thread among this system's workers, or -1 if it isn't one.
+         */
+        [[nodiscard]] int current_worker() const;
+
+    private:
+        friend struct job_fiber;
+
+        struct worker; ///< @private
+
+        struct condition { ///< @private Type erased condition to wait for.
+            bool (*check)(void *); ///< @private
+            void *arg; ///< @private
+
+            bool operator()() const { ///< @private
+                return check(arg);
+            }
+        };
+
+        template<typename F>
+        job *make_job(F &&fn, job_counter *counter, bool fiber) { ///< @private
+            using fn_type = std::decay_t<F>;
+
+            job *j = allocate();
+            if constexpr (sizeof(fn_type) <= job::inline_size && alignof(fn_type) <= alignof(std::max_align_t)) {
+                new(j->storage) fn_type(std::forward<F>(fn));
+                j->invoke = &job::invoke_inline<fn_type>;
+            } else {
+                new(j->storage) fn_type *(new fn_type(std::forward<F>(fn)));
+                j->invoke = &job::invoke_heap<fn_type>;
+            }
+
+            j->counter = counter;
+            j->fiber = fiber;
+            if (counter != nullptr) {
+                counter->add();
+            }
+            return j;
+        }
+
+        job *allocate(); ///< @private
+        void push(job *j); ///< @private
+        job *find_job(int self); ///< @private
+        void run_job(job *j); ///< @private
+        void finish_job(job *j); ///< @private
+        void start_fiber(job *j); ///< @private
+        void resume_fiber(job_fiber *f); ///< @private
+        void poll_waiters(); ///< @private
+        void wait_condition(const condition &ready); ///< @private
+        bool has_work() const; ///< @private
+        void worker_loop(unsigned index, const worker_options &options); ///< @private
+
+        const size_t id; ///< @private Tells systems apart in the thread local caches.
+        std::vector<std::unique_ptr<worker>> workers; ///< @private
+        std::vector<std::thread> threads; ///< @private
+        job_counter starting; ///< @private Workers still setting up.
+
+        mpmc_queue<job *> injected{4096}; ///< @private Jobs submitted by threads that aren't workers.
+        std::mutex overflow_mtx; ///< @private Guards `overflow`.
+        std::deque<job *> overflow; ///< @private Jobs submitted while `injected` was full.
+        std::atomic<size_t> injected_count{0}; ///< @private Jobs in `injected` and `overflow`.
+
+        std::mutex pools_mtx; ///< @private Guards `external_pools`.
+        std::vector<std::unique_ptr<job_pool>> external_pools; ///< @private Pools of threads that aren't workers.
+
+        std::mutex sleep_mtx; ///< @private
+        std::condition_variable sleep_cv; ///< @private
+        std::atomic<unsigned> sleepers{0}; ///< @private
+        std::atomic<bool> running{true}; ///< @private
+
+        std::mutex fiber_mtx; ///< @private Guards the fiber lists and `waiting`.
+        std::vector<std::unique_ptr<job_fiber>> fibers; ///< @private Every fiber ever started.
+        std::vector<job_fiber *> free_fibers; ///< @private Fibers to reuse.
+        std::vector<job_waiter *> waiting; ///< @private Parked waiters, like suspended fibers.
+        std::atomic<size_t> waiting_count{0}; ///< @private
+    };
+
+    /**
+     * @var extern job_system *jobs
+     * @brief The default job system, for work frames wait on. Constructed by `init_threads()`.
+     * @details Example Usage: `hp::job_counter ctr; hp::jobs->submit([&]() { cull(); }, &ctr); hp::jobs->wait(ctr);`
+     */
+    extern job_system *jobs;
+
+    /**
+     * @var extern job_system *background_jobs
+     * @brief Low priority job system, for work no frame waits on, like asset decoding. Constructed by `init_threads()`.
+     */
+    extern job_system *background_jobs;
+
     /**
      * @var extern boost::asio::io_service *io_service
-     * @brief Interface for submitting asynchronous tasks.
+     * @brief Interface for submitting asynchronous tasks that block, such as file or network IO.
      * @details Once the default thread pool has been constructed, you can submit a task using
      *           `"io_service->post"`. For example, `"io_service->post(boost::bind(printf, "Test"));"` would queue `"printf("Test")"` to be called by the threadpool. See boost documentation for more details.
+     *           Prefer `hp::jobs` for CPU work: This pool is a single shared queue, and is kept small.
      */
     extern boost::asio::io_service *io_service;
 
     /**
-     * @fn void init_threads(unsigned num_threads = 0)
-     * @brief Initialize/Construct the default thread pool.
+     * @fn template<typename F> void wait_io(job_system &js, F &&fn)
+     * @brief Run a blocking callable on `hp::io_service`, and wait for it with `job_system::wait()`.
+     * @details From a job of `job_system::submit_fiber()`, this suspends the job until the IO is done, so the
+     *          worker stays busy with other jobs.
+     *          Example Usage: `hp::wait_io(*hp::jobs, [&]() { bytes = read_file(path); });`
+     * @param fn Callable taking no arguments. Must not throw.
+     */
+    template<typename F>
+    void wait_io(job_system &js, F &&fn) {
+        job_counter done;
+        done.add();
+        io_service->post([&done, &fn]() {
+            fn();
+            done.signal();
+        });
+        js.wait(done);
+    }
+
+    /**
+     * @struct thread_options
+     * @brief Sizes and setup of the threads started by `init_threads()`.
+     * @details Example Usage, keeping CPU 0 for the render thread on an 8 core machine:
+     *          ```
+     *          hp::thread_options opts;
+     *          opts.workers.cpus = {1, 2, 3, 4, 5, 6, 7};
+     *          opts.workers.priority = hp::thread_priority::high;  // The workers no longer share CPU 0 with it.
+     *          hp::configure_thread("Render", hp::thread_priority::high, 0);
+     *          hp::init_threads(opts);
+     *          ```
+     */
+    struct thread_options {
+        /**
+         * @var unsigned num_workers
+         * @brief Number of `hp::jobs` workers. If `0`, one per hardware thread but one, or `8` if that's unknown.
+         */
+        unsigned num_workers = 0;
+
+        /**
+         * @var unsigned num_background_workers
+         * @brief Number of `hp::background_jobs` workers. If `0`, defaults to `1`.
+         */
+        unsigned num_background_workers = 1;
+
+        /**
+         * @var unsigned num_io_threads
+         * @brief Number of threads serving `hp::io_service`. If `0`, defaults to `2`.
+         */
+        unsigned num_io_threads = 2;
+
+        /**
+         * @var worker_options workers
+         * @brief Setup of the `hp::jobs` workers.
+         * @details Normal priority by default. `thread_priority::high` is opt-in: A worker per hardware thread at high
+         *          priority can starve the rest of the system, and the render thread itself.
+         */
+        worker_options workers{"Worker", thread_priority::normal, {}, false};
+
+        /**
+         * @var worker_options background_workers
+         * @brief Setup of the `hp::background_jobs` workers.
+         */
+        worker_options background_workers{"Background", thread_priority::low, {}, false};
+
+        /**
+         * @var worker_options io_threads
+         * @brief Setup of the IO threads. `numa_local` has no effect.
+         */
+        worker_options io_threads{"IO", thread_priority::low, {}, false};
+    };
+
+    /**
+     * @fn void init_threads(const thread_options &options)
+     * @brief Initialize/Construct the job systems (`hp::jobs` and `hp::background_jobs`) and the IO thread pool
+     *        (`hp::io_service`).
      * @details Best practice is to call `init_threads` at program startup and `quit_threads` at exit.
-     * @param num_threads The number of threads to assign to the thread pool. If set to `0`, a reasonable number
-     *                    of threads would be automatically selected depending on hardware. If this automatic
-     *                    selection fails, this value would default to `8`.
      */
-    void init_threads(unsigned num_threads = 0);
+    void init_threads(const thread_options &options);
+
+    /**
+     * @fn void init_threads(unsigned num_workers = 0, unsigned num_io_threads = 0)
+     * @brief Initialize the threads with default `thread_options`, but for the number of threads.
+     * @param num_workers The number of `hp::jobs` workers. If set to `0`, one per hardware thread but one would be
+     *                    selected. If this automatic selection fails, this value would default to `8`.
+     * @param num_io_threads The number of threads serving `hp::io_service`. If set to `0`, defaults to `2`.
+     */
+    void init_threads(unsigned num_workers = 0, unsigned num_io_threads = 0);
 
     /**
      * @fn void quit_threads()
-     * @brief Stops the default thread pool, joining all threads.
-     * @details Best practice is to call `init_threads` at program startup and `quit_threads` at exit.
+     * @brief Stops the job systems and IO thread pool, joining all threads.
+     * @details Jobs already submitted to `hp::jobs` still run. Best practice is to call `init_threads` at program
+     *          startup and `quit_threads` at exit.
      */
     void quit_threads();
 }
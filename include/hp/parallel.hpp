@@ -0,0 +1,269 @@
+/**
+ * @file parallel.hpp
+ * @brief Data parallel loops, reductions and sorts on the `job_system`.
+ * @details Ranges are split in halves recursively until they are no bigger than the grain size: One half is
+ *          submitted as a job, the other split further on the same thread. Idle workers steal the biggest pieces
+ *          first, so uneven work evens out. The calling thread runs chunks too, and helps run jobs until all are
+ *          done instead of blocking.
+ */
+
+#pragma once
+
+#ifndef __HEPHAESTUS_PARALLEL_HPP
+/**
+ * @def __HEPHAESTUS_PARALLEL_HPP
+ * @brief This macro is defined if `parallel.hpp` has been included.
+ */
+#define __HEPHAESTUS_PARALLEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "multithreading.hpp"
+
+namespace hp {
+    namespace detail {
+        /**
+         * @fn inline size_t parallel_grain(const job_system &js, size_t count, size_t grain, size_t align)
+         * @private
+         * @brief Pick the grain size for `count` items: About eight chunks per thread unless given, so stealing has
+         *        something to even out, rounded up to a multiple of `align`.
+         */
+        inline size_t parallel_grain(const job_system &js, size_t count, size_t grain, size_t align) {
+            if (grain == 0) {
+                const size_t threads = js.worker_count() + 1;
+                grain = std::max<size_t>(1, count / (threads * 8));
+            }
+            return (grain + align - 1) / align * align;
+        }
+
+        /**
+         * @fn inline size_t parallel_split(size_t begin, size_t end, size_t align, size_t phase)
+         * @private
+         * @brief Find a split point near the middle of a range, on an index `i` with `(i + phase) % align == 0` if any.
+         */
+        inline size_t parallel_split(size_t begin, size_t end, size_t align, size_t phase) {
+            const size_t mid = begin + (end - begin) / 2;
+            if (align <= 1) {
+                return mid;
+            }
+
+            // Round down unless that reaches `begin`, as `mid - rem` would wrap around below zero for small ranges.
+            const size_t rem = (mid + phase) % align;
+            if (rem < mid - begin) {
+                return mid - rem;
+            }
+            const size_t up = mid + (align - rem);
+            return up < end ? up : mid;
+        }
+
+        /**
+         * @fn template<typename T> size_t cache_line_elements(const T *data, size_t &phase)
+         * @private
+         * @brief Number of elements of an array per cache line, and how many elements the first one is into its line.
+         * @return `1` if elements don't tile cache lines evenly.
+         */
+        template<typename T>
+        size_t cache_line_elements(const T *data, size_t &phase) {
+            const auto addr = reinterpret_cast<uintptr_t>(data);
+            phase = 0;
+            if (sizeof(T) > cache_line_size || cache_line_size % sizeof(T) != 0 || addr % sizeof(T) != 0) {
+                return 1;
+            }
+
+            const size_t align = cache_line_size / sizeof(T);
+            phase = (addr % cache_line_size) / sizeof(T);
+            return align;
+        }
+
+        /**
+         * @fn template<typename F> void parallel_for_range(job_system &js, size_t begin, size_t end, size_t grain, size_t align, size_t phase, const F &fn, job_counter &counter)
+         * @private
+         * @brief Split a range down to the grain size, submitting every upper half, then run the rest.
+         */
+        template<typename F>
+        void parallel_for_range(job_system &js, size_t begin, size_t end, size_t grain, size_t align, size_t phase,
+                                const F &fn, job_counter &counter) {
+            while (end - begin > grain) {
+                const size_t mid = parallel_split(begin, end, align, phase);
+                js.submit([&js, mid, end, grain, align, phase, &fn, &counter]() {
+                    parallel_for_range(js, mid, end, grain, align, phase, fn, counter);
+                }, &counter);
+                end = mid;
+            }
+            fn(begin, end);
+        }
+
+        /**
+         * @fn template<typename It, typename Compare> void parallel_sort_range(job_system &js, It first, It last, const Compare &comp, size_t cutoff, job_counter &counter)
+         * @private
+         * @brief Quicksort: Partition three ways around a median of three, submit the upper part, and keep going with
+         *        the lower one until it is small enough for `std::sort()`.
+         */
+        template<typename It, typename Compare>
+        void parallel_sort_range(job_system &js, It first, It last, const Compare &comp, size_t cutoff,
+                                 job_counter &counter) {
+            using value_type = typename std::iterator_traits<It>::value_type;
+
+            while (static_cast<size_t>(last - first) > cutoff) {
+                It a = first, b = first + (last - first) / 2, c = last - 1;
+                if (comp(*b, *a)) std::swap(a, b);
+                if (comp(*c, *b)) b = comp(*c, *a) ? a : c;
+                const value_type pivot = *b;
+
+                It lo = std::partition(first, last, [&](const value_type &v) { return comp(v, pivot); });
+                It hi = std::partition(lo, last, [&](const value_type &v) { return !comp(pivot, v); });
+
+                if (last - hi > 1) {
+                    js.submit([&js, hi, last, &comp, cutoff, &counter]() {
+                        parallel_sort_range(js, hi, last, comp, cutoff, counter);
+                    }, &counter);
+                }
+                last = lo;  // [lo, hi) equals the pivot, and is already in place.
+            }
+            std::sort(first, last, comp);
+        }
+    }
+
+    /**
+     * @fn template<typename F> void parallel_for_chunks(job_system &js, size_t begin, size_t end, F &&fn, size_t grain = 0)
+     * @brief Call `fn(chunk_begin, chunk_end)` for disjoint chunks covering `[begin, end)`, in parallel.
+     * @details Blocks until every chunk is done, running jobs meanwhile. Safe to call from within jobs.
+     * @param fn Callable taking the begin and end index of a chunk. Called concurrently; Must not throw.
+     * @param grain Most indices per chunk. If `0`, picked from the number of indices and workers.
+     */
+    template<typename F>
+    void parallel_for_chunks(job_system &js, size_t begin, size_t end, F &&fn, size_t grain = 0) {
+        if (begin >= end) {
+            return;
+        }
+
+        job_counter counter;
+        detail::parallel_for_range(js, begin, end, detail::parallel_grain(js, end - begin, grain, 1), 1, 0, fn,
+                                   counter);
+        js.wait(counter);
+    }
+
+    /**
+     * @fn template<typename F> void parallel_for(job_system &js, size_t begin, size_t end, F &&fn, size_t grain = 0)
+     * @brief Call `fn(i)` for every index in `[begin, end)`, in parallel. See `parallel_for_chunks()`.
+     * @details Example Usage:
+     *          ```
+     *          hp::parallel_for(*hp::jobs, 0, particles.size(), [&](size_t i) { particles[i].update(dt); });
+     *          ```
+     */
+    template<typename F>
+    void parallel_for(job_system &js, size_t begin, size_t end, F &&fn, size_t grain = 0) {
+        parallel_for_chunks(js, begin, end, [&fn](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) {
+                fn(i);
+            }
+        }, grain);
+    }
+
+    /**
+     * @fn template<typename Container, typename F> void parallel_for_each(job_system &js, Container &container, F &&fn, size_t grain = 0)
+     * @brief Call `fn(element)` for every element of a contiguous container, like `std::vector`, in parallel.
+     * @details Chunks start and end on cache line boundaries where possible, so no two threads write to the same
+     *          cache line. See `parallel_for_chunks()`.
+     * @param grain Most elements per chunk. Rounded up to whole cache lines. If `0`, picked automatically.
+     */
+    template<typename Container, typename F>
+    void parallel_for_each(job_system &js, Container &container, F &&fn, size_t grain = 0) {
+        auto *data = std::data(container);
+        const size_t count = std::size(container);
+        if (count == 0) {
+            return;
+        }
+
+        size_t phase;
+        const size_t align = detail::cache_line_elements(data, phase);
+        const auto chunk = [data, &fn](size_t b, size_t e) {
+            for (size_t i = b; i < e; i++) {
+                fn(data[i]);
+            }
+        };
+
+        job_counter counter;
+        detail::parallel_for_range(js, 0, count, detail::parallel_grain(js, count, grain, align), align, phase, chunk,
+                                   counter);
+        js.wait(counter);
+    }
+
+    /**
+     * @fn template<typename T, typename Reduce, typename Combine> T parallel_reduce(job_system &js, size_t begin, size_t end, T identity, Reduce &&reduce, Combine &&combine, size_t grain = 0)
+     * @brief Reduce the indices `[begin, end)` to one value, in parallel.
+     * @details Every chunk is reduced into its own cache line, then the chunk results are combined in order on the
+     *          calling thread, so the result only depends on the grain size, not on scheduling.
+     *          Example Usage:
+     *          ```
+     *          float sum = hp::parallel_reduce(*hp::jobs, 0, v.size(), 0.0f,
+     *                  [&](size_t b, size_t e, float acc) { for (; b < e; b++) acc += v[b]; return acc; },
+     *                  std::plus<>());
+     *          ```
+     * @param identity Value that `combine` leaves others unchanged with, like `0` for sums.
+     * @param reduce Callable taking the begin and end index of a chunk and an accumulator starting at `identity`, and
+     *               returning the accumulated value. Called concurrently; Must not throw.
+     * @param combine Callable combining two results into one. Must be associative.
+     * @param grain Most indices per chunk. If `0`, picked from the number of indices and workers.
+     * @return The combined result, or `identity` for an empty range.
+     */
+    template<typename T, typename Reduce, typename Combine>
+    T parallel_reduce(job_system &js, size_t begin, size_t end, T identity, Reduce &&reduce, Combine &&combine,
+                      size_t grain = 0) {
+        if (begin >= end) {
+            return identity;
+        }
+
+        struct alignas(cache_line_size) slot {
+            T value;
+        };
+
+        grain = detail::parallel_grain(js, end - begin, grain, 1);
+        const size_t chunks = (end - begin + grain - 1) / grain;
+        std::vector<slot> partials(chunks, slot{identity});
+
+        parallel_for_chunks(js, 0, chunks, [&](size_t cb, size_t ce) {
+            for (size_t c = cb; c < ce; c++) {
+                const size_t b = begin + c * grain;
+                partials[c].value = reduce(b, std::min(end, b + grain), identity);
+            }
+        }, 1);
+
+        T result = std::move(identity);
+        for (auto &partial : partials) {
+            result = combine(std::move(result), std::move(partial.value));
+        }
+        return result;
+    }
+
+    /**
+     * @fn template<typename It, typename Compare = std::less<>> void parallel_sort(job_system &js, It first, It last, Compare comp = Compare(), size_t cutoff = 0)
+     * @brief Sort a random access range in parallel. Not stable.
+     * @details A parallel quicksort. The first partition pass runs on the calling thread alone, so expect speedups
+     *          below the number of cores. Blocks until sorted, running jobs meanwhile.
+     * @param comp Strict weak ordering, like for `std::sort()`. Called concurrently.
+     * @param cutoff Ranges up to this size are sorted with `std::sort()` on one thread. If `0`, picked automatically.
+     */
+    template<typename It, typename Compare = std::less<>>
+    void parallel_sort(job_system &js, It first, It last, Compare comp = Compare(), size_t cutoff = 0) {
+        const auto count = static_cast<size_t>(last - first);
+        if (count < 2) {
+            return;
+        }
+        if (cutoff == 0) {
+            cutoff = std::max<size_t>(2048, detail::parallel_grain(js, count, 0, 1));
+        }
+
+        job_counter counter;
+        detail::parallel_sort_range(js, first, last, comp, cutoff, counter);
+        js.wait(counter);
+    }
+}
+
+#endif //__HEPHAESTUS_PARALLEL_HPP
@@ -12,55 +12,220 @@
  */
 #define __HEPHAESTUS_PROFILING_HPP
 
+#include <atomic>
 #include <chrono>
-#include <queue>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <fstream>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 #include <iostream>
 
 #include "boost/current_function.hpp"
 
+#include "clock.hpp"
 #include "config.hpp"
 #include "logging.hpp"
+#include "profiling_stats.hpp"
+#include "queues.hpp"
+#include "trace_format.hpp"
 
 namespace hp {
     class profiler_session;
 
+    class capture_server;
+
+    /**
+     * @struct zone_desc
+     * @brief Static description of a profiled zone (a function or a named scope), registered once per call site.
+     * @details Events only carry the `id` of their zone; The name and the rest are written once per trace by the
+     *          session's writer thread. Descriptors are never freed, so pointers to them stay valid forever.
+     *          Usually created by `HP_START_PROFILER`, `HP_PROFILE_SCOPE` or `HP_PROFILE_SCOPE_EX`.
+     */
+    struct zone_desc {
+        const char *name; ///< Name of the zone. Must outlive the program, like a string literal.
+        const char *category; ///< Category of the zone, such as `"function"` or `"scope"`. Must outlive the program.
+        const char *file; ///< Source file of the zone, or `""` if unknown.
+        unsigned line; ///< Source line of the zone, or 0 if unknown.
+        uint32_t color; ///< `0xRRGGBB` color hint for trace viewers, or 0 for the default.
+        uint32_t id; ///< Unique id of the zone, assigned by `register_zone()`.
+    };
+
+    /**
+     * @fn const zone_desc *register_zone(const char *name, const char *category = "function", const char *file = "", unsigned line = 0, uint32_t color = 0)
+     * @brief Register a new zone and assign it an id. Thread safe.
+     * @details Call this once per call site, and keep the returned pointer (a function-local `static` is ideal).
+     *          Calling it again registers another zone, even for the same name.
+     * @return Pointer to the registered descriptor, valid for the lifetime of the program.
+     */
+    const zone_desc *register_zone(const char *name, const char *category = "function", const char *file = "",
+                                   unsigned line = 0, uint32_t color = 0);
+
+    /**
+     * @fn const zone_desc *intern_zone(const char *name)
+     * @brief Find or register the zone for a name, keyed by the name's *pointer*. Thread safe.
+     * @details Used for profilers created from plain names, like `profiler_session::new_profiler()`. Costs a lock and
+     *          a lookup, so prefer `register_zone()` with a static descriptor in hot code.
+     */
+    const zone_desc *intern_zone(const char *name);
+
+    /**
+     * @fn const zone_desc *find_zone(uint32_t id)
+     * @brief Look up a registered zone by id. Thread safe.
+     * @return The zone's descriptor, or `nullptr` if no zone has that id.
+     */
+    const zone_desc *find_zone(uint32_t id);
+
+    /**
+     * @fn void set_thread_name(const std::string &name)
+     * @brief Name the calling thread for debuggers and `top -H`, and in profiler traces. Thread safe.
+     * @details Traces only use the name for sessions the thread records its first event to afterwards, so name threads
+     *          as soon as they start. The OS may truncate the name, to 15 characters on Linux.
+     */
+    void set_thread_name(const std::string &name);
+
     /**
      * @struct profile_result
      * @brief Includes details of a profile result, such as start and end times.
+     * @details The process and thread the profile was taken on are stored once in the `event_buffer` it's recorded in.
      */
     struct profile_result {
     public:
         /**
-         * @var const char *name
-         * @brief The name of the profile this was generated from.
+         * @var uint32_t zone
+         * @brief Id of the zone this was generated from. See `hp::find_zone()`.
+         */
+        uint32_t zone;
+
+        /**
+         * @var uint32_t frame
+         * @brief Index of the frame the profile ended in. See `profiler_session::next_frame()`.
+         */
+        uint32_t frame;
+
+        /**
+         * @var uint64_t start
+         * @brief The start time of the profile in `hp::clock` ticks. See `hp::clock::to_ns()`.
+         */
+        uint64_t start;
+
+        /**
+         * @var uint64_t end
+         * @brief The end time of the profile in `hp::clock` ticks. See `hp::clock::to_ns()`.
+         */
+        uint64_t end;
+    };
+
+    /**
+     * @class event_buffer
+     * @brief Fixed-size, preallocated ring buffer (an `spsc_queue`) of `profile_result`s owned by a single thread.
+     * @details Every thread that stops a profiler gets its own `event_buffer` per `profiler_session`, so recording
+     *          an event never takes a lock and never contends with other threads. The owning thread is the only
+     *          producer and the session (while flushing) is the only consumer.
+     *          If the buffer is full, the event is dropped and counted. See `dropped()`.
+     */
+    class event_buffer {
+    public:
+        /**
+         * @var static constexpr size_t capacity
+         * @brief Number of events each per-thread buffer can hold before events start getting dropped.
+         * @note Must be a power of two.
+         */
+        static constexpr size_t capacity = 1u << 14u;
+
+        /**
+         * @var const size_t pid
+         * @brief Process id of the thread that owns this buffer.
+         */
+        const size_t pid;
+
+        /**
+         * @var const size_t thread
+         * @brief Id of the thread that owns this buffer.
+         */
+        const size_t thread;
+
+        /**
+         * @var const char *const name
+         * @brief Display name of the thread in the trace, or `nullptr` to leave it unnamed. See `profiler_session::new_track()`.
+         */
+        const char *const name;
+
+        /**
+         * @fn event_buffer(size_t pid, size_t thread, const char *name = nullptr)
+         * @brief Construct an empty buffer, preallocating storage for `capacity` events.
+         * @param pid Process id of the owning thread.
+         * @param thread Id of the owning thread.
+         * @param name Display name of the thread in the trace. Must outlive the buffer.
+         */
+        event_buffer(size_t pid, size_t thread, const char *name = nullptr);
+
+        /**
+         * @fn bool try_push(const profile_result &res)
+         * @brief Append an event to the buffer. Must ONLY be called by the owning thread.
+         * @param res The event to append.
+         * @return True if the event was stored, false if the buffer was full. Nothing is counted as dropped;
+         *         That is up to the caller (see `count_drop()`), so it can retry instead.
          */
-        const char *name;
+        inline bool try_push(const profile_result &res) {
+            return ring.try_push(res);
+        }
 
         /**
-         * @var long long start
-         * @brief The start time of the profile in microseconds since the epoch.
+         * @fn bool pop(profile_result &out)
+         * @brief Remove the oldest event from the buffer. Must ONLY be called by the consumer (the session).
+         * @param out Written to with the oldest event if there is one.
+         * @return True if an event was removed, false if the buffer was empty.
          */
-        long long start;
+        inline bool pop(profile_result &out) {
+            return ring.try_pop(out);
+        }
 
         /**
-         * @var long long end
-         * @brief The end time of the profile in microseconds since the epoch.
+         * @fn inline void count_drop()
+         * @brief Record that an event was dropped because this buffer was full.
          */
-        long long end;
+        inline void count_drop() {
+            drop_count.fetch_add(1, std::memory_order_relaxed);
+        }
 
         /**
-         * @var size_t pid
-         * @brief Process id of the process the profile was taken on.
+         * @fn [[nodiscard]] inline size_t size() const
+         * @brief Query the approximate number of events waiting in the buffer.
          */
-        size_t pid;
+        [[nodiscard]] inline size_t size() const {
+            return ring.size();
+        }
 
         /**
-         * @var size_t thread
-         * @brief Thread id of the thread the profile was taken on.
+         * @fn [[nodiscard]] inline size_t dropped() const
+         * @brief Query the number of events that were dropped because this buffer was full.
          */
-        size_t thread;
+        [[nodiscard]] inline size_t dropped() const {
+            return drop_count.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static_assert((capacity & (capacity - 1)) == 0, "event_buffer::capacity must be a power of two!");
+
+        friend class profiler_session;
+
+        spsc_queue<profile_result> ring; ///< @private
+        alignas(cache_line_size) std::atomic<size_t> drop_count{0}; ///< @private
+        bool name_written = false; ///< @private Only touched by the session's writer.
+    };
+
+    /**
+     * @enum overflow_policy
+     * @brief What a recording thread does when its `event_buffer` is full because the writer thread fell behind.
+     */
+    enum class overflow_policy {
+        drop, ///< Discard the event and count it. See `profiler_session::dropped_events()`. Never stalls the caller.
+        block ///< Wake the writer thread and wait until there is room. No events are lost, but the caller may stall.
     };
 
     /**
@@ -135,10 +300,10 @@ namespace hp {
 
         friend class profiler_session;
 
-        explicit profiler(const char *name, profiler_session *par); ///< @private
+        explicit profiler(const zone_desc *zone, profiler_session *par); ///< @private
 
-        const char *name; ///< @private
-        std::chrono::time_point<std::chrono::high_resolution_clock> start_time; ///< @private
+        const zone_desc *zone; ///< @private
+        uint64_t start_time = 0; ///< @private
         profiler_session *parent; ///< @private
         bool stopped; ///< @private
     };
@@ -159,12 +324,18 @@ namespace hp {
         static profiler_session *default_session;
 
         /**
-         * @fn explicit profiler_session(const char *name, const char *output_file = "out.json")
+         * @fn explicit profiler_session(const char *name, const char *output_file = "out.json", overflow_policy policy = overflow_policy::drop, trace_format format = trace_format::json)
          * @brief Constructor for profiler sessions.
+         * @details Starts a writer thread that drains the per-thread buffers in batches every `flush_interval`
+         *          (or sooner when a buffer is half full), so nobody needs to call `flush_all()` while the session runs.
+         *          Memory use is capped at `event_buffer::capacity` events per recording thread plus one write batch.
          * @param name Name of the session. No use other than identification
          * @param output_file File to write the report to.
+         * @param policy What recording threads do when the writer can't keep up. See `hp::overflow_policy`.
+         * @param format Chrome trace JSON, or the much smaller and cheaper binary format described in `trace_format.hpp`.
          */
-        explicit profiler_session(const char *name, const char *output_file = "out.json");
+        explicit profiler_session(const char *name, const char *output_file = "out.json",
+                                  overflow_policy policy = overflow_policy::drop, trace_format format = trace_format::json);
 
         /**
          * @fn virtual ~profiler_session()
@@ -226,9 +397,37 @@ namespace hp {
          */
         profiler *new_dynamic_profiler(const char *pname = "Unnamed Profiler");
 
+        /**
+         * @fn profiler new_profiler(const zone_desc *zone)
+         * @brief Construct and retrieve a new `hp::profiler` for a registered zone. Cheaper than naming it every time.
+         * @param zone Zone to report as, returned by `hp::register_zone()`.
+         * @return Returns the newly constructed profiler.
+         */
+        profiler new_profiler(const zone_desc *zone);
+
+        /**
+         * @var static constexpr std::chrono::milliseconds flush_interval
+         * @brief How often the writer thread wakes up to drain the thread buffers if nobody wakes it earlier.
+         */
+        static constexpr std::chrono::milliseconds flush_interval = std::chrono::milliseconds(5);
+
+        /**
+         * @var static constexpr size_t write_batch_size
+         * @brief Number of bytes the writer thread formats in memory before handing them to the file in a single write.
+         */
+        static constexpr size_t write_batch_size = 1u << 20u;
+
+        /**
+         * @fn size_t dropped_events()
+         * @brief Query the total number of events dropped because a thread's `event_buffer` was full.
+         * @details Events are only dropped with `overflow_policy::drop`, when a thread records more than
+         *          `event_buffer::capacity` events before the writer thread gets to them.
+         */
+        size_t dropped_events();
+
         /**
          * @fn void close()
-         * @brief Closes the file.
+         * @brief Stops the writer thread and closes the file.
          * @note This function does not finish writing queued reports, so reports in queue WILL NOT be written!
          *       Best practice is to call `hp::profiler_session::flush_all()` before calling this function.
          */
@@ -237,6 +436,7 @@ namespace hp {
         /**
          * @fn void flush_single()
          * @brief Write a SINGLE profile report to the file
+         * @details Takes the report from the first thread buffer that isn't empty.
          * @note See `void flush_all()` if you wish to write ALL queued profile reports.
          */
         void flush_single();
@@ -244,33 +444,330 @@ namespace hp {
         /**
          * @fn void flush_all()
          * @brief Writes all queued profile reports to the file.
+         * @details This is where the per-thread `event_buffer`s are merged. Recording threads are never blocked by this.
+         *          The writer thread already does this periodically, so this is only needed to force reports out *now*.
          * @note You MUST call this function before calling `close()`, or reports in queue will NOT be written!
          */
         void flush_all();
 
+        /**
+         * @var static constexpr size_t first_track_id
+         * @brief Thread id of the first track made by `new_track()`. Chosen to be above any real thread id.
+         */
+        static constexpr size_t first_track_id = 1u << 30u;
+
+        /**
+         * @fn size_t new_track(const char *track_name)
+         * @brief Create a named track: A timeline that shows up in the trace like a thread, for events that didn't happen
+         *        on a CPU thread, such as GPU work. Record to it with `record_track()`.
+         * @param track_name Display name of the track, such as `"GPU"`. Must outlive the session.
+         * @return Index of the track.
+         */
+        size_t new_track(const char *track_name);
+
+        /**
+         * @fn void record_track(size_t track, const profile_result &res)
+         * @brief Record an already timed event to a track.
+         * @details Like thread buffers, tracks have a single producer: Calls for the same track must not run concurrently.
+         * @param track Index returned by `new_track()`. Unknown indices are ignored.
+         * @param res The event. Times are in `hp::clock` ticks; Convert external timestamps with `hp::clock::from_ns()`.
+         */
+        void record_track(size_t track, const profile_result &res);
+
+        /**
+         * @fn void record_counter(const trace::counter &ctr)
+         * @brief Record a sample of a counter, such as a `hp::memory_counter`. Thread safe.
+         * @details Samples are written as counter tracks (`"ph": "C"` in JSON), one track each for the bytes, the
+         *          peak bytes and the allocations. `frame_end()` samples the memory counters itself.
+         * @param ctr The sample. `zone_id` names the counter, and `time` is in `hp::clock` ticks. `pid` is filled in.
+         */
+        void record_counter(const trace::counter &ctr);
+
+        /**
+         * @fn static inline void next_frame()
+         * @brief Advance the global frame counter. Call this once per frame, from one thread, to get per-frame statistics.
+         * @details Events are attributed to the frame that was current when they were recorded.
+         */
+        static inline void next_frame() {
+            frame_counter.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * @fn static inline uint32_t current_frame()
+         * @brief Query the global frame counter. See `next_frame()`.
+         */
+        static inline uint32_t current_frame() {
+            return frame_counter.load(std::memory_order_relaxed);
+        }
+
+        /**
+         * @fn static void frame_begin()
+         * @brief Mark the start of a frame: Advance the frame counter (See `next_frame()`) and start timing the frame.
+         * @details `hp::vk::window::draw_frame()` calls this itself. Every event recorded until the next `frame_begin()`
+         *          carries the new frame index in the trace, so zones can be grouped by frame.
+         *          Only call it from the thread that draws frames. Ends the previous frame if `frame_end()` wasn't called.
+         */
+        static void frame_begin();
+
+        /**
+         * @fn static void frame_end()
+         * @brief Mark the end of the frame started by `frame_begin()`.
+         * @details Records a zone named "Frame" (category "frame", see `frame_zone()`) for the whole frame to the
+         *          `default_session` that was set at `frame_begin()`, so per-frame totals show up in the trace and in
+         *          the aggregated statistics. Also samples the memory counters (See `memory_tracking.hpp`).
+         *          Does nothing if no frame was started.
+         */
+        static void frame_end();
+
+        /**
+         * @fn static const zone_desc *frame_zone()
+         * @brief Retrieve the zone `frame_end()` records frames as. Look for its id in a `stats_report` for frame times.
+         */
+        static const zone_desc *frame_zone();
+
+        /**
+         * @fn void enable_stats(uint32_t window_frames = 120)
+         * @brief Start aggregating per-zone statistics on the writer thread. See `hp::stats_aggregator`.
+         * @details Costs nothing on the recording threads, so it can stay on even without a trace
+         *          (See `trace_format::none`). Only events recorded after this call are counted.
+         *          Calling it again does nothing.
+         * @param window_frames Number of completed frames covered by `stats_scope::window`.
+         */
+        void enable_stats(uint32_t window_frames = 120);
+
+        /**
+         * @fn stats_report stats(stats_scope scope = stats_scope::window)
+         * @brief Query aggregated per-zone statistics. Can be called from any thread.
+         * @return The report, or an empty one if `enable_stats()` wasn't called.
+         */
+        stats_report stats(stats_scope scope = stats_scope::window);
+
+        /**
+         * @fn void on_frame_stats(std::function<void(const stats_report &)> callback)
+         * @brief Set a function that gets the statistics of every frame as it completes. Requires `enable_stats()`.
+         * @details Called on the writer thread, about two frames after the frame ended. See `stats_aggregator::on_frame()`.
+         */
+        void on_frame_stats(std::function<void(const stats_report &)> callback);
+
+        /**
+         * @fn void dump_stats(std::ostream &os, stats_scope scope = stats_scope::window)
+         * @brief Write aggregated per-zone statistics as CSV, one zone per line, with durations in microseconds.
+         */
+        void dump_stats(std::ostream &os, stats_scope scope = stats_scope::window);
+
+        /**
+         * @var static constexpr uint16_t default_live_port
+         * @brief Port `serve_live()` listens on by default.
+         */
+        static constexpr uint16_t default_live_port = 28077;
+
+        /**
+         * @fn bool serve_live(uint16_t port = default_live_port)
+         * @brief Let clients such as `HephaestusTraceCapture` start and stop captures of this session over loopback TCP.
+         * @details Captures are streamed as binary traces, whatever the session's own `trace_format`, and can be
+         *          filtered by zone at runtime. Costs nothing while no capture is running. See `hp::capture_server`.
+         *          Replaces the previous server, if any.
+         * @param port Port to listen on at `127.0.0.1`, or 0 to let the OS pick one (See `live_port()`).
+         * @return True if the server is listening.
+         */
+        bool serve_live(uint16_t port = default_live_port);
+
+        /**
+         * @fn void stop_live()
+         * @brief Stop the server started by `serve_live()`, disconnecting any client.
+         */
+        void stop_live();
+
+        /**
+         * @fn uint16_t live_port()
+         * @brief Query the port `serve_live()` listens on, or 0 if it isn't serving.
+         */
+        uint16_t live_port();
+
     private:
 
         friend class profiler;
+        friend class scoped_zone;
+
+        /**
+         * @fn event_buffer *local_buffer()
+         * @private
+         * @brief Retrieve the calling thread's buffer for this session, creating and registering it on first use.
+         * @details Only the first call on each thread takes `mtx`; After that, the buffer is found in a thread local cache.
+         */
+        event_buffer *local_buffer();
+
+        void record(const profile_result &res); ///< @private
+
+        void push(event_buffer *buf, const profile_result &res); ///< @private
+
+        void write_thread_name(event_buffer &buf); ///< @private
+
+        void format_event(const profile_result &res, long long start, long long end,
+                          const event_buffer &buf); ///< @private
+
+        void format_counter(const trace::counter &ctr); ///< @private
+
+        const std::string &json_zone_prefix(uint32_t zone); ///< @private
+
+        trace::header binary_header() const; ///< @private
+
+        /**
+         * @fn void drain(bool single)
+         * @private
+         * @brief Move events out of the thread buffers into `batch`, writing it out whenever it exceeds `write_batch_size`.
+         * @note `write_mtx` *MUST* be held by the caller, as it makes the caller the single consumer of every buffer.
+         */
+        void drain(bool single);
+
+        void write_batch(); ///< @private
+
+        void start_writer(); ///< @private
+
+        void stop_writer(); ///< @private
 
-        std::mutex mtx; ///< @private
-        std::queue<profile_result> queue; ///< @private
+        void writer_loop(); ///< @private
+
+        inline void wake_writer() { ///< @private
+            if (!wake_requested.exchange(true, std::memory_order_acq_rel)) {
+                writer_cv.notify_one();
+            }
+        }
+
+        std::mutex mtx; ///< @private Guards `buffers`.
+        std::mutex write_mtx; ///< @private Guards `out`, `batch` and consuming from the buffers.
+        std::vector<std::unique_ptr<event_buffer>> buffers; ///< @private
+        std::vector<event_buffer *> tracks; ///< @private Guarded by `mtx`. Owned by `buffers`.
+        std::vector<trace::counter> counters; ///< @private Guarded by `mtx`. Samples waiting for the writer.
+        std::vector<trace::counter> counter_batch; ///< @private Reused by `drain()`.
+        size_t id; ///< @private
         const char *file; ///< @private
         const char *name; ///< @private
         std::ofstream out; ///< @private
+        fmt::memory_buffer batch; ///< @private
         bool closed; ///< @private
+        overflow_policy policy = overflow_policy::drop; ///< @private
+        trace_format format = trace_format::json; ///< @private
+        trace::encoder encoder; ///< @private Only used for `trace_format::binary`
+        std::vector<std::string> json_zones; ///< @private Preformatted name and category per zone id, for JSON.
+        std::unique_ptr<stats_aggregator> aggregator; ///< @private Set once by `enable_stats()`.
+        std::atomic<bool> stats_enabled{false}; ///< @private
+        std::vector<stats_sample> samples; ///< @private Reused by `drain()`.
+        std::unique_ptr<capture_server> server; ///< @private Guarded by `write_mtx`.
+
+        static std::atomic<uint32_t> frame_counter; ///< @private
+
+        std::thread writer; ///< @private
+        std::condition_variable writer_cv; ///< @private
+        std::mutex writer_mtx; ///< @private
+        std::atomic<bool> wake_requested{false}; ///< @private
+        std::atomic<bool> writer_running{false}; ///< @private
 
         bool first_event_written; ///< @private
     };
+
+    /**
+     * @class scoped_zone
+     * @brief Lightweight RAII timer that records a zone to `profiler_session::default_session` when it goes out of scope.
+     * @details Unlike `hp::profiler`, it can't be restarted or moved, and does nothing but read the clock twice.
+     *          Use it through `HP_PROFILE_SCOPE` or `HP_PROFILE_SCOPE_EX`.
+     */
+    class scoped_zone {
+    public:
+        /**
+         * @fn explicit scoped_zone(const zone_desc *zone)
+         * @brief Start timing a zone, if there is a default session.
+         * @param zone Zone to report as, returned by `hp::register_zone()`.
+         */
+        explicit inline scoped_zone(const zone_desc *zone) : session(profiler_session::default_session),
+                                                             zone(zone->id) {
+            if (session != nullptr) {
+                start = clock::ticks();
+            }
+        }
+
+        /**
+         * @fn ~scoped_zone()
+         * @brief Stop timing, and record the zone.
+         */
+        inline ~scoped_zone() {
+            if (session != nullptr) {
+                session->record(profile_result{zone, profiler_session::current_frame(), start, clock::ticks_ordered()});
+            }
+        }
+
+        scoped_zone(const scoped_zone &other) = delete; ///< @private
+        scoped_zone &operator=(const scoped_zone &other) = delete; ///< @private
+
+    private:
+        profiler_session *session; ///< @private
+        uint32_t zone; ///< @private
+        uint64_t start = 0; ///< @private
+    };
+
+    /**
+     * @class scoped_frame
+     * @brief RAII frame marker: Calls `profiler_session::frame_begin()` on construction and `frame_end()` on destruction.
+     * @details Ends the frame on every return path. Use it through `HP_PROFILE_FRAME`.
+     */
+    class scoped_frame {
+    public:
+        inline scoped_frame() { ///< @private
+            profiler_session::frame_begin();
+        }
+
+        inline ~scoped_frame() { ///< @private
+            profiler_session::frame_end();
+        }
+
+        scoped_frame(const scoped_frame &other) = delete; ///< @private
+        scoped_frame &operator=(const scoped_frame &other) = delete; ///< @private
+    };
 }
 
+/**
+ * @def HP_CONCAT
+ * @brief Concatenate two tokens after expanding them, e.g. for unique identifiers with `__LINE__`.
+ */
+#define HP_CONCAT(a, b) __HP_CONCAT_IMPL(a, b)
+
+/**
+ * @def __HP_CONCAT_IMPL
+ * @private
+ */
+#define __HP_CONCAT_IMPL(a, b) a##b
+
 #ifdef HP_PROFILING_ENABLED
 /**
  * @def HP_START_PROFILER
  * @brief Create a profiler from the default session and start timing. Will stop when scope exits.
  * @details Useful for timing function calls and sections of code. You can simply create a scope and put
  *          `HP_START_PROFILER` at the beginning to time the execution time of the code within that scope.
+ *          The zone is named after the enclosing function, and registered only the first time the line runs.
+ */
+#define HP_START_PROFILER static const ::hp::zone_desc *__hp_tmp_profiler_zone = ::hp::register_zone(BOOST_CURRENT_FUNCTION, "function", __FILE__, __LINE__); ::hp::scoped_zone __hp_tmp_profiler_obj(__hp_tmp_profiler_zone);
+
+/**
+ * @def HP_PROFILE_SCOPE_EX
+ * @brief Time the rest of the enclosing scope as a zone with a name, category and `0xRRGGBB` color.
+ * @details The zone is registered only the first time the line runs. Can be used several times in one scope.
+ *          Example Usage: `HP_PROFILE_SCOPE_EX("upload", "vk", 0xff8000);`
+ */
+#define HP_PROFILE_SCOPE_EX(name, category, color) static const ::hp::zone_desc *HP_CONCAT(__hp_zone_, __LINE__) = ::hp::register_zone(name, category, __FILE__, __LINE__, color); ::hp::scoped_zone HP_CONCAT(__hp_scope_, __LINE__)(HP_CONCAT(__hp_zone_, __LINE__))
+
+/**
+ * @def HP_PROFILE_SCOPE
+ * @brief Time the rest of the enclosing scope as a named zone. Will stop when scope exits.
+ * @details Example Usage: `{ HP_PROFILE_SCOPE("upload"); copy_buffer(...); }`
  */
-#define HP_START_PROFILER ::hp::profiler __hp_tmp_profiler_obj; if (::hp::profiler_session::default_session != nullptr) {__hp_tmp_profiler_obj = ::std::move(::hp::profiler_session::default_session->new_profiler(BOOST_CURRENT_FUNCTION)); __hp_tmp_profiler_obj.start();};
+#define HP_PROFILE_SCOPE(name) HP_PROFILE_SCOPE_EX(name, "scope", 0)
+
+/**
+ * @def HP_PROFILE_FRAME
+ * @brief Mark the rest of the enclosing scope as one frame. See `profiler_session::frame_begin()`.
+ * @details `hp::vk::window::draw_frame()` already does this. Use it for loops that don't draw with a window.
+ */
+#define HP_PROFILE_FRAME ::hp::scoped_frame __hp_frame_obj
 #else
 
 /**
@@ -280,6 +777,24 @@ namespace hp {
  *          `HP_START_PROFILER` at the beginning to time the execution time of the code within that scope.
  */
 #define HP_START_PROFILER
+
+/**
+ * @def HP_PROFILE_SCOPE_EX
+ * @brief Time the rest of the enclosing scope as a zone with a name, category and `0xRRGGBB` color.
+ */
+#define HP_PROFILE_SCOPE_EX(name, category, color)
+
+/**
+ * @def HP_PROFILE_SCOPE
+ * @brief Time the rest of the enclosing scope as a named zone. Will stop when scope exits.
+ */
+#define HP_PROFILE_SCOPE(name)
+
+/**
+ * @def HP_PROFILE_FRAME
+ * @brief Mark the rest of the enclosing scope as one frame.
+ */
+#define HP_PROFILE_FRAME
 #endif
 
 #endif //__HEPHAESTUS_PROFILING_HPP
@@ -0,0 +1,252 @@
+/**
+ * @file profiling_stats.hpp
+ * @brief In-process aggregation of profiler events into per-zone statistics, per frame and over a sliding window.
+ * @details Used by `profiler_session` (see `profiler_session::enable_stats()`). All aggregation happens on the session's
+ *          writer thread, so recording threads pay nothing extra for it.
+ */
+
+#pragma once
+
+#ifndef __HEPHAESTUS_PROFILING_STATS_HPP
+/**
+ * @def __HEPHAESTUS_PROFILING_STATS_HPP
+ * @brief This macro is defined if `profiling_stats.hpp` has been included.
+ */
+#define __HEPHAESTUS_PROFILING_STATS_HPP
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace hp {
+    /**
+     * @class latency_histogram
+     * @brief HDR-style log-linear histogram of nanosecond durations with a relative error of at most 1/32 (~3%).
+     * @details Every power of two is split into `1 << sub_bucket_bits` linear buckets, so memory use is fixed
+     *          (`bucket_count` counters) no matter how many values are recorded. Values below 64ns are exact, and
+     *          values of `2^max_magnitude` ns (~4.9 hours) and above are clamped to the last bucket.
+     *          Buckets are ordered like their values, which lets small sets of raw bucket indices stand in for values.
+     */
+    class latency_histogram {
+    public:
+        /**
+         * @var static constexpr unsigned sub_bucket_bits
+         * @brief Log2 of the number of linear buckets per power of two.
+         */
+        static constexpr unsigned sub_bucket_bits = 5;
+
+        /**
+         * @var static constexpr unsigned max_magnitude
+         * @brief Log2 of the smallest value that is clamped.
+         */
+        static constexpr unsigned max_magnitude = 44;
+
+        /**
+         * @var static constexpr unsigned bucket_count
+         * @brief Total number of buckets.
+         */
+        static constexpr unsigned bucket_count = (max_magnitude - sub_bucket_bits + 1u) << sub_bucket_bits;
+
+        /**
+         * @fn static unsigned bucket_of(uint64_t value)
+         * @brief Query the index of the bucket a value falls into.
+         */
+        static unsigned bucket_of(uint64_t value);
+
+        /**
+         * @fn static uint64_t value_of(unsigned bucket)
+         * @brief Query the value a bucket stands for (the middle of its range).
+         */
+        static uint64_t value_of(unsigned bucket);
+
+        /**
+         * @fn void add(unsigned bucket, uint64_t n = 1)
+         * @brief Count `n` more values in a bucket. See `bucket_of()`.
+         */
+        void add(unsigned bucket, uint64_t n = 1);
+
+        /**
+         * @fn void remove(unsigned bucket, uint64_t n = 1)
+         * @brief Undo `add()`, such as when a value leaves a sliding window.
+         */
+        void remove(unsigned bucket, uint64_t n = 1);
+
+        /**
+         * @fn inline void record(uint64_t value)
+         * @brief Count a value.
+         */
+        inline void record(uint64_t value) {
+            add(bucket_of(value));
+        }
+
+        /**
+         * @fn [[nodiscard]] uint64_t percentile(double pct) const
+         * @brief Query the value below or at which `pct` percent of the counted values are. Returns 0 if empty.
+         * @param pct Percentile in [0, 100], e.g. 99 for the p99.
+         */
+        [[nodiscard]] uint64_t percentile(double pct) const;
+
+        /**
+         * @fn [[nodiscard]] inline uint64_t count() const
+         * @brief Query the number of counted values.
+         */
+        [[nodiscard]] inline uint64_t count() const {
+            return total;
+        }
+
+        /**
+         * @fn void clear()
+         * @brief Forget all counted values. Keeps the memory for the buckets.
+         */
+        void clear();
+
+    private:
+        std::vector<uint64_t> counts; ///< @private Allocated on the first `add()`.
+        uint64_t total = 0; ///< @private
+    };
+
+    /**
+     * @enum stats_scope
+     * @brief Range of frames a `stats_report` covers.
+     */
+    enum class stats_scope {
+        frame, ///< The most recently completed frame.
+        window, ///< The last `stats_aggregator::window_frames()` completed frames.
+        lifetime ///< Everything since stats were enabled, including frames that aren't completed yet.
+    };
+
+    /**
+     * @struct zone_stats
+     * @brief Aggregated durations of one zone. All durations are in nanoseconds.
+     * @details Percentiles come from a `latency_histogram`, so they are accurate to ~3%. Count, total, min and max are exact.
+     */
+    struct zone_stats {
+        uint32_t zone = 0; ///< Id of the zone. See `hp::find_zone()`.
+        uint64_t count = 0; ///< Number of events.
+        long long total_ns = 0; ///< Sum of all durations.
+        long long min_ns = 0; ///< Shortest duration.
+        long long max_ns = 0; ///< Longest duration.
+        long long p50_ns = 0; ///< Median duration.
+        long long p90_ns = 0; ///< 90th percentile duration.
+        long long p99_ns = 0; ///< 99th percentile duration.
+
+        /**
+         * @fn [[nodiscard]] inline double avg_ns() const
+         * @brief Query the mean duration.
+         */
+        [[nodiscard]] inline double avg_ns() const {
+            return count > 0 ? static_cast<double>(total_ns) / static_cast<double>(count) : 0.0;
+        }
+    };
+
+    /**
+     * @struct stats_report
+     * @brief Snapshot of the statistics of every zone over a `stats_scope`.
+     */
+    struct stats_report {
+        stats_scope scope = stats_scope::frame; ///< What the report covers.
+        uint32_t first_frame = 0; ///< Index of the first frame covered.
+        uint32_t last_frame = 0; ///< Index of the last frame covered.
+        std::vector<zone_stats> zones; ///< Statistics of every zone with events, sorted by descending `total_ns`.
+    };
+
+    /**
+     * @struct stats_sample
+     * @brief A single event handed to `stats_aggregator::ingest()`.
+     */
+    struct stats_sample {
+        uint32_t zone; ///< Id of the zone.
+        uint32_t frame; ///< Frame the event was recorded in.
+        long long duration_ns; ///< Duration of the event.
+    };
+
+    /**
+     * @class stats_aggregator
+     * @brief Folds events into per-zone statistics per frame, over a sliding window of frames, and over its lifetime.
+     * @details A frame is considered complete once the frame counter is 2 frames past it, so events recorded on other
+     *          threads around the frame boundary still make it in. Events that arrive for an already completed frame
+     *          are counted in the oldest incomplete one instead.
+     *          Only the writer thread calls `ingest()`; `report()` can be called from anywhere.
+     */
+    class stats_aggregator {
+    public:
+        /**
+         * @fn explicit stats_aggregator(uint32_t window_frames)
+         * @brief Construct an empty aggregator.
+         * @param window_frames Number of completed frames the `stats_scope::window` report covers.
+         */
+        explicit stats_aggregator(uint32_t window_frames);
+
+        /**
+         * @fn void ingest(std::vector<stats_sample> &samples, uint32_t current_frame)
+         * @brief Fold a batch of events in and complete frames that are far enough behind `current_frame`.
+         * @details Clears `samples`. Calls the `on_frame()` callback, if any, once per completed frame.
+         */
+        void ingest(std::vector<stats_sample> &samples, uint32_t current_frame);
+
+        /**
+         * @fn [[nodiscard]] stats_report report(stats_scope scope) const
+         * @brief Build a report of the current statistics.
+         */
+        [[nodiscard]] stats_report report(stats_scope scope) const;
+
+        /**
+         * @fn void on_frame(std::function<void(const stats_report &)> callback)
+         * @brief Set a function that gets the `stats_scope::frame` report of every frame as it completes.
+         * @details Called on the writer thread, so keep it short. Useful to alarm on frame time regressions.
+         *          Pass an empty function to remove it.
+         */
+        void on_frame(std::function<void(const stats_report &)> callback);
+
+        /**
+         * @fn [[nodiscard]] uint32_t window_frames() const
+         * @brief Query the length of the sliding window in frames.
+         */
+        [[nodiscard]] uint32_t window_frames() const;
+
+    private:
+        struct zone_accum { ///< @private
+            uint64_t count = 0; ///< @private
+            long long total = 0; ///< @private
+            long long min = 0; ///< @private
+            long long max = 0; ///< @private
+            std::vector<uint16_t> buckets; ///< @private One `latency_histogram` bucket per event.
+        };
+
+        struct frame_accum { ///< @private
+            uint32_t frame = 0; ///< @private
+            std::unordered_map<uint32_t, zone_accum> zones; ///< @private
+        };
+
+        struct zone_totals { ///< @private
+            zone_accum lifetime; ///< @private `buckets` is unused; See `lifetime_hist`.
+            latency_histogram lifetime_hist; ///< @private
+            latency_histogram window_hist; ///< @private
+        };
+
+        static void accumulate(zone_accum &acc, long long duration); ///< @private
+
+        static zone_stats frame_stats(uint32_t zone, const zone_accum &acc); ///< @private
+
+        void complete(frame_accum &&frame); ///< @private
+
+        stats_report frame_report() const; ///< @private
+
+        mutable std::mutex mtx; ///< @private Guards everything below.
+        uint32_t window; ///< @private
+        std::map<uint32_t, frame_accum> pending; ///< @private
+        std::deque<frame_accum> completed; ///< @private Last `window` completed frames, oldest first.
+        std::vector<zone_totals> totals; ///< @private Indexed by zone id.
+        bool any_completed = false; ///< @private
+        uint32_t last_completed = 0; ///< @private
+        uint32_t first_frame = 0; ///< @private
+        bool any_ingested = false; ///< @private
+        std::function<void(const stats_report &)> callback; ///< @private
+    };
+}
+
+#endif //__HEPHAESTUS_PROFILING_STATS_HPP
@@ -0,0 +1,235 @@
+/**
+ * @file queues.hpp
+ * @brief Bounded lock-free queues: A single producer single consumer ring, and a multi producer multi consumer queue.
+ * @details Both preallocate every slot, never allocate afterwards, and keep the indices written by different threads
+ *          on cache lines of their own.
+ */
+
+#pragma once
+
+#ifndef __HEPHAESTUS_QUEUES_HPP
+/**
+ * @def __HEPHAESTUS_QUEUES_HPP
+ * @brief This macro is defined if `queues.hpp` has been included.
+ */
+#define __HEPHAESTUS_QUEUES_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace hp {
+    /**
+     * @var constexpr size_t cache_line_size
+     * @brief Size of a cache line in bytes. Data written by different threads should be this far apart.
+     */
+    constexpr size_t cache_line_size = 64;
+
+    /**
+     * @class spsc_queue
+     * @brief Bounded ring for exactly one producer thread and one consumer thread. Wait-free.
+     * @details Each side caches the other side's index, and only reloads it when the ring looks full or empty, so
+     *          pushing and popping usually touch no cache line the other thread writes.
+     * @note `T` must be default constructible and move assignable; Slots hold default constructed `T`s when unused.
+     */
+    template<typename T>
+    class spsc_queue {
+    public:
+        /**
+         * @fn explicit spsc_queue(size_t capacity)
+         * @brief Construct an empty queue.
+         * @param capacity Number of items the queue holds. Must be a power of two.
+         * @param first_index Index of the first item. Only useful to test the indices wrapping around.
+         */
+        explicit spsc_queue(size_t capacity, size_t first_index = 0) : head(first_index), tail_cache(first_index),
+                                                                       tail(first_index), head_cache(first_index),
+                                                                       mask(capacity - 1), slots(new T[capacity]) {}
+
+        spsc_queue(const spsc_queue &other) = delete; ///< @private
+        spsc_queue &operator=(const spsc_queue &other) = delete; ///< @private
+
+        /**
+         * @fn template<typename U> bool try_push(U &&item)
+         * @brief Append an item. Producer only.
+         * @return False if the queue was full. `item` is left untouched then.
+         */
+        template<typename U>
+        bool try_push(U &&item) {
+            const size_t h = head.load(std::memory_order_relaxed);
+            if (h - tail_cache > mask) {
+                tail_cache = tail.load(std::memory_order_acquire);
+                if (h - tail_cache > mask) {
+                    return false;
+                }
+            }
+
+            slots[h & mask] = std::forward<U>(item);
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @fn bool try_pop(T &out)
+         * @brief Remove the oldest item. Consumer only.
+         * @return False if the queue was empty.
+         */
+        bool try_pop(T &out) {
+            const size_t t = tail.load(std::memory_order_relaxed);
+            if (t == head_cache) {
+                head_cache = head.load(std::memory_order_acquire);
+                if (t == head_cache) {
+                    return false;
+                }
+            }
+
+            out = std::move(slots[t & mask]);
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @fn [[nodiscard]] inline size_t size() const
+         * @brief Query the approximate number of items in the queue. Exact from the producer or consumer when the
+         *        other side is idle.
+         */
+        [[nodiscard]] inline size_t size() const {
+            return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @fn [[nodiscard]] inline size_t capacity() const
+         * @brief Query the number of items the queue holds.
+         */
+        [[nodiscard]] inline size_t capacity() const {
+            return mask + 1;
+        }
+
+    private:
+        alignas(cache_line_size) std::atomic<size_t> head; ///< @private Written by the producer.
+        size_t tail_cache; ///< @private The producer's last look at `tail`.
+        alignas(cache_line_size) std::atomic<size_t> tail; ///< @private Written by the consumer.
+        size_t head_cache; ///< @private The consumer's last look at `head`.
+        alignas(cache_line_size) const size_t mask; ///< @private
+        std::unique_ptr<T[]> slots; ///< @private
+    };
+
+    /**
+     * @class mpmc_queue
+     * @brief Bounded queue for any number of producer and consumer threads. Lock-free.
+     * @details Dmitry Vyukov's bounded MPMC queue: Every slot carries a sequence number telling producers and
+     *          consumers whose turn it is, so both sides only contend on their own index, with one CAS per operation.
+     *          Items come out in the order their pushes claimed slots.
+     * @note `T` must be default constructible and move assignable.
+     */
+    template<typename T>
+    class mpmc_queue {
+    public:
+        /**
+         * @fn explicit mpmc_queue(size_t capacity)
+         * @brief Construct an empty queue.
+         * @param capacity Number of items the queue holds. Must be a power of two, and at least 2.
+         * @param first_index Index of the first item. Only useful to test the indices wrapping around.
+         */
+        explicit mpmc_queue(size_t capacity, size_t first_index = 0) : enqueue_pos(first_index),
+                                                                       dequeue_pos(first_index), mask(capacity - 1),
+                                                                       cells(new cell[capacity]) {
+            for (size_t i = 0; i < capacity; i++) {
+                cells[(first_index + i) & mask].sequence.store(first_index + i, std::memory_order_relaxed);
+            }
+        }
+
+        mpmc_queue(const mpmc_queue &other) = delete; ///< @private
+        mpmc_queue &operator=(const mpmc_queue &other) = delete; ///< @private
+
+        /**
+         * @fn template<typename U> bool try_push(U &&item)
+         * @brief Append an item. Thread safe.
+         * @return False if the queue was full. `item` is left untouched then.
+         */
+        template<typename U>
+        bool try_push(U &&item) {
+            size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+            cell *c;
+            while (true) {
+                c = &cells[pos & mask];
+                const size_t seq = c->sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;  // The slot still holds the item from a lap ago.
+                } else {
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            c->data = std::forward<U>(item);
+            c->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @fn bool try_pop(T &out)
+         * @brief Remove the oldest item. Thread safe.
+         * @return False if the queue was empty.
+         */
+        bool try_pop(T &out) {
+            size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+            cell *c;
+            while (true) {
+                c = &cells[pos & mask];
+                const size_t seq = c->sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;  // Nothing pushed to this slot yet.
+                } else {
+                    pos = dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+
+            out = std::move(c->data);
+            c->sequence.store(pos + mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @fn [[nodiscard]] inline size_t size() const
+         * @brief Query the approximate number of items in the queue.
+         */
+        [[nodiscard]] inline size_t size() const {
+            const size_t enq = enqueue_pos.load(std::memory_order_relaxed);
+            const size_t deq = dequeue_pos.load(std::memory_order_relaxed);
+            const auto diff = static_cast<intptr_t>(enq - deq);  // Negative while a pop of an empty queue races.
+            return diff > 0 ? static_cast<size_t>(diff) : 0;
+        }
+
+        /**
+         * @fn [[nodiscard]] inline size_t capacity() const
+         * @brief Query the number of items the queue holds.
+         */
+        [[nodiscard]] inline size_t capacity() const {
+            return mask + 1;
+        }
+
+    private:
+        struct cell { ///< @private
+            std::atomic<size_t> sequence; ///< @private
+            T data; ///< @private
+        };
+
+        alignas(cache_line_size) std::atomic<size_t> enqueue_pos; ///< @private
+        alignas(cache_line_size) std::atomic<size_t> dequeue_pos; ///< @private
+        alignas(cache_line_size) const size_t mask; ///< @private
+        std::unique_ptr<cell[]> cells; ///< @private
+    };
+}
+
+#endif //__HEPHAESTUS_QUEUES_HPP
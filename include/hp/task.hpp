@@ -0,0 +1,407 @@
+/**
+ * @file task.hpp
+ * @brief C++20 coroutine tasks running on the `job_system`, with awaitables for GPU work, file reads and jobs.
+ * @details Only built with the CMake option `HP_ENABLE_COROUTINES`, which defines `HP_COROUTINES_ENABLED`. The rest
+ *          of Hephaestus stays on C++17; Only code including this header has to be compiled as C++20.
+ *          Example Usage:
+ *          ```
+ *          hp::task<> upload_mesh(hp::vk::window *win, std::string path) {
+ *              auto bytes = co_await hp::read_file(*hp::jobs, path);
+ *              if (!bytes) co_return;
+ *              fill(staging, *bytes);
+ *              co_await hp::when_signaled(*hp::jobs, *win, win->copy_buffer(staging, mesh, false));
+ *          }
+ *          hp::spawn(*hp::jobs, upload_mesh(win, "mesh.bin"));
+ *          ```
+ */
+
+#pragma once
+
+#ifndef __HEPHAESTUS_TASK_HPP
+/**
+ * @def __HEPHAESTUS_TASK_HPP
+ * @brief This macro is defined if `task.hpp` has been included.
+ */
+#define __HEPHAESTUS_TASK_HPP
+
+#ifndef __cpp_impl_coroutine
+#error "hp/task.hpp needs C++20 coroutines! Configure with HP_ENABLE_COROUTINES and compile this file as C++20."
+#endif
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+#include "multithreading.hpp"
+
+namespace hp {
+    namespace vk {
+        class window;
+    }
+
+    template<typename T = void>
+    class task;
+
+    namespace detail {
+        /**
+         * @struct task_promise_base
+         * @private
+         * @brief Tasks start when awaited, and resume their awaiter once finished.
+         */
+        struct task_promise_base {
+            struct final_awaiter {
+                bool await_ready() noexcept {
+                    return false;
+                }
+
+                template<typename P>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept {
+                    return h.promise().continuation;
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            std::coroutine_handle<> continuation = std::noop_coroutine();
+
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+
+            final_awaiter final_suspend() noexcept {
+                return {};
+            }
+
+            void unhandled_exception() noexcept {
+                std::terminate();  // Like jobs, tasks must not throw.
+            }
+        };
+
+        template<typename T>
+        struct task_promise : task_promise_base {
+            std::optional<T> value;
+
+            task<T> get_return_object() noexcept;
+
+            void return_value(T v) {
+                value.emplace(std::move(v));
+            }
+        };
+
+        template<>
+        struct task_promise<void> : task_promise_base {
+            task<void> get_return_object() noexcept;
+
+            void return_void() noexcept {}
+        };
+    }
+
+    /**
+     * @class task
+     * @brief A coroutine computing a `T`. Starts once awaited, with `co_await`, or handed to `spawn()` or `sync_wait()`.
+     * @details Runs on whichever thread resumes it: Awaiting the awaitables of this file suspends the task without
+     *          blocking a thread, and resumes it as a job of the given `job_system`. Move only.
+     *          Tasks must not throw.
+     */
+    template<typename T>
+    class [[nodiscard]] task {
+    public:
+        /**
+         * @typedef promise_type
+         * @brief Promise type of the coroutine.
+         */
+        using promise_type = detail::task_promise<T>;
+
+        /**
+         * @fn task(task &&other) noexcept
+         * @brief Move a task.
+         */
+        task(task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+        /**
+         * @fn task &operator=(task &&other) noexcept
+         * @brief Move a task, destroying the one overwritten.
+         */
+        task &operator=(task &&other) noexcept {
+            if (this != &other) {
+                if (handle) {
+                    handle.destroy();
+                }
+                handle = std::exchange(other.handle, nullptr);
+            }
+            return *this;
+        }
+
+        task(const task &other) = delete; ///< @private
+        task &operator=(const task &other) = delete; ///< @private
+
+        /**
+         * @fn ~task()
+         * @brief Destroy the coroutine. Must not be running.
+         */
+        ~task() {
+            if (handle) {
+                handle.destroy();
+            }
+        }
+
+        /**
+         * @fn auto operator co_await() && noexcept
+         * @brief Start the task, and resume the awaiting coroutine with its result once finished.
+         */
+        auto operator co_await() && noexcept {
+            struct awaiter {
+                std::coroutine_handle<promise_type> handle;
+
+                bool await_ready() noexcept {
+                    return !handle || handle.done();
+                }
+
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                    handle.promise().continuation = awaiting;
+                    return handle;
+                }
+
+                T await_resume() {
+                    if constexpr (!std::is_void_v<T>) {
+                        return std::move(*handle.promise().value);
+                    }
+                }
+            };
+            return awaiter{handle};
+        }
+
+    private:
+        friend struct detail::task_promise<T>;
+
+        explicit task(std::coroutine_handle<promise_type> h) noexcept : handle(h) {}
+
+        std::coroutine_handle<promise_type> handle; ///< @private
+    };
+
+    namespace detail {
+        template<typename T>
+        task<T> task_promise<T>::get_return_object() noexcept {
+            return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+        }
+
+        inline task<void> task_promise<void>::get_return_object() noexcept {
+            return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+        }
+
+        /**
+         * @struct detached_task
+         * @private
+         * @brief Coroutine that starts at once and destroys itself once finished. Drives tasks from outside.
+         */
+        struct detached_task {
+            struct promise_type {
+                detached_task get_return_object() noexcept {
+                    return {};
+                }
+
+                std::suspend_never initial_suspend() noexcept {
+                    return {};
+                }
+
+                std::suspend_never final_suspend() noexcept {
+                    return {};
+                }
+
+                void return_void() noexcept {}
+
+                void unhandled_exception() noexcept {
+                    std::terminate();
+                }
+            };
+        };
+    }
+
+    /**
+     * @fn inline auto schedule(job_system &js)
+     * @brief Awaitable moving the awaiting coroutine onto a worker of `js`.
+     * @details Example Usage: `co_await hp::schedule(*hp::jobs);`
+     */
+    inline auto schedule(job_system &js) {
+        struct awaiter {
+            job_system &js;
+
+            bool await_ready() noexcept {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> h) {
+                js.submit([h]() { h.resume(); });
+            }
+
+            void await_resume() noexcept {}
+        };
+        return awaiter{js};
+    }
+
+    /**
+     * @fn inline auto when_done(job_system &js, const job_counter &counter)
+     * @brief Awaitable resuming the awaiting coroutine on a worker of `js` once every job counted by `counter` has
+     *        finished.
+     * @details Example Usage: `js.submit([&]() { cull(); }, &ctr); co_await hp::when_done(js, ctr);`
+     */
+    inline auto when_done(job_system &js, const job_counter &counter) {
+        struct awaiter : job_waiter {
+            job_system &js;
+            const job_counter &counter;
+            std::coroutine_handle<> handle;
+
+            awaiter(job_system &js, const job_counter &counter) : js(js), counter(counter) {}
+
+            bool await_ready() noexcept {
+                return counter.done();
+            }
+
+            void await_suspend(std::coroutine_handle<> h) {
+                handle = h;
+                ready = [](job_waiter &w) { return static_cast<awaiter &>(w).counter.done(); };
+                resume = [](job_waiter &w) { static_cast<awaiter &>(w).handle.resume(); };
+                js.park(*this);
+            }
+
+            void await_resume() noexcept {}
+        };
+        return awaiter{js, counter};
+    }
+
+    /**
+     * @class fence_awaiter
+     * @brief Awaitable resuming the awaiting coroutine once a copy of `vk::window::copy_buffer()` has finished. See
+     *        `when_signaled()`.
+     * @details The fence is polled by the workers of the job system, so no thread waits for the GPU. Once signaled,
+     *          the fence and command buffer are deleted.
+     */
+    class fence_awaiter : private job_waiter {
+    public:
+        /**
+         * @fn fence_awaiter(job_system &js, vk::window &win, std::pair<::vk::Fence, ::vk::CommandBuffer> copy)
+         * @brief Construct the awaitable. See `when_signaled()`.
+         */
+        fence_awaiter(job_system &js, vk::window &win, std::pair<::vk::Fence, ::vk::CommandBuffer> copy);
+
+        fence_awaiter(const fence_awaiter &other) = delete; ///< @private
+        fence_awaiter &operator=(const fence_awaiter &other) = delete; ///< @private
+
+        bool await_ready(); ///< @private
+        void await_suspend(std::coroutine_handle<> h); ///< @private
+        void await_resume(); ///< @private
+
+    private:
+        job_system &js; ///< @private
+        vk::window &win; ///< @private
+        std::pair<::vk::Fence, ::vk::CommandBuffer> copy; ///< @private
+        std::coroutine_handle<> handle; ///< @private
+    };
+
+    /**
+     * @fn inline fence_awaiter when_signaled(job_system &js, vk::window &win, std::pair<::vk::Fence, ::vk::CommandBuffer> copy)
+     * @brief Awaitable resuming the awaiting coroutine on a worker of `js` once a copy has finished on the GPU.
+     * @details Example Usage: `co_await hp::when_signaled(js, *win, win->copy_buffer(staging, vbo, false));`
+     * @param copy Fence and command buffer returned by `vk::window::copy_buffer()` with `wait` set to `false`. Both
+     *             are deleted once the fence is signaled. Returns at once for null handles.
+     */
+    inline fence_awaiter when_signaled(job_system &js, vk::window &win,
+                                       std::pair<::vk::Fence, ::vk::CommandBuffer> copy) {
+        return fence_awaiter(js, win, copy);
+    }
+
+    /**
+     * @class file_read
+     * @brief Awaitable reading a whole file on `hp::io_service`, and resuming the awaiting coroutine on a worker of
+     *        the job system afterwards. See `read_file()`.
+     * @details `co_await` results in the bytes of the file, or `std::nullopt` if it can't be read.
+     */
+    class file_read {
+    public:
+        /**
+         * @fn file_read(job_system &js, std::string path)
+         * @brief Construct the awaitable. See `read_file()`.
+         */
+        file_read(job_system &js, std::string path);
+
+        file_read(const file_read &other) = delete; ///< @private
+        file_read &operator=(const file_read &other) = delete; ///< @private
+
+        bool await_ready() noexcept { ///< @private
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> h); ///< @private
+        std::optional<std::vector<char>> await_resume(); ///< @private
+
+    private:
+        job_system &js; ///< @private
+        std::string path; ///< @private
+        std::optional<std::vector<char>> bytes; ///< @private
+    };
+
+    /**
+     * @fn inline file_read read_file(job_system &js, std::string path)
+     * @brief Awaitable reading a whole file without blocking a worker. See `file_read`.
+     * @details Example Usage: `std::optional<std::vector<char>> spv = co_await hp::read_file(js, "frag.spv");`
+     */
+    inline file_read read_file(job_system &js, std::string path) {
+        return file_read(js, std::move(path));
+    }
+
+    /**
+     * @fn inline void spawn(job_system &js, task<> t, job_counter *counter = nullptr)
+     * @brief Start a task on a worker of `js`, without waiting for it.
+     * @param counter Counter to count the task with until it finishes, or `nullptr`. See `job_system::wait()` and
+     *                `when_done()`.
+     */
+    inline void spawn(job_system &js, task<> t, job_counter *counter = nullptr) {
+        if (counter != nullptr) {
+            counter->add();
+        }
+
+        [](job_system &js, task<> t, job_counter *counter) -> detail::detached_task {
+            co_await schedule(js);
+            co_await std::move(t);
+            if (counter != nullptr) {
+                counter->signal();
+            }
+        }(js, std::move(t), counter);
+    }
+
+    /**
+     * @fn template<typename T> T sync_wait(job_system &js, task<T> t)
+     * @brief Run a task to completion, and return its result.
+     * @details The task starts on the calling thread. Waits like `job_system::wait()`, so the calling thread runs
+     *          jobs meanwhile, or the calling fiber is suspended.
+     */
+    template<typename T>
+    T sync_wait(job_system &js, task<T> t) {
+        job_counter done;
+        done.add();
+
+        if constexpr (std::is_void_v<T>) {
+            [](task<T> t, job_counter &done) -> detail::detached_task {
+                co_await std::move(t);
+                done.signal();
+            }(std::move(t), done);
+            js.wait(done);
+        } else {
+            std::optional<T> result;
+            [](task<T> t, job_counter &done, std::optional<T> &result) -> detail::detached_task {
+                result.emplace(co_await std::move(t));
+                done.signal();
+            }(std::move(t), done, result);
+            js.wait(done);
+            return std::move(*result);
+        }
+    }
+}
+
+#endif //__HEPHAESTUS_TASK_HPP
@@ -0,0 +1,149 @@
+/**
+ * @file task_graph.hpp
+ * @brief Reusable graphs of dependent tasks, run on the `job_system`.
+ */
+
+#pragma once
+
+#ifndef __HEPHAESTUS_TASK_GRAPH_HPP
+/**
+ * @def __HEPHAESTUS_TASK_GRAPH_HPP
+ * @brief This macro is defined if `task_graph.hpp` has been included.
+ */
+#define __HEPHAESTUS_TASK_GRAPH_HPP
+
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include "multithreading.hpp"
+#include "profiling.hpp"
+
+namespace hp {
+    /**
+     * @class task_graph
+     * @brief A directed acyclic graph of tasks that is built once and run as often as needed, such as once per frame.
+     * @details A task runs once all of the tasks it depends on have finished, on whichever worker finished the last of
+     *          them: The task that makes successors ready submits all but one of them and continues with the last
+     *          one itself, so chains of tasks don't go through the job queues at all.
+     *          Running only resets one counter per task and submits the tasks without dependencies; Nothing is
+     *          allocated. Every task is timed as a profiler zone (category "task") named after it.
+     *          Example Usage:
+     *          ```
+     *          hp::task_graph frame;
+     *          auto decode = frame.add("Decode", [&]() { decode_assets(); });
+     *          auto cull = frame.add("Cull", [&]() { cull(); });
+     *          frame.add("Record", [&]() { record(); }, {decode, cull});
+     *          while (running) { frame.run_and_wait(*hp::jobs); }
+     *          ```
+     */
+    class task_graph {
+    public:
+        /**
+         * @typedef task
+         * @brief Handle of a task in the graph, returned by `add()`.
+         */
+        using task = uint32_t;
+
+        /**
+         * @fn task_graph() = default
+         * @brief Construct an empty graph.
+         */
+        task_graph() = default;
+
+        /**
+         * @fn ~task_graph()
+         * @brief Wait for the graph to finish if it is running.
+         */
+        ~task_graph();
+
+        task_graph(const task_graph &other) = delete; ///< @private
+        task_graph &operator=(const task_graph &other) = delete; ///< @private
+
+        /**
+         * @fn task add(const char *name, std::function<void()> fn, std::initializer_list<task> deps = {})
+         * @brief Add a task. Must not be called while the graph is running.
+         * @param name Name of the task in profiler traces. Must outlive the graph, like a string literal.
+         * @param fn Work of the task. Must not throw.
+         * @param deps Tasks that have to finish before this one starts. See `precede()`.
+         * @return Handle of the new task.
+         */
+        task add(const char *name, std::function<void()> fn, std::initializer_list<task> deps = {});
+
+        /**
+         * @fn void precede(task before, task after)
+         * @brief Make `after` start only once `before` has finished. Must not be called while the graph is running.
+         */
+        void precede(task before, task after);
+
+        /**
+         * @fn bool run(job_system &js)
+         * @brief Start running every task of the graph on a job system, and return immediately. See `wait()`.
+         * @return False if the graph is still running, or has a cycle. Nothing is started then.
+         */
+        bool run(job_system &js);
+
+        /**
+         * @fn void wait()
+         * @brief Wait until the current run has finished, running other jobs meanwhile. Returns at once if not running.
+         */
+        void wait();
+
+        /**
+         * @fn inline void run_and_wait(job_system &js)
+         * @brief Run the graph and wait for it to finish.
+         */
+        inline void run_and_wait(job_system &js) {
+            if (run(js)) {
+                wait();
+            }
+        }
+
+        /**
+         * @fn [[nodiscard]] inline bool done() const
+         * @brief Query if every task of the last run has finished.
+         */
+        [[nodiscard]] inline bool done() const {
+            return finished.done();
+        }
+
+        /**
+         * @fn [[nodiscard]] inline const job_counter &counter() const
+         * @brief Retrieve the counter of unfinished tasks, to join on the graph with `job_system::wait()`.
+         */
+        [[nodiscard]] inline const job_counter &counter() const {
+            return finished;
+        }
+
+        /**
+         * @fn [[nodiscard]] inline size_t size() const
+         * @brief Query the number of tasks in the graph.
+         */
+        [[nodiscard]] inline size_t size() const {
+            return nodes.size();
+        }
+
+    private:
+        struct node { ///< @private
+            std::function<void()> fn; ///< @private
+            const zone_desc *zone; ///< @private
+            std::vector<task> successors; ///< @private
+            uint32_t predecessors = 0; ///< @private
+        };
+
+        bool compile(); ///< @private
+        void execute(task t); ///< @private
+
+        std::vector<node> nodes; ///< @private
+        std::vector<task> roots; ///< @private Tasks without dependencies. Set by `compile()`.
+        std::unique_ptr<std::atomic<uint32_t>[]> remaining; ///< @private Unfinished dependencies per task this run.
+        bool dirty = true; ///< @private Needs `compile()`.
+        bool acyclic = false; ///< @private Result of the last `compile()`.
+        job_system *js = nullptr; ///< @private System of the current run.
+        job_counter finished; ///< @private Tasks not yet finished this run.
+    };
+}
+
+#endif //__HEPHAESTUS_TASK_GRAPH_HPP
@@ -0,0 +1,327 @@
+/**
+ * @file trace_format.hpp
+ * @brief Compact binary profiler trace format, shared by `profiler_session` and the trace tools.
+ * @details A binary trace is the 8 byte `hp::trace::magic`, a header and then a stream of records, each starting
+ *          with a `hp::trace::record_type` byte. Integers are LEB128 varints, and signed integers are zigzag encoded.
+ *          - `zone_def`: varint id, string name, string category, string file, varint line, varint color.
+ *                        Emitted the first time a zone is used, so zone names are stored once per trace.
+ *          - `thread_def`: varint index, varint pid, varint thread id. Emitted the first time a thread is seen.
+ *          - `thread_name`: varint index, string. Optional display name of a thread, such as `"GPU"` for GPU tracks.
+ *          - `event`: varint zone id, varint thread index, zigzag start (delta from the previous event's start on the
+ *                     same thread), varint duration, zigzag frame index (delta from the previous event's frame on the
+ *                     same thread; Added in version 4).
+ *          - `counter`: varint zone id, varint pid, zigzag time (delta from the previous counter), zigzag frame index
+ *                       (delta from the previous counter), zigzag bytes, zigzag peak bytes, varint allocations.
+ *                       A sample of a memory counter (See `memory_tracking.hpp`). Added in version 5.
+ *          Version 1 traces used `name_def` (varint id, string name) instead of `zone_def`; Readers still accept it.
+ *          Use the `HephaestusTraceConvert` tool to turn a binary trace into Chrome trace JSON.
+ */
+
+#pragma once
+
+#ifndef __HEPHAESTUS_TRACE_FORMAT_HPP
+/**
+ * @def __HEPHAESTUS_TRACE_FORMAT_HPP
+ * @brief This macro is defined if `trace_format.hpp` has been included.
+ */
+#define __HEPHAESTUS_TRACE_FORMAT_HPP
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "spdlog/fmt/fmt.h"
+
+namespace hp {
+    /**
+     * @enum trace_format
+     * @brief Output format of a `profiler_session`.
+     */
+    enum class trace_format {
+        json, ///< Chrome trace JSON, viewable directly in `chrome://tracing`. Large and slow to write.
+        binary, ///< Compact binary format described in `trace_format.hpp`. Convert with `HephaestusTraceConvert`.
+        none ///< Don't write a trace at all. Only useful with `profiler_session::enable_stats()`.
+    };
+}
+
+namespace hp::trace {
+    /**
+     * @var constexpr char magic[8]
+     * @brief The first 8 bytes of every binary trace.
+     */
+    constexpr char magic[8] = {'H', 'P', 'T', 'R', 'A', 'C', 'E', '\0'};
+
+    /**
+     * @var constexpr uint32_t version
+     * @brief Version of the binary format written by this build. Readers reject newer versions.
+     */
+    constexpr uint32_t version = 5;
+
+    /**
+     * @enum record_type
+     * @brief Tag byte at the start of every record in a binary trace.
+     */
+    enum class record_type : uint8_t {
+        name_def = 1, ///< Defines only the name of a zone id. Only written by version 1.
+        thread_def = 2, ///< Defines the pid and thread id for a thread index.
+        event = 3, ///< A complete timed event.
+        zone_def = 4, ///< Defines the name, category, source location and color of a zone id.
+        thread_name = 5, ///< Names a thread index. Added in version 3.
+        counter = 6 ///< A sample of a memory counter. Added in version 5.
+    };
+
+    /**
+     * @struct header
+     * @brief The header at the start of a binary trace.
+     */
+    struct header {
+        uint32_t version = ::hp::trace::version; ///< Format version the trace was written with.
+        uint64_t ts_unit_ns = 1000; ///< Length of one timestamp tick in nanoseconds.
+        std::string session_name; ///< Name of the `profiler_session` that wrote the trace.
+        std::string compile_datetime; ///< When the writing binary was compiled.
+        std::string current_datetime; ///< When the trace was started.
+    };
+
+    /**
+     * @struct zone_info
+     * @brief Static description of a profiling zone. See `hp::zone_desc`.
+     */
+    struct zone_info {
+        std::string name; ///< Name of the zone.
+        std::string category; ///< Category of the zone, such as `"function"` or `"scope"`.
+        std::string file; ///< Source file the zone is in. Empty if unknown.
+        unsigned line = 0; ///< Source line the zone is on. 0 if unknown.
+        uint32_t color = 0; ///< `0xRRGGBB` color hint for viewers. 0 for the default.
+    };
+
+    /**
+     * @struct event
+     * @brief A decoded event. Resolve `zone_id` and `thread_index` with `reader::zone()` and `reader::thread()`.
+     */
+    struct event {
+        uint32_t zone_id = 0; ///< Id of the zone of the event.
+        uint32_t thread_index = 0; ///< Index of the thread the event was recorded on.
+        long long start = 0; ///< Start time in ticks of `header::ts_unit_ns`.
+        long long end = 0; ///< End time in ticks of `header::ts_unit_ns`.
+        uint32_t frame = 0; ///< Frame the event was recorded in. See `profiler_session::next_frame()`. 0 before version 4.
+    };
+
+    /**
+     * @struct counter
+     * @brief A decoded counter sample. Resolve `zone_id` with `reader::zone()`; It names the counter's call site.
+     */
+    struct counter {
+        uint32_t zone_id = 0; ///< Id of the zone naming the counter.
+        size_t pid = 0; ///< Process the counter was sampled in.
+        long long time = 0; ///< Sample time in ticks of `header::ts_unit_ns`.
+        uint32_t frame = 0; ///< Frame the sample ends.
+        long long bytes = 0; ///< Bytes allocated and not yet freed.
+        long long peak_bytes = 0; ///< Highest value of `bytes` during the frame.
+        unsigned long long allocations = 0; ///< Number of allocations made during the frame.
+    };
+
+    /**
+     * @enum record_kind
+     * @brief What `reader::next_record()` decoded.
+     */
+    enum class record_kind {
+        event, ///< A timed `event`.
+        counter ///< A `counter` sample.
+    };
+
+    /**
+     * @struct thread_info
+     * @brief Process and thread id of a thread index.
+     */
+    struct thread_info {
+        size_t pid = 0; ///< Process id.
+        size_t thread = 0; ///< Thread id.
+        std::string name; ///< Display name of the thread. Empty if it wasn't named.
+    };
+
+    /**
+     * @fn inline void put_varint(fmt::memory_buffer &buf, uint64_t val)
+     * @brief Append an unsigned LEB128 varint to a buffer.
+     */
+    inline void put_varint(fmt::memory_buffer &buf, uint64_t val) {
+        while (val >= 0x80u) {
+            buf.push_back(static_cast<char>((val & 0x7fu) | 0x80u));
+            val >>= 7u;
+        }
+        buf.push_back(static_cast<char>(val));
+    }
+
+    /**
+     * @fn inline void put_zigzag(fmt::memory_buffer &buf, int64_t val)
+     * @brief Append a zigzag encoded signed varint to a buffer, so small negative numbers stay small.
+     */
+    inline void put_zigzag(fmt::memory_buffer &buf, int64_t val) {
+        put_varint(buf, (static_cast<uint64_t>(val) << 1u) ^ static_cast<uint64_t>(val >> 63));
+    }
+
+    /**
+     * @fn inline void put_string(fmt::memory_buffer &buf, const std::string &str)
+     * @brief Append a length-prefixed string to a buffer.
+     */
+    inline void put_string(fmt::memory_buffer &buf, const std::string &str) {
+        put_varint(buf, str.size());
+        buf.append(str.data(), str.data() + str.size());
+    }
+
+    /**
+     * @class encoder
+     * @brief Stateful binary trace encoder. Defines zones and threads once, and delta encodes timestamps per thread.
+     * @note Not thread safe. `profiler_session` only calls it from whoever holds its write lock.
+     */
+    class encoder {
+    public:
+        /**
+         * @fn void write_header(fmt::memory_buffer &buf, const header &head)
+         * @brief Append the magic and header. Must be the first thing written.
+         */
+        void write_header(fmt::memory_buffer &buf, const header &head);
+
+        /**
+         * @fn [[nodiscard]] inline bool knows_zone(uint32_t id) const
+         * @brief Query if `write_zone()` was already called for a zone id.
+         */
+        [[nodiscard]] inline bool knows_zone(uint32_t id) const {
+            return id < zones.size() && zones[id];
+        }
+
+        /**
+         * @fn void write_zone(fmt::memory_buffer &buf, uint32_t id, const zone_info &zone)
+         * @brief Append a `zone_def` record. Call this once per zone before its first event (See `knows_zone()`).
+         */
+        void write_zone(fmt::memory_buffer &buf, uint32_t id, const zone_info &zone);
+
+        /**
+         * @fn void write_event(fmt::memory_buffer &buf, uint32_t zone_id, uint32_t frame, size_t pid, size_t thread, long long start, long long end)
+         * @brief Append an event, preceded by a `thread_def` record if the thread is new.
+         */
+        void write_event(fmt::memory_buffer &buf, uint32_t zone_id, uint32_t frame, size_t pid, size_t thread,
+                         long long start, long long end);
+
+        /**
+         * @fn void write_thread_name(fmt::memory_buffer &buf, size_t pid, size_t thread, const std::string &name)
+         * @brief Append a `thread_name` record, preceded by a `thread_def` record if the thread is new.
+         */
+        void write_thread_name(fmt::memory_buffer &buf, size_t pid, size_t thread, const std::string &name);
+
+        /**
+         * @fn void write_counter(fmt::memory_buffer &buf, const counter &ctr)
+         * @brief Append a `counter` record. Its zone must be known, like an event's.
+         */
+        void write_counter(fmt::memory_buffer &buf, const counter &ctr);
+
+    private:
+        struct thread_state { ///< @private
+            uint32_t index; ///< @private
+            long long last_start; ///< @private
+            uint32_t last_frame; ///< @private
+        };
+
+        thread_state &thread_index(fmt::memory_buffer &buf, size_t pid, size_t thread); ///< @private
+
+        std::vector<bool> zones; ///< @private
+        std::unordered_map<size_t, thread_state> threads; ///< @private
+        long long last_counter_time = 0; ///< @private
+        uint32_t last_counter_frame = 0; ///< @private
+    };
+
+    /**
+     * @class reader
+     * @brief Decodes a binary trace from a stream.
+     */
+    class reader {
+    public:
+        /**
+         * @fn explicit reader(std::istream &in)
+         * @brief Construct a reader. Call `read_header()` before `next()`.
+         * @param in Stream to read from. Should be opened in binary mode.
+         */
+        explicit reader(std::istream &in);
+
+        /**
+         * @fn bool read_header(header &out)
+         * @brief Read and validate the magic and header.
+         * @return False if the stream isn't a binary trace or was written by a newer version.
+         */
+        bool read_header(header &out);
+
+        /**
+         * @fn bool next(event &out)
+         * @brief Read up to and including the next event, applying any definitions on the way.
+         * @details Skips counter samples. Use `next_record()` to get those as well.
+         * @return False at the end of the stream or on a malformed record. See `failed()` to tell them apart.
+         */
+        bool next(event &out);
+
+        /**
+         * @fn bool next_record(event &ev, counter &ctr, record_kind &kind)
+         * @brief Read up to and including the next event or counter sample, applying any definitions on the way.
+         * @param kind Set to which of `ev` and `ctr` was written to.
+         * @return False at the end of the stream or on a malformed record. See `failed()` to tell them apart.
+         */
+        bool next_record(event &ev, counter &ctr, record_kind &kind);
+
+        /**
+         * @fn [[nodiscard]] const zone_info &zone(uint32_t id) const
+         * @brief Look up a zone defined so far. Returns an empty `zone_info` for unknown ids.
+         */
+        [[nodiscard]] const zone_info &zone(uint32_t id) const;
+
+        /**
+         * @fn [[nodiscard]] const thread_info &thread(uint32_t index) const
+         * @brief Look up a thread defined so far. Returns zeroes for unknown indices.
+         */
+        [[nodiscard]] const thread_info &thread(uint32_t index) const;
+
+        /**
+         * @fn [[nodiscard]] inline uint32_t thread_count() const
+         * @brief Query the number of thread indices defined so far.
+         */
+        [[nodiscard]] inline uint32_t thread_count() const {
+            return static_cast<uint32_t>(threads.size());
+        }
+
+        /**
+         * @fn [[nodiscard]] inline bool failed() const
+         * @brief True if reading stopped because of a malformed or truncated record.
+         */
+        [[nodiscard]] inline bool failed() const {
+            return fail;
+        }
+
+        /**
+         * @var static constexpr uint64_t max_string_size
+         * @brief Longest string a trace may contain. Longer ones are treated as corruption.
+         */
+        static constexpr uint64_t max_string_size = 1u << 20u;
+
+        /**
+         * @var static constexpr uint64_t max_id
+         * @brief Largest zone id or thread index a trace may define. Larger ones are treated as corruption.
+         * @details Ids index tables that are resized to fit them, so a corrupt id can't be allowed to be arbitrarily large.
+         */
+        static constexpr uint64_t max_id = 1u << 20u;
+
+    private:
+        bool get_varint(uint64_t &out); ///< @private
+        bool get_string(std::string &out); ///< @private Reads in chunks, so only bytes that are there get allocated.
+
+        std::istream &in; ///< @private
+        std::vector<zone_info> zones; ///< @private
+        std::vector<thread_info> threads; ///< @private
+        std::vector<long long> last_starts; ///< @private
+        std::vector<uint32_t> last_frames; ///< @private
+        long long last_counter_time = 0; ///< @private
+        uint32_t last_counter_frame = 0; ///< @private
+        uint32_t file_version = 0; ///< @private Set by `read_header()`.
+        bool fail = false; ///< @private
+    };
+}
+
+#endif //__HEPHAESTUS_TRACE_FORMAT_HPP
@@ -0,0 +1,205 @@
+/**
+ * @file command_stream.hpp
+ * @brief A compact list of recorded draw commands, replayed into Vulkan command buffers.
+ * @details Commands are plain structs tagged with an opcode, copied back to back into one growing block of memory.
+ *          Recording a command never allocates once the block is big enough, and `clear()` keeps it, so re-recording
+ *          a scene of the same size allocates nothing at all. Replaying is a single pass over the block with a
+ *          `switch` on each opcode, instead of an indirect call per command.
+ */
+
+#pragma once
+
+#ifndef __HEPHAESTUS_VK_COMMAND_STREAM_HPP
+/**
+ * @def __HEPHAESTUS_VK_COMMAND_STREAM_HPP
+ * @brief This macro is defined if `command_stream.hpp` has been included.
+ */
+#define __HEPHAESTUS_VK_COMMAND_STREAM_HPP
+
+#include "hp/vk/vk.hpp"
+#include "hp/vk/gpu_profiler.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace hp::vk {
+    /**
+     * @enum command_op
+     * @brief Tags every command in a `command_stream`, so the replay knows which struct follows.
+     */
+    enum class command_op : uint8_t {
+        bind_pipeline, ///< `bind_pipeline_cmd`
+        set_viewport, ///< `set_viewport_cmd`
+        set_scissor, ///< `set_scissor_cmd`
+        bind_vbos, ///< `bind_vbos_cmd`
+        bind_index_buffer, ///< `bind_index_buffer_cmd`
+        draw, ///< `draw_cmd`
+        draw_indexed, ///< `draw_indexed_cmd`
+        write_timestamp ///< `write_timestamp_cmd`
+    };
+
+    /**
+     * @struct bind_pipeline_cmd
+     * @brief Bind a graphics pipeline. Recorded by `window::rec_bind_shader()`.
+     */
+    struct alignas(8) bind_pipeline_cmd {
+        static constexpr command_op op = command_op::bind_pipeline; ///< Opcode of this command.
+        command_op tag = op; ///< @private
+        ::vk::Pipeline pipeline; ///< Pipeline to bind.
+    };
+
+    /**
+     * @struct set_viewport_cmd
+     * @brief Set the viewport. Recorded by `window::rec_set_viewport()`.
+     */
+    struct alignas(8) set_viewport_cmd {
+        static constexpr command_op op = command_op::set_viewport; ///< Opcode of this command.
+        command_op tag = op; ///< @private
+        ::vk::Viewport viewport; ///< The new viewport.
+    };
+
+    /**
+     * @struct set_scissor_cmd
+     * @brief Set the scissor. Recorded by `window::rec_set_scissor()`.
+     */
+    struct alignas(8) set_scissor_cmd {
+        static constexpr command_op op = command_op::set_scissor; ///< Opcode of this command.
+        command_op tag = op; ///< @private
+        ::vk::Rect2D scissor; ///< The new scissor.
+    };
+
+    /**
+     * @struct bind_vbos_cmd
+     * @brief Bind vertex buffers. Recorded by `window::rec_bind_vbos()`.
+     * @details The buffers and offsets are read when the stream is replayed, not when it is recorded, so they *MUST*
+     *          stay valid until then.
+     */
+    struct alignas(8) bind_vbos_cmd {
+        static constexpr command_op op = command_op::bind_vbos; ///< Opcode of this command.
+        command_op tag = op; ///< @private
+        uint32_t first = 0; ///< Index of the first binding to update.
+        uint32_t count = 0; ///< Number of buffers to bind.
+        const ::vk::Buffer *bufs = nullptr; ///< `count` buffers.
+        const ::vk::DeviceSize *offsets = nullptr; ///< `count` offsets (in bytes) into the buffers.
+    };
+
+    /**
+     * @struct bind_index_buffer_cmd
+     * @brief Bind an index buffer. Recorded by `window::rec_bind_index_buffer()`.
+     */
+    struct alignas(8) bind_index_buffer_cmd {
+        static constexpr command_op op = command_op::bind_index_buffer; ///< Opcode of this command.
+        command_op tag = op; ///< @private
+        ::vk::IndexType type = ::vk::IndexType::eUint16; ///< Type of the indices.
+        ::vk::Buffer buf; ///< Buffer holding the indices.
+        ::vk::DeviceSize offset = 0; ///< Offset (in bytes) of the first index.
+    };
+
+    /**
+     * @struct draw_cmd
+     * @brief Draw vertices. Recorded by `window::rec_draw()`.
+     */
+    struct alignas(8) draw_cmd {
+        static constexpr command_op op = command_op::draw; ///< Opcode of this command.
+        command_op tag = op; ///< @private
+        uint32_t vertex_count = 0; ///< Number of vertices to draw.
+    };
+
+    /**
+     * @struct draw_indexed_cmd
+     * @brief Draw with the bound index buffer. Recorded by `window::rec_draw_indexed()`.
+     */
+    struct alignas(8) draw_indexed_cmd {
+        static constexpr command_op op = command_op::draw_indexed; ///< Opcode of this command.
+        command_op tag = op; ///< @private
+        uint32_t index_count = 0; ///< Number of indices to draw.
+    };
+
+    /**
+     * @struct write_timestamp_cmd
+     * @brief Write a GPU profiler timestamp. Recorded by `window::rec_gpu_zone_begin()` and `rec_gpu_zone_end()`.
+     */
+    struct alignas(8) write_timestamp_cmd {
+        static constexpr command_op op = command_op::write_timestamp; ///< Opcode of this command.
+        command_op tag = op; ///< @private
+        uint32_t query = 0; ///< Query of the `gpu_profiler` to write.
+        ::vk::PipelineStageFlagBits stage = ::vk::PipelineStageFlagBits::eTopOfPipe; ///< Stage to write it at.
+    };
+
+    /**
+     * @class command_stream
+     * @brief An append-only list of commands, replayed into a command buffer by `replay()`.
+     * @details Example Usage:
+     *          ```
+     *          hp::vk::command_stream stream;
+     *          hp::vk::draw_cmd draw;
+     *          draw.vertex_count = 3;
+     *          stream.push(draw);
+     *          stream.replay(cmd_buf, gpu_prof);
+     *          ```
+     *          Set the fields of commands by name; The opcode tag comes first, so aggregate initialization would
+     *          overwrite it.
+     * @note Not thread safe.
+     */
+    class command_stream {
+    public:
+        command_stream() = default;
+
+        /**
+         * @fn template<typename Command> inline void push(const Command &command)
+         * @brief Append a command to the end of the stream.
+         * @param command One of the `*_cmd` structs of `command_stream.hpp`.
+         */
+        template<typename Command>
+        inline void push(const Command &command) {
+            static_assert(std::is_trivially_copyable_v<Command> && sizeof(Command) % sizeof(uint64_t) == 0,
+                          "Commands must be trivially copyable and declared alignas(8)!");
+
+            const size_t at = words.size();
+            words.resize(at + sizeof(Command) / sizeof(uint64_t));
+            std::memcpy(words.data() + at, static_cast<const void *>(&command), sizeof(Command));
+            count++;
+        }
+
+        /**
+         * @fn inline void clear()
+         * @brief Remove every command. Keeps the memory, for the next recording to reuse.
+         */
+        inline void clear() {
+            words.clear();
+            count = 0;
+        }
+
+        /**
+         * @fn [[nodiscard]] inline size_t size() const
+         * @brief Query the number of commands in the stream.
+         */
+        [[nodiscard]] inline size_t size() const {
+            return count;
+        }
+
+        /**
+         * @fn [[nodiscard]] inline size_t bytes() const
+         * @brief Query the number of bytes the commands in the stream take up.
+         */
+        [[nodiscard]] inline size_t bytes() const {
+            return words.size() * sizeof(uint64_t);
+        }
+
+        /**
+         * @fn void replay(::vk::CommandBuffer cmd, gpu_profiler &prof) const
+         * @brief Record every command of the stream into `cmd`, in order.
+         * @param cmd Command buffer that is recording, inside a render pass.
+         * @param prof Profiler `write_timestamp_cmd`s are written with.
+         */
+        void replay(::vk::CommandBuffer cmd, gpu_profiler &prof) const;
+
+    private:
+        std::vector<uint64_t> words; ///< @private Commands, each padded to whole words.
+        size_t count = 0; ///< @private
+    };
+}
+
+#endif //__HEPHAESTUS_VK_COMMAND_STREAM_HPP
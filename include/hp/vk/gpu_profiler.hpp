@@ -0,0 +1,152 @@
+/**
+ * @file gpu_profiler.hpp
+ * @brief GPU zones timed with Vulkan timestamp queries, reported to the CPU profiler on a separate "GPU" track.
+ */
+
+#pragma once
+
+#ifndef __HEPHAESTUS_VK_GPU_PROFILER_HPP
+/**
+ * @def __HEPHAESTUS_VK_GPU_PROFILER_HPP
+ * @brief This macro is defined if `gpu_profiler.hpp` has been included.
+ */
+#define __HEPHAESTUS_VK_GPU_PROFILER_HPP
+
+#include "hp/profiling.hpp"
+#include "hp/vk/vk.hpp"
+
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+namespace hp::vk {
+    /**
+     * @class gpu_profiler
+     * @brief Times GPU work with timestamp queries and hands the results to `profiler_session::default_session`.
+     * @details Owned by a `hp::vk::window`. Command buffers are recorded once per swapchain image, so every image gets its
+     *          own `VkQueryPool`. Each recorded command buffer resets its pool, and writes a pair of timestamps for the
+     *          render pass and for every zone recorded with `window::rec_gpu_zone_begin()`/`window::rec_gpu_zone_end()`.
+     *          Results are read back without stalling, once the frame's fence has signaled, and converted to the CPU
+     *          clock with either `VK_EXT_calibrated_timestamps` or a measured submit round trip.
+     *          Works on any device with timestamp support on the graphics queue, including lavapipe.
+     */
+    class gpu_profiler {
+    public:
+        /**
+         * @var static constexpr uint32_t max_zones
+         * @brief Maximum number of GPU zones (including the render pass) per recording. Extra zones are ignored.
+         */
+        static constexpr uint32_t max_zones = 256;
+
+        /**
+         * @var static constexpr std::chrono::seconds calibration_interval
+         * @brief How often the GPU clock is re-calibrated against the CPU clock to correct drift between the two.
+         * @details Only with `VK_EXT_calibrated_timestamps`, which doesn't block. Without it, the calibration waits for
+         *          a submission, so it is only measured while the device is idle anyway: At startup, and whenever the
+         *          command buffers are re-recorded after waiting for the device (swapchain recreation,
+         *          `window::save_recording()`, `window::set_dynamic_recording()`).
+         */
+        static constexpr std::chrono::seconds calibration_interval = std::chrono::seconds(2);
+
+        gpu_profiler() = default;
+
+        /**
+         * @fn [[nodiscard]] inline bool is_supported() const
+         * @brief Query if the device supports timestamps on the graphics queue. Otherwise everything is a no-op.
+         */
+        [[nodiscard]] inline bool is_supported() const {
+            return supported;
+        }
+
+        /**
+         * @fn [[nodiscard]] inline bool uses_calibrated_timestamps() const
+         * @brief Query if `VK_EXT_calibrated_timestamps` is used to line GPU timestamps up with the CPU clock.
+         */
+        [[nodiscard]] inline bool uses_calibrated_timestamps() const {
+            return calibrated_ext;
+        }
+
+        /**
+         * @fn void write_timestamp(::vk::CommandBuffer cmd, uint32_t query, ::vk::PipelineStageFlagBits stage)
+         * @brief Record a timestamp write into the pool of the image being recorded. Used by the `rec_gpu_zone_*` commands.
+         */
+        void write_timestamp(::vk::CommandBuffer cmd, uint32_t query, ::vk::PipelineStageFlagBits stage);
+
+    private:
+        friend class window;
+
+        struct pending_frame { ///< @private
+            bool active = false; ///< @private
+            uint32_t frame = 0; ///< @private CPU frame index at submission.
+        };
+
+        void init(::vk::Instance inst, ::vk::PhysicalDevice phys, ::vk::Device dev, uint32_t queue_fam,
+                  ::vk::Queue queue, bool has_calibrated_ext); ///< @private
+
+        void destroy(); ///< @private
+
+        uint32_t begin_zone(const zone_desc *zone); ///< @private Returns the query to write, or `UINT32_MAX`.
+
+        uint32_t end_zone(); ///< @private Returns the query to write, or `UINT32_MAX`.
+
+        void clear_zones(); ///< @private
+
+        const zone_desc *named_zone(const char *name); ///< @private
+
+        void prepare(size_t n_images); ///< @private Call after the device is idle, before re-recording.
+
+        void prepare_image(uint32_t img); ///< @private Before re-recording one image, once it was collected.
+
+        void begin_commands(::vk::CommandBuffer cmd, uint32_t img); ///< @private Before the render pass begins.
+
+        void close_zones(::vk::CommandBuffer cmd); ///< @private Before the render pass ends.
+
+        void end_commands(::vk::CommandBuffer cmd); ///< @private After the render pass ends.
+
+        void submitted(size_t flight_slot, uint32_t img); ///< @private
+
+        void frame_done(size_t flight_slot); ///< @private After the flight fence of `flight_slot` signaled.
+
+        void collect(uint32_t img); ///< @private
+
+        void collect_all(); ///< @private Call after the device is idle.
+
+        void calibrate(); ///< @private Blocks without `VK_EXT_calibrated_timestamps`; Only call it while idle then.
+
+        long long to_cpu_ns(uint64_t gpu_ticks) const; ///< @private
+
+        bool supported = false; ///< @private
+        bool calibrated_ext = false; ///< @private
+        ::vk::Instance inst; ///< @private
+        ::vk::PhysicalDevice phys; ///< @private
+        ::vk::Device dev; ///< @private
+        ::vk::Queue queue; ///< @private
+        double period_ns = 1.0; ///< @private
+        uint64_t valid_mask = ~uint64_t(0); ///< @private
+
+        uint64_t gpu_base = 0; ///< @private
+        long long cpu_base_ns = 0; ///< @private
+        long long last_calibration_ns = 0; ///< @private
+
+        ::vk::CommandPool calib_pool; ///< @private Only used without `VK_EXT_calibrated_timestamps`.
+        ::vk::CommandBuffer calib_cmd; ///< @private
+        ::vk::QueryPool calib_queries; ///< @private
+        ::vk::Fence calib_fence; ///< @private
+
+        std::vector<::vk::QueryPool> pools; ///< @private One per swapchain image.
+        std::vector<pending_frame> pending; ///< @private One per swapchain image.
+        std::vector<uint32_t> flight_imgs; ///< @private Image submitted with each flight fence.
+        std::vector<uint64_t> results; ///< @private
+
+        std::vector<const zone_desc *> zones; ///< @private Zones for the next recording. Zone `i` uses queries `2i`, `2i+1`.
+        std::vector<std::vector<const zone_desc *>> recorded_zones; ///< @private Zones of each image's command buffer.
+        std::vector<uint32_t> open_zones; ///< @private
+        std::unordered_map<const char *, const zone_desc *> names; ///< @private
+        uint32_t rec_img = 0; ///< @private
+
+        profiler_session *track_session = nullptr; ///< @private
+        size_t track = 0; ///< @private
+    };
+}
+
+#endif //__HEPHAESTUS_VK_GPU_PROFILER_HPP
@@ -14,11 +14,17 @@
 #define __HEPHAESTUS_VK_WINDOW_HPP
 
 #include "hp/config.hpp"
+#include "hp/memory_tracking.hpp"
+#include "hp/multithreading.hpp"
 #include "hp/vk/vk.hpp"
+#include "hp/vk/gpu_profiler.hpp"
+#include "hp/vk/command_stream.hpp"
 #include "hp/hp.hpp"
 
 #include "glm/glm.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <map>
 #include <set>
 #include <queue>
@@ -292,6 +298,7 @@ namespace hp::vk {
         ::vk::Buffer buf; ///< @private
         window *parent{}; ///< @private
         VmaAllocation allocation{}; ///< @private
+        size_t tracked_bytes = 0; ///< @private Device memory counted by `HP_TRACK_ALLOC`, freed by the destructor.
 
         generic_buffer(size_t size, const ::vk::BufferUsageFlags &usage, const ::vk::MemoryPropertyFlags &flags,
                        window *parent); ///< @private
@@ -596,6 +603,102 @@ namespace hp::vk {
         void rebuild_pipeline();
     };
 
+    /**
+     * @class draw_list
+     * @brief Draw commands recorded apart from the window's own, so that many threads can record at the same time.
+     * @details Register a list with `window::add_draw_list()`. `window::save_recording()` then replays every list
+     *          into a secondary command buffer of its own, on the workers of `hp::jobs`, and executes them after the
+     *          window's own commands in the order they were added. Each list starts with no state bound, so it has to
+     *          bind a shader and set the viewport and scissor itself.
+     *          Example Usage:
+     *          ```
+     *          std::vector<hp::vk::draw_list> lists(16);
+     *          hp::parallel_for(*hp::jobs, 0, lists.size(), [&](size_t i) {
+     *              lists[i].clear();
+     *              lists[i].rec_bind_shader(shaders);
+     *              // ...
+     *          });
+     *          inst->save_recording();
+     *          ```
+     * @note Different lists can be recorded concurrently, but a single list is not thread safe. Lists *MUST NOT* be
+     *       changed while `save_recording()` runs.
+     */
+    class draw_list {
+    public:
+        /**
+         * @fn draw_list() = default
+         * @brief Standard default constructor.
+         */
+        draw_list() = default;
+
+        /**
+         * @fn void clear()
+         * @brief Remove every recorded command.
+         */
+        void clear();
+
+        /**
+         * @fn void rec_bind_shader(shader_program *shader)
+         * @brief Record binding a pipeline. See `window::rec_bind_shader()`.
+         */
+        void rec_bind_shader(shader_program *shader);
+
+        /**
+         * @fn void rec_set_viewport(::vk::Viewport viewport)
+         * @brief Record setting the viewport. See `window::rec_set_viewport()`.
+         */
+        void rec_set_viewport(::vk::Viewport viewport);
+
+        /**
+         * @fn void rec_set_scissor(::vk::Rect2D scissor)
+         * @brief Record setting the scissor. See `window::rec_set_scissor()`.
+         */
+        void rec_set_scissor(::vk::Rect2D scissor);
+
+        /**
+         * @fn void rec_bind_vbos(vertex_buffer *vbo)
+         * @brief Record binding a *single* vertex buffer object. See `window::rec_bind_vbos()`.
+         */
+        void rec_bind_vbos(vertex_buffer *vbo);
+
+        /**
+         * @fn void rec_bind_vbos(vertex_bind_info *bi, uint32_t start = 0)
+         * @brief Record binding a list of vertex buffer objects. See `window::rec_bind_vbos()`.
+         */
+        void rec_bind_vbos(vertex_bind_info *bi, uint32_t start = 0);
+
+        /**
+         * @fn void rec_bind_index_buffer(index_buffer ibo)
+         * @brief Record binding an index buffer. See `window::rec_bind_index_buffer()`.
+         */
+        void rec_bind_index_buffer(index_buffer ibo);
+
+        /**
+         * @fn void rec_draw_indexed(::vk::DeviceSize num_indices)
+         * @brief Record issuing a draw command using the index buffer. See `window::rec_draw_indexed()`.
+         */
+        void rec_draw_indexed(::vk::DeviceSize num_indices);
+
+        /**
+         * @fn void rec_draw(unsigned num_verts)
+         * @brief Record issuing a standard draw command. See `window::rec_draw()`.
+         */
+        void rec_draw(unsigned num_verts);
+
+        /**
+         * @fn [[nodiscard]] inline size_t size() const
+         * @brief Query the number of recorded commands.
+         */
+        [[nodiscard]] inline size_t size() const {
+            return stream.size();
+        }
+
+    private:
+        command_stream stream; ///< @private
+
+        friend class window;
+    };
+
     static void on_resize_event(GLFWwindow *win, int width, int height); ///< @private
 
     static void on_iconify_event(GLFWwindow *win, int state); ///< @private
@@ -603,6 +706,8 @@ namespace hp::vk {
     /**
      * @class window
      * @brief Describes a vulkan window. Is used as a base for all operations.
+     * @details A headless window (See `window(int, int, const char *, uint32_t, bool)`) has no GLFW window, surface
+     *          or swapchain, and renders into offscreen images instead. Everything else works the same.
      */
     class window {
     private:
@@ -610,6 +715,12 @@ namespace hp::vk {
         ::vk::SurfaceKHR surf; ///< @private
         size_t current_frame = 0; ///< @private
 
+        bool headless = false; ///< @private
+        std::vector<VmaAllocation> offscreen_allocs; ///< @private Memory of the offscreen images, if headless.
+        size_t offscreen_bytes = 0; ///< @private Device memory counted by `HP_TRACK_ALLOC`, freed by the destructor.
+        uint32_t last_img = UINT32_MAX; ///< @private Image the last `draw_frame()` submitted to. For `read_frame()`.
+        generic_buffer *readback_buf = nullptr; ///< @private Host visible copy target of `read_frame()`.
+
         bool uses_validation_layers{}; ///< @private
         ::vk::Instance inst; ///< @private
         VkDebugUtilsMessengerEXT debug_msgr{}; ///< @private
@@ -620,6 +731,7 @@ namespace hp::vk {
         ::vk::PhysicalDevice *phys_dev{}; ///< @private
         ::vk::PhysicalDeviceMemoryProperties mem_props; ///< @private
         ::vk::Device log_dev; ///< @private
+        ::vk::PipelineCache pipeline_cache; ///< @private Shared by every `shader_program`. See `save_pipeline_cache()`.
         std::multimap<float, ::vk::PhysicalDevice> devices; ///< @private
 
         ::vk::Queue graphics_queue; ///< @private
@@ -650,9 +762,15 @@ namespace hp::vk {
 
         std::vector<::vk::Fence> child_fences;
 
-        std::vector<std::function<void(::vk::CommandBuffer, window * )>> record_buffer; ///< @private
+        draw_list commands; ///< @private Everything recorded by the `rec_*` functions, for `save_recording()`.
+        std::vector<draw_list *> draw_lists; ///< @private See `add_draw_list()`.
+        std::vector<std::vector<::vk::CommandPool>> draw_pools; ///< @private Per frame in flight, a pool per worker.
+        std::mutex shared_draw_pool_mtx; ///< @private See `thread_draw_pool()`.
+        bool dynamic_recording = false; ///< @private See `set_dynamic_recording()`.
         mutable std::recursive_mutex render_mtx; ///< @private
 
+        gpu_profiler gpu_prof; ///< @private
+
         void (*swap_recreate_callback)(::vk::Extent2D) = nullptr; ///< @private
 
         bool swapchain_recreate_event = false; ///< @private
@@ -665,6 +783,68 @@ namespace hp::vk {
         void record_cmd_bufs(std::vector<::vk::Framebuffer> *frame_bufs,
                              ::vk::RenderPass *rend_pass, ::vk::Extent2D *extent); ///< @private
 
+        /**
+         * @fn void record_primary(::vk::CommandBuffer cmd, uint32_t img, ::vk::Framebuffer frame_buf, ::vk::RenderPass rend_pass, ::vk::Extent2D extent, const ::vk::CommandBuffer *list_bufs, size_t pool_set, ::vk::CommandBufferUsageFlags usage)
+         * @private
+         * @brief Record the render pass of image `img` into `cmd`: The window's own commands, then `list_bufs`.
+         * @param list_bufs `draw_lists.size()` secondary buffers recorded for `frame_buf`.
+         * @param pool_set Set of `draw_pools` the secondary buffer for the window's own commands comes from.
+         */
+        void record_primary(::vk::CommandBuffer cmd, uint32_t img, ::vk::Framebuffer frame_buf,
+                            ::vk::RenderPass rend_pass, ::vk::Extent2D extent, const ::vk::CommandBuffer *list_bufs,
+                            size_t pool_set, ::vk::CommandBufferUsageFlags usage);
+
+        /**
+         * @fn ::vk::CommandBuffer frame_cmd_buf(uint32_t img)
+         * @private
+         * @brief Get the command buffer to submit for image `img`. Records a new one with dynamic recording.
+         */
+        ::vk::CommandBuffer frame_cmd_buf(uint32_t img);
+
+        /**
+         * @fn void reset_draw_pools(size_t pool_set)
+         * @private
+         * @brief Create the pools of set `pool_set` of `draw_pools` if needed, and reset them.
+         * @note Nothing allocated from the set may still be pending execution.
+         */
+        void reset_draw_pools(size_t pool_set);
+
+        /**
+         * @fn ::vk::CommandPool thread_draw_pool(size_t pool_set)
+         * @private
+         * @brief Get the calling thread's pool in set `pool_set` of `draw_pools`.
+         * @details Each worker of `hp::jobs` has a pool of its own. Every other thread gets the last one: The thread
+         *          drawing, holding `render_mtx`, but also any thread that runs recording jobs while waiting on
+         *          `hp::jobs`. Those must hold `shared_draw_pool_mtx` while using it, and so does the drawing thread
+         *          when it allocates from it. Recording the primary buffer needs no lock, as every recording job is done.
+         */
+        ::vk::CommandPool thread_draw_pool(size_t pool_set);
+
+        /**
+         * @fn std::vector<::vk::CommandBuffer> record_draw_lists(const ::vk::Framebuffer *frame_bufs, size_t num_bufs, ::vk::RenderPass rend_pass, size_t pool_set)
+         * @private
+         * @brief Replay every draw list into secondary command buffers for every framebuffer, in parallel.
+         * @return The buffers, `draw_lists.size()` per framebuffer, in the order of `draw_lists`.
+         */
+        std::vector<::vk::CommandBuffer> record_draw_lists(const ::vk::Framebuffer *frame_bufs, size_t num_bufs,
+                                                           ::vk::RenderPass rend_pass, size_t pool_set);
+
+        /**
+         * @fn ::vk::CommandBuffer begin_secondary(::vk::RenderPass rend_pass, ::vk::Framebuffer frame_buf, size_t pool_set)
+         * @private
+         * @brief Allocate a secondary command buffer from the calling thread's pool in set `pool_set` of `draw_pools`,
+         *        and begin it.
+         */
+        ::vk::CommandBuffer begin_secondary(::vk::RenderPass rend_pass, ::vk::Framebuffer frame_buf, size_t pool_set);
+
+        /**
+         * @fn void create_pipeline_cache()
+         * @private
+         * @brief Create `pipeline_cache`, from the contents of `hp::vk::pipeline_cache_file` if they were saved by the
+         *        same driver on the same device. Otherwise, it starts out empty.
+         */
+        void create_pipeline_cache();
+
         ::vk::Result createDebugUtilsMessengerEXT(const VkDebugUtilsMessengerCreateInfoEXT *pCreateInfo,
                                                   const VkAllocationCallbacks *pAllocator,
                                                   VkDebugUtilsMessengerEXT *pDebugMessenger); ///< @private
@@ -677,6 +857,20 @@ namespace hp::vk {
 
         void recreate_swapchain(); ///< @private
 
+        /**
+         * @fn void create_offscreen_targets(::vk::Extent2D extent)
+         * @private
+         * @brief Headless counterpart to `create_swapchain()`: Allocate the images frames are rendered into.
+         */
+        void create_offscreen_targets(::vk::Extent2D extent);
+
+        /**
+         * @fn ::vk::RenderPass create_render_pass(::vk::Format fmt, ::vk::ImageLayout final_layout)
+         * @private
+         * @brief Create the render pass drawing into a single color attachment, left in `final_layout`.
+         */
+        ::vk::RenderPass create_render_pass(::vk::Format fmt, ::vk::ImageLayout final_layout);
+
         friend class shader_program;
 
         friend class generic_buffer;
@@ -695,14 +889,19 @@ namespace hp::vk {
         window() = default;
 
         /**
-         * @fn window(int width, int height, const char *app_name, uint32_t version)
+         * @fn window(int width, int height, const char *app_name, uint32_t version, bool headless = false)
          * @brief Window constructor.
+         * @details A headless window creates no GLFW window, surface or swapchain, and doesn't need a display. Frames
+         *          are rendered into `max_frames_in_flight` offscreen images of `width` by `height` pixels in
+         *          `R8G8B8A8Unorm`, which can be read back with `read_frame()` or `save_frame_png()`. Any device with a
+         *          graphics queue can be selected, including CPU implementations like lavapipe.
          * @param width Width of the window in pixels
          * @param height Height of the window in pixels
          * @param app_name The name of you application
          * @param version Version of you application, should be a return value of `VK_MAKE_VERSION()`. See vulkan documentation for more details.
+         * @param headless Render offscreen instead of to a window on the screen.
          */
-        window(int width, int height, const char *app_name, uint32_t version);
+        window(int width, int height, const char *app_name, uint32_t version, bool headless = false);
 
         /**
          * @fn virtual ~window()
@@ -778,9 +977,17 @@ namespace hp::vk {
          * @return True if the window should close (ie. You should terminate the program, or other appropriate behavior)
          */
         inline bool should_close() {
-            return glfwWindowShouldClose(win);
+            return !headless && glfwWindowShouldClose(win);
         };
 
+        /**
+         * @fn [[nodiscard]] inline bool is_headless() const
+         * @brief Query if this window renders offscreen. See `window(int, int, const char *, uint32_t, bool)`.
+         */
+        [[nodiscard]] inline bool is_headless() const {
+            return headless;
+        }
+
         /**
          * @fn inline ::vk::Extent2D get_dims()
          * @brief Get the current size of the window (in pixels).
@@ -799,6 +1006,7 @@ namespace hp::vk {
          * @param source The source buffer of the copy operation
          * @param dest The destination buffer of the copy operation
          * @param wait Whether or not to wait for the copy operation to finish. See the return values for the function.
+         *             Waits like `window::wait_fences`, so fiber jobs are suspended rather than blocked.
          * @param src_offset Index (in bytes) in the source at which to start copying data.
          * @param dest_offset Index (in bytes) in the destination at which to start writing data.
          * @param size The size (in bytes) of the data that should be copied. If set to 0, the entire sizes of the
@@ -806,6 +1014,8 @@ namespace hp::vk {
          * @return Returns a vk::Fence and vk::CommandBuffer if the `wait` parameter is set to `false`.
          *          These objects *MUST* be *EXPLICITLY DESTROYED!* If `wait` is `false` or the sizes of the buffers are mismatched
          *         while `size` is 0, then this function would return `VK_NULL_HANDLE`s.
+         * @note Thread safe, so it may be called from jobs on any thread while the render thread draws. Recording and
+         *       submitting are serialized with `draw_frame()`, but the wait is not.
          * @warning It is possible that the fence would never be signaled if the operation fails, so waiting for
          *          them may cause infinite blocking. Therefore, it is recommended that you set a timeout for fence waits.
          */
@@ -834,9 +1044,45 @@ namespace hp::vk {
         /**
          * @fn void save_recording()
          * @brief Create new command buffers according to the contents of the recording buffer.
+         * @note Does nothing with dynamic recording, where every `draw_frame()` records the current commands anyway.
          */
         void save_recording();
 
+        /**
+         * @fn void set_dynamic_recording(bool dynamic)
+         * @brief Choose between baked and dynamic recording. Baked (the default) is the fastest for static scenes.
+         * @details Baked recording replays the commands of the window and its draw lists into command buffers once, in
+         *          `save_recording()`, which waits for the device to be idle first. With dynamic recording,
+         *          `draw_frame()` replays them into new one-time command buffers for every frame instead, from pools
+         *          that are reset once that frame in flight finished, so changing the scene never stalls the GPU.
+         *          Just change the commands or draw lists between two `draw_frame()`s.
+         * @note Waits for the device to be idle once, when the mode changes.
+         */
+        void set_dynamic_recording(bool dynamic);
+
+        /**
+         * @fn [[nodiscard]] inline bool is_dynamic_recording() const
+         * @brief Query whether every frame records its own command buffers. See `set_dynamic_recording()`.
+         */
+        [[nodiscard]] inline bool is_dynamic_recording() const {
+            return dynamic_recording;
+        }
+
+        /**
+         * @fn void add_draw_list(draw_list *list)
+         * @brief Execute a draw list after the commands of this window, and of the lists added before it.
+         * @details Takes effect with the next `save_recording()`, which records all lists in parallel on `hp::jobs`
+         *          (or serially, if there is no job system). See `hp::vk::draw_list`.
+         * @param list The list. *MUST* stay alive until it is removed with `remove_draw_list()`.
+         */
+        void add_draw_list(draw_list *list);
+
+        /**
+         * @fn void remove_draw_list(draw_list *list)
+         * @brief Stop executing a draw list. Takes effect with the next `save_recording()`.
+         */
+        void remove_draw_list(draw_list *list);
+
         /**
          * @fn void rec_bind_shader(shader_program *shader)
          * @brief Add a pipeline binding operation to the recording buffer.
@@ -909,6 +1155,38 @@ namespace hp::vk {
          */
         void rec_draw(unsigned num_verts);
 
+        /**
+         * @fn void rec_gpu_zone_begin(const zone_desc *zone)
+         * @brief Record the start of a GPU zone, timed with timestamp queries and shown on the "GPU" trace track.
+         * @details Every `rec_gpu_zone_begin()` *MUST* be matched by a `rec_gpu_zone_end()`; Zones still open when
+         *          `save_recording()` is called end with the render pass. Zones nest. Each recording holds at most
+         *          `gpu_profiler::max_zones` zones, including the implicit "Render Pass" zone.
+         *          Does nothing if the device doesn't support timestamps. See `hp::vk::gpu_profiler`.
+         * @param zone Descriptor of the zone, usually from `hp::register_zone()`.
+         */
+        void rec_gpu_zone_begin(const zone_desc *zone);
+
+        /**
+         * @fn void rec_gpu_zone_begin(const char *name)
+         * @brief Record the start of a GPU zone with the category "gpu". See `rec_gpu_zone_begin(const zone_desc *)`.
+         * @param name Name of the zone. *MUST* stay valid for the lifetime of the program (eg. a string literal).
+         */
+        void rec_gpu_zone_begin(const char *name);
+
+        /**
+         * @fn void rec_gpu_zone_end()
+         * @brief Record the end of the innermost open GPU zone.
+         */
+        void rec_gpu_zone_end();
+
+        /**
+         * @fn inline gpu_profiler &get_gpu_profiler()
+         * @brief Retrieve the GPU profiler of this window.
+         */
+        inline gpu_profiler &get_gpu_profiler() {
+            return gpu_prof;
+        }
+
         /**
          * @fn inline shader_program *new_shader_program(const std::string &, const char *metapath = "/shader_metadat.txt")
          * @brief Construct and retrieve a new `hp::vk::shader_program`
@@ -950,14 +1228,18 @@ namespace hp::vk {
          *       and command pool! As of right now, the command pool is *NEVER* recreated.
          * @param bufs Pointer to a list of command buffers to destroy
          * @param num Number of command buffers the list contains
+         * @note Thread safe.
          */
         inline void delete_cmd_buffers(::vk::CommandBuffer *bufs, uint32_t num = 1) {
+            std::lock_guard<std::recursive_mutex> lg(render_mtx);
             log_dev.freeCommandBuffers(cmd_pool, num, bufs);
         }
 
         /**
          * @fn inline void wait_fences(::vk::Fence *fences, uint32_t num = 1, uint64_t timeout = UINT64_MAX)
          * @brief Block until the fences provided are signaled
+         * @details Called from a job of `job_system::submit_fiber()` on `hp::jobs`, the job is suspended instead,
+         *          and the worker runs other jobs until the fences are signaled.
          * @note The fence provided *MUST* be associated with this window!
          * @param fences Pointer to a list of fences
          * @param num The number of fences that list contains (default to 1 for waiting on a single fence)
@@ -969,7 +1251,33 @@ namespace hp::vk {
          *          the application would be forced to wait that number of nanoseconds if the fence is never signaled.
          */
         inline void wait_fences(::vk::Fence *fences, uint32_t num = 1, uint64_t timeout = UINT64_MAX) {
-            log_dev.waitForFences(num, fences, ::vk::Bool32(VK_TRUE), timeout);
+            if (jobs == nullptr || !jobs->in_fiber()) {
+                log_dev.waitForFences(num, fences, ::vk::Bool32(VK_TRUE), timeout);
+                return;
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            jobs->wait_until([&]() {
+                if (timeout != UINT64_MAX && static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count()) >= timeout) {
+                    return true;
+                }
+                for (uint32_t i = 0; i < num; i++) {
+                    if (!fence_signaled(fences[i])) {
+                        return false;
+                    }
+                }
+                return true;
+            });
+        }
+
+        /**
+         * @fn inline bool fence_signaled(::vk::Fence fence)
+         * @brief Query if a fence is signaled, without waiting.
+         * @note The fence provided *MUST* be associated with this window!
+         */
+        inline bool fence_signaled(::vk::Fence fence) {
+            return log_dev.getFenceStatus(fence) == ::vk::Result::eSuccess;
         }
 
         /**
@@ -978,8 +1286,10 @@ namespace hp::vk {
          * @warning DO NOT attempt to call `delete` on pointer returned by this function! Use `window::delete_fence()` instead!
          *          It is also *NOT* necessary to call `delete_fence`; the fences are automatically cleaned up when window is destroyed!
          * @return The newly constructed vk::Fence
+         * @note Thread safe.
          */
         inline ::vk::Fence new_fence() {
+            std::lock_guard<std::recursive_mutex> lg(render_mtx);
             ::vk::Fence ret = ::vk::Fence();
             ::vk::FenceCreateInfo fence_ci((::vk::FenceCreateFlags()));
             if (handle_res(log_dev.createFence(&fence_ci, nullptr, &ret), HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
@@ -995,8 +1305,10 @@ namespace hp::vk {
          * @note The fence provided *MUST* be associated with this window, but it *DOES NOT* have to be created
          *       with `window::new_fence()`.
          * @param fence Fence to destroy
+         * @note Thread safe.
          */
         inline void delete_fence(::vk::Fence fence) {
+            std::lock_guard<std::recursive_mutex> lg(render_mtx);
             log_dev.destroyFence(fence, nullptr);
             boost::remove_erase(child_fences, fence);
         }
@@ -1014,6 +1326,7 @@ namespace hp::vk {
         inline generic_buffer *
         new_buffer(size_t size, const ::vk::BufferUsageFlags &usage, const ::vk::MemoryPropertyFlags &flags) {
             auto buf = new generic_buffer(size, usage, flags, this);
+            HP_TRACK_ALLOC("window::new_buffer", "heap", sizeof(generic_buffer));
             child_bufs.emplace_back(buf);
             return buf;
         }
@@ -1026,17 +1339,53 @@ namespace hp::vk {
          * @param buf The buffer to destroy
          */
         inline void delete_buffer(generic_buffer *buf) {
-            boost::remove_erase(child_bufs, buf);
+            auto it = std::find(child_bufs.begin(), child_bufs.end(), buf);
+            if (it != child_bufs.end()) {
+                child_bufs.erase(it);
+                HP_TRACK_FREE("window::new_buffer", "heap", sizeof(generic_buffer));  // Only these were counted.
+            }
             delete buf;
         }
 
+        /**
+         * @fn bool save_pipeline_cache()
+         * @brief Write every pipeline compiled so far to `hp::vk::pipeline_cache_file`, so the next run can skip compiling
+         *        them. The destructor calls it too.
+         * @details The cache is written to a temporary file first, which then replaces the old one, so a crash never
+         *          leaves a partial file behind. On startup, a saved cache is only used if it was written by the same
+         *          driver version on the same device; Otherwise, every pipeline is compiled again.
+         * @return `true` if the file was written.
+         */
+        bool save_pipeline_cache();
+
         /**
          * @fn void draw_frame()
          * @brief Draw the next frame to the screen.
          * @note This function blocks until the frame is acquired, but *DOES NOT* block until it is presented.
          *        This function is also thread safe! :)
+         *        Each call is one profiler frame (See `hp::profiler_session::frame_begin()`), split into the zones
+         *        "Fence Wait", "Acquire Image", "Submit" and "Present". Headless windows only have "Fence Wait" and
+         *        "Submit". With dynamic recording, "Submit" contains a "Record" zone.
          */
         void draw_frame();
+
+        /**
+         * @fn bool read_frame(std::vector<uint8_t> &pixels)
+         * @brief Copy the image the last `draw_frame()` rendered into memory. Only supported by headless windows.
+         * @details Blocks until the frame is done rendering. The pixels are tightly packed rows of `R8G8B8A8Unorm`,
+         *          top to bottom, so `pixels` is resized to `get_dims().width * get_dims().height * 4` bytes.
+         * @param pixels Where to store the frame.
+         * @return False if the window isn't headless or nothing has been drawn yet, otherwise true.
+         */
+        bool read_frame(std::vector<uint8_t> &pixels);
+
+        /**
+         * @fn bool save_frame_png(const std::string &path)
+         * @brief Write the image the last `draw_frame()` rendered to a PNG file. See `read_frame()`.
+         * @param path Path of the PNG file to write.
+         * @return False if the frame couldn't be read or written, otherwise true.
+         */
+        bool save_frame_png(const std::string &path);
     };
 }
 
@@ -0,0 +1,352 @@
+//
+// Live capture server for profiler sessions. See `hp/capture_server.hpp`.
+//
+
+#include "hp/capture_server.hpp"
+#include "hp/profiling.hpp"
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/write.hpp>
+
+#include <cstring>
+#include <istream>
+#include <sstream>
+
+namespace hp {
+
+    static std::string make_frame(char type, const char *data, size_t size) {
+        std::string frame;
+        frame.reserve(size + 5);
+        frame.push_back(type);
+        for (unsigned i = 0; i < 4; i++) {
+            frame.push_back(static_cast<char>((size >> (i * 8u)) & 0xffu));
+        }
+        frame.append(data, size);
+        return frame;
+    }
+
+    capture_server::capture_server(const trace::header &head, uint16_t port) : head(head), acceptor(io), client(io) {
+        boost::system::error_code ec;
+        boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+        acceptor.open(endpoint.protocol(), ec);
+        if (!ec) {
+            acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
+            acceptor.bind(endpoint, ec);
+        }
+        if (!ec) {
+            acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
+        }
+        if (ec) {
+            HP_WARN("Capture server failed to listen on 127.0.0.1:{}! ({})", port, ec.message());
+            return;
+        }
+
+        this->port = acceptor.local_endpoint().port();
+        listening = true;
+        accept();
+        io_thread = std::thread([this]() { io.run(); });
+        HP_INFO("Capture server listening on 127.0.0.1:{}", this->port);
+    }
+
+    capture_server::~capture_server() {
+        io.stop();
+        if (io_thread.joinable()) {
+            io_thread.join();
+        }
+    }
+
+    bool capture_server::sync() {
+        uint32_t gen = state_gen.load(std::memory_order_acquire);
+        if (gen == seen_gen) {
+            return capturing;
+        }
+        seen_gen = gen;
+
+        std::lock_guard<std::mutex> lg(mtx);
+        if (filter_gen != seen_filter_gen) {
+            seen_filter_gen = filter_gen;
+            active_filters = filters;
+            zone_filter.clear();
+        }
+
+        if (capturing && (!want_capture || epoch != capture_epoch)) {
+            end_capture(nullptr);
+        }
+        if (want_capture && epoch != capture_epoch) {
+            capture_epoch = epoch;
+            begin_capture();
+        }
+        return capturing;
+    }
+
+    void capture_server::begin_capture() {
+        encoder = trace::encoder();
+        named_threads.clear();
+        live.clear();
+        live_events = 0;
+        encoder.write_header(live, head);
+        capturing = true;
+    }
+
+    void capture_server::end_capture(const char *error) {
+        if (error != nullptr) {
+            post_frame('M', error, std::strlen(error), capture_epoch);
+        } else {
+            flush();
+            if (!capturing) {
+                return;  // `flush()` already ended it because the client fell behind.
+            }
+        }
+        post_frame('E', nullptr, 0, capture_epoch);
+        live.clear();
+        live_events = 0;
+        capturing = false;
+    }
+
+    bool capture_server::zone_passes(uint32_t zone) {
+        if (active_filters.empty()) {
+            return true;
+        }
+
+        if (zone >= zone_filter.size()) {
+            zone_filter.resize(zone + 1, 0);
+        }
+
+        if (zone_filter[zone] == 0) {
+            const zone_desc *desc = find_zone(zone);
+            bool pass = false;
+            for (const auto &filter : active_filters) {
+                if (desc != nullptr && (std::strstr(desc->name, filter.c_str()) != nullptr ||
+                                        std::strstr(desc->category, filter.c_str()) != nullptr)) {
+                    pass = true;
+                    break;
+                }
+            }
+            zone_filter[zone] = pass ? 1 : 2;
+        }
+        return zone_filter[zone] == 1;
+    }
+
+    void capture_server::write_event(const profile_result &res, long long start, long long end,
+                                     const event_buffer &buf) {
+        if (!zone_passes(res.zone)) {
+            return;
+        }
+
+        define_zone(res.zone);
+
+        if (buf.name != nullptr && named_threads.insert(buf.thread).second) {
+            encoder.write_thread_name(live, buf.pid, buf.thread, buf.name);
+        }
+
+        encoder.write_event(live, res.zone, res.frame, buf.pid, buf.thread, start, end);
+        live_events++;
+        if (live.size() >= chunk_size) {
+            flush();
+        }
+    }
+
+    void capture_server::write_counter(const trace::counter &ctr) {
+        if (!zone_passes(ctr.zone_id)) {
+            return;
+        }
+
+        define_zone(ctr.zone_id);
+        encoder.write_counter(live, ctr);
+        live_events++;
+        if (live.size() >= chunk_size) {
+            flush();
+        }
+    }
+
+    void capture_server::define_zone(uint32_t zone) {
+        if (encoder.knows_zone(zone)) {
+            return;
+        }
+
+        const zone_desc *desc = find_zone(zone);
+        trace::zone_info info;
+        if (desc != nullptr) {
+            info = {desc->name, desc->category, desc->file, desc->line, desc->color};
+        }
+        encoder.write_zone(live, zone, info);
+    }
+
+    void capture_server::flush() {
+        if (!capturing || live.size() == 0) {
+            return;
+        }
+
+        if (queued.load(std::memory_order_acquire) + live.size() > max_queued_bytes) {
+            dropped.fetch_add(live_events, std::memory_order_relaxed);
+            end_capture("error capture stopped because the client can't keep up");
+            return;
+        }
+
+        post_frame('T', live.data(), live.size(), capture_epoch);
+        live.clear();
+        live_events = 0;
+    }
+
+    void capture_server::post_frame(char type, const char *data, size_t size, uint32_t frame_epoch) {
+        std::string frame = make_frame(type, data, size);
+        queued.fetch_add(frame.size(), std::memory_order_acq_rel);
+        boost::asio::post(io, [this, frame_epoch, frame = std::move(frame)]() mutable {
+            bool current;
+            {
+                std::lock_guard<std::mutex> lg(mtx);
+                current = frame_epoch == epoch;
+            }
+
+            if (!current || !client.is_open()) {  // Belongs to a capture that was restarted or lost its client.
+                queued.fetch_sub(frame.size(), std::memory_order_acq_rel);
+                return;
+            }
+            enqueue(std::move(frame));
+        });
+    }
+
+    void capture_server::accept() {
+        acceptor.async_accept(client, [this](const boost::system::error_code &ec) {
+            if (ec) {
+                if (ec != boost::asio::error::operation_aborted) {
+                    HP_WARN("Capture server failed to accept a client! ({})", ec.message());
+                    accept();
+                }
+                return;
+            }
+
+            boost::system::error_code opt_ec;
+            client.set_option(boost::asio::ip::tcp::no_delay(true), opt_ec);
+            HP_INFO("Capture client connected");
+            read_command();
+        });
+    }
+
+    void capture_server::read_command() {
+        boost::asio::async_read_until(client, commands, '\n', [this](const boost::system::error_code &ec, size_t) {
+            if (ec) {
+                disconnect();
+                return;
+            }
+
+            std::istream in(&commands);
+            std::string line;
+            std::getline(in, line);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            handle_command(line);
+            read_command();
+        });
+    }
+
+    void capture_server::handle_command(const std::string &line) {
+        std::string cmd = line.substr(0, line.find(' '));
+        std::string args = cmd.size() < line.size() ? line.substr(cmd.size() + 1) : "";
+
+        if (cmd == "start") {
+            {
+                std::lock_guard<std::mutex> lg(mtx);
+                want_capture = true;
+                epoch++;
+            }
+            state_gen.fetch_add(1, std::memory_order_acq_rel);
+            reply("ok start");
+        } else if (cmd == "stop") {
+            {
+                std::lock_guard<std::mutex> lg(mtx);
+                want_capture = false;
+            }
+            state_gen.fetch_add(1, std::memory_order_acq_rel);
+            reply("ok stop");
+        } else if (cmd == "filter") {
+            std::vector<std::string> new_filters;
+            std::stringstream ss(args);
+            std::string filter;
+            while (std::getline(ss, filter, ',')) {
+                if (!filter.empty()) {
+                    new_filters.emplace_back(filter);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lg(mtx);
+                filters = std::move(new_filters);
+                filter_gen++;
+            }
+            state_gen.fetch_add(1, std::memory_order_acq_rel);
+            reply("ok filter");
+        } else if (cmd == "status") {
+            std::string msg;
+            {
+                std::lock_guard<std::mutex> lg(mtx);
+                msg = fmt::format("ok capturing={} dropped={} filters=", want_capture ? 1 : 0,
+                                  dropped.load(std::memory_order_relaxed));
+                for (size_t i = 0; i < filters.size(); i++) {
+                    msg += (i > 0 ? "," : "") + filters[i];
+                }
+            }
+            reply(msg);
+        } else if (!cmd.empty()) {
+            reply(fmt::format("error unknown command '{}'", cmd));
+        }
+    }
+
+    void capture_server::reply(const std::string &msg) {
+        std::string frame = make_frame('M', msg.data(), msg.size());
+        queued.fetch_add(frame.size(), std::memory_order_acq_rel);
+        enqueue(std::move(frame));
+    }
+
+    void capture_server::enqueue(std::string frame) {
+        out_queue.emplace_back(std::move(frame));
+        if (out_queue.size() == 1) {
+            write_next();
+        }
+    }
+
+    void capture_server::write_next() {
+        boost::asio::async_write(client, boost::asio::buffer(out_queue.front()),
+                                 [this](const boost::system::error_code &ec, size_t) {
+                                     if (out_queue.empty()) {
+                                         return;  // Cleared by `disconnect()`.
+                                     }
+
+                                     queued.fetch_sub(out_queue.front().size(), std::memory_order_acq_rel);
+                                     out_queue.pop_front();
+                                     if (ec) {
+                                         disconnect();
+                                     } else if (!out_queue.empty()) {
+                                         write_next();
+                                     }
+                                 });
+    }
+
+    void capture_server::disconnect() {
+        if (!client.is_open()) {
+            return;
+        }
+
+        boost::system::error_code ec;
+        client.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+        client.close(ec);
+        for (const auto &frame : out_queue) {
+            queued.fetch_sub(frame.size(), std::memory_order_acq_rel);
+        }
+        out_queue.clear();
+        commands.consume(commands.size());
+
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            want_capture = false;
+            epoch++;
+            filters.clear();  // The next client starts from scratch.
+            filter_gen++;
+        }
+        state_gen.fetch_add(1, std::memory_order_acq_rel);
+        HP_INFO("Capture client disconnected");
+        accept();
+    }
+}
@@ -0,0 +1,95 @@
+//
+// TSC calibration for `hp::clock`. See `hp/clock.hpp`.
+//
+
+#include "hp/clock.hpp"
+#include "hp/logging.hpp"
+
+#include <cmath>
+#include <mutex>
+#include <thread>
+
+#if defined(HP_CLOCK_HAS_TSC) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+namespace hp::clock {
+    std::atomic<bool> tsc_active{false};
+
+    static double tick_ns = 1.0;
+    static uint64_t base_tick = 0;
+    static long long base_ns = 0;
+    static std::once_flag calibrated;
+
+    static long long steady_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+#ifdef HP_CLOCK_HAS_TSC
+
+    static bool has_invariant_tsc() {
+        unsigned regs[4] = {0, 0, 0, 0};
+#ifdef _MSC_VER
+        int msvc_regs[4];
+        __cpuid(msvc_regs, 0x80000000);
+        if (static_cast<unsigned>(msvc_regs[0]) < 0x80000007u) {
+            return false;
+        }
+        __cpuid(msvc_regs, 0x80000007);
+        regs[3] = static_cast<unsigned>(msvc_regs[3]);
+#else
+        if (__get_cpuid_max(0x80000000u, nullptr) < 0x80000007u) {
+            return false;
+        }
+        __get_cpuid(0x80000007u, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+        return (regs[3] & (1u << 8u)) != 0; // EDX bit 8: Invariant TSC (constant rate in all P/C-states)
+    }
+
+#endif
+
+    void calibrate() {
+        std::call_once(calibrated, []() {
+#ifdef HP_CLOCK_HAS_TSC
+            if (has_invariant_tsc()) {
+                // Pair up TSC and steady_clock readings ~10ms apart. Each pair is taken back to back, so the error
+                // is roughly the cost of one steady_clock read divided by the window.
+                long long ns0 = steady_ns();
+                uint64_t tsc0 = __rdtsc();
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                long long ns1 = steady_ns();
+                uint64_t tsc1 = __rdtsc();
+
+                if (tsc1 > tsc0 && ns1 > ns0) {
+                    tick_ns = static_cast<double>(ns1 - ns0) / static_cast<double>(tsc1 - tsc0);
+                    base_tick = tsc1;
+                    base_ns = ns1;
+                    tsc_active.store(true, std::memory_order_release);  // Publishes the calibration above.
+                    HP_INFO("Calibrated invariant TSC at {:.3f} MHz", 1000.0 / tick_ns);
+                    return;
+                }
+            }
+            HP_INFO("No usable invariant TSC! Falling back to std::chrono::steady_clock for profiling.");
+#endif
+        });
+    }
+
+    long long to_ns(uint64_t tick) {
+        if ((tick & steady_tag) != 0) {
+            return static_cast<long long>(tick & ~steady_tag);
+        }
+        return base_ns + static_cast<long long>(static_cast<double>(static_cast<int64_t>(tick - base_tick)) * tick_ns);
+    }
+
+    uint64_t from_ns(long long ns) {
+        if (!tsc_active.load(std::memory_order_acquire)) {
+            return steady_tag | static_cast<uint64_t>(ns);
+        }
+        return base_tick + static_cast<uint64_t>(std::llround(static_cast<double>(ns - base_ns) / tick_ns));
+    }
+
+    double ns_per_tick() {
+        return tick_ns;
+    }
+}
@@ -3,6 +3,19 @@
 //
 
 #include "hp/logging.hpp"
+#include "hp/multithreading.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace hp {
     std::string current_datetime() {
@@ -25,11 +38,405 @@ namespace hp {
         std::cerr << "[** SPDLOG ERROR **]: " << msg << std::endl;
     }
 
+    namespace detail {
+        std::atomic<bool> log_thread_running{false};
+        std::atomic<uint8_t> log_levels[log_module_count] = {};  // Trace, the lowest level.
+        std::atomic<uint32_t> log_rate_limit{10};
+
+        static const char *const module_names[log_module_count] = {
+                "core", "vk", "shaders", "buffers", "threading", "profiling", "app"
+        };
+
+        static std::mutex config_mtx;
+        static std::string config_path;  // Guarded by `config_mtx`. Empty if no config file is watched.
+        static std::filesystem::file_time_type config_time;  // Guarded by `config_mtx`.
+
+        /**
+         * @struct log_buffer
+         * @brief A thread's log ring. Owned by the registry, so records outlive the thread until they are written.
+         */
+        struct log_buffer {
+            spsc_queue<log_record> ring{1024};
+            size_t thread_id = spdlog::details::os::thread_id();
+        };
+
+        /**
+         * @struct pending_log
+         * @brief A record taken off a ring, waiting to be written in timestamp order.
+         */
+        struct pending_log {
+            log_record rec;
+            size_t thread_id;
+        };
+
+        static std::mutex buffers_mtx;
+        static std::vector<std::shared_ptr<log_buffer>> buffers;
+        static thread_local std::shared_ptr<log_buffer> local_buffer;
+
+        static std::thread log_thread;
+        static std::atomic<bool> log_thread_quit{false};
+        static std::mutex flush_mtx;
+        static std::condition_variable flush_cv;
+        static uint64_t flush_requested = 0;  // Guarded by `flush_mtx`.
+        static uint64_t flush_completed = 0;  // Guarded by `flush_mtx`.
+        static std::atomic<uint64_t> full_waits{0};
+
+        static std::chrono::system_clock::time_point system_base;
+        static long long clock_base_ns = 0;
+        static std::terminate_handler previous_terminate = nullptr;
+
+        static log_buffer &thread_buffer() {
+            if (!local_buffer) {
+                local_buffer = std::make_shared<log_buffer>();
+                std::lock_guard<std::mutex> lg(buffers_mtx);
+                buffers.push_back(local_buffer);
+            }
+            return *local_buffer;
+        }
+
+        void push_log(const log_record &rec) {
+            log_buffer &buf = thread_buffer();
+            if (buf.ring.try_push(rec)) {
+                return;
+            }
+
+            // The logging thread is behind. Waiting loses no messages, and a full ring of 1024 drains quickly.
+            full_waits.fetch_add(1, std::memory_order_relaxed);
+            while (!buf.ring.try_push(rec)) {
+                std::this_thread::yield();
+            }
+        }
+
+        static void write_to_sinks(const log_site &site, std::string_view message,
+                                   std::chrono::system_clock::time_point time, size_t thread_id) {
+            auto *logger = spdlog::default_logger_raw();
+            spdlog::details::log_msg msg(spdlog::source_loc(site.file, site.line, site.func), logger->name(),
+                                         site.level, spdlog::string_view_t(message.data(), message.size()));
+            msg.time = time;
+            msg.thread_id = thread_id;
+            for (auto &sink : logger->sinks()) {
+                if (sink->should_log(msg.level)) {
+                    try {
+                        sink->log(msg);
+                    } catch (const spdlog::spdlog_ex &ex) {
+                        on_spdlog_err(ex.what());
+                    }
+                }
+            }
+            if (msg.level >= logger->flush_level()) {
+                logger->flush();
+            }
+        }
+
+        void write_log(const log_site &site, std::string_view message) {
+            write_to_sinks(site, message, std::chrono::system_clock::now(), spdlog::details::os::thread_id());
+        }
+
+        static void write_record(const pending_log &pending) {
+            const log_record &rec = pending.rec;
+            std::string message;
+            if (rec.formatted != nullptr) {
+                message = std::move(*rec.formatted);
+                delete rec.formatted;
+            } else {
+                try {
+                    message = rec.decode(rec.format, rec.args);
+                } catch (const std::exception &ex) {
+                    on_spdlog_err(std::string("Failed formatting \"") + rec.format + "\": " + ex.what());
+                    return;
+                }
+            }
+
+            const auto time = system_base + std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                    std::chrono::nanoseconds(clock::to_ns(rec.ticks) - clock_base_ns));
+            write_to_sinks(*rec.site, message, time, pending.thread_id);
+        }
+
+        /**
+         * @fn static size_t drain(std::vector<pending_log> &pending)
+         * @brief Take every record off every ring, and write them in timestamp order. Frees the rings of exited threads
+         *        once they are empty.
+         * @return The number of records written.
+         */
+        static size_t drain(std::vector<pending_log> &pending) {
+            {
+                std::lock_guard<std::mutex> lg(buffers_mtx);
+                for (auto &buf : buffers) {
+                    pending_log next;
+                    while (buf->ring.try_pop(next.rec)) {
+                        next.thread_id = buf->thread_id;
+                        pending.push_back(next);
+                    }
+                }
+                // Only the registry holds the rings of exited threads, and nothing can push to them anymore.
+                buffers.erase(std::remove_if(buffers.begin(), buffers.end(), [](const std::shared_ptr<log_buffer> &buf) {
+                    return buf.use_count() == 1 && buf->ring.size() == 0;
+                }), buffers.end());
+            }
+
+            // Each ring is in order already; This only interleaves the threads.
+            std::stable_sort(pending.begin(), pending.end(), [](const pending_log &a, const pending_log &b) {
+                return a.rec.ticks < b.rec.ticks;
+            });
+            for (const auto &rec : pending) {
+                write_record(rec);
+            }
+
+            const size_t count = pending.size();
+            pending.clear();
+            return count;
+        }
+
+        bool log_rate_check(log_site &site, uint32_t limit) {
+            const long long now = clock::now_ns();
+            long long start = site.window_start.load(std::memory_order_relaxed);
+            if (now - start >= 1000000000 &&
+                site.window_start.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+                const uint32_t previous = site.window_count.exchange(0, std::memory_order_relaxed);
+                if (previous > limit) {
+                    // Logged from the same site, so it shows up with the messages it stands for.
+                    auto *message = new std::string(fmt::format("... and {} more like this were dropped by the rate limit.",
+                                                                previous - limit));
+                    if (log_thread_running.load(std::memory_order_relaxed)) {
+                        push_log(log_record{&site, nullptr, nullptr, message, clock::ticks(), {}});
+                    } else {
+                        write_log(site, *message);
+                        delete message;
+                    }
+                }
+            }
+            return site.window_count.fetch_add(1, std::memory_order_relaxed) < limit;
+        }
+
+        /**
+         * @fn static void check_config_file()
+         * @brief Apply the watched config file again if it changed since it was last applied.
+         */
+        static void check_config_file() {
+            std::string path;
+            {
+                std::lock_guard<std::mutex> lg(config_mtx);
+                if (config_path.empty()) {
+                    return;
+                }
+                std::error_code ec;
+                const auto time = std::filesystem::last_write_time(config_path, ec);
+                if (ec || time == config_time) {
+                    return;
+                }
+                path = config_path;
+            }
+
+            HP_INFO("Log config \"{}\" changed! Applying it again.", path);
+            load_log_config(path, true);
+        }
+
+        static void log_thread_loop() {
+            configure_thread("Logger", thread_priority::low);
+
+            std::vector<pending_log> pending;
+            auto next_config_check = std::chrono::steady_clock::now();
+            while (true) {
+                if (std::chrono::steady_clock::now() >= next_config_check) {
+                    check_config_file();
+                    next_config_check = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+                }
+
+                uint64_t requested;
+                {
+                    std::lock_guard<std::mutex> lg(flush_mtx);
+                    requested = flush_requested;
+                }
+                const bool quitting = log_thread_quit.load(std::memory_order_acquire);
+
+                // Records pushed before the flush request (or the quit) was made are all visible to this drain.
+                const size_t written = drain(pending);
+                {
+                    std::lock_guard<std::mutex> lg(flush_mtx);
+                    if (flush_completed != requested) {
+                        spdlog::default_logger_raw()->flush();
+                        flush_completed = requested;
+                        flush_cv.notify_all();
+                    }
+                }
+
+                if (quitting) {
+                    break;
+                }
+                if (written == 0) {
+                    std::unique_lock<std::mutex> lk(flush_mtx);
+                    flush_cv.wait_for(lk, std::chrono::milliseconds(2), [&]() {
+                        return flush_requested != flush_completed || log_thread_quit.load(std::memory_order_relaxed);
+                    });
+                }
+            }
+            spdlog::default_logger_raw()->flush();
+
+            const uint64_t waits = full_waits.load(std::memory_order_relaxed);
+            if (waits != 0) {
+                HP_INFO("Logging threads waited for a full log ring {} times. Consider logging less in hot loops.", waits);
+            }
+        }
+
+        static void on_terminate() {
+            if (std::this_thread::get_id() != log_thread.get_id()) {
+                flush_logs();
+            }
+            if (previous_terminate != nullptr) {
+                previous_terminate();
+            }
+            std::abort();
+        }
+    }
+
+    void flush_logs() {
+        using namespace detail;
+        if (!log_thread_running.load(std::memory_order_acquire)) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lk(flush_mtx);
+        const uint64_t target = ++flush_requested;
+        flush_cv.notify_all();
+        flush_cv.wait(lk, [&]() { return flush_completed >= target || !log_thread_running.load(); });
+    }
+
+    void quit_logging() {
+        using namespace detail;
+        if (!log_thread_running.exchange(false)) {
+            return;
+        }
+
+        // Messages logged from now on are written synchronously; The thread writes everything pushed before.
+        log_thread_quit.store(true, std::memory_order_release);
+        flush_cv.notify_all();
+        log_thread.join();
+        flush_cv.notify_all();
+
+        std::vector<pending_log> pending;
+        drain(pending);  // Anything pushed by threads that saw the thread running just before it stopped.
+    }
+
+    void set_log_level(spdlog::level::level_enum level) {
+        for (auto &module_level : detail::log_levels) {
+            module_level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+        }
+    }
+
+    void set_log_level(log_module module, spdlog::level::level_enum level) {
+        detail::log_levels[static_cast<size_t>(module)].store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+    }
+
+    spdlog::level::level_enum get_log_level(log_module module) {
+        return static_cast<spdlog::level::level_enum>(
+                detail::log_levels[static_cast<size_t>(module)].load(std::memory_order_relaxed));
+    }
+
+    void set_log_rate_limit(uint32_t per_second) {
+        detail::log_rate_limit.store(per_second, std::memory_order_relaxed);
+    }
+
+    static bool parse_log_level(const std::string &name, spdlog::level::level_enum &level) {
+        static const std::pair<const char *, spdlog::level::level_enum> names[] = {
+                {"trace", spdlog::level::trace}, {"debug", spdlog::level::debug}, {"info", spdlog::level::info},
+                {"warn", spdlog::level::warn}, {"warning", spdlog::level::warn}, {"error", spdlog::level::err},
+                {"fatal", spdlog::level::critical}, {"critical", spdlog::level::critical}, {"off", spdlog::level::off}
+        };
+        for (const auto &entry : names) {
+            if (name == entry.first) {
+                level = entry.second;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool apply_log_filter(const std::string &filter) {
+        spdlog::level::level_enum level;
+        const size_t eq = filter.find('=');
+        if (eq == std::string::npos) {
+            if (!parse_log_level(filter, level)) {
+                return false;
+            }
+            set_log_level(level);
+            return true;
+        }
+
+        const std::string key = filter.substr(0, eq);
+        const std::string value = filter.substr(eq + 1);
+        if (key == "rate") {
+            char *end = nullptr;
+            const unsigned long rate = std::strtoul(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0') {
+                return false;
+            }
+            set_log_rate_limit(static_cast<uint32_t>(rate));
+            return true;
+        }
+
+        for (size_t m = 0; m < log_module_count; m++) {
+            if (key == detail::module_names[m]) {
+                if (!parse_log_level(value, level)) {
+                    return false;
+                }
+                set_log_level(static_cast<log_module>(m), level);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool configure_logging(const std::string &filters) {
+        bool valid = true;
+        std::string filter;
+        bool comment = false;
+        for (size_t i = 0; i <= filters.size(); i++) {
+            const char c = i < filters.size() ? filters[i] : '\n';
+            if (c == '\n') {
+                comment = false;
+            } else if (c == '#') {
+                comment = true;
+            }
+
+            if (c == ',' || c == '\n' || c == '#' || std::isspace(static_cast<unsigned char>(c))) {
+                if (!filter.empty() && !apply_log_filter(filter)) {
+                    HP_WARN("Invalid log filter \"{}\"! Ignoring it!", filter);
+                    valid = false;
+                }
+                filter.clear();
+            } else if (!comment) {
+                filter += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+        }
+        return valid;
+    }
+
+    bool load_log_config(const std::string &path, bool watch) {
+        std::error_code ec;
+        const auto time = std::filesystem::last_write_time(path, ec);
+        std::ifstream file(path);
+        if (ec || !file) {
+            HP_WARN("Failed to open log config \"{}\"! Ignoring invocation!", path);
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lg(detail::config_mtx);
+            if (watch) {
+                detail::config_path = path;
+                detail::config_time = time;
+            } else if (detail::config_path == path) {
+                detail::config_path.clear();
+            }
+        }
+
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        return configure_logging(contents.str());
+    }
+
     void init_logging(bool use_single_file, bool use_unique_file) {
         try {
-            if (async_logging_enabled) {
-                spdlog::init_thread_pool(8192, 1);
-            }
             // Sink for outputting to the console
             auto console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
 //            auto systemd_sink = std::make_shared<spdlog::sinks::systemd_sink_st>();
@@ -67,15 +474,7 @@ namespace hp {
             sink_list.emplace_back(syslog_sink);
 #endif
 
-            std::shared_ptr<spdlog::logger> logger;
-            if (async_logging_enabled) {
-                logger = std::make_shared<spdlog::async_logger>("root",
-                                                                sink_list.begin(), sink_list.end(),
-                                                                spdlog::thread_pool(),
-                                                                spdlog::async_overflow_policy::block);
-            } else {
-                logger = std::make_shared<spdlog::logger>("root", sink_list.begin(), sink_list.end());
-            }
+            auto logger = std::make_shared<spdlog::logger>("root", sink_list.begin(), sink_list.end());
 
             spdlog::register_logger(logger);
             spdlog::set_default_logger(logger);
@@ -88,9 +487,30 @@ namespace hp {
             spdlog::set_pattern("%^[%H:%M:%S.%e] [%l] [%P|%t] [%!|%s:%#]: %v%$");
 
             spdlog::set_error_handler(on_spdlog_err);
+            logger->flush_on(spdlog::level::warn);
+
+            if (async_logging_enabled && !detail::log_thread_running.load()) {
+                // Calibrate first, so records are timestamped with the TSC from the start.
+                clock::calibrate();
+                detail::system_base = std::chrono::system_clock::now();
+                detail::clock_base_ns = clock::to_ns(clock::ticks());
+                detail::log_thread_quit.store(false);
+                detail::log_thread = std::thread(detail::log_thread_loop);
+                detail::log_thread_running.store(true, std::memory_order_release);
+                detail::previous_terminate = std::set_terminate(detail::on_terminate);
+                std::atexit(quit_logging);
+            }
 
             HP_INFO("Started Hephaestus {}! Compiled on {} at {}. The current time is {}", HP_VERSION_STRING, __DATE__,
                     __TIME__, now);
+
+            if (const char *config = std::getenv("HP_LOG_CONFIG")) {
+                load_log_config(config, true);
+            }
+            if (const char *filters = std::getenv("HP_LOG")) {
+                HP_INFO("Applying log filters \"{}\" from HP_LOG.", filters);
+                configure_logging(filters);
+            }
         }
         catch (const spdlog::spdlog_ex &ex) {
             std::cerr << "Log initialization failed: " << ex.what() << std::endl;
@@ -99,6 +519,28 @@ namespace hp {
 
 #else
     void init_logging(bool use_single_file, bool use_unique_file) {};
+
+    void set_log_level(spdlog::level::level_enum level) {}
+
+    void set_log_level(log_module module, spdlog::level::level_enum level) {}
+
+    spdlog::level::level_enum get_log_level(log_module module) {
+        return spdlog::level::off;
+    }
+
+    void set_log_rate_limit(uint32_t per_second) {}
+
+    bool configure_logging(const std::string &filters) {
+        return true;
+    }
+
+    bool load_log_config(const std::string &path, bool watch) {
+        return true;
+    }
+
+    void flush_logs() {}
+
+    void quit_logging() {}
 #endif
 
 }
@@ -0,0 +1,221 @@
+//
+// Heap and device memory counters for profiler traces. See `hp/memory_tracking.hpp`.
+//
+
+#include "hp/memory_tracking.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <string>
+#include <unordered_map>
+
+namespace hp {
+
+    static std::atomic<memory_counter *> counter_list{nullptr};  // Constant initialized, so usable before main().
+
+    memory_counter::memory_counter(const char *name, const char *category, const char *file, unsigned line)
+            : name(name), category(category), file(file), line(line) {
+        memory_counter *head = counter_list.load(std::memory_order_relaxed);
+        do {
+            next = head;
+        } while (!counter_list.compare_exchange_weak(head, this, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    /**
+     * @struct counter_registry
+     * @private
+     * @brief Storage for counters made by `intern_memory_counter()`. A deque, so counters never move.
+     */
+    struct counter_registry {
+        std::mutex mtx;
+        std::deque<memory_counter> counters;
+        std::unordered_map<std::string, memory_counter *> by_name;
+    };
+
+    static counter_registry &counters() {
+        static counter_registry registry;
+        return registry;
+    }
+
+    memory_counter &intern_memory_counter(const char *name, const char *category, const char *file, unsigned line) {
+        counter_registry &reg = counters();
+        std::lock_guard<std::mutex> lg(reg.mtx);
+        auto it = reg.by_name.find(name);
+        if (it != reg.by_name.end()) {
+            return *it->second;
+        }
+
+        reg.counters.emplace_back(name, category, file, line);
+        reg.by_name.emplace(name, &reg.counters.back());
+        return reg.counters.back();
+    }
+
+    void sample_memory_counters(profiler_session *session, uint32_t frame, uint64_t time) {
+        for (memory_counter *ctr = counter_list.load(std::memory_order_acquire); ctr != nullptr; ctr = ctr->next) {
+            const int64_t bytes = ctr->live_bytes.load(std::memory_order_relaxed);
+            const int64_t peak = std::max(ctr->peak_bytes.exchange(bytes, std::memory_order_relaxed), bytes);
+            const uint64_t allocs = ctr->frame_allocs.exchange(0, std::memory_order_relaxed);
+            if (bytes == ctr->last_bytes && peak == ctr->last_peak && allocs == ctr->last_allocs) {
+                continue;  // Counter tracks hold their last value, so only changes need a sample.
+            }
+
+            ctr->last_bytes = bytes;
+            ctr->last_peak = peak;
+            ctr->last_allocs = allocs;
+            if (session == nullptr) {
+                continue;
+            }
+
+            if (ctr->zone == nullptr) {  // Registered here rather than in the constructor, which can't allocate.
+                ctr->zone = register_zone(ctr->name, ctr->category, ctr->file, ctr->line);
+            }
+
+            trace::counter sample;
+            sample.zone_id = ctr->zone->id;
+            sample.time = static_cast<long long>(time);
+            sample.frame = frame;
+            sample.bytes = bytes;
+            sample.peak_bytes = peak;
+            sample.allocations = allocs;
+            session->record_counter(sample);
+        }
+    }
+}
+
+#if defined(HP_MEMORY_TRACKING_ENABLED) && defined(HP_TRACK_GLOBAL_NEW)
+
+namespace {
+    /// Bytes in front of every tracked allocation: The requested size and the pointer returned by `malloc()`.
+    constexpr size_t header_size = 2 * sizeof(void *) < 16 ? 16 : 2 * sizeof(void *);
+
+    hp::memory_counter &global_new_counter() {
+        static hp::memory_counter ctr("operator new", "heap", __FILE__, __LINE__);
+        return ctr;
+    }
+
+    void *tracked_alloc(size_t size, size_t align) noexcept {
+        void *raw = std::malloc(size + header_size + align - 1);
+        if (raw == nullptr) {
+            return nullptr;
+        }
+
+        auto addr = reinterpret_cast<uintptr_t>(raw) + header_size;
+        addr = (addr + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+        auto header = reinterpret_cast<void **>(addr);
+        header[-1] = raw;
+        reinterpret_cast<size_t *>(header)[-2] = size;
+        global_new_counter().on_alloc(size);
+        return header;
+    }
+
+    void *tracked_alloc_or_throw(size_t size, size_t align) {
+        while (true) {
+            void *ret = tracked_alloc(size, align);
+            if (ret != nullptr) {
+                return ret;
+            }
+
+            std::new_handler handler = std::get_new_handler();
+            if (handler == nullptr) {
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+    }
+
+    void tracked_free(void *ptr) noexcept {
+        if (ptr == nullptr) {
+            return;
+        }
+
+        auto header = static_cast<void **>(ptr);
+        global_new_counter().on_free(reinterpret_cast<size_t *>(header)[-2]);
+        std::free(header[-1]);
+    }
+
+    constexpr size_t default_align = alignof(std::max_align_t);
+}
+
+void *operator new(size_t size) {
+    return tracked_alloc_or_throw(size, default_align);
+}
+
+void *operator new[](size_t size) {
+    return tracked_alloc_or_throw(size, default_align);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return tracked_alloc(size, default_align);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return tracked_alloc(size, default_align);
+}
+
+void *operator new(size_t size, std::align_val_t align) {
+    return tracked_alloc_or_throw(size, static_cast<size_t>(align));
+}
+
+void *operator new[](size_t size, std::align_val_t align) {
+    return tracked_alloc_or_throw(size, static_cast<size_t>(align));
+}
+
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return tracked_alloc(size, static_cast<size_t>(align));
+}
+
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return tracked_alloc(size, static_cast<size_t>(align));
+}
+
+void operator delete(void *ptr) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t, const std::nothrow_t &) noexcept {
+    tracked_free(ptr);
+}
+
+#endif
@@ -4,39 +4,615 @@
 
 #include "hp/multithreading.hpp"
 #include "hp/logging.hpp"
+#include "hp/profiling.hpp"
+
+#include <algorithm>
+
+#include <boost/context/fiber.hpp>
+#include <boost/context/protected_fixedsize_stack.hpp>
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <pthread/qos.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 namespace hp {
+    job_system *jobs = nullptr;
+    job_system *background_jobs = nullptr;
     boost::asio::io_service *io_service = nullptr;
     static boost::thread_group *default_threadpool = nullptr;
     static boost::asio::io_service::work *io_work = nullptr;
 
-    void init_threads(unsigned num_threads) {
-        if (io_service != nullptr || default_threadpool != nullptr || io_work != nullptr) {
+    static_assert(sizeof(job) == 128, "hp::job should be exactly two cache lines!");
+
+    static std::atomic<size_t> next_system_id{1};
+
+    /**
+     * @struct job_pool
+     * @private
+     * @brief Free list of jobs owned by one thread. Other threads return jobs through `remote_free`.
+     * @details The owner allocates from `local_free`, and only takes the whole `remote_free` stack once that runs dry,
+     *          so the common case touches no shared cache lines at all.
+     */
+    struct job_pool {
+        static constexpr size_t block_size = 256;
+
+        job *local_free = nullptr;
+        alignas(64) std::atomic<job *> remote_free{nullptr};
+        std::vector<std::unique_ptr<job[]>> blocks;
+
+        job *allocate() {
+            if (local_free == nullptr) {
+                local_free = remote_free.exchange(nullptr, std::memory_order_acquire);
+            }
+
+            if (local_free == nullptr) {
+                blocks.emplace_back(new job[block_size]);
+                job *block = blocks.back().get();
+                for (size_t i = 0; i < block_size; i++) {
+                    block[i].pool = this;
+                    block[i].next = i + 1 < block_size ? &block[i + 1] : nullptr;
+                }
+                local_free = block;
+            }
+
+            job *j = local_free;
+            local_free = j->next;
+            return j;
+        }
+
+        void release_local(job *j) {
+            j->next = local_free;
+            local_free = j;
+        }
+
+        void release_remote(job *j) {
+            job *head = remote_free.load(std::memory_order_relaxed);
+            do {
+                j->next = head;
+            } while (!remote_free.compare_exchange_weak(head, j, std::memory_order_release,
+                                                        std::memory_order_relaxed));
+        }
+    };
+
+    /**
+     * @struct job_fiber
+     * @private
+     * @brief A fiber running one job of `job_system::submit_fiber()` at a time. Keeps its stack between jobs.
+     * @details Parks itself as a `job_waiter` while suspended.
+     */
+    struct job_fiber : job_waiter {
+        /**
+         * @struct stack
+         * @private
+         * @brief Stack allocator handing out the fiber's own stack, which outlives the `boost::context::fiber`s on it.
+         */
+        struct stack {
+            boost::context::stack_context ctx;
+
+            boost::context::stack_context allocate() {
+                return ctx;
+            }
+
+            void deallocate(boost::context::stack_context &) noexcept {}
+        };
+
+        boost::context::stack_context stack_ctx;
+        job_system *system = nullptr;
+        job *j = nullptr;
+        boost::context::fiber self;  // The fiber, while it isn't running.
+        boost::context::fiber caller;  // Whoever resumed the fiber, while it is running.
+        job_system::condition until{};  // What the fiber waits for, while suspended.
+        bool finished = false;
+
+        job_fiber() : stack_ctx(boost::context::protected_fixedsize_stack(job_system::fiber_stack_size).allocate()) {
+            ready = [](job_waiter &w) {
+                return static_cast<job_fiber &>(w).until();
+            };
+            resume = [](job_waiter &w) {
+                auto &f = static_cast<job_fiber &>(w);
+                f.system->resume_fiber(&f);
+            };
+        }
+
+        ~job_fiber() {
+            boost::context::protected_fixedsize_stack(job_system::fiber_stack_size).deallocate(stack_ctx);
+        }
+    };
+
+    static thread_local job_fiber *current_fiber = nullptr;
+
+    struct job_system::worker {
+        work_stealing_deque<job *> deque;
+        job_pool pool;
+        uint32_t rng;
+    };
+
+    /**
+     * @struct job_thread_cache
+     * @private
+     * @brief Thread local lookup from job system ids to the calling thread's pool and worker index in that system.
+     * @details System ids are never reused, so entries of destroyed systems are simply never matched again.
+     */
+    struct job_thread_cache {
+        struct entry {
+            size_t id;
+            job_pool *pool;
+            int worker;
+        };
+
+        entry last{0, nullptr, -1};
+        std::vector<entry> entries;
+
+        const entry *find(size_t id) {
+            if (last.id == id) {
+                return &last;
+            }
+            for (const auto &ent : entries) {
+                if (ent.id == id) {
+                    last = ent;
+                    return &last;
+                }
+            }
+            return nullptr;
+        }
+
+        void add(size_t id, job_pool *pool, int worker) {
+            entries.push_back(entry{id, pool, worker});
+            last = entries.back();
+        }
+    };
+
+    static thread_local job_thread_cache job_cache;
+
+    bool configure_thread(const std::string &name, thread_priority priority, int cpu) {
+        set_thread_name(name);
+        bool ok = true;
+
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
+        const int win_priority = priority == thread_priority::high ? THREAD_PRIORITY_ABOVE_NORMAL
+                                 : priority == thread_priority::low ? THREAD_PRIORITY_BELOW_NORMAL
+                                 : THREAD_PRIORITY_NORMAL;
+        if (!SetThreadPriority(GetCurrentThread(), win_priority)) {
+            HP_WARN("Cannot set priority of thread '{}'!", name);
+            ok = false;
+        }
+        if (cpu >= 0 && SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << static_cast<unsigned>(cpu)) == 0) {
+            HP_WARN("Cannot pin thread '{}' to CPU {}!", name, cpu);
+            ok = false;
+        }
+#elif defined(__APPLE__)
+        const qos_class_t qos = priority == thread_priority::high ? QOS_CLASS_USER_INTERACTIVE
+                                : priority == thread_priority::low ? QOS_CLASS_UTILITY
+                                : QOS_CLASS_DEFAULT;
+        if (pthread_set_qos_class_self_np(qos, 0) != 0) {
+            HP_WARN("Cannot set priority of thread '{}'!", name);
+            ok = false;
+        }
+        if (cpu >= 0) {
+            HP_WARN("Cannot pin thread '{}' to CPU {}: macOS has no thread affinity!", name, cpu);
+            ok = false;
+        }
+#elif defined(__linux__)
+        // Threads have nice values of their own on Linux.
+        const int nice = priority == thread_priority::high ? -5 : priority == thread_priority::low ? 10 : 0;
+        if (priority != thread_priority::normal &&
+            ::setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)), nice) != 0) {
+            static std::atomic<bool> warned{false};  // Every worker would fail the same way.
+            if (!warned.exchange(true)) {
+                HP_WARN("Cannot set priority of thread '{}' to nice {}! Raising it needs CAP_SYS_NICE.", name, nice);
+            }
+            ok = false;
+        }
+        if (cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(static_cast<size_t>(cpu), &set);
+            if (::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) != 0) {
+                HP_WARN("Cannot pin thread '{}' to CPU {}!", name, cpu);
+                ok = false;
+            }
+        }
+#endif
+
+        return ok;
+    }
+
+    job_system::job_system(unsigned num_workers, const worker_options &options) : id(next_system_id++) {
+        if (num_workers == 0) {
+            unsigned hw = std::thread::hardware_concurrency();
+            num_workers = hw > 1 ? hw - 1 : (hw == 1 ? 1 : 8);
+        }
+
+        workers.resize(num_workers);
+        if (!options.numa_local) {
+            for (auto &w : workers) {
+                w = std::make_unique<worker>();
+            }
+        }
+
+        starting.add(num_workers);
+        for (unsigned i = 0; i < num_workers; i++) {
+            threads.emplace_back(&job_system::worker_loop, this, i, std::cref(options));
+        }
+
+        while (!starting.done()) {  // Workers steal from each other, so they all have to exist before any job runs.
+            std::this_thread::yield();
+        }
+    }
+
+    job_system::~job_system() {
+        {
+            std::lock_guard<std::mutex> lg(sleep_mtx);
+            running.store(false, std::memory_order_release);
+        }
+        sleep_cv.notify_all();
+
+        for (auto &t : threads) {
+            t.join();
+        }
+
+        while (true) {  // Anything pushed after the workers left, by jobs themselves, and waiters still parked.
+            if (job *j = find_job(-1)) {
+                run_job(j);
+            } else if (waiting_count.load(std::memory_order_relaxed) > 0) {
+                std::this_thread::yield();
+            } else {
+                break;
+            }
+        }
+    }
+
+    bool job_system::in_fiber() const {
+        return current_fiber != nullptr;
+    }
+
+    int job_system::current_worker() const {
+        const job_thread_cache::entry *ent = job_cache.find(id);
+        return ent != nullptr ? ent->worker : -1;
+    }
+
+    job *job_system::allocate() {
+        const job_thread_cache::entry *ent = job_cache.find(id);
+        if (ent == nullptr) {
+            std::lock_guard<std::mutex> lg(pools_mtx);
+            external_pools.emplace_back(std::make_unique<job_pool>());
+            job_cache.add(id, external_pools.back().get(), -1);
+            ent = &job_cache.last;
+        }
+        return ent->pool->allocate();
+    }
+
+    void job_system::push(job *j) {
+        const int self = current_worker();
+        if (self >= 0) {
+            workers[self]->deque.push(j);
+        } else {
+            if (!injected.try_push(j)) {
+                std::lock_guard<std::mutex> lg(overflow_mtx);
+                overflow.push_back(j);
+            }
+            injected_count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Pairs with the fence in `worker_loop()`: Either we see the sleeper, or it sees the job.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lg(sleep_mtx);
+            sleep_cv.notify_one();
+        }
+    }
+
+    job *job_system::find_job(int self) {
+        if (self >= 0) {
+            if (job *j = workers[self]->deque.pop()) {
+                return j;
+            }
+        }
+
+        poll_waiters();  // Out of local work, so a good time to check on suspended fibers and other waiters.
+        if (self >= 0) {
+            if (job *j = workers[self]->deque.pop()) {
+                return j;
+            }
+        }
+
+        if (injected_count.load(std::memory_order_relaxed) > 0) {
+            job *j = nullptr;
+            if (!injected.try_pop(j)) {
+                std::lock_guard<std::mutex> lg(overflow_mtx);
+                if (!overflow.empty()) {
+                    j = overflow.front();
+                    overflow.pop_front();
+                }
+            }
+            if (j != nullptr) {
+                injected_count.fetch_sub(1, std::memory_order_relaxed);
+                return j;
+            }
+        }
+
+        const auto count = static_cast<uint32_t>(workers.size());
+        if (count == 0) {
+            return nullptr;
+        }
+
+        uint32_t start;
+        if (self >= 0) {
+            uint32_t &rng = workers[self]->rng;  // xorshift32, so thieves spread out over their victims.
+            rng ^= rng << 13u;
+            rng ^= rng >> 17u;
+            rng ^= rng << 5u;
+            start = rng % count;
+        } else {
+            start = static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id())) % count;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            const uint32_t victim = (start + i) % count;
+            if (static_cast<int>(victim) == self) {
+                continue;
+            }
+            if (job *j = workers[victim]->deque.steal()) {
+                return j;
+            }
+        }
+        return nullptr;
+    }
+
+    void job_system::run_job(job *j) {
+        if (j->fiber) {
+            start_fiber(j);
+            return;
+        }
+
+        j->invoke(*j);
+        finish_job(j);
+    }
+
+    void job_system::finish_job(job *j) {
+        job_counter *counter = j->counter;
+
+        const job_thread_cache::entry *ent = job_cache.find(id);
+        if (ent != nullptr && ent->pool == j->pool) {
+            j->pool->release_local(j);
+        } else {
+            j->pool->release_remote(j);
+        }
+
+        if (counter != nullptr) {
+            counter->signal();
+        }
+    }
+
+    bool job_system::has_work() const {
+        if (injected_count.load(std::memory_order_relaxed) > 0) {
+            return true;
+        }
+        for (const auto &w : workers) {
+            if (!w->deque.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool job_system::run_one() {
+        job *j = find_job(current_worker());
+        if (j == nullptr) {
+            return false;
+        }
+        run_job(j);
+        return true;
+    }
+
+    void job_system::start_fiber(job *j) {
+        job_fiber *f;
+        {
+            std::lock_guard<std::mutex> lg(fiber_mtx);
+            if (free_fibers.empty()) {
+                fibers.emplace_back(std::make_unique<job_fiber>());
+                free_fibers.push_back(fibers.back().get());
+            }
+            f = free_fibers.back();
+            free_fibers.pop_back();
+        }
+
+        f->system = this;
+        f->j = j;
+        f->finished = false;
+        f->self = boost::context::fiber(std::allocator_arg, job_fiber::stack{f->stack_ctx},
+                                        [f](boost::context::fiber &&caller) {
+                                            f->caller = std::move(caller);
+                                            f->j->invoke(*f->j);
+                                            f->finished = true;
+                                            return std::move(f->caller);
+                                        });
+        resume_fiber(f);
+    }
+
+    void job_system::resume_fiber(job_fiber *f) {
+        job_fiber *outer = current_fiber;  // Set if a fiber runs jobs itself, through `run_one()`.
+        current_fiber = f;
+        f->self = std::move(f->self).resume();
+        current_fiber = outer;
+
+        // Only now is the fiber off its stack, so only now may anyone else resume it.
+        if (f->finished) {
+            job *j = f->j;
+            {
+                std::lock_guard<std::mutex> lg(fiber_mtx);
+                free_fibers.push_back(f);
+            }
+            finish_job(j);
+        } else {
+            park(*f);
+        }
+    }
+
+    void job_system::park(job_waiter &w) {
+        std::lock_guard<std::mutex> lg(fiber_mtx);
+        waiting.push_back(&w);
+        waiting_count.store(waiting.size(), std::memory_order_relaxed);
+    }
+
+    void job_system::poll_waiters() {
+        if (waiting_count.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lk(fiber_mtx, std::try_to_lock);
+        if (!lk.owns_lock()) {
+            return;  // Somebody else is polling already.
+        }
+
+        job_waiter *ready = nullptr;
+        for (size_t i = 0; i < waiting.size();) {
+            job_waiter *w = waiting[i];
+            if (w->ready(*w)) {
+                w->next = ready;
+                ready = w;
+                waiting[i] = waiting.back();
+                waiting.pop_back();
+            } else {
+                i++;
+            }
+        }
+        waiting_count.store(waiting.size(), std::memory_order_relaxed);
+        lk.unlock();
+
+        while (ready != nullptr) {
+            job_waiter *w = ready;
+            ready = w->next;
+            submit([w]() { w->resume(*w); });
+        }
+    }
+
+    void job_system::wait(const job_counter &counter) {
+        wait_until([&counter]() { return counter.done(); });
+    }
+
+    void job_system::wait_condition(const condition &ready) {
+        if (ready()) {
+            return;
+        }
+
+        if (job_fiber *f = current_fiber) {
+            f->until = ready;
+            f->caller = std::move(f->caller).resume();  // Back here once `poll_waiters()` found it ready.
+            return;
+        }
+
+        const int self = current_worker();
+        unsigned idle = 0;
+        while (!ready()) {
+            if (job *j = find_job(self)) {
+                run_job(j);
+                idle = 0;
+            } else if (++idle > 64) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void job_system::worker_loop(unsigned index, const worker_options &options) {
+        const int cpu = options.cpus.empty() ? -1 : options.cpus[index % options.cpus.size()];
+        configure_thread(options.name + " " + std::to_string(index), options.priority, cpu);
+
+        if (options.numa_local) {  // Allocated after pinning, so its pages land on this CPU's node.
+            workers[index] = std::make_unique<worker>();
+        }
+        worker &self = *workers[index];
+        self.rng = 0x9e3779b9u * (index + 1);
+        job_cache.add(id, &self.pool, static_cast<int>(index));
+
+        starting.signal();  // `options` is gone once every worker signaled.
+        while (!starting.done()) {
+            std::this_thread::yield();
+        }
+
+        unsigned idle = 0;
+        while (true) {
+            if (job *j = find_job(static_cast<int>(index))) {
+                run_job(j);
+                idle = 0;
+                continue;
+            }
+
+            if (!running.load(std::memory_order_acquire)) {
+                break;  // Only once there is nothing left to run.
+            }
+
+            if (++idle < 64) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lk(sleep_mtx);
+            sleepers.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!has_work() && running.load(std::memory_order_acquire)) {
+                // The timeout is only a safety net; `push()` wakes us up. Parked waiters have to be polled though.
+                sleep_cv.wait_for(lk, waiting_count.load(std::memory_order_relaxed) > 0
+                                      ? std::chrono::microseconds(250) : std::chrono::microseconds(10000));
+            }
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+            idle = 0;
+        }
+    }
+
+    void init_threads(const thread_options &options) {
+        if (jobs != nullptr || io_service != nullptr || default_threadpool != nullptr || io_work != nullptr) {
             HP_WARN("Init threads called with thread pool active! Ignoring invocation!");
             return;
         }
-        num_threads = num_threads == 0 ? (int) (std::thread::hardware_concurrency() *
-                                                2)  // 2x hardware threads would work best?
-                                       : num_threads;
-        num_threads = num_threads == 0 ? 8 : num_threads; // Default to 8 concurrent threads
+        const unsigned num_io_threads = options.num_io_threads == 0 ? 2 : options.num_io_threads;
 
-        HP_INFO("Started thread pool with {} threads!", num_threads);
+        jobs = new job_system(options.num_workers, options.workers);
+        background_jobs = new job_system(std::max(options.num_background_workers, 1u), options.background_workers);
+        HP_INFO("Started job systems with {} and {} background workers, and IO thread pool with {} threads!",
+                jobs->worker_count(), background_jobs->worker_count(), num_io_threads);
 
         io_service = new boost::asio::io_service;
         default_threadpool = new boost::thread_group;
         io_work = new boost::asio::io_service::work(*io_service);
 
-        for (unsigned i = 0; i < num_threads; i++) {
-            default_threadpool->create_thread(boost::bind(&boost::asio::io_service::run, io_service));
+        const worker_options &io = options.io_threads;
+        for (unsigned i = 0; i < num_io_threads; i++) {
+            const int cpu = io.cpus.empty() ? -1 : io.cpus[i % io.cpus.size()];
+            default_threadpool->create_thread([name = io.name + " " + std::to_string(i), priority = io.priority, cpu]() {
+                configure_thread(name, priority, cpu);
+                io_service->run();
+            });
         }
     }
 
+    void init_threads(unsigned num_workers, unsigned num_io_threads) {
+        thread_options options;
+        options.num_workers = num_workers;
+        options.num_io_threads = num_io_threads;
+        init_threads(options);
+    }
+
     void quit_threads() {
-        if (io_service == nullptr || default_threadpool == nullptr || io_work == nullptr) {
+        if (jobs == nullptr || io_service == nullptr || default_threadpool == nullptr || io_work == nullptr) {
             HP_WARN("Quit threads called with thread pool stopped! Ignoring invocation!");
             return;
         }
 
+        delete jobs;
+        jobs = nullptr;
+        delete background_jobs;
+        background_jobs = nullptr;
+
         io_service->stop();
         default_threadpool->join_all();
 
@@ -3,6 +3,8 @@
 //
 
 #include "hp/profiling.hpp"
+#include "hp/capture_server.hpp"
+#include "hp/memory_tracking.hpp"
 
 #ifdef __APPLE__
 
@@ -10,25 +12,169 @@
 
 #endif
 
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
+#include <process.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 namespace hp {
 
-    profiler_session::profiler_session(const char *name, const char *output_file) : file(output_file), name(name),
-                                                                                    closed(false),
-                                                                                    first_event_written(false) {
-        out.open(output_file);
+    static std::atomic<size_t> next_session_id{1};
+
+    /**
+     * @struct zone_registry
+     * @private
+     * @brief Global storage for `zone_desc`s. A deque, so registering never moves existing descriptors.
+     */
+    struct zone_registry {
+        std::mutex mtx;
+        std::deque<zone_desc> zones;
+        std::unordered_map<const char *, const zone_desc *> interned;
+    };
+
+    static zone_registry &zones() {
+        static zone_registry registry;  // Function-local so static descriptors in other TUs can register safely.
+        return registry;
+    }
+
+    const zone_desc *register_zone(const char *name, const char *category, const char *file, unsigned line,
+                                   uint32_t color) {
+        zone_registry &reg = zones();
+        std::lock_guard<std::mutex> lg(reg.mtx);
+        auto id = static_cast<uint32_t>(reg.zones.size());
+        reg.zones.push_back(zone_desc{name, category, file, line, color, id});
+        return &reg.zones.back();
+    }
+
+    const zone_desc *intern_zone(const char *name) {
+        zone_registry &reg = zones();
+        std::lock_guard<std::mutex> lg(reg.mtx);
+        auto it = reg.interned.find(name);
+        if (it != reg.interned.end()) {
+            return it->second;
+        }
+
+        auto id = static_cast<uint32_t>(reg.zones.size());
+        reg.zones.push_back(zone_desc{name, "function", "", 0, 0, id});
+        reg.interned.emplace(name, &reg.zones.back());
+        return &reg.zones.back();
+    }
+
+    const zone_desc *find_zone(uint32_t id) {
+        zone_registry &reg = zones();
+        std::lock_guard<std::mutex> lg(reg.mtx);
+        return id < reg.zones.size() ? &reg.zones[id] : nullptr;
+    }
+
+    /**
+     * @struct session_buffer_cache
+     * @private
+     * @brief Thread local lookup from session ids to that thread's buffer in the session.
+     * @details Session ids are never reused, so entries of destroyed sessions are simply never matched again.
+     */
+    struct session_buffer_cache {
+        size_t last_id = 0;
+        event_buffer *last_buf = nullptr;
+        std::vector<std::pair<size_t, event_buffer *>> entries;
+    };
+
+    static thread_local session_buffer_cache buffer_cache;
+
+    /**
+     * @struct thread_identity
+     * @private
+     * @brief Process and thread id of the current thread, queried once per thread instead of once per event.
+     */
+    struct thread_identity {
+        size_t pid;
+        size_t thread;
+        const char *name = nullptr;  // Set by `set_thread_name()`.
+
+        thread_identity() {
+#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
+            pid = ::_getpid();
+#else
+            pid = ::getpid();
+#endif
+
+#if defined(__linux__)
+            thread = static_cast<size_t>(::syscall(SYS_gettid));  // Small, and matches what `top`/`perf` show.
+#else
+            thread = std::hash<std::thread::id>{}(std::this_thread::get_id());
+#endif
+        }
+    };
+
+    static thread_identity &current_thread() {
+        static thread_local thread_identity ident;
+        return ident;
+    }
+
+    void set_thread_name(const std::string &name) {
+        static std::mutex names_mtx;
+        static std::deque<std::string> names;  // Never freed, since traces may be written after the thread exits.
+        {
+            std::lock_guard<std::mutex> lg(names_mtx);
+            names.emplace_back(name);
+            current_thread().name = names.back().c_str();
+        }
+
+#if defined(__linux__)
+        ::pthread_setname_np(::pthread_self(), name.substr(0, 15).c_str());
+#elif defined(__APPLE__)
+        ::pthread_setname_np(name.c_str());
+#endif
+    }
+
+    event_buffer::event_buffer(size_t pid, size_t thread, const char *name) : pid(pid), thread(thread), name(name),
+                                                                              ring(capacity) {}
 
-        std::string strname = std::string(name);
-        std::replace(strname.begin(), strname.end(), '\"', '\'');
+    profiler_session::profiler_session(const char *name, const char *output_file, overflow_policy policy,
+                                       trace_format format)
+            : id(next_session_id++), file(output_file), name(name), closed(false), policy(policy), format(format),
+              first_event_written(false) {
+        clock::calibrate();
+
+        if (format == trace_format::none) {
+            // Nothing to open; The session only exists for `enable_stats()`.
+        } else if (format == trace_format::binary) {
+            out.open(output_file, std::ios::binary);
+
+            encoder.write_header(batch, binary_header());
+            write_batch();
+        } else {
+            out.open(output_file);
 
-        out << fmt::format(
-                R"({{"name": "{0}", "compile-datetime": "{1} at {2}", "current-datetime": "{3}", "traceEvents":[)",
-                name, __DATE__, __TIME__, current_datetime());
+            std::string strname = std::string(name);
+            std::replace(strname.begin(), strname.end(), '\"', '\'');
+
+            out << fmt::format(
+                    R"({{"name": "{0}", "compile-datetime": "{1} at {2}", "current-datetime": "{3}", "traceEvents":[)",
+                    strname, __DATE__, __TIME__, current_datetime());
+        }
 
         out.flush();
 
-        if (!out.is_open()) {
-            // LOG
+        if (format != trace_format::none && !out.is_open()) {
+            HP_WARN("Profiler session \"{}\" failed to open '{}'! Nothing will be written!", name, output_file);
         }
+
+        start_writer();
+    }
+
+    trace::header profiler_session::binary_header() const {
+        trace::header head;
+        head.ts_unit_ns = 1;
+        head.session_name = name;
+        head.compile_datetime = fmt::format("{} at {}", __DATE__, __TIME__);
+        head.current_datetime = current_datetime();
+        return head;
     }
 
     profiler_session::~profiler_session() {
@@ -41,27 +187,173 @@ namespace hp {
             return *this;
         }
 
-        this->~profiler_session();
+        flush_all();  // Same as the destructor, but our members are still alive to be assigned to.
+        close();
+
+        mv.stop_writer();  // The writer thread is bound to `mv`, so it has to be restarted for us.
+        std::lock_guard<std::mutex> lg(mv.mtx);
+        std::lock_guard<std::mutex> wlg(mv.write_mtx);
         out = std::move(mv.out);
+        batch = std::move(mv.batch);
         closed = mv.closed;
         name = mv.name;
         file = mv.file;
+        policy = mv.policy;
+        format = mv.format;
+        encoder = std::move(mv.encoder);
+        json_zones = std::move(mv.json_zones);
+        aggregator = std::move(mv.aggregator);
+        stats_enabled.store(mv.stats_enabled.load(std::memory_order_acquire), std::memory_order_release);
+        mv.stats_enabled.store(false, std::memory_order_release);
+        server = std::move(mv.server);
         first_event_written = mv.first_event_written;
+        buffers = std::move(mv.buffers);
+        tracks = std::move(mv.tracks);
+        counters = std::move(mv.counters);
+        id = mv.id;  // Threads still find their buffers by id, which are moved along with it.
+
+        mv.closed = true;
+        mv.id = next_session_id++;
+
+        if (!closed) {
+            start_writer();
+        }
 
         return *this;
     }
 
     profiler_session::profiler_session(profiler_session &&mv) noexcept {
+        mv.stop_writer();
+        std::lock_guard<std::mutex> lg(mv.mtx);
+        std::lock_guard<std::mutex> wlg(mv.write_mtx);
         out = std::move(mv.out);
+        batch = std::move(mv.batch);
         closed = mv.closed;
         name = mv.name;
         file = mv.file;
+        policy = mv.policy;
+        format = mv.format;
+        encoder = std::move(mv.encoder);
+        json_zones = std::move(mv.json_zones);
+        aggregator = std::move(mv.aggregator);
+        stats_enabled.store(mv.stats_enabled.load(std::memory_order_acquire), std::memory_order_release);
+        mv.stats_enabled.store(false, std::memory_order_release);
+        server = std::move(mv.server);
         first_event_written = mv.first_event_written;
+        buffers = std::move(mv.buffers);
+        tracks = std::move(mv.tracks);
+        counters = std::move(mv.counters);
+        id = mv.id;
+
+        mv.closed = true;
+        mv.id = next_session_id++;
+
+        if (!closed) {
+            start_writer();
+        }
+    }
+
+    event_buffer *profiler_session::local_buffer() {
+        session_buffer_cache &cache = buffer_cache;
+        if (cache.last_id == id) {
+            return cache.last_buf;
+        }
+
+        event_buffer *buf = nullptr;
+        for (const auto &entry : cache.entries) {
+            if (entry.first == id) {
+                buf = entry.second;
+                break;
+            }
+        }
+
+        if (buf == nullptr) {
+            std::lock_guard<std::mutex> lg(mtx);
+            const thread_identity &ident = current_thread();
+            buffers.emplace_back(std::make_unique<event_buffer>(ident.pid, ident.thread, ident.name));
+            buf = buffers.back().get();
+            cache.entries.emplace_back(id, buf);
+        }
+
+        cache.last_id = id;
+        cache.last_buf = buf;
+        return buf;
+    }
+
+    void profiler_session::record(const profile_result &res) {
+        push(local_buffer(), res);
+    }
+
+    size_t profiler_session::new_track(const char *track_name) {
+        std::lock_guard<std::mutex> lg(mtx);
+        buffers.emplace_back(std::make_unique<event_buffer>(current_thread().pid, first_track_id + tracks.size(),
+                                                            track_name));
+        tracks.emplace_back(buffers.back().get());
+        return tracks.size() - 1;
+    }
+
+    void profiler_session::record_track(size_t track, const profile_result &res) {
+        event_buffer *buf;
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            if (track >= tracks.size()) {
+                return;
+            }
+            buf = tracks[track];
+        }
+        push(buf, res);
+    }
+
+    void profiler_session::record_counter(const trace::counter &ctr) {
+        std::lock_guard<std::mutex> lg(mtx);
+        counters.push_back(ctr);
+        counters.back().pid = current_thread().pid;
+    }
+
+    void profiler_session::push(event_buffer *buf, const profile_result &res) {
+        if (buf->try_push(res)) {
+            if (buf->size() >= event_buffer::capacity / 2) {
+                wake_writer();  // Don't wait for the next `flush_interval` if we're filling up quickly.
+            }
+            return;
+        }
+
+        if (policy == overflow_policy::drop || !writer_running.load(std::memory_order_acquire)) {
+            buf->count_drop();
+            return;
+        }
+
+        // overflow_policy::block: Apply backpressure until the writer makes room.
+        while (!buf->try_push(res)) {
+            wake_writer();
+            std::this_thread::yield();
+            if (!writer_running.load(std::memory_order_acquire)) {
+                buf->count_drop();
+                return;
+            }
+        }
+    }
+
+    size_t profiler_session::dropped_events() {
+        std::lock_guard<std::mutex> lg(mtx);
+        size_t ret = 0;
+        for (const auto &buf : buffers) {
+            ret += buf->dropped();
+        }
+        return ret;
     }
 
     profiler profiler_session::new_profiler(const char *pname) {
         if (!closed) {
-            return profiler(pname, this);
+            return profiler(intern_zone(pname), this);
+        } else {
+            return profiler();
+        }
+    }
+
+    profiler profiler_session::new_profiler(const zone_desc *zone) {
+        if (!closed) {
+            return profiler(zone, this);
         } else {
             return profiler();
         }
@@ -69,88 +361,346 @@ namespace hp {
 
     profiler *profiler_session::new_dynamic_profiler(const char *pname) {
         if (!closed) {
-            return new profiler(pname, this);
+            return new profiler(intern_zone(pname), this);
         } else {
             return nullptr;
         }
     }
 
     void profiler_session::close() {
+        stop_writer();
+
         std::lock_guard<std::mutex> lg(mtx);
+        std::lock_guard<std::mutex> wlg(write_mtx);
         if (!closed) {
-            out << "]}";
+            size_t drops = 0;
+            for (const auto &buf : buffers) {
+                drops += buf->dropped();
+            }
+            if (drops > 0) {
+                HP_WARN("Profiler session \"{}\" dropped {} events because thread buffers were full!", name, drops);
+            }
+
+            write_batch();
+            if (format == trace_format::json) {
+                out << "]}";
+            }
             out.flush();
             out.close();
+            server.reset();
             closed = true;
         }
     }
 
-    profiler_session::profiler_session() : file("dummy_file.json"), name("Dummy Session"), closed(true),
-                                           first_event_written(true) {}
+    profiler_session::profiler_session() : id(next_session_id++), file("dummy_file.json"), name("Dummy Session"),
+                                           closed(true), first_event_written(true) {}
 
-    void profiler_session::flush_single() {
-        std::lock_guard<std::mutex> lg(mtx);
-        if (closed || queue.empty()) {
+    const std::string &profiler_session::json_zone_prefix(uint32_t zone) {
+        if (zone >= json_zones.size()) {
+            json_zones.resize(zone + 1);
+        }
+
+        std::string &prefix = json_zones[zone];
+        if (prefix.empty()) {
+            const zone_desc *desc = find_zone(zone);
+            std::string zname = desc != nullptr ? desc->name : "Unknown Zone";
+            std::string zcat = desc != nullptr ? desc->category : "function";
+            std::replace(zname.begin(), zname.end(), '"', '\'');
+            std::replace(zcat.begin(), zcat.end(), '"', '\'');
+            prefix = fmt::format(R"({{"name": "{}", "cat": "{}", "ph": "X", "dur": )", zname, zcat);
+        }
+        return prefix;
+    }
+
+    void profiler_session::format_event(const profile_result &res, long long start, long long end,
+                                        const event_buffer &buf) {
+        if (format == trace_format::none) {
             return;
         }
 
-        profile_result head = queue.front();
-        queue.pop();
+        if (format == trace_format::binary) {
+            if (!encoder.knows_zone(res.zone)) {
+                const zone_desc *desc = find_zone(res.zone);
+                trace::zone_info info;
+                if (desc != nullptr) {
+                    info = {desc->name, desc->category, desc->file, desc->line, desc->color};
+                }
+                encoder.write_zone(batch, res.zone, info);
+            }
+            encoder.write_event(batch, res.zone, res.frame, buf.pid, buf.thread, start, end);
+            return;
+        }
 
         if (first_event_written) {
-            out << ", ";
+            batch.append(fmt::string_view(", "));
         } else {
             first_event_written = true;
         }
 
-        std::string strname = std::string(head.name);
-        std::replace(strname.begin(), strname.end(), '"', '\'');
+        // Chrome traces are in microseconds, but take fractions, so we keep the full nanosecond resolution.
+        long long dur = end - start;
+        const std::string &prefix = json_zone_prefix(res.zone);
+        batch.append(prefix.data(), prefix.data() + prefix.size());
+        fmt::format_to(std::back_inserter(batch),
+                       R"({}.{:03}, "pid": {}, "tid": {}, "ts": {}.{:03}, "args": {{"frame": {}}}}})",
+                       dur / 1000, dur % 1000, buf.pid, buf.thread, start / 1000, start % 1000, res.frame);
+    }
 
-        out << fmt::format(
-                R"({{"cat": "function", "dur": {}, "name": "{}", "ph": "X", "pid": {}, "tid": {}, "ts": {}}})",
-                head.end - head.start, strname, head.pid, head.thread, head.start);
+    void profiler_session::format_counter(const trace::counter &ctr) {
+        if (format == trace_format::none) {
+            return;
+        }
 
-        out.flush();
+        if (format == trace_format::binary) {
+            if (!encoder.knows_zone(ctr.zone_id)) {
+                const zone_desc *desc = find_zone(ctr.zone_id);
+                trace::zone_info info;
+                if (desc != nullptr) {
+                    info = {desc->name, desc->category, desc->file, desc->line, desc->color};
+                }
+                encoder.write_zone(batch, ctr.zone_id, info);
+            }
+            encoder.write_counter(batch, ctr);
+            return;
+        }
+
+        const zone_desc *desc = find_zone(ctr.zone_id);
+        std::string cname = desc != nullptr ? desc->name : "Unknown Counter";
+        std::string ccat = desc != nullptr ? desc->category : "memory";
+        std::replace(cname.begin(), cname.end(), '"', '\'');
+        std::replace(ccat.begin(), ccat.end(), '"', '\'');
+
+        // One track per value; Chrome stacks the values of a single counter event, which would add bytes to peaks.
+        fmt::format_to(std::back_inserter(batch),
+                       R"({0}{{"name": "{1} bytes", "cat": "{2}", "ph": "C", "pid": {3}, "ts": {4}.{5:03}, "args": {{"bytes": {6}}}}}, )"
+                       R"({{"name": "{1} peak", "cat": "{2}", "ph": "C", "pid": {3}, "ts": {4}.{5:03}, "args": {{"bytes": {7}}}}}, )"
+                       R"({{"name": "{1} allocations", "cat": "{2}", "ph": "C", "pid": {3}, "ts": {4}.{5:03}, "args": {{"count": {8}}}}})",
+                       first_event_written ? ", " : "", cname, ccat, ctr.pid, ctr.time / 1000, ctr.time % 1000,
+                       ctr.bytes, ctr.peak_bytes, ctr.allocations);
+        first_event_written = true;
+    }
+
+    void profiler_session::write_thread_name(event_buffer &buf) {
+        buf.name_written = true;
+        if (format == trace_format::binary) {
+            encoder.write_thread_name(batch, buf.pid, buf.thread, buf.name);
+        } else if (format == trace_format::json) {
+            std::string tname = buf.name;
+            std::replace(tname.begin(), tname.end(), '"', '\'');
+            fmt::format_to(std::back_inserter(batch),
+                           R"({}{{"name": "thread_name", "ph": "M", "pid": {}, "tid": {}, "args": {{"name": "{}"}}}})",
+                           first_event_written ? ", " : "", buf.pid, buf.thread, tname);
+            first_event_written = true;
+        }
+    }
+
+    void profiler_session::write_batch() {
+        if (batch.size() > 0) {
+            out.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+            batch.clear();
+        }
+    }
+
+    void profiler_session::drain(bool single) {
+        std::vector<event_buffer *> snapshot;
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            snapshot.reserve(buffers.size());
+            for (const auto &buf : buffers) {
+                snapshot.emplace_back(buf.get());
+            }
+            if (!single) {
+                counter_batch.swap(counters);
+            }
+        }
 
+        const bool collect = stats_enabled.load(std::memory_order_acquire);
+        const bool live = server != nullptr && server->sync();
+        bool done = false;
+        profile_result head{};
+        for (auto buf : snapshot) {
+            if (buf->name != nullptr && !buf->name_written) {
+                write_thread_name(*buf);
+            }
+
+            while (!done && buf->pop(head)) {
+                long long start = clock::to_ns(head.start);
+                long long end = clock::to_ns(head.end);
+                format_event(head, start, end, *buf);
+                if (live) {
+                    server->write_event(head, start, end, *buf);
+                }
+                if (collect) {
+                    samples.push_back(stats_sample{head.zone, head.frame, end - start});
+                }
+
+                if (single) {
+                    done = true;
+                } else if (batch.size() >= write_batch_size) {
+                    write_batch();
+                }
+            }
+        }
+
+        for (auto &ctr : counter_batch) {
+            ctr.time = clock::to_ns(static_cast<uint64_t>(ctr.time));
+            format_counter(ctr);
+            if (live) {
+                server->write_counter(ctr);
+            }
+        }
+        counter_batch.clear();
+
+        if (live) {
+            server->flush();
+        }
+
+        if (collect) {
+            aggregator->ingest(samples, current_frame());
+        }
+    }
+
+    void profiler_session::flush_single() {
+        std::lock_guard<std::mutex> lg(write_mtx);
+        if (closed) {
+            return;
+        }
+
+        drain(true);
+        write_batch();
+        out.flush();
     }
 
     void profiler_session::flush_all() {
-        std::lock_guard<std::mutex> lg(mtx);
-        if (closed || queue.empty()) {
+        std::lock_guard<std::mutex> lg(write_mtx);
+        if (closed) {
+            return;
+        }
+
+        drain(false);
+        write_batch();
+        out.flush();
+    }
+
+    void profiler_session::start_writer() {
+        writer_running.store(true, std::memory_order_release);
+        writer = std::thread(&profiler_session::writer_loop, this);
+    }
+
+    void profiler_session::stop_writer() {
+        if (!writer.joinable()) {
             return;
         }
 
-        while (!queue.empty()) {
-            profile_result head = queue.front();
-            queue.pop();
+        {
+            std::lock_guard<std::mutex> lg(writer_mtx);
+            writer_running.store(false, std::memory_order_release);
+        }
+        writer_cv.notify_one();
+        writer.join();
+    }
 
-            if (first_event_written) {
-                out << ", ";
-            } else {
-                first_event_written = true;
+    void profiler_session::writer_loop() {
+        while (writer_running.load(std::memory_order_acquire)) {
+            {
+                std::unique_lock<std::mutex> lk(writer_mtx);
+                writer_cv.wait_for(lk, flush_interval, [this]() {
+                    return wake_requested.load(std::memory_order_acquire) ||
+                           !writer_running.load(std::memory_order_acquire);
+                });
+                wake_requested.store(false, std::memory_order_release);
             }
 
-            std::string strname = std::string(head.name);
-            std::replace(strname.begin(), strname.end(), '"', '\'');
+            std::lock_guard<std::mutex> lg(write_mtx);
+            drain(false);
+            write_batch();
+        }
+    }
 
-            out << fmt::format(
-                    R"({{"cat": "function", "dur": {}, "name": "{}", "ph": "X", "pid": {}, "tid": {}, "ts": {}}})",
-                    head.end - head.start, strname, head.pid, head.thread, head.start);
+    void profiler_session::enable_stats(uint32_t window_frames) {
+        std::lock_guard<std::mutex> lg(write_mtx);
+        if (aggregator != nullptr) {
+            return;
+        }
 
-            out.flush();
+        aggregator = std::make_unique<stats_aggregator>(window_frames);
+        stats_enabled.store(true, std::memory_order_release);
+    }
+
+    stats_report profiler_session::stats(stats_scope scope) {
+        if (!stats_enabled.load(std::memory_order_acquire)) {
+            stats_report ret;
+            ret.scope = scope;
+            return ret;
+        }
+        return aggregator->report(scope);
+    }
+
+    void profiler_session::on_frame_stats(std::function<void(const stats_report &)> callback) {
+        if (!stats_enabled.load(std::memory_order_acquire)) {
+            HP_WARN("Profiler session \"{}\" has no stats to report! Call enable_stats() first!", name);
+            return;
+        }
+        aggregator->on_frame(std::move(callback));
+    }
+
+    void profiler_session::dump_stats(std::ostream &os, stats_scope scope) {
+        stats_report report = stats(scope);
+
+        fmt::memory_buffer buf;
+        buf.append(fmt::string_view("name,category,file,line,count,total_us,min_us,avg_us,p50_us,p90_us,p99_us,max_us\n"));
+        for (const auto &zone : report.zones) {
+            const zone_desc *desc = find_zone(zone.zone);
+            std::string zname = desc != nullptr ? desc->name : "Unknown Zone";
+            std::replace(zname.begin(), zname.end(), '"', '\'');
+            fmt::format_to(std::back_inserter(buf),
+                           "\"{}\",\"{}\",\"{}\",{},{},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f},{:.3f}\n",
+                           zname, desc != nullptr ? desc->category : "", desc != nullptr ? desc->file : "",
+                           desc != nullptr ? desc->line : 0, zone.count, zone.total_ns / 1000.0, zone.min_ns / 1000.0,
+                           zone.avg_ns() / 1000.0, zone.p50_ns / 1000.0, zone.p90_ns / 1000.0, zone.p99_ns / 1000.0,
+                           zone.max_ns / 1000.0);
+        }
+        os.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+    }
+
+    bool profiler_session::serve_live(uint16_t port) {
+        stop_live();  // Free the port first, in case the same one is asked for again.
+
+        auto new_server = std::make_unique<capture_server>(binary_header(), port);
+        if (!new_server->is_listening()) {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lg(write_mtx);
+        server = std::move(new_server);
+        return true;
+    }
+
+    void profiler_session::stop_live() {
+        std::unique_ptr<capture_server> old;
+        {
+            std::lock_guard<std::mutex> lg(write_mtx);
+            old = std::move(server);
         }
+        // Destroyed outside the lock, so the writer isn't held up by the networking thread shutting down.
+    }
+
+    uint16_t profiler_session::live_port() {
+        std::lock_guard<std::mutex> lg(write_mtx);
+        return server != nullptr ? server->get_port() : 0;
     }
 
     profiler::~profiler() {
         stop();
     }
 
-    profiler::profiler() : name("Dummy Profiler"), parent(nullptr), stopped(true) {}
+    profiler::profiler() : zone(nullptr), parent(nullptr), stopped(true) {}
 
     profiler::profiler(profiler &&other) noexcept {
-        name = other.name;
+        zone = other.zone;
         parent = other.parent;
         stopped = other.stopped;
+        start_time = other.start_time;
 
         other.parent = nullptr; // Destroy other's parent so we don't dig ourselves into trouble.
     }
@@ -161,9 +711,10 @@ namespace hp {
         }
 
         this->stop();
-        name = other.name;
+        zone = other.zone;
         parent = other.parent;
         stopped = other.stopped;
+        start_time = other.start_time;
 
         other.parent = nullptr; // Destroy other.
 
@@ -172,46 +723,83 @@ namespace hp {
 
     void profiler::stop() {
         if (parent == nullptr) {  // Most likely in this case our profiler was a dummy.
-            if (strcmp(name, "Dummy Profiler") != 0) {
-                HP_WARN("Profiler \"{}\" stopped with null parent!", name);
+            if (zone != nullptr) {
+                HP_WARN("Profiler \"{}\" stopped with null parent!", zone->name);
             }
             return;
         }
 
-
-        std::lock_guard<std::mutex> lg(parent->mtx);
         if (!stopped) {
             stopped = true;
-            auto end = std::chrono::high_resolution_clock::now();
             profile_result res = profile_result();
-            res.name = name;
-            res.start = std::chrono::time_point_cast<std::chrono::microseconds>(start_time).time_since_epoch().count();
-            res.end = std::chrono::time_point_cast<std::chrono::microseconds>(end).time_since_epoch().count();
-            res.thread = std::hash<std::thread::id>{}(std::this_thread::get_id());
-#if defined(_WIN32) || defined(__WIN32__) || defined(WIN32)
-            res.pid = ::_getpid();
-#else
-            res.pid = ::getpid();
-#endif
-            parent->queue.push(res);
+            res.end = clock::ticks_ordered();
+            res.zone = zone->id;
+            res.frame = profiler_session::current_frame();
+            res.start = start_time;
+            parent->record(res);
         }
     }
 
     void profiler::start() {
         if (parent == nullptr) {  // Cannot start because the profiler has nothing to report to!
-            HP_WARN("Attempted to start profiler \"{}\" with a null parent! Ignoring call to profiler::start()!", name);
+            HP_WARN("Attempted to start profiler \"{}\" with a null parent! Ignoring call to profiler::start()!",
+                    zone != nullptr ? zone->name : "Dummy Profiler");
             return;
         }
 
-
-        std::lock_guard<std::mutex> lg(parent->mtx);
         if (stopped) {
-            start_time = std::chrono::high_resolution_clock::now();
+            start_time = clock::ticks();
             stopped = false;
         }
     }
 
-    profiler::profiler(const char *name, profiler_session *par) : name(name), parent(par), stopped(true) {}
+    profiler::profiler(const zone_desc *zone, profiler_session *par) : zone(zone), parent(par), stopped(true) {}
+
+    /// The open frame of `profiler_session::frame_begin()`. Only touched by the thread that draws frames.
+    struct open_frame {
+        profiler_session *session = nullptr;
+        uint64_t start = 0;
+        uint32_t frame = 0;
+        bool active = false;
+    };
+
+    static open_frame current_open_frame;
+
+    void profiler_session::frame_begin() {
+        if (current_open_frame.active) {
+            frame_end();
+        }
+
+        next_frame();
+        current_open_frame.session = default_session;
+        current_open_frame.frame = current_frame();
+        current_open_frame.active = true;
+        current_open_frame.start = clock::ticks();
+    }
+
+    void profiler_session::frame_end() {
+        if (!current_open_frame.active) {
+            return;
+        }
+
+        uint64_t end = clock::ticks_ordered();
+        current_open_frame.active = false;
+        // The session may have been replaced (and deleted) since the frame began.
+        if (current_open_frame.session != nullptr && current_open_frame.session == default_session) {
+            current_open_frame.session->record(profile_result{frame_zone()->id, current_open_frame.frame,
+                                                              current_open_frame.start, end});
+            sample_memory_counters(current_open_frame.session, current_open_frame.frame, end);
+        } else {
+            sample_memory_counters(nullptr, current_open_frame.frame, end);
+        }
+    }
+
+    const zone_desc *profiler_session::frame_zone() {
+        static const zone_desc *zone = register_zone("Frame", "frame", __FILE__, __LINE__);
+        return zone;
+    }
 
     profiler_session *profiler_session::default_session = nullptr;
+
+    std::atomic<uint32_t> profiler_session::frame_counter{0};
 }
@@ -0,0 +1,315 @@
+//
+// Per-zone profiling statistics. See `hp/profiling_stats.hpp`.
+//
+
+#include "hp/profiling_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace hp {
+
+    static unsigned log2_floor(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#else
+        unsigned ret = 0;
+        while (value >>= 1u) {
+            ret++;
+        }
+        return ret;
+#endif
+    }
+
+    static void sort_by_total(stats_report &report) {
+        std::sort(report.zones.begin(), report.zones.end(), [](const zone_stats &a, const zone_stats &b) {
+            return a.total_ns > b.total_ns;
+        });
+    }
+
+    /// Bucket midpoints can lie just outside the exact range, which looks odd next to it in a report.
+    static void clamp_percentiles(zone_stats &stats) {
+        stats.p50_ns = std::clamp(stats.p50_ns, stats.min_ns, stats.max_ns);
+        stats.p90_ns = std::clamp(stats.p90_ns, stats.min_ns, stats.max_ns);
+        stats.p99_ns = std::clamp(stats.p99_ns, stats.min_ns, stats.max_ns);
+    }
+
+    /// Zero-based index of the value at percentile `pct` among `n` sorted values.
+    static uint64_t percentile_index(double pct, uint64_t n) {
+        auto rank = static_cast<uint64_t>(std::ceil(pct / 100.0 * static_cast<double>(n)));
+        return std::clamp<uint64_t>(rank, 1, n) - 1;
+    }
+
+    unsigned latency_histogram::bucket_of(uint64_t value) {
+        if (value < (2u << sub_bucket_bits)) {
+            return static_cast<unsigned>(value);  // Exact
+        }
+
+        unsigned magnitude = log2_floor(value);
+        if (magnitude >= max_magnitude) {
+            return bucket_count - 1;
+        }
+
+        unsigned shift = magnitude - sub_bucket_bits;
+        return (shift << sub_bucket_bits) + static_cast<unsigned>(value >> shift);
+    }
+
+    uint64_t latency_histogram::value_of(unsigned bucket) {
+        if (bucket < (2u << sub_bucket_bits)) {
+            return bucket;
+        }
+
+        unsigned shift = (bucket >> sub_bucket_bits) - 1;
+        uint64_t sub = (bucket & ((1u << sub_bucket_bits) - 1)) | (1u << sub_bucket_bits);
+        return (sub << shift) + ((uint64_t(1) << shift) >> 1u);
+    }
+
+    void latency_histogram::add(unsigned bucket, uint64_t n) {
+        if (counts.empty()) {
+            counts.resize(bucket_count, 0);
+        }
+        counts[std::min(bucket, bucket_count - 1)] += n;
+        total += n;
+    }
+
+    void latency_histogram::remove(unsigned bucket, uint64_t n) {
+        if (counts.empty()) {
+            return;
+        }
+
+        uint64_t &cnt = counts[std::min(bucket, bucket_count - 1)];
+        n = std::min(n, cnt);
+        cnt -= n;
+        total -= n;
+    }
+
+    uint64_t latency_histogram::percentile(double pct) const {
+        if (total == 0) {
+            return 0;
+        }
+
+        uint64_t index = percentile_index(pct, total);
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < bucket_count; i++) {
+            seen += counts[i];
+            if (seen > index) {
+                return value_of(i);
+            }
+        }
+        return value_of(bucket_count - 1);
+    }
+
+    void latency_histogram::clear() {
+        std::fill(counts.begin(), counts.end(), 0);
+        total = 0;
+    }
+
+    stats_aggregator::stats_aggregator(uint32_t window_frames) : window(std::max<uint32_t>(window_frames, 1)) {}
+
+    void stats_aggregator::accumulate(zone_accum &acc, long long duration) {
+        if (acc.count == 0) {
+            acc.min = duration;
+            acc.max = duration;
+        } else {
+            acc.min = std::min(acc.min, duration);
+            acc.max = std::max(acc.max, duration);
+        }
+        acc.count++;
+        acc.total += duration;
+    }
+
+    void stats_aggregator::ingest(std::vector<stats_sample> &samples, uint32_t current_frame) {
+        std::vector<stats_report> reports;
+        std::function<void(const stats_report &)> cb;
+
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            for (const auto &sample : samples) {
+                long long duration = std::max(sample.duration_ns, 0LL);  // TSCs of different cores may disagree slightly.
+                uint32_t frame = sample.frame;
+                if (any_completed && frame <= last_completed) {
+                    frame = last_completed + 1;  // Too late for its own frame.
+                }
+
+                if (!any_ingested) {
+                    first_frame = frame;
+                    any_ingested = true;
+                }
+
+                frame_accum &fa = pending[frame];
+                fa.frame = frame;
+                zone_accum &acc = fa.zones[sample.zone];
+                accumulate(acc, duration);
+                acc.buckets.push_back(static_cast<uint16_t>(latency_histogram::bucket_of(static_cast<uint64_t>(duration))));
+
+                if (sample.zone >= totals.size()) {
+                    totals.resize(sample.zone + 1);
+                }
+                accumulate(totals[sample.zone].lifetime, duration);
+                totals[sample.zone].lifetime_hist.record(static_cast<uint64_t>(duration));
+            }
+            samples.clear();
+
+            while (!pending.empty() && pending.begin()->first + 1 < current_frame) {
+                complete(std::move(pending.begin()->second));
+                pending.erase(pending.begin());
+                if (callback) {
+                    reports.emplace_back(frame_report());
+                }
+            }
+
+            if (!reports.empty()) {
+                cb = callback;
+            }
+        }
+
+        for (const auto &report : reports) {  // Outside the lock, so the callback can call `report()`.
+            cb(report);
+        }
+    }
+
+    void stats_aggregator::complete(frame_accum &&frame) {
+        for (const auto &zone : frame.zones) {
+            for (auto bucket : zone.second.buckets) {
+                totals[zone.first].window_hist.add(bucket);
+            }
+        }
+
+        last_completed = frame.frame;
+        any_completed = true;
+        completed.emplace_back(std::move(frame));
+
+        while (completed.front().frame + window <= last_completed) {
+            for (const auto &zone : completed.front().zones) {
+                for (auto bucket : zone.second.buckets) {
+                    totals[zone.first].window_hist.remove(bucket);
+                }
+            }
+            completed.pop_front();
+        }
+    }
+
+    zone_stats stats_aggregator::frame_stats(uint32_t zone, const zone_accum &acc) {
+        zone_stats ret;
+        ret.zone = zone;
+        ret.count = acc.count;
+        ret.total_ns = acc.total;
+        ret.min_ns = acc.min;
+        ret.max_ns = acc.max;
+
+        // Buckets are ordered like their values, so selecting on the raw bucket indices finds the percentiles.
+        std::vector<uint16_t> buckets = acc.buckets;
+        auto pick = [&](double pct) {
+            auto it = buckets.begin() + static_cast<std::ptrdiff_t>(percentile_index(pct, buckets.size()));
+            std::nth_element(buckets.begin(), it, buckets.end());
+            return static_cast<long long>(latency_histogram::value_of(*it));
+        };
+        ret.p50_ns = pick(50);
+        ret.p90_ns = pick(90);
+        ret.p99_ns = pick(99);
+        clamp_percentiles(ret);
+        return ret;
+    }
+
+    stats_report stats_aggregator::frame_report() const {
+        stats_report ret;
+        ret.scope = stats_scope::frame;
+        if (completed.empty()) {
+            return ret;
+        }
+
+        const frame_accum &frame = completed.back();
+        ret.first_frame = frame.frame;
+        ret.last_frame = frame.frame;
+        ret.zones.reserve(frame.zones.size());
+        for (const auto &zone : frame.zones) {
+            ret.zones.emplace_back(frame_stats(zone.first, zone.second));
+        }
+        sort_by_total(ret);
+        return ret;
+    }
+
+    stats_report stats_aggregator::report(stats_scope scope) const {
+        std::lock_guard<std::mutex> lg(mtx);
+        stats_report ret;
+
+        switch (scope) {
+            case (stats_scope::frame): {
+                ret = frame_report();
+                break;
+            }
+            case (stats_scope::window): {
+                ret.scope = stats_scope::window;
+                if (completed.empty()) {
+                    break;
+                }
+
+                ret.first_frame = completed.front().frame;
+                ret.last_frame = completed.back().frame;
+                std::unordered_map<uint32_t, zone_accum> sums;
+                for (const auto &frame : completed) {
+                    for (const auto &zone : frame.zones) {
+                        zone_accum &sum = sums[zone.first];
+                        sum.min = sum.count == 0 ? zone.second.min : std::min(sum.min, zone.second.min);
+                        sum.max = sum.count == 0 ? zone.second.max : std::max(sum.max, zone.second.max);
+                        sum.count += zone.second.count;
+                        sum.total += zone.second.total;
+                    }
+                }
+
+                for (const auto &sum : sums) {
+                    const latency_histogram &hist = totals[sum.first].window_hist;
+                    zone_stats stats;
+                    stats.zone = sum.first;
+                    stats.count = sum.second.count;
+                    stats.total_ns = sum.second.total;
+                    stats.min_ns = sum.second.min;
+                    stats.max_ns = sum.second.max;
+                    stats.p50_ns = static_cast<long long>(hist.percentile(50));
+                    stats.p90_ns = static_cast<long long>(hist.percentile(90));
+                    stats.p99_ns = static_cast<long long>(hist.percentile(99));
+                    clamp_percentiles(stats);
+                    ret.zones.emplace_back(stats);
+                }
+                break;
+            }
+            case (stats_scope::lifetime): {
+                ret.scope = stats_scope::lifetime;
+                ret.first_frame = first_frame;
+                ret.last_frame = pending.empty() ? last_completed : pending.rbegin()->first;
+                for (uint32_t zone = 0; zone < totals.size(); zone++) {
+                    const zone_totals &tot = totals[zone];
+                    if (tot.lifetime.count == 0) {
+                        continue;
+                    }
+
+                    zone_stats stats;
+                    stats.zone = zone;
+                    stats.count = tot.lifetime.count;
+                    stats.total_ns = tot.lifetime.total;
+                    stats.min_ns = tot.lifetime.min;
+                    stats.max_ns = tot.lifetime.max;
+                    stats.p50_ns = static_cast<long long>(tot.lifetime_hist.percentile(50));
+                    stats.p90_ns = static_cast<long long>(tot.lifetime_hist.percentile(90));
+                    stats.p99_ns = static_cast<long long>(tot.lifetime_hist.percentile(99));
+                    clamp_percentiles(stats);
+                    ret.zones.emplace_back(stats);
+                }
+                break;
+            }
+        }
+
+        sort_by_total(ret);
+        return ret;
+    }
+
+    void stats_aggregator::on_frame(std::function<void(const stats_report &)> cb) {
+        std::lock_guard<std::mutex> lg(mtx);
+        callback = std::move(cb);
+    }
+
+    uint32_t stats_aggregator::window_frames() const {
+        std::lock_guard<std::mutex> lg(mtx);
+        return window;
+    }
+}
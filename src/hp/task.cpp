@@ -0,0 +1,65 @@
+//
+// Coroutine awaitables for GPU copies and file reads. See `hp/task.hpp`.
+//
+
+#include "hp/task.hpp"
+#include "hp/logging.hpp"
+#include "hp/vk/window.hpp"
+
+#include <fstream>
+
+namespace hp {
+    fence_awaiter::fence_awaiter(job_system &js, vk::window &win, std::pair<::vk::Fence, ::vk::CommandBuffer> copy)
+            : js(js), win(win), copy(copy) {
+        ready = [](job_waiter &w) {
+            auto &self = static_cast<fence_awaiter &>(w);
+            return self.win.fence_signaled(self.copy.first);
+        };
+        resume = [](job_waiter &w) {
+            static_cast<fence_awaiter &>(w).handle.resume();
+        };
+    }
+
+    bool fence_awaiter::await_ready() {
+        return !copy.first || win.fence_signaled(copy.first);
+    }
+
+    void fence_awaiter::await_suspend(std::coroutine_handle<> h) {
+        handle = h;
+        js.park(*this);
+    }
+
+    void fence_awaiter::await_resume() {
+        // Resumed on whichever worker polled the fence; Both calls take the window's render lock, like `copy_buffer()`.
+        if (copy.first) {
+            win.delete_fence(copy.first);
+        }
+        if (copy.second) {
+            win.delete_cmd_buffers(&copy.second);
+        }
+    }
+
+    file_read::file_read(job_system &js, std::string path) : js(js), path(std::move(path)) {}
+
+    void file_read::await_suspend(std::coroutine_handle<> h) {
+        io_service->post([this, h]() {
+            std::ifstream file(path, std::ios::ate | std::ios::binary);
+            if (file.is_open()) {
+                std::vector<char> data(static_cast<size_t>(file.tellg()));
+                file.seekg(0);
+                if (file.read(data.data(), static_cast<std::streamsize>(data.size()))) {
+                    bytes = std::move(data);
+                }
+            }
+            if (!bytes) {
+                HP_WARN("[** IO ERROR **] Cannot read '{}'!", path);
+            }
+
+            js.submit([h]() { h.resume(); });
+        });
+    }
+
+    std::optional<std::vector<char>> file_read::await_resume() {
+        return std::move(bytes);
+    }
+}
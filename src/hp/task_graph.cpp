@@ -0,0 +1,138 @@
+//
+// Reusable graphs of dependent tasks. See `hp/task_graph.hpp`.
+//
+
+#include "hp/task_graph.hpp"
+#include "hp/logging.hpp"
+
+#include <limits>
+
+namespace hp {
+    static constexpr task_graph::task no_task = std::numeric_limits<task_graph::task>::max();
+
+    task_graph::~task_graph() {
+        wait();
+    }
+
+    task_graph::task task_graph::add(const char *name, std::function<void()> fn, std::initializer_list<task> deps) {
+        if (!finished.done()) {
+            HP_WARN("Task \"{}\" added to a running task graph! Ignoring invocation!", name);
+            return no_task;
+        }
+
+        const auto id = static_cast<task>(nodes.size());
+        nodes.push_back(node{std::move(fn), register_zone(name, "task"), {}, 0});
+        for (task dep : deps) {
+            precede(dep, id);
+        }
+        dirty = true;
+        return id;
+    }
+
+    void task_graph::precede(task before, task after) {
+        if (!finished.done()) {
+            HP_WARN("Dependency added to a running task graph! Ignoring invocation!");
+            return;
+        }
+        if (before >= nodes.size() || after >= nodes.size()) {
+            HP_WARN("Dependency between unknown tasks {} and {}! Ignoring invocation!", before, after);
+            return;
+        }
+
+        nodes[before].successors.push_back(after);
+        nodes[after].predecessors++;
+        dirty = true;
+    }
+
+    bool task_graph::compile() {
+        dirty = false;
+        roots.clear();
+        remaining.reset(new std::atomic<uint32_t>[nodes.size()]);
+
+        // Kahn's algorithm, only to find cycles; They would never finish.
+        std::vector<uint32_t> preds(nodes.size());
+        std::vector<task> ready;
+        for (task t = 0; t < nodes.size(); t++) {
+            preds[t] = nodes[t].predecessors;
+            if (preds[t] == 0) {
+                roots.push_back(t);
+                ready.push_back(t);
+            }
+        }
+
+        size_t visited = 0;
+        while (!ready.empty()) {
+            task t = ready.back();
+            ready.pop_back();
+            visited++;
+            for (task succ : nodes[t].successors) {
+                if (--preds[succ] == 0) {
+                    ready.push_back(succ);
+                }
+            }
+        }
+
+        acyclic = visited == nodes.size();
+        if (!acyclic) {
+            HP_WARN("Task graph has a cycle through {} tasks! It will not run!", nodes.size() - visited);
+        }
+        return acyclic;
+    }
+
+    bool task_graph::run(job_system &sys) {
+        if (!finished.done()) {
+            HP_WARN("Task graph started while still running! Ignoring invocation!");
+            return false;
+        }
+        if (dirty && !compile()) {
+            return false;
+        }
+        if (!acyclic) {
+            return false;
+        }
+
+        js = &sys;
+        for (task t = 0; t < nodes.size(); t++) {
+            remaining[t].store(nodes[t].predecessors, std::memory_order_relaxed);
+        }
+
+        finished.add(static_cast<uint32_t>(nodes.size()));
+        for (task t : roots) {  // Submitting publishes the counters reset above.
+            js->submit([this, t]() { execute(t); });
+        }
+        return true;
+    }
+
+    void task_graph::execute(task t) {
+        while (t != no_task) {
+            const node &n = nodes[t];
+            {
+#ifdef HP_PROFILING_ENABLED
+                scoped_zone zone(n.zone);
+#endif
+                n.fn();
+            }
+
+            task next = no_task;
+            for (task succ : n.successors) {
+                if (remaining[succ].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    if (next != no_task) {
+                        js->submit([this, next]() { execute(next); });
+                    }
+                    next = succ;  // Continue with the last ready successor ourselves.
+                }
+            }
+
+            // Once the last task signals, `wait()` may return and the graph may be destroyed; Don't touch it after.
+            finished.signal();
+            t = next;
+        }
+    }
+
+    void task_graph::wait() {
+        if (finished.done()) {
+            return;
+        }
+        js->wait(finished);
+    }
+}
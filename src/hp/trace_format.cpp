@@ -0,0 +1,290 @@
+//
+// Binary profiler trace encoding/decoding. See `hp/trace_format.hpp`.
+//
+
+#include "hp/trace_format.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace hp::trace {
+
+    void encoder::write_header(fmt::memory_buffer &buf, const header &head) {
+        buf.append(magic, magic + sizeof(magic));
+        put_varint(buf, head.version);
+        put_varint(buf, head.ts_unit_ns);
+        put_string(buf, head.session_name);
+        put_string(buf, head.compile_datetime);
+        put_string(buf, head.current_datetime);
+    }
+
+    void encoder::write_zone(fmt::memory_buffer &buf, uint32_t id, const zone_info &zone) {
+        if (id >= zones.size()) {
+            zones.resize(id + 1, false);
+        }
+        zones[id] = true;
+
+        buf.push_back(static_cast<char>(record_type::zone_def));
+        put_varint(buf, id);
+        put_string(buf, zone.name);
+        put_string(buf, zone.category);
+        put_string(buf, zone.file);
+        put_varint(buf, zone.line);
+        put_varint(buf, zone.color);
+    }
+
+    encoder::thread_state &encoder::thread_index(fmt::memory_buffer &buf, size_t pid, size_t thread) {
+        auto thread_it = threads.find(thread);
+        if (thread_it == threads.end()) {
+            thread_it = threads.emplace(thread, thread_state{static_cast<uint32_t>(threads.size()), 0, 0}).first;
+            buf.push_back(static_cast<char>(record_type::thread_def));
+            put_varint(buf, thread_it->second.index);
+            put_varint(buf, pid);
+            put_varint(buf, thread);
+        }
+        return thread_it->second;
+    }
+
+    void encoder::write_event(fmt::memory_buffer &buf, uint32_t zone_id, uint32_t frame, size_t pid, size_t thread,
+                              long long start, long long end) {
+        thread_state &state = thread_index(buf, pid, thread);
+
+        buf.push_back(static_cast<char>(record_type::event));
+        put_varint(buf, zone_id);
+        put_varint(buf, state.index);
+        put_zigzag(buf, start - state.last_start);
+        put_varint(buf, static_cast<uint64_t>(end - start));
+        put_zigzag(buf, static_cast<int64_t>(frame) - static_cast<int64_t>(state.last_frame));
+        state.last_start = start;
+        state.last_frame = frame;
+    }
+
+    void encoder::write_thread_name(fmt::memory_buffer &buf, size_t pid, size_t thread, const std::string &name) {
+        thread_state &state = thread_index(buf, pid, thread);
+
+        buf.push_back(static_cast<char>(record_type::thread_name));
+        put_varint(buf, state.index);
+        put_string(buf, name);
+    }
+
+    void encoder::write_counter(fmt::memory_buffer &buf, const counter &ctr) {
+        buf.push_back(static_cast<char>(record_type::counter));
+        put_varint(buf, ctr.zone_id);
+        put_varint(buf, ctr.pid);
+        put_zigzag(buf, ctr.time - last_counter_time);
+        put_zigzag(buf, static_cast<int64_t>(ctr.frame) - static_cast<int64_t>(last_counter_frame));
+        put_zigzag(buf, ctr.bytes);
+        put_zigzag(buf, ctr.peak_bytes);
+        put_varint(buf, ctr.allocations);
+        last_counter_time = ctr.time;
+        last_counter_frame = ctr.frame;
+    }
+
+    /// Undo `put_zigzag()`.
+    static inline int64_t unzigzag(uint64_t val) {
+        return static_cast<int64_t>((val >> 1u) ^ (~(val & 1u) + 1u));
+    }
+
+    reader::reader(std::istream &in) : in(in) {}
+
+    bool reader::get_varint(uint64_t &out) {
+        out = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            int byte = in.get();
+            if (byte == std::char_traits<char>::eof()) {
+                return false;
+            }
+
+            out |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool reader::get_string(std::string &out) {
+        uint64_t len;
+        if (!get_varint(len) || len > max_string_size) {
+            return false;
+        }
+
+        // A truncated or corrupt trace can claim any length, so never allocate more than was actually read.
+        char chunk[4096];
+        out.clear();
+        while (out.size() < len) {
+            auto want = static_cast<std::streamsize>(std::min<uint64_t>(sizeof(chunk), len - out.size()));
+            in.read(chunk, want);
+            out.append(chunk, static_cast<size_t>(in.gcount()));
+            if (in.gcount() != want) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool reader::read_header(header &out) {
+        char file_magic[sizeof(magic)];
+        in.read(file_magic, sizeof(file_magic));
+        if (in.gcount() != sizeof(file_magic) || std::memcmp(file_magic, magic, sizeof(magic)) != 0) {
+            fail = true;
+            return false;
+        }
+
+        uint64_t ver, unit;
+        if (!get_varint(ver) || ver > version || !get_varint(unit) || !get_string(out.session_name) ||
+            !get_string(out.compile_datetime) || !get_string(out.current_datetime)) {
+            fail = true;
+            return false;
+        }
+
+        out.version = static_cast<uint32_t>(ver);
+        file_version = out.version;
+        out.ts_unit_ns = unit;
+        return true;
+    }
+
+    bool reader::next(event &out) {
+        counter ctr;
+        record_kind kind;
+        while (next_record(out, ctr, kind)) {
+            if (kind == record_kind::event) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool reader::next_record(event &out, counter &ctr, record_kind &kind) {
+        while (true) {
+            int tag = in.get();
+            if (tag == std::char_traits<char>::eof()) {
+                return false;
+            }
+
+            switch (static_cast<record_type>(tag)) {
+                case (record_type::name_def): {
+                    uint64_t id;
+                    zone_info info;
+                    if (!get_varint(id) || id > max_id || !get_string(info.name)) {
+                        fail = true;
+                        return false;
+                    }
+
+                    info.category = "function";
+                    if (id >= zones.size()) {
+                        zones.resize(id + 1);
+                    }
+                    zones[id] = std::move(info);
+                    break;
+                }
+                case (record_type::zone_def): {
+                    uint64_t id, line, color;
+                    zone_info info;
+                    if (!get_varint(id) || id > max_id || !get_string(info.name) || !get_string(info.category) ||
+                        !get_string(info.file) || !get_varint(line) || !get_varint(color)) {
+                        fail = true;
+                        return false;
+                    }
+
+                    info.line = static_cast<unsigned>(line);
+                    info.color = static_cast<uint32_t>(color);
+                    if (id >= zones.size()) {
+                        zones.resize(id + 1);
+                    }
+                    zones[id] = std::move(info);
+                    break;
+                }
+                case (record_type::thread_def): {
+                    uint64_t index, pid, thread;
+                    if (!get_varint(index) || index > max_id || !get_varint(pid) || !get_varint(thread)) {
+                        fail = true;
+                        return false;
+                    }
+
+                    if (index >= threads.size()) {
+                        threads.resize(index + 1);
+                        last_starts.resize(index + 1, 0);
+                        last_frames.resize(index + 1, 0);
+                    }
+                    threads[index].pid = static_cast<size_t>(pid);
+                    threads[index].thread = static_cast<size_t>(thread);
+                    break;
+                }
+                case (record_type::thread_name): {
+                    uint64_t index;
+                    std::string str;
+                    if (!get_varint(index) || !get_string(str) || index >= threads.size()) {
+                        fail = true;
+                        return false;
+                    }
+
+                    threads[index].name = std::move(str);
+                    break;
+                }
+                case (record_type::event): {
+                    uint64_t zone_id, index, zz_delta, dur;
+                    if (!get_varint(zone_id) || !get_varint(index) || !get_varint(zz_delta) || !get_varint(dur) ||
+                        index >= threads.size()) {
+                        fail = true;
+                        return false;
+                    }
+
+                    last_starts[index] += unzigzag(zz_delta);
+
+                    if (file_version >= 4) {
+                        uint64_t zz_frame;
+                        if (!get_varint(zz_frame)) {
+                            fail = true;
+                            return false;
+                        }
+                        last_frames[index] += static_cast<uint32_t>(unzigzag(zz_frame));
+                    }
+
+                    out.zone_id = static_cast<uint32_t>(zone_id);
+                    out.thread_index = static_cast<uint32_t>(index);
+                    out.start = last_starts[index];
+                    out.end = out.start + static_cast<long long>(dur);
+                    out.frame = last_frames[index];
+                    kind = record_kind::event;
+                    return true;
+                }
+                case (record_type::counter): {
+                    uint64_t zone_id, pid, zz_time, zz_frame, zz_bytes, zz_peak, allocs;
+                    if (!get_varint(zone_id) || !get_varint(pid) || !get_varint(zz_time) || !get_varint(zz_frame) ||
+                        !get_varint(zz_bytes) || !get_varint(zz_peak) || !get_varint(allocs)) {
+                        fail = true;
+                        return false;
+                    }
+
+                    last_counter_time += unzigzag(zz_time);
+                    last_counter_frame += static_cast<uint32_t>(unzigzag(zz_frame));
+
+                    ctr.zone_id = static_cast<uint32_t>(zone_id);
+                    ctr.pid = static_cast<size_t>(pid);
+                    ctr.time = last_counter_time;
+                    ctr.frame = last_counter_frame;
+                    ctr.bytes = unzigzag(zz_bytes);
+                    ctr.peak_bytes = unzigzag(zz_peak);
+                    ctr.allocations = allocs;
+                    kind = record_kind::counter;
+                    return true;
+                }
+                default: {
+                    fail = true;
+                    return false;
+                }
+            }
+        }
+    }
+
+    const zone_info &reader::zone(uint32_t id) const {
+        static const zone_info unknown;
+        return id < zones.size() ? zones[id] : unknown;
+    }
+
+    const thread_info &reader::thread(uint32_t index) const {
+        static const thread_info unknown;
+        return index < threads.size() ? threads[index] : unknown;
+    }
+}
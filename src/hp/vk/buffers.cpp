@@ -118,13 +118,22 @@ namespace hp::vk {
         alloc_ci.preferredFlags = static_cast<VkMemoryPropertyFlags>(::vk::MemoryPropertyFlagBits::eHostCached);
 
         auto vanilla_buf = static_cast<VkBuffer>(buf);
+        VmaAllocationInfo alloc_info = {};
         handle_res(::vk::Result(
-                vmaCreateBuffer(parent->allocator, &buffer_ci, &alloc_ci, &vanilla_buf, &allocation, nullptr)),
+                vmaCreateBuffer(parent->allocator, &buffer_ci, &alloc_ci, &vanilla_buf, &allocation, &alloc_info)),
                    HP_GET_CODE_LOC);
         buf = ::vk::Buffer(vanilla_buf);
+
+        if (allocation != nullptr) {  // Counts what VMA actually allocated, which may be more than `size`.
+            tracked_bytes = alloc_info.size;
+            HP_TRACK_ALLOC("generic_buffer (VMA)", "device", tracked_bytes);
+        }
     }
 
     generic_buffer::~generic_buffer() {
+        if (tracked_bytes > 0) {
+            HP_TRACK_FREE("generic_buffer (VMA)", "device", tracked_bytes);
+        }
         vmaDestroyBuffer(parent->allocator, static_cast<VkBuffer>(buf), allocation);
     }
 
@@ -140,6 +149,8 @@ namespace hp::vk {
         buf = rhs.buf;
         parent = rhs.parent;
         allocation = rhs.allocation;
+        tracked_bytes = rhs.tracked_bytes;
+        rhs.tracked_bytes = 0;  // Counted once, by whoever frees it.
         return *this;
     }
 
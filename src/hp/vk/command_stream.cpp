@@ -0,0 +1,76 @@
+//
+// Replay of recorded draw commands. See `hp/vk/command_stream.hpp`.
+//
+
+#include "hp/vk/command_stream.hpp"
+#include "hp/logging.hpp"
+
+namespace hp::vk {
+    namespace {
+        template<typename Command>
+        inline Command read_command(const uint64_t *&at) {
+            Command ret;
+            std::memcpy(static_cast<void *>(&ret), at, sizeof(Command));
+            at += sizeof(Command) / sizeof(uint64_t);
+            return ret;
+        }
+    }
+
+    void command_stream::replay(::vk::CommandBuffer cmd, gpu_profiler &prof) const {
+        const uint64_t *at = words.data();
+        const uint64_t *end = at + words.size();
+
+        while (at < end) {
+            command_op op;
+            std::memcpy(&op, at, sizeof(op));  // Every command starts with its tag.
+
+            switch (op) {
+                case (command_op::bind_pipeline): {
+                    auto c = read_command<bind_pipeline_cmd>(at);
+                    cmd.bindPipeline(::vk::PipelineBindPoint::eGraphics, c.pipeline);
+                    break;
+                }
+                case (command_op::set_viewport): {
+                    auto c = read_command<set_viewport_cmd>(at);
+                    cmd.setViewport(0, 1, &c.viewport);
+                    break;
+                }
+                case (command_op::set_scissor): {
+                    auto c = read_command<set_scissor_cmd>(at);
+                    cmd.setScissor(0, 1, &c.scissor);
+                    break;
+                }
+                case (command_op::bind_vbos): {
+                    auto c = read_command<bind_vbos_cmd>(at);
+                    cmd.bindVertexBuffers(c.first, c.count, c.bufs, c.offsets);
+                    break;
+                }
+                case (command_op::bind_index_buffer): {
+                    auto c = read_command<bind_index_buffer_cmd>(at);
+                    cmd.bindIndexBuffer(c.buf, c.offset, c.type);
+                    break;
+                }
+                case (command_op::draw): {
+                    auto c = read_command<draw_cmd>(at);
+                    cmd.draw(c.vertex_count, 1, 0, 0);
+                    break;
+                }
+                case (command_op::draw_indexed): {
+                    auto c = read_command<draw_indexed_cmd>(at);
+                    cmd.drawIndexed(c.index_count, 1, 0, 0, 0);
+                    break;
+                }
+                case (command_op::write_timestamp): {
+                    auto c = read_command<write_timestamp_cmd>(at);
+                    prof.write_timestamp(cmd, c.query, c.stage);
+                    break;
+                }
+                default: {
+                    HP_FATAL("Corrupt command stream: Unknown opcode {}! Skipping the rest of it!",
+                             static_cast<unsigned>(op));
+                    return;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,386 @@
+//
+// GPU timestamp zones. See `hp/vk/gpu_profiler.hpp`.
+//
+
+#include "hp/vk/gpu_profiler.hpp"
+#include "hp/config.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#if defined(__linux__) && defined(VK_EXT_calibrated_timestamps)
+/**
+ * @def HP_VK_HAS_CALIBRATED_TIMESTAMPS
+ * @private
+ * @brief Defined if `VK_EXT_calibrated_timestamps` can line GPU timestamps up with `std::chrono::steady_clock`,
+ *        which is `CLOCK_MONOTONIC` on Linux.
+ */
+#define HP_VK_HAS_CALIBRATED_TIMESTAMPS
+#endif
+
+namespace hp::vk {
+
+    static long long steady_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static const zone_desc *render_pass_zone() {
+        static const zone_desc *zone = register_zone("Render Pass", "gpu", __FILE__, __LINE__);
+        return zone;
+    }
+
+    void gpu_profiler::init(::vk::Instance instance, ::vk::PhysicalDevice physical, ::vk::Device device,
+                            uint32_t queue_fam, ::vk::Queue graphics_queue, bool has_calibrated_ext) {
+        inst = instance;
+        phys = physical;
+        dev = device;
+        queue = graphics_queue;
+
+        std::vector<::vk::QueueFamilyProperties> fams = phys.getQueueFamilyProperties();
+        uint32_t valid_bits = queue_fam < fams.size() ? fams[queue_fam].timestampValidBits : 0;
+        if (valid_bits == 0) {
+            HP_WARN("The graphics queue doesn't support timestamps! GPU profiling is disabled!");
+            return;
+        }
+
+        valid_mask = valid_bits >= 64 ? ~uint64_t(0) : (uint64_t(1) << valid_bits) - 1;
+        period_ns = phys.getProperties().limits.timestampPeriod;
+        flight_imgs.assign(max_frames_in_flight, UINT32_MAX);
+        zones = {render_pass_zone()};
+
+#ifdef HP_VK_HAS_CALIBRATED_TIMESTAMPS
+        if (has_calibrated_ext) {
+            auto get_domains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT) inst.getProcAddr(
+                    "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+            uint32_t n_domains = 0;
+            if (get_domains != nullptr &&
+                get_domains(static_cast<VkPhysicalDevice>(phys), &n_domains, nullptr) == VK_SUCCESS) {
+                std::vector<VkTimeDomainEXT> domains(n_domains);
+                get_domains(static_cast<VkPhysicalDevice>(phys), &n_domains, domains.data());
+                calibrated_ext =
+                        std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != domains.end() &&
+                        std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT) != domains.end() &&
+                        dev.getProcAddr("vkGetCalibratedTimestampsEXT") != nullptr;
+            }
+        }
+#endif
+
+        if (!calibrated_ext) {
+            // Fall back to timing a tiny command buffer that only writes a timestamp. Recorded once, submitted many times.
+            ::vk::CommandPoolCreateInfo pool_ci(::vk::CommandPoolCreateFlags(), queue_fam);
+            ::vk::QueryPoolCreateInfo query_ci(::vk::QueryPoolCreateFlags(), ::vk::QueryType::eTimestamp, 1,
+                                               ::vk::QueryPipelineStatisticFlags());
+            ::vk::FenceCreateInfo fence_ci((::vk::FenceCreateFlags()));
+            if (handle_res(dev.createCommandPool(&pool_ci, nullptr, &calib_pool), HP_GET_CODE_LOC) !=
+                ::vk::Result::eSuccess ||
+                handle_res(dev.createQueryPool(&query_ci, nullptr, &calib_queries), HP_GET_CODE_LOC) !=
+                ::vk::Result::eSuccess ||
+                handle_res(dev.createFence(&fence_ci, nullptr, &calib_fence), HP_GET_CODE_LOC) !=
+                ::vk::Result::eSuccess) {
+                HP_FATAL("Failed to create GPU clock calibration objects! GPU profiling is disabled!");
+                destroy();
+                return;
+            }
+
+            ::vk::CommandBufferAllocateInfo cmd_ai(calib_pool, ::vk::CommandBufferLevel::ePrimary, 1);
+            dev.allocateCommandBuffers(&cmd_ai, &calib_cmd);
+
+            ::vk::CommandBufferBeginInfo cmd_bi(::vk::CommandBufferUsageFlags(), nullptr);
+            calib_cmd.begin(&cmd_bi);
+            calib_cmd.resetQueryPool(calib_queries, 0, 1);
+            calib_cmd.writeTimestamp(::vk::PipelineStageFlagBits::eTopOfPipe, calib_queries, 0);
+            calib_cmd.end();
+        }
+
+        supported = true;
+        clock::calibrate();
+        calibrate();
+        HP_DEBUG("GPU profiling enabled with {} valid timestamp bits, {}ns per tick and {} clock calibration!",
+                 valid_bits, period_ns, calibrated_ext ? "VK_EXT_calibrated_timestamps" : "round trip");
+    }
+
+    void gpu_profiler::destroy() {
+        if (dev == ::vk::Device()) {
+            return;
+        }
+
+        collect_all();
+
+        for (auto pool : pools) {
+            dev.destroyQueryPool(pool, nullptr);
+        }
+        pools.clear();
+        pending.clear();
+        recorded_zones.clear();
+
+        if (calib_queries != ::vk::QueryPool()) {
+            dev.destroyQueryPool(calib_queries, nullptr);
+        }
+        if (calib_fence != ::vk::Fence()) {
+            dev.destroyFence(calib_fence, nullptr);
+        }
+        if (calib_pool != ::vk::CommandPool()) {
+            dev.destroyCommandPool(calib_pool, nullptr);  // Frees `calib_cmd`
+        }
+
+        calib_queries = ::vk::QueryPool();
+        calib_fence = ::vk::Fence();
+        calib_pool = ::vk::CommandPool();
+        calib_cmd = ::vk::CommandBuffer();
+        supported = false;
+        dev = ::vk::Device();
+    }
+
+    void gpu_profiler::calibrate() {
+#ifdef HP_VK_HAS_CALIBRATED_TIMESTAMPS
+        if (calibrated_ext) {
+            auto get_timestamps = (PFN_vkGetCalibratedTimestampsEXT) dev.getProcAddr("vkGetCalibratedTimestampsEXT");
+            VkCalibratedTimestampInfoEXT infos[2] = {
+                    {VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, nullptr, VK_TIME_DOMAIN_DEVICE_EXT},
+                    {VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, nullptr, VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT}};
+            uint64_t stamps[2];
+            uint64_t max_deviation;
+            if (get_timestamps(static_cast<VkDevice>(dev), 2, infos, stamps, &max_deviation) == VK_SUCCESS) {
+                gpu_base = stamps[0] & valid_mask;
+                cpu_base_ns = static_cast<long long>(stamps[1]);
+                last_calibration_ns = steady_ns();
+                return;
+            }
+            HP_WARN("vkGetCalibratedTimestampsEXT() failed! Keeping the previous GPU clock calibration.");
+            last_calibration_ns = steady_ns();
+            return;
+        }
+#endif
+
+        // The timestamp was written somewhere between submitting and the fence wait returning. Take the middle of the
+        // tightest of a few tries. Callers make sure the device is idle, so this doesn't wait for frames in flight.
+        long long best = LLONG_MAX;
+        for (int i = 0; i < 3; i++) {
+            ::vk::SubmitInfo calib_si(0, nullptr, nullptr, 1, &calib_cmd, 0, nullptr);
+            long long before = steady_ns();
+            if (handle_res(queue.submit(1, &calib_si, calib_fence), HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
+                break;
+            }
+            dev.waitForFences(1, &calib_fence, ::vk::Bool32(VK_TRUE), UINT64_MAX);
+            long long after = steady_ns();
+            dev.resetFences(1, &calib_fence);
+
+            uint64_t stamp;
+            if (dev.getQueryPoolResults(calib_queries, 0, 1, sizeof(stamp), &stamp, sizeof(stamp),
+                                        ::vk::QueryResultFlagBits::e64) != ::vk::Result::eSuccess) {
+                continue;
+            }
+
+            if (after - before < best) {
+                best = after - before;
+                gpu_base = stamp & valid_mask;
+                cpu_base_ns = before + (after - before) / 2;
+            }
+        }
+        last_calibration_ns = steady_ns();
+    }
+
+    long long gpu_profiler::to_cpu_ns(uint64_t gpu_ticks) const {
+        // Timestamps may have fewer than 64 valid bits, so deltas wrap around at `valid_mask`.
+        uint64_t delta = (gpu_ticks - gpu_base) & valid_mask;
+        auto signed_delta = delta > (valid_mask >> 1u) ? static_cast<long long>(delta - valid_mask - 1)
+                                                       : static_cast<long long>(delta);
+        return cpu_base_ns + std::llround(static_cast<double>(signed_delta) * period_ns);
+    }
+
+    uint32_t gpu_profiler::begin_zone(const zone_desc *zone) {
+        if (!supported) {
+            return UINT32_MAX;
+        }
+
+        if (zones.size() >= max_zones) {
+            HP_WARN("More than {} GPU zones recorded! Ignoring GPU zone \"{}\"!", max_zones, zone->name);
+            open_zones.emplace_back(UINT32_MAX);
+            return UINT32_MAX;
+        }
+
+        auto slot = static_cast<uint32_t>(zones.size());
+        zones.emplace_back(zone);
+        open_zones.emplace_back(slot);
+        return slot * 2;
+    }
+
+    uint32_t gpu_profiler::end_zone() {
+        if (!supported) {
+            return UINT32_MAX;
+        }
+
+        if (open_zones.empty()) {
+            HP_WARN("rec_gpu_zone_end() called without a matching rec_gpu_zone_begin()! Ignoring invocation!");
+            return UINT32_MAX;
+        }
+
+        uint32_t slot = open_zones.back();
+        open_zones.pop_back();
+        return slot == UINT32_MAX ? UINT32_MAX : slot * 2 + 1;
+    }
+
+    void gpu_profiler::clear_zones() {
+        if (!supported) {
+            return;
+        }
+
+        zones.resize(1);  // Keep the render pass
+        open_zones.clear();
+    }
+
+    const zone_desc *gpu_profiler::named_zone(const char *name) {
+        auto it = names.find(name);
+        if (it == names.end()) {
+            it = names.emplace(name, register_zone(name, "gpu")).first;
+        }
+        return it->second;
+    }
+
+    void gpu_profiler::prepare(size_t n_images) {
+        if (!supported) {
+            return;
+        }
+
+        collect_all();  // Results of the old command buffers refer to the old zones.
+        for (auto &frame : pending) {
+            frame.active = false;  // The device is idle, so whatever isn't available now never will be.
+        }
+        if (!calibrated_ext) {
+            calibrate();  // The round trip waits for a submission, which is only free while nothing else runs.
+        }
+
+        ::vk::QueryPoolCreateInfo query_ci(::vk::QueryPoolCreateFlags(), ::vk::QueryType::eTimestamp, max_zones * 2,
+                                           ::vk::QueryPipelineStatisticFlags());
+        while (pools.size() < n_images) {
+            ::vk::QueryPool pool;
+            if (handle_res(dev.createQueryPool(&query_ci, nullptr, &pool), HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
+                HP_FATAL("Failed to create timestamp query pool! GPU profiling is disabled!");
+                destroy();
+                return;
+            }
+            pools.emplace_back(pool);
+            pending.emplace_back();
+        }
+
+        recorded_zones.assign(pools.size(), zones);
+        if (!open_zones.empty()) {
+            HP_WARN("{} GPU zones weren't ended with rec_gpu_zone_end()! They will end with the render pass.",
+                    open_zones.size());
+        }
+    }
+
+    void gpu_profiler::prepare_image(uint32_t img) {
+        if (!supported || img >= recorded_zones.size()) {
+            return;
+        }
+
+        pending[img].active = false;  // Whatever wasn't collected is overwritten by the new recording.
+        recorded_zones[img] = zones;
+        if (!open_zones.empty()) {
+            HP_WARN("{} GPU zones weren't ended with rec_gpu_zone_end()! They will end with the render pass.",
+                    open_zones.size());
+        }
+    }
+
+    void gpu_profiler::begin_commands(::vk::CommandBuffer cmd, uint32_t img) {
+        if (!supported) {
+            return;
+        }
+
+        rec_img = img;
+        cmd.resetQueryPool(pools[img], 0, static_cast<uint32_t>(recorded_zones[img].size() * 2));
+        write_timestamp(cmd, 0, ::vk::PipelineStageFlagBits::eTopOfPipe);
+    }
+
+    void gpu_profiler::write_timestamp(::vk::CommandBuffer cmd, uint32_t query, ::vk::PipelineStageFlagBits stage) {
+        if (!supported || rec_img >= pools.size() || query >= recorded_zones[rec_img].size() * 2) {
+            return;
+        }
+
+        cmd.writeTimestamp(stage, pools[rec_img], query);
+    }
+
+    void gpu_profiler::close_zones(::vk::CommandBuffer cmd) {
+        for (auto it = open_zones.rbegin(); it != open_zones.rend(); it++) {
+            if (*it != UINT32_MAX) {
+                write_timestamp(cmd, *it * 2 + 1, ::vk::PipelineStageFlagBits::eBottomOfPipe);
+            }
+        }
+    }
+
+    void gpu_profiler::end_commands(::vk::CommandBuffer cmd) {
+        write_timestamp(cmd, 1, ::vk::PipelineStageFlagBits::eBottomOfPipe);
+    }
+
+    void gpu_profiler::submitted(size_t flight_slot, uint32_t img) {
+        if (!supported || img >= pending.size()) {
+            return;
+        }
+
+        pending[img].active = true;
+        pending[img].frame = profiler_session::current_frame();
+        flight_imgs[flight_slot] = img;
+    }
+
+    void gpu_profiler::frame_done(size_t flight_slot) {
+        if (!supported || flight_slot >= flight_imgs.size() || flight_imgs[flight_slot] == UINT32_MAX) {
+            return;
+        }
+
+        collect(flight_imgs[flight_slot]);
+    }
+
+    void gpu_profiler::collect(uint32_t img) {
+        if (!supported || img >= pending.size() || !pending[img].active) {
+            return;
+        }
+
+        auto n_queries = static_cast<uint32_t>(recorded_zones[img].size() * 2);
+        results.resize(n_queries);
+        ::vk::Result res = dev.getQueryPoolResults(pools[img], 0, n_queries, n_queries * sizeof(uint64_t),
+                                                   results.data(), sizeof(uint64_t), ::vk::QueryResultFlagBits::e64);
+        if (res == ::vk::Result::eNotReady) {
+            return;  // Never blocks; Try again after the next fence.
+        }
+
+        pending[img].active = false;
+        if (handle_res(res, HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
+            return;
+        }
+
+        profiler_session *session = profiler_session::default_session;
+        if (session == nullptr) {
+            return;
+        }
+
+        if (session != track_session) {
+            track = session->new_track("GPU");
+            track_session = session;
+        }
+
+        if (calibrated_ext &&
+            steady_ns() - last_calibration_ns >= std::chrono::nanoseconds(calibration_interval).count()) {
+            calibrate();  // Doesn't block, unlike the round trip `prepare()` measures.
+        }
+
+        for (size_t i = 0; i < recorded_zones[img].size(); i++) {
+            long long start = to_cpu_ns(results[i * 2]);
+            long long end = to_cpu_ns(results[i * 2 + 1]);
+            if (end < start) {
+                continue;
+            }
+
+            session->record_track(track, profile_result{recorded_zones[img][i]->id, pending[img].frame,
+                                                        clock::from_ns(start), clock::from_ns(end)});
+        }
+    }
+
+    void gpu_profiler::collect_all() {
+        for (uint32_t img = 0; img < pending.size(); img++) {
+            collect(img);
+        }
+    }
+}
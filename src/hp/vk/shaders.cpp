@@ -301,7 +301,7 @@ namespace hp::vk {
 
         HP_FATAL("About to create pipeline!");
         if (handle_res(
-                parent->log_dev.createGraphicsPipelines(::vk::PipelineCache(), 1, &pipeline_ci, nullptr, &pipeline),
+                parent->log_dev.createGraphicsPipelines(parent->pipeline_cache, 1, &pipeline_ci, nullptr, &pipeline),
                 HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
             HP_FATAL("Failed to create pipeline!");
         }
@@ -2,29 +2,39 @@
 // Created by 25granty on 11/18/19.
 //
 
+#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <hp/vk/window.hpp>
+#include <hp/parallel.hpp>
 
 #include "window_accessories.cpp"
-#include "boost/bind.hpp"
 #include "vk_mem_alloc.h"
+#include "stb/stb_image_write.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 
 namespace hp::vk {
-    hp::vk::window::window(int width, int height, const char *app_name, uint32_t version) {
-        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);  // Don't automatically create an OpenGL context
+    hp::vk::window::window(int width, int height, const char *app_name, uint32_t version, bool headless) {
+        this->headless = headless;
 
         // "VK_LAYER_LUNARG_api_dump",
         const std::vector<const char *> &req_layer = {"VK_LAYER_KHRONOS_validation",
                                                       "VK_LAYER_LUNARG_standard_validation"};
-        const std::vector<const char *> &req_dev_ext = {VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-                                                        "VK_KHR_get_memory_requirements2"};
+        std::vector<const char *> req_dev_ext = {"VK_KHR_get_memory_requirements2"};
         std::vector<const char *> req_ext = {};
 
         bool only_use_requested = true;
 
-        win = glfwCreateWindow(width, height, app_name, nullptr, nullptr);
-        glfwSetWindowUserPointer(win, this);
-        glfwSetFramebufferSizeCallback(win, on_resize_event);
-        glfwSetWindowIconifyCallback(win, on_iconify_event);
+        if (!headless) {
+            req_dev_ext.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+            glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);  // Don't automatically create an OpenGL context
+            win = glfwCreateWindow(width, height, app_name, nullptr, nullptr);
+            glfwSetWindowUserPointer(win, this);
+            glfwSetFramebufferSizeCallback(win, on_resize_event);
+            glfwSetWindowIconifyCallback(win, on_iconify_event);
+        }
 
         uses_validation_layers = hp::vk::validation_layers_enabled;
 
@@ -39,9 +49,9 @@ namespace hp::vk {
             uses_validation_layers = false;
         }
 
-        // Query required extensions
+        // Query required extensions. Headless windows have no surface, so they don't need any.
         uint32_t require_ext_count = 0;
-        const char **require_ext_arr = glfwGetRequiredInstanceExtensions(&require_ext_count);
+        const char **require_ext_arr = headless ? nullptr : glfwGetRequiredInstanceExtensions(&require_ext_count);
 
         std::vector<const char *> support_req_ext(require_ext_arr, require_ext_arr + require_ext_count);
 
@@ -136,15 +146,17 @@ namespace hp::vk {
             HP_DEBUG("Successfully created debug messenger!");
         }
 
-        auto vanilla_surf = (VkSurfaceKHR) surf;
+        if (!headless) {
+            auto vanilla_surf = (VkSurfaceKHR) surf;
 
-        if (handle_res(::vk::Result(glfwCreateWindowSurface((VkInstance) inst, win, nullptr, &vanilla_surf)),
-                       HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
-            HP_FATAL("Failed to create window surface!");
-        } else {
-            HP_DEBUG("Constructed window surface");
+            if (handle_res(::vk::Result(glfwCreateWindowSurface((VkInstance) inst, win, nullptr, &vanilla_surf)),
+                           HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
+                HP_FATAL("Failed to create window surface!");
+            } else {
+                HP_DEBUG("Constructed window surface");
+            }
+            surf = ::vk::SurfaceKHR(vanilla_surf);
         }
-        surf = ::vk::SurfaceKHR(vanilla_surf);
 
         devices = std::multimap<float, ::vk::PhysicalDevice>();
         std::vector<::vk::PhysicalDevice> devs = inst.enumeratePhysicalDevices();
@@ -156,7 +168,7 @@ namespace hp::vk {
         for (::vk::PhysicalDevice device : devs) {
             ::vk::PhysicalDeviceProperties props = device.getProperties();
             ::vk::PhysicalDeviceFeatures features = device.getFeatures();
-            auto swap_supp = get_swap_chain_support(&device, surf);
+            auto swap_supp = headless ? swap_chain_support{} : get_swap_chain_support(&device, surf);
             auto dev_qfam_indx = build_queue_fam_indices(&device, surf);
 
             phys_dev_ext = device.enumerateDeviceExtensionProperties();
@@ -169,7 +181,8 @@ namespace hp::vk {
             HP_DEBUG("Checking support of physical device '{}' with api {} and driver {}...", props.deviceName,
                      props.apiVersion, props.driverVersion);
 
-            float n = req_dev_ext.size() + 4;  // Should we use floats? Data COULD (but most likely WONT) be lost.
+            // Should we use floats? Data COULD (but most likely WONT) be lost.
+            float n = req_dev_ext.size() + (headless ? 2 : 4);  // Headless skips the formats and present modes.
 
             float score = -1000.0f;
             if (features.geometryShader) { // Required features.
@@ -178,16 +191,18 @@ namespace hp::vk {
                 HP_FATAL("Device {} doesn't support geometry shaders!", props.deviceName);
             }
 
-            if (!swap_supp.formats.empty()) {
-                score += 1000.0f / n;
-            } else {
-                HP_FATAL("Device {} doesn't support any formats!", props.deviceName);
-            }
+            if (!headless) {  // No surface to check formats and present modes against otherwise.
+                if (!swap_supp.formats.empty()) {
+                    score += 1000.0f / n;
+                } else {
+                    HP_FATAL("Device {} doesn't support any formats!", props.deviceName);
+                }
 
-            if (!swap_supp.present_modes.empty()) {
-                score += 1000.0f / n;
-            } else {
-                HP_FATAL("Device {} doesn't support any presentation modes!", props.deviceName);
+                if (!swap_supp.present_modes.empty()) {
+                    score += 1000.0f / n;
+                } else {
+                    HP_FATAL("Device {} doesn't support any presentation modes!", props.deviceName);
+                }
             }
 
             if (dev_qfam_indx.is_complete()) {
@@ -238,6 +253,14 @@ namespace hp::vk {
             }
         }
 
+        bool has_calibrated_ts = false;  // Optional; Only lines GPU profiler zones up with CPU zones more precisely.
+#ifdef VK_EXT_calibrated_timestamps
+        if (dev_ext_supported(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)) {
+            support_req_dev_ext.emplace_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+            has_calibrated_ts = true;
+        }
+#endif
+
         HP_DEBUG("Selected physical device '{}'", phys_dev->getProperties().deviceName);
 
         float queue_priority = 1.0f;  // We are using only a single queue so assign max priority.
@@ -298,8 +321,17 @@ namespace hp::vk {
         allocator_ci.vulkanApiVersion = VK_API_VERSION_1_1;
         vmaCreateAllocator(&allocator_ci, &allocator);
 
+        gpu_prof.init(inst, *phys_dev, log_dev, queue_fam_indices.graphics_fam.value(), graphics_queue,
+                      has_calibrated_ts);
+
+        create_pipeline_cache();
+
         swap_chain = ::vk::SwapchainKHR();
-        create_swapchain(false);
+        if (headless) {
+            create_offscreen_targets(::vk::Extent2D(static_cast<uint32_t>(width), static_cast<uint32_t>(height)));
+        } else {
+            create_swapchain(false);
+        }
 
         ::vk::SemaphoreCreateInfo sm_ci((::vk::SemaphoreCreateFlags()));
         ::vk::FenceCreateInfo fence_ci(::vk::FenceCreateFlagBits::eSignaled);
@@ -330,6 +362,8 @@ namespace hp::vk {
     hp::vk::window::~window() {
         log_dev.waitIdle(); // Wait for operations to finish
 
+        gpu_prof.destroy();
+
         for (size_t i = 0; i < max_frames_in_flight; i++) {
             log_dev.destroySemaphore(img_avail_sms.at(i), nullptr);
             log_dev.destroySemaphore(rend_fin_sms.at(i), nullptr);
@@ -341,6 +375,11 @@ namespace hp::vk {
         }
 
         log_dev.destroyCommandPool(cmd_pool, nullptr);
+        for (auto &pools : draw_pools) {
+            for (auto pool : pools) {
+                log_dev.destroyCommandPool(pool, nullptr);
+            }
+        }
 
         for (auto fb : framebuffers) {
             log_dev.destroyFramebuffer(fb, nullptr);
@@ -356,12 +395,25 @@ namespace hp::vk {
             log_dev.destroyImageView(img, nullptr);
         }
 
-        log_dev.destroySwapchainKHR(swap_chain, nullptr);
+        if (headless) {
+            for (size_t i = 0; i < offscreen_allocs.size(); i++) {
+                vmaDestroyImage(allocator, static_cast<VkImage>(swap_imgs[i]), offscreen_allocs[i]);
+            }
+            if (offscreen_bytes > 0) {
+                HP_TRACK_FREE("window offscreen images (VMA)", "device", offscreen_bytes);
+            }
+        } else {
+            log_dev.destroySwapchainKHR(swap_chain, nullptr);
+        }
 
         for (auto buf : child_bufs) {
+            HP_TRACK_FREE("window::new_buffer", "heap", sizeof(generic_buffer));
             delete buf;
         }
 
+        save_pipeline_cache();
+        log_dev.destroyPipelineCache(pipeline_cache, nullptr);
+
         vmaDestroyAllocator(allocator);
 
         log_dev.destroy();
@@ -370,9 +422,13 @@ namespace hp::vk {
             destroyDebugUtilsMessengerEXT(debug_msgr, nullptr);
         }
 
-        inst.destroySurfaceKHR(surf, nullptr);
+        if (!headless) {
+            inst.destroySurfaceKHR(surf, nullptr);
+        }
         inst.destroy();
-        glfwDestroyWindow(win);
+        if (!headless) {
+            glfwDestroyWindow(win);
+        }
     }
 
     void window::create_swapchain(bool do_destroy) {
@@ -485,36 +541,7 @@ namespace hp::vk {
 
 
         if (!do_destroy || new_fmt != swap_fmt) {
-            // Render pass stuff
-            ::vk::AttachmentDescription color_attach(::vk::AttachmentDescriptionFlags(), new_fmt.format,
-                                                     ::vk::SampleCountFlagBits::e1,
-                                                     ::vk::AttachmentLoadOp::eClear, ::vk::AttachmentStoreOp::eStore,
-                                                     ::vk::AttachmentLoadOp::eDontCare,
-                                                     ::vk::AttachmentStoreOp::eDontCare, ::vk::ImageLayout::eUndefined,
-                                                     ::vk::ImageLayout::ePresentSrcKHR);
-
-            ::vk::AttachmentReference color_attach_ref(0, ::vk::ImageLayout::eColorAttachmentOptimal);
-
-            ::vk::SubpassDescription subpass(::vk::SubpassDescriptionFlags(), ::vk::PipelineBindPoint::eGraphics, 0,
-                                             nullptr,
-                                             1, &color_attach_ref, nullptr, nullptr, 0, nullptr);
-
-            ::vk::SubpassDependency subpass_dep(VK_SUBPASS_EXTERNAL, 0,
-                                                ::vk::PipelineStageFlagBits::eColorAttachmentOutput,
-                                                ::vk::PipelineStageFlagBits::eColorAttachmentOutput,
-                                                ::vk::AccessFlags(),
-                                                ::vk::AccessFlagBits::eColorAttachmentRead |
-                                                ::vk::AccessFlagBits::eColorAttachmentWrite, ::vk::DependencyFlags());
-
-            ::vk::RenderPassCreateInfo rend_pass_ci(::vk::RenderPassCreateFlags(), 1, &color_attach, 1, &subpass, 1,
-                                                    &subpass_dep);
-
-            if (handle_res(log_dev.createRenderPass(&rend_pass_ci, nullptr, &new_pass), HP_GET_CODE_LOC) !=
-                ::vk::Result::eSuccess) {
-                HP_FATAL("Failed to create render pass! Aborting!");
-                std::terminate();
-            }
-            HP_DEBUG("Render pass constructed successfully!");
+            new_pass = create_render_pass(new_fmt.format, ::vk::ImageLayout::ePresentSrcKHR);
         }
 
         // Framebuffers
@@ -608,14 +635,182 @@ namespace hp::vk {
         framebuffers = std::move(new_bufs);
     }
 
+    ::vk::RenderPass window::create_render_pass(::vk::Format fmt, ::vk::ImageLayout final_layout) {
+        ::vk::RenderPass ret;
+        ::vk::AttachmentDescription color_attach(::vk::AttachmentDescriptionFlags(), fmt,
+                                                 ::vk::SampleCountFlagBits::e1,
+                                                 ::vk::AttachmentLoadOp::eClear, ::vk::AttachmentStoreOp::eStore,
+                                                 ::vk::AttachmentLoadOp::eDontCare,
+                                                 ::vk::AttachmentStoreOp::eDontCare, ::vk::ImageLayout::eUndefined,
+                                                 final_layout);
+
+        ::vk::AttachmentReference color_attach_ref(0, ::vk::ImageLayout::eColorAttachmentOptimal);
+
+        ::vk::SubpassDescription subpass(::vk::SubpassDescriptionFlags(), ::vk::PipelineBindPoint::eGraphics, 0,
+                                         nullptr,
+                                         1, &color_attach_ref, nullptr, nullptr, 0, nullptr);
+
+        ::vk::SubpassDependency subpass_deps[2] = {
+                ::vk::SubpassDependency(VK_SUBPASS_EXTERNAL, 0,
+                                        ::vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                        ::vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                        ::vk::AccessFlags(),
+                                        ::vk::AccessFlagBits::eColorAttachmentRead |
+                                        ::vk::AccessFlagBits::eColorAttachmentWrite, ::vk::DependencyFlags()),
+                // Headless frames are copied out by `read_frame()`. The implicit dependency to `VK_SUBPASS_EXTERNAL`
+                // has an empty destination, so the transfer has to be chained to the attachment writes explicitly.
+                ::vk::SubpassDependency(0, VK_SUBPASS_EXTERNAL,
+                                        ::vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                                        ::vk::PipelineStageFlagBits::eTransfer,
+                                        ::vk::AccessFlagBits::eColorAttachmentWrite,
+                                        ::vk::AccessFlagBits::eTransferRead, ::vk::DependencyFlags())};
+        const uint32_t num_deps = final_layout == ::vk::ImageLayout::eTransferSrcOptimal ? 2 : 1;
+
+        ::vk::RenderPassCreateInfo rend_pass_ci(::vk::RenderPassCreateFlags(), 1, &color_attach, 1, &subpass,
+                                                num_deps, subpass_deps);
+
+        if (handle_res(log_dev.createRenderPass(&rend_pass_ci, nullptr, &ret), HP_GET_CODE_LOC) !=
+            ::vk::Result::eSuccess) {
+            HP_FATAL("Failed to create render pass! Aborting!");
+            std::terminate();
+        }
+        HP_DEBUG("Render pass constructed successfully!");
+        return ret;
+    }
+
+    void window::create_offscreen_targets(::vk::Extent2D extent) {
+        swap_extent = extent;
+        swap_fmt = ::vk::SurfaceFormatKHR(::vk::Format::eR8G8B8A8Unorm, ::vk::ColorSpaceKHR::eSrgbNonlinear);
+        HP_DEBUG("Rendering headless into {} offscreen images of {}x{}", max_frames_in_flight, extent.width,
+                 extent.height);
+
+        VkImageCreateInfo img_ci = {};
+        img_ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        img_ci.imageType = VK_IMAGE_TYPE_2D;
+        img_ci.format = static_cast<VkFormat>(swap_fmt.format);
+        img_ci.extent = {extent.width, extent.height, 1};
+        img_ci.mipLevels = 1;
+        img_ci.arrayLayers = 1;
+        img_ci.samples = VK_SAMPLE_COUNT_1_BIT;
+        img_ci.tiling = VK_IMAGE_TILING_OPTIMAL;
+        img_ci.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        img_ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        img_ci.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VmaAllocationCreateInfo alloc_ci = {};
+        alloc_ci.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+        // As many images as frames in flight, so a frame's fence also guards its image.
+        swap_imgs.resize(max_frames_in_flight);
+        offscreen_allocs.resize(max_frames_in_flight);
+        swap_views.resize(max_frames_in_flight);
+        for (size_t i = 0; i < max_frames_in_flight; i++) {
+            VkImage vanilla_img;
+            VmaAllocationInfo alloc_info = {};
+            if (handle_res(::vk::Result(vmaCreateImage(allocator, &img_ci, &alloc_ci, &vanilla_img,
+                                                       &offscreen_allocs[i], &alloc_info)), HP_GET_CODE_LOC) !=
+                ::vk::Result::eSuccess) {
+                HP_FATAL("Failed to create offscreen image! Aborting!");
+                std::terminate();
+            }
+            swap_imgs[i] = ::vk::Image(vanilla_img);
+            offscreen_bytes += alloc_info.size;
+
+            ::vk::ImageViewCreateInfo view_ci(::vk::ImageViewCreateFlags(), swap_imgs[i], ::vk::ImageViewType::e2D,
+                                              swap_fmt.format,
+                                              {::vk::ComponentSwizzle::eIdentity, ::vk::ComponentSwizzle::eIdentity,
+                                               ::vk::ComponentSwizzle::eIdentity, ::vk::ComponentSwizzle::eIdentity},
+                                              {::vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1});
+
+            if (handle_res(log_dev.createImageView(&view_ci, nullptr, &swap_views[i]), HP_GET_CODE_LOC) !=
+                ::vk::Result::eSuccess) {
+                HP_FATAL("Failed to create image view!");
+            }
+        }
+        HP_TRACK_ALLOC("window offscreen images (VMA)", "device", offscreen_bytes);
+
+        // Frames are left ready to be copied out by `read_frame()`, instead of to be presented.
+        render_pass = create_render_pass(swap_fmt.format, ::vk::ImageLayout::eTransferSrcOptimal);
+
+        framebuffers.resize(swap_views.size());
+        for (size_t i = 0; i < swap_views.size(); i++) {
+            ::vk::FramebufferCreateInfo framebuf_ci(::vk::FramebufferCreateFlags(), render_pass, 1, &swap_views[i],
+                                                    extent.width, extent.height, 1);
+
+            if (handle_res(log_dev.createFramebuffer(&framebuf_ci, nullptr, &framebuffers[i]), HP_GET_CODE_LOC) !=
+                ::vk::Result::eSuccess) {
+                HP_FATAL("Failed to create framebuffer!");
+                std::terminate();
+            }
+        }
+
+        ::vk::CommandPoolCreateInfo pool_ci(
+                ::vk::CommandPoolCreateFlagBits::eResetCommandBuffer | ::vk::CommandPoolCreateFlagBits::eTransient,
+                queue_fam_indices.graphics_fam.value());
+        if (handle_res(log_dev.createCommandPool(&pool_ci, nullptr, &cmd_pool), HP_GET_CODE_LOC) !=
+            ::vk::Result::eSuccess) {
+            HP_FATAL("Failed to create command pool!");
+            std::terminate();
+        }
+
+        img_fences.resize(swap_imgs.size(), ::vk::Fence());
+        cmd_bufs.resize(framebuffers.size());
+        ::vk::CommandBufferAllocateInfo cmd_buf_ai(cmd_pool, ::vk::CommandBufferLevel::ePrimary, cmd_bufs.size());
+        if (handle_res(log_dev.allocateCommandBuffers(&cmd_buf_ai, cmd_bufs.data()), HP_GET_CODE_LOC) !=
+            ::vk::Result::eSuccess) {
+            HP_FATAL("Failed to allocated command buffers!");
+            std::terminate();
+        }
+
+        std::lock_guard<std::recursive_mutex> lg(render_mtx);
+        record_cmd_bufs(&framebuffers, &render_pass, &swap_extent);
+    }
+
     void window::draw_frame() {
         std::lock_guard<std::recursive_mutex> lg(render_mtx);
+        HP_PROFILE_FRAME;
 
-        log_dev.waitForFences(1, &flight_fences[current_frame], ::vk::Bool32(VK_TRUE), UINT64_MAX);
+        {
+            HP_PROFILE_SCOPE_EX("Fence Wait", "frame", 0);
+            log_dev.waitForFences(1, &flight_fences[current_frame], ::vk::Bool32(VK_TRUE), UINT64_MAX);
+            gpu_prof.frame_done(current_frame);
+        }
+        if (dynamic_recording) {
+            reset_draw_pools(current_frame);  // Everything recorded into them the last time has executed.
+        }
 
         uint32_t img_indx;
-        ::vk::Result res = log_dev.acquireNextImageKHR(swap_chain, UINT64_MAX, img_avail_sms[current_frame],
-                                                       ::vk::Fence(), &img_indx);
+        ::vk::Result res;
+        if (headless) {  // Nothing to acquire or present; Each frame in flight renders into its own image.
+            img_indx = static_cast<uint32_t>(current_frame);
+            {
+                HP_PROFILE_SCOPE_EX("Submit", "frame", 0);
+                img_fences[img_indx] = flight_fences[current_frame];
+
+                gpu_prof.collect(img_indx);
+                ::vk::CommandBuffer cmd_buf = frame_cmd_buf(img_indx);
+
+                ::vk::SubmitInfo cmd_buf_si(0, nullptr, nullptr, 1, &cmd_buf, 0, nullptr);
+
+                log_dev.resetFences(1, &flight_fences[current_frame]);
+                if (handle_res(graphics_queue.submit(1, &cmd_buf_si, flight_fences[current_frame]),
+                               HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
+                    HP_FATAL("Failed to submit draw commands! Skipping frame!");
+                    return;
+                }
+                gpu_prof.submitted(current_frame, img_indx);
+            }
+
+            last_img = img_indx;
+            current_frame = (current_frame + 1) % max_frames_in_flight;
+            return;
+        }
+
+        {
+            HP_PROFILE_SCOPE_EX("Acquire Image", "frame", 0);
+            res = log_dev.acquireNextImageKHR(swap_chain, UINT64_MAX, img_avail_sms[current_frame], ::vk::Fence(),
+                                              &img_indx);
+        }
         if (res == ::vk::Result::eErrorOutOfDateKHR || res == ::vk::Result::eSuboptimalKHR) {
             HP_INFO("Recreating swapchain from image querying!");
             recreate_swapchain();
@@ -625,26 +820,37 @@ namespace hp::vk {
             return;
         }
 
-        // Check if a previous frame is using this image (i.e. there is its fence to wait on)
-        if (img_fences[img_indx] != ::vk::Fence()) {
-            log_dev.waitForFences(1, &img_fences[img_indx], VK_TRUE, UINT64_MAX);
-        }
-        // Mark the image as now being in use by this frame
-        img_fences[img_indx] = flight_fences[current_frame];
+        {
+            HP_PROFILE_SCOPE_EX("Submit", "frame", 0);
+            // Check if a previous frame is using this image (i.e. there is its fence to wait on)
+            if (img_fences[img_indx] != ::vk::Fence()) {
+                log_dev.waitForFences(1, &img_fences[img_indx], VK_TRUE, UINT64_MAX);
+            }
+            // Mark the image as now being in use by this frame
+            img_fences[img_indx] = flight_fences[current_frame];
 
-        ::vk::PipelineStageFlags wait_stage = ::vk::PipelineStageFlagBits::eColorAttachmentOutput;
-        ::vk::SubmitInfo cmd_buf_si(1, &img_avail_sms[current_frame], &wait_stage, 1,
-                                    &cmd_bufs[img_indx], 1, &rend_fin_sms[current_frame]);
+            gpu_prof.collect(img_indx);  // The image's previous submission finished, so its queries can be reused.
+            ::vk::CommandBuffer cmd_buf = frame_cmd_buf(img_indx);
 
-        log_dev.resetFences(1, &flight_fences[current_frame]);
-        if (handle_res(graphics_queue.submit(1, &cmd_buf_si, flight_fences[current_frame]), HP_GET_CODE_LOC) !=
-            ::vk::Result::eSuccess) {
-            HP_FATAL("Failed to submit draw commands! Skipping frame!");
-            return;
+            ::vk::PipelineStageFlags wait_stage = ::vk::PipelineStageFlagBits::eColorAttachmentOutput;
+            ::vk::SubmitInfo cmd_buf_si(1, &img_avail_sms[current_frame], &wait_stage, 1,
+                                        &cmd_buf, 1, &rend_fin_sms[current_frame]);
+
+            log_dev.resetFences(1, &flight_fences[current_frame]);
+            if (handle_res(graphics_queue.submit(1, &cmd_buf_si, flight_fences[current_frame]), HP_GET_CODE_LOC) !=
+                ::vk::Result::eSuccess) {
+                HP_FATAL("Failed to submit draw commands! Skipping frame!");
+                return;
+            }
+            gpu_prof.submitted(current_frame, img_indx);
         }
 
-        ::vk::PresentInfoKHR frame_pi(1, &rend_fin_sms[current_frame], 1, &swap_chain, &img_indx, nullptr);
-        ::vk::Result pres_res = present_queue.presentKHR(&frame_pi);
+        ::vk::Result pres_res;
+        {
+            HP_PROFILE_SCOPE_EX("Present", "frame", 0);
+            ::vk::PresentInfoKHR frame_pi(1, &rend_fin_sms[current_frame], 1, &swap_chain, &img_indx, nullptr);
+            pres_res = present_queue.presentKHR(&frame_pi);
+        }
         if (pres_res == ::vk::Result::eErrorOutOfDateKHR || pres_res == ::vk::Result::eSuboptimalKHR ||
             swapchain_recreate_event) {
             swapchain_recreate_event = false;
@@ -660,36 +866,303 @@ namespace hp::vk {
 
     void window::record_cmd_bufs(std::vector<::vk::Framebuffer> *frame_bufs,
                                  ::vk::RenderPass *rend_pass, ::vk::Extent2D *extent) {
+        gpu_prof.prepare(cmd_bufs.size());
+        if (dynamic_recording) {
+            return;  // `draw_frame()` records every frame itself.
+        }
+
+        // Pool set 0 is free to reset; Callers wait for the device to be idle first.
+        reset_draw_pools(0);
+        std::vector<::vk::CommandBuffer> list_bufs;
+        if (!draw_lists.empty()) {
+            list_bufs = record_draw_lists(frame_bufs->data(), frame_bufs->size(), *rend_pass, 0);
+        }
+
         for (size_t i = 0; i < cmd_bufs.size(); i++) {
-            ::vk::CommandBufferBeginInfo cmd_buf_bi(::vk::CommandBufferUsageFlags(), nullptr);
+            record_primary(cmd_bufs[i], static_cast<uint32_t>(i), (*frame_bufs)[i], *rend_pass, *extent,
+                           list_bufs.data() + i * draw_lists.size(), 0, ::vk::CommandBufferUsageFlags());
+        }
+    }
 
-            if (handle_res(cmd_bufs[i].begin(&cmd_buf_bi), HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
-                HP_FATAL("Failed to begin command buffer recording!");
-                std::terminate();
+    void window::record_primary(::vk::CommandBuffer cmd, uint32_t img, ::vk::Framebuffer frame_buf,
+                                ::vk::RenderPass rend_pass, ::vk::Extent2D extent,
+                                const ::vk::CommandBuffer *list_bufs, size_t pool_set,
+                                ::vk::CommandBufferUsageFlags usage) {
+        ::vk::CommandBufferBeginInfo cmd_buf_bi(usage, nullptr);
+
+        if (handle_res(cmd.begin(&cmd_buf_bi), HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
+            HP_FATAL("Failed to begin command buffer recording!");
+            std::terminate();
+        }
+
+        ::vk::ClearValue clear_col(::vk::ClearColorValue(std::array<float, 4>({0.0f, 0.0f, 0.0f, 1.0f})));
+
+        ::vk::RenderPassBeginInfo rend_pass_bi(rend_pass, frame_buf, ::vk::Rect2D(::vk::Offset2D(0, 0), extent), 1,
+                                               &clear_col);
+
+        gpu_prof.begin_commands(cmd, img);
+        if (!draw_lists.empty()) {
+            // With draw lists, the render pass can only execute secondary command buffers, so this window's own
+            // commands go into one of those too, executed first. Recorded here, as GPU zones are written to the
+            // query pool `begin_commands()` just picked.
+            std::vector<::vk::CommandBuffer> exec_bufs;
+            {
+                std::lock_guard<std::mutex> pool_lg(shared_draw_pool_mtx);  // See `thread_draw_pool()`.
+                exec_bufs.emplace_back(begin_secondary(rend_pass, frame_buf, pool_set));
+                commands.stream.replay(exec_bufs[0], gpu_prof);
+                gpu_prof.close_zones(exec_bufs[0]);
+                exec_bufs[0].end();
             }
 
-            ::vk::ClearValue clear_col(::vk::ClearColorValue(std::array<float, 4>({0.0f, 0.0f, 0.0f, 1.0f})));
+            exec_bufs.insert(exec_bufs.end(), list_bufs, list_bufs + draw_lists.size());
 
-            ::vk::RenderPassBeginInfo rend_pass_bi(*rend_pass, (*frame_bufs)[i],
-                                                   ::vk::Rect2D(::vk::Offset2D(0, 0), *extent), 1,
-                                                   &clear_col);
+            cmd.beginRenderPass(&rend_pass_bi, ::vk::SubpassContents::eSecondaryCommandBuffers);
+            cmd.executeCommands(static_cast<uint32_t>(exec_bufs.size()), exec_bufs.data());
+        } else {
+            cmd.beginRenderPass(&rend_pass_bi, ::vk::SubpassContents::eInline);
+            commands.stream.replay(cmd, gpu_prof);
+            gpu_prof.close_zones(cmd);
+        }
+        cmd.endRenderPass();
+        gpu_prof.end_commands(cmd);
 
-            cmd_bufs[i].beginRenderPass(&rend_pass_bi, ::vk::SubpassContents::eInline);
+#ifdef VULKAN_HPP_DISABLE_ENHANCED_MODE
+        if (handle_res(cmd.end(), HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
+            HP_FATAL("Failed to end command buffer recording!");
+            std::terminate();
+        }
+#else
+        cmd.end();  // Enhanced mode does exception handling for us. :)
+#endif
+    }
+
+    ::vk::CommandBuffer window::frame_cmd_buf(uint32_t img) {
+        if (!dynamic_recording) {
+            return cmd_bufs[img];
+        }
+
+        HP_PROFILE_SCOPE_EX("Record", "frame", 0);
+        gpu_prof.prepare_image(img);  // Its previous submission finished and was collected.
+
+        std::vector<::vk::CommandBuffer> list_bufs;
+        if (!draw_lists.empty()) {
+            list_bufs = record_draw_lists(&framebuffers[img], 1, render_pass, current_frame);
+        }
 
-            for (const auto &fn : record_buffer) {
-                fn(cmd_bufs[i], this);
+        ::vk::CommandBuffer ret;
+        {
+            std::lock_guard<std::mutex> pool_lg(shared_draw_pool_mtx);  // See `thread_draw_pool()`.
+            ::vk::CommandBufferAllocateInfo cmd_buf_ai(thread_draw_pool(current_frame),
+                                                       ::vk::CommandBufferLevel::ePrimary, 1);
+            if (handle_res(log_dev.allocateCommandBuffers(&cmd_buf_ai, &ret), HP_GET_CODE_LOC) !=
+                ::vk::Result::eSuccess) {
+                HP_FATAL("Failed to allocated command buffers!");
+                std::terminate();
             }
+        }
 
-            cmd_bufs[i].endRenderPass();
+        record_primary(ret, img, framebuffers[img], render_pass, swap_extent, list_bufs.data(), current_frame,
+                       ::vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+        return ret;
+    }
 
-#ifdef VULKAN_HPP_DISABLE_ENHANCED_MODE
-            if (handle_res(cmd_bufs[i].end(), HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
-                HP_FATAL("Failed to end command buffer recording!");
+    void window::reset_draw_pools(size_t pool_set) {
+        const size_t num_pools = jobs != nullptr ? jobs->worker_count() + 1 : 1;
+        if (draw_pools.size() <= pool_set) {
+            draw_pools.resize(pool_set + 1);
+        }
+
+        auto &pools = draw_pools[pool_set];
+        while (pools.size() < num_pools) {
+            ::vk::CommandPool pool;
+            ::vk::CommandPoolCreateInfo pool_ci(dynamic_recording ? ::vk::CommandPoolCreateFlagBits::eTransient
+                                                                  : ::vk::CommandPoolCreateFlags(),
+                                                queue_fam_indices.graphics_fam.value());
+            if (handle_res(log_dev.createCommandPool(&pool_ci, nullptr, &pool), HP_GET_CODE_LOC) !=
+                ::vk::Result::eSuccess) {
+                HP_FATAL("Failed to create command pool!");
                 std::terminate();
             }
-#else
-            cmd_bufs[i].end();  // Enhanced mode does exception handling for us. :)
-#endif
+            pools.emplace_back(pool);
+        }
+
+        for (auto pool : pools) {
+            log_dev.resetCommandPool(pool, ::vk::CommandPoolResetFlags());
+        }
+    }
+
+    ::vk::CommandPool window::thread_draw_pool(size_t pool_set) {
+        const auto &pools = draw_pools[pool_set];
+        const int worker = jobs != nullptr ? jobs->current_worker() : -1;
+        return pools[worker < 0 ? pools.size() - 1 : static_cast<size_t>(worker)];
+    }
+
+    std::vector<::vk::CommandBuffer> window::record_draw_lists(const ::vk::Framebuffer *frame_bufs, size_t num_bufs,
+                                                               ::vk::RenderPass rend_pass, size_t pool_set) {
+        HP_PROFILE_SCOPE("Record Draw Lists");
+
+        const size_t num_lists = draw_lists.size();
+        std::vector<::vk::CommandBuffer> ret(num_bufs * num_lists);
+        auto record = [&](size_t n) {
+            std::unique_lock<std::mutex> lg(shared_draw_pool_mtx, std::defer_lock);
+            if (jobs == nullptr || jobs->current_worker() < 0) {
+                lg.lock();  // This thread shares the last pool. See `thread_draw_pool()`.
+            }
+            ret[n] = begin_secondary(rend_pass, frame_bufs[n / num_lists], pool_set);
+            draw_lists[n % num_lists]->stream.replay(ret[n], gpu_prof);  // Lists have no GPU zones.
+            ret[n].end();
+        };
+
+        if (jobs != nullptr) {
+            parallel_for(*jobs, 0, ret.size(), record, 1);
+        } else {
+            for (size_t n = 0; n < ret.size(); n++) {
+                record(n);
+            }
+        }
+        return ret;
+    }
+
+    ::vk::CommandBuffer window::begin_secondary(::vk::RenderPass rend_pass, ::vk::Framebuffer frame_buf,
+                                                size_t pool_set) {
+        ::vk::CommandBuffer ret;
+        ::vk::CommandBufferAllocateInfo cmd_buf_ai(thread_draw_pool(pool_set), ::vk::CommandBufferLevel::eSecondary, 1);
+        if (handle_res(log_dev.allocateCommandBuffers(&cmd_buf_ai, &ret), HP_GET_CODE_LOC) !=
+            ::vk::Result::eSuccess) {
+            HP_FATAL("Failed to allocated command buffers!");
+            std::terminate();
+        }
+
+        ::vk::CommandBufferInheritanceInfo inherit_inf(rend_pass, 0, frame_buf);
+        ::vk::CommandBufferBeginInfo cmd_buf_bi(::vk::CommandBufferUsageFlagBits::eRenderPassContinue |
+                                                (dynamic_recording ? ::vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+                                                                   : ::vk::CommandBufferUsageFlags()),
+                                                &inherit_inf);
+        if (handle_res(ret.begin(&cmd_buf_bi), HP_GET_CODE_LOC) != ::vk::Result::eSuccess) {
+            HP_FATAL("Failed to begin command buffer recording!");
+            std::terminate();
+        }
+        return ret;
+    }
+
+    void window::create_pipeline_cache() {
+        std::vector<char> data;
+        if (pipeline_cache_file != nullptr) {
+            std::ifstream file(pipeline_cache_file, std::ios::ate | std::ios::binary);
+            if (file.is_open()) {
+                data.resize(static_cast<size_t>(file.tellg()));
+                file.seekg(0);
+                file.read(data.data(), static_cast<std::streamsize>(data.size()));
+                if (!file) {
+                    HP_WARN("Failed to read pipeline cache '{}'! Starting with an empty one!", pipeline_cache_file);
+                    data.clear();
+                }
+            }
+        }
+
+        if (!data.empty()) {
+            // The header every implementation writes first. See `VkPipelineCacheHeaderVersionOne`.
+            struct {
+                uint32_t size;
+                uint32_t version;
+                uint32_t vendor_id;
+                uint32_t device_id;
+                uint8_t uuid[VK_UUID_SIZE];
+            } header{};
+            ::vk::PhysicalDeviceProperties props = phys_dev->getProperties();
+
+            bool valid = data.size() >= sizeof(header);
+            if (valid) {
+                std::memcpy(&header, data.data(), sizeof(header));
+                valid = header.size >= sizeof(header) && header.size <= data.size() &&
+                        header.version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                        header.vendor_id == props.vendorID && header.device_id == props.deviceID &&
+                        std::memcmp(header.uuid, &props.pipelineCacheUUID[0], VK_UUID_SIZE) == 0;
+            }
+
+            if (!valid) {
+                HP_INFO("Pipeline cache '{}' is corrupt, or from another device or driver! Starting with an empty one!",
+                        pipeline_cache_file);
+                data.clear();
+            } else {
+                HP_DEBUG("Loaded {} bytes of pipeline cache from '{}'", data.size(), pipeline_cache_file);
+            }
+        }
+
+        ::vk::PipelineCacheCreateInfo cache_ci(::vk::PipelineCacheCreateFlags(), data.size(), data.data());
+        if (handle_res(log_dev.createPipelineCache(&cache_ci, nullptr, &pipeline_cache), HP_GET_CODE_LOC) !=
+            ::vk::Result::eSuccess) {
+            HP_WARN("Failed to create pipeline cache! Every pipeline will be compiled from scratch!");
+            pipeline_cache = ::vk::PipelineCache();
+        }
+    }
+
+    bool window::save_pipeline_cache() {
+        if (pipeline_cache_file == nullptr || pipeline_cache == ::vk::PipelineCache()) {
+            return false;
+        }
+
+        size_t size = 0;
+        std::vector<char> data;
+        if (handle_res(log_dev.getPipelineCacheData(pipeline_cache, &size, nullptr), HP_GET_CODE_LOC) !=
+            ::vk::Result::eSuccess) {
+            HP_WARN("Failed to query the pipeline cache size! Ignoring invocation!");
+            return false;
+        }
+        data.resize(size);
+        if (handle_res(log_dev.getPipelineCacheData(pipeline_cache, &size, data.data()), HP_GET_CODE_LOC) !=
+            ::vk::Result::eSuccess) {
+            HP_WARN("Failed to read the pipeline cache! Ignoring invocation!");
+            return false;
+        }
+        data.resize(size);
+
+        // Write a temporary file and rename it over the old one, so a crash never leaves a partial cache behind.
+        const std::string tmp_path = std::string(pipeline_cache_file) + ".tmp";
+        {
+            std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+            file.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!file) {
+                HP_WARN("Failed to write pipeline cache '{}'! Ignoring invocation!", tmp_path);
+                file.close();
+                std::remove(tmp_path.c_str());
+                return false;
+            }
+        }
+
+        if (std::rename(tmp_path.c_str(), pipeline_cache_file) != 0) {
+            // Windows can't rename over an existing file.
+            std::remove(pipeline_cache_file);
+            if (std::rename(tmp_path.c_str(), pipeline_cache_file) != 0) {
+                HP_WARN("Failed to replace pipeline cache '{}'! Ignoring invocation!", pipeline_cache_file);
+                std::remove(tmp_path.c_str());
+                return false;
+            }
+        }
+
+        HP_DEBUG("Saved {} bytes of pipeline cache to '{}'", data.size(), pipeline_cache_file);
+        return true;
+    }
+
+    void window::set_dynamic_recording(bool dynamic) {
+        std::lock_guard<std::recursive_mutex> lg(render_mtx);
+        if (dynamic == dynamic_recording) {
+            return;
+        }
+
+        log_dev.waitIdle();  // Once, so the pools can be handed from one mode to the other.
+        for (auto &pools : draw_pools) {
+            for (auto pool : pools) {
+                log_dev.destroyCommandPool(pool, nullptr);
+            }
+        }
+        draw_pools.clear();
+
+        dynamic_recording = dynamic;
+        if (dynamic) {
+            gpu_prof.prepare(cmd_bufs.size());
+        } else {
+            record_cmd_bufs(&framebuffers, &render_pass, &swap_extent);
         }
     }
 
@@ -706,11 +1179,80 @@ namespace hp::vk {
 
     void window::save_recording() {
         std::lock_guard<std::recursive_mutex> lg(render_mtx);
+        if (dynamic_recording) {
+            return;  // The next `draw_frame()` records the changes anyway.
+        }
         log_dev.waitIdle();
 
         record_cmd_bufs(&framebuffers, &render_pass, &swap_extent);
     }
 
+    bool window::read_frame(std::vector<uint8_t> &pixels) {
+        if (!headless) {
+            HP_WARN("read_frame() called on a window that isn't headless! Ignoring invocation!");
+            return false;
+        }
+
+        std::lock_guard<std::recursive_mutex> lg(render_mtx);
+        if (last_img == UINT32_MAX) {
+            HP_WARN("read_frame() called before any frame was drawn! Ignoring invocation!");
+            return false;
+        }
+
+        const size_t size = static_cast<size_t>(swap_extent.width) * swap_extent.height * 4;
+        if (readback_buf == nullptr) {
+            readback_buf = new_buffer(size, ::vk::BufferUsageFlagBits::eTransferDst, memory_host);
+        }
+
+        ::vk::CommandBufferAllocateInfo cmd_ai(cmd_pool, ::vk::CommandBufferLevel::ePrimary, 1);
+        ::vk::CommandBuffer cmd_buf;
+        log_dev.allocateCommandBuffers(&cmd_ai, &cmd_buf);
+
+        ::vk::CommandBufferBeginInfo cmd_bi(::vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr);
+        cmd_buf.begin(&cmd_bi);
+
+        // The frame was submitted before this on the same queue. The render pass's dependency to
+        // `VK_SUBPASS_EXTERNAL` (see `create_render_pass()`) makes its writes visible to this copy.
+        ::vk::BufferImageCopy cpy_region(0, 0, 0, {::vk::ImageAspectFlagBits::eColor, 0, 0, 1}, {0, 0, 0},
+                                         {swap_extent.width, swap_extent.height, 1});
+        cmd_buf.copyImageToBuffer(swap_imgs[last_img], ::vk::ImageLayout::eTransferSrcOptimal, readback_buf->buf, 1,
+                                  &cpy_region);
+
+        ::vk::BufferMemoryBarrier buf_barrier(::vk::AccessFlagBits::eTransferWrite, ::vk::AccessFlagBits::eHostRead,
+                                              VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, readback_buf->buf, 0,
+                                              VK_WHOLE_SIZE);
+        cmd_buf.pipelineBarrier(::vk::PipelineStageFlagBits::eTransfer, ::vk::PipelineStageFlagBits::eHost,
+                                ::vk::DependencyFlags(), 0, nullptr, 1, &buf_barrier, 0, nullptr);
+        cmd_buf.end();
+
+        ::vk::SubmitInfo submit_inf(0, nullptr, nullptr, 1, &cmd_buf, 0, nullptr);
+        ::vk::Fence fence = new_fence();
+        graphics_queue.submit(1, &submit_inf, fence);
+        log_dev.waitForFences(1, &fence, ::vk::Bool32(VK_TRUE), UINT64_MAX);  // Not `wait_fences`; We hold the lock.
+        delete_fence(fence);
+        log_dev.freeCommandBuffers(cmd_pool, 1, &cmd_buf);
+
+        uint8_t *mapped = readback_buf->start_write();
+        readback_buf->invalidate();
+        pixels.assign(mapped, mapped + size);
+        readback_buf->stop_write();
+        return true;
+    }
+
+    bool window::save_frame_png(const std::string &path) {
+        std::vector<uint8_t> pixels;
+        if (!read_frame(pixels)) {
+            return false;
+        }
+
+        const int width = static_cast<int>(swap_extent.width), height = static_cast<int>(swap_extent.height);
+        if (stbi_write_png(path.c_str(), width, height, 4, pixels.data(), width * 4) == 0) {
+            HP_WARN("Failed to write frame to '{}'!", path);
+            return false;
+        }
+        return true;
+    }
+
     std::pair<::vk::Fence, ::vk::CommandBuffer> window::copy_buffer(generic_buffer *source, generic_buffer *dest,
                                                                     bool wait, size_t src_offset, size_t dest_offset,
                                                                     size_t size) {
@@ -719,26 +1261,33 @@ namespace hp::vk {
             HP_FATAL("Source buffer was {} bytes, but dest buffer was {} bytes!", source->capacity, dest->capacity);
             return {::vk::Fence(), ::vk::CommandBuffer()};
         }
-        ::vk::CommandBufferAllocateInfo cmd_ai(cmd_pool, ::vk::CommandBufferLevel::ePrimary, 1);
 
         ::vk::CommandBuffer cmd_buf;
-        log_dev.allocateCommandBuffers(&cmd_ai, &cmd_buf);
+        ::vk::Fence ret;
+        {
+            // `cmd_pool` and `graphics_queue` are shared with `draw_frame()`. Not held while waiting below, since a
+            // suspended fiber may resume on another thread.
+            std::lock_guard<std::recursive_mutex> lg(render_mtx);
+            ::vk::CommandBufferAllocateInfo cmd_ai(cmd_pool, ::vk::CommandBufferLevel::ePrimary, 1);
+            log_dev.allocateCommandBuffers(&cmd_ai, &cmd_buf);
 
-        ::vk::CommandBufferBeginInfo cmd_bi(::vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr);
-        cmd_buf.begin(&cmd_bi);
+            ::vk::CommandBufferBeginInfo cmd_bi(::vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr);
+            cmd_buf.begin(&cmd_bi);
 
-        ::vk::BufferCopy cpy_region(src_offset, dest_offset, size == 0 ? source->capacity : size);
-        cmd_buf.copyBuffer(source->buf, dest->buf, 1, &cpy_region);
-        cmd_buf.end();
+            ::vk::BufferCopy cpy_region(src_offset, dest_offset, size == 0 ? source->capacity : size);
+            cmd_buf.copyBuffer(source->buf, dest->buf, 1, &cpy_region);
+            cmd_buf.end();
 
-        ::vk::SubmitInfo submit_inf(0, nullptr, nullptr, 1, &cmd_buf, 0, nullptr);
+            ::vk::SubmitInfo submit_inf(0, nullptr, nullptr, 1, &cmd_buf, 0, nullptr);
 
-        ::vk::Fence ret = new_fence();
+            ret = new_fence();
 
-        graphics_queue.submit(1, &submit_inf, ret);
+            graphics_queue.submit(1, &submit_inf, ret);
+        }
 
         if (wait) {
-            log_dev.waitForFences(1, &ret, ::vk::Bool32(VK_TRUE), UINT64_MAX);
+            wait_fences(&ret);  // Suspends instead of blocking in fiber jobs.
+            std::lock_guard<std::recursive_mutex> lg(render_mtx);
             delete_fence(ret);
             log_dev.freeCommandBuffers(cmd_pool, 1, &cmd_buf);
             return {::vk::Fence(), ::vk::CommandBuffer()};
@@ -51,38 +51,6 @@ namespace hp::vk {
         }
     }
 
-    static void bind_vbo_helper(::vk::Buffer *vbos, uint32_t start, ::vk::DeviceSize *offsets, uint32_t num_vbos,
-                                ::vk::CommandBuffer cmd,
-                                window *win) {
-        cmd.bindVertexBuffers(start, num_vbos, vbos, offsets);
-    }
-
-    static void bind_shader_helper(::vk::Pipeline pipeline, ::vk::CommandBuffer cmd, window *win) {
-        cmd.bindPipeline(::vk::PipelineBindPoint::eGraphics, pipeline);
-    }
-
-    static void draw_cmd_helper(unsigned num_verts, ::vk::CommandBuffer cmd, window *win) {
-        cmd.draw(num_verts, 1, 0, 0);
-    }
-
-    static void set_viewport_helper(::vk::Viewport vp, ::vk::CommandBuffer cmd, window *win) {
-        cmd.setViewport(0, 1, &vp);
-    }
-
-    static void set_scissor_helper(::vk::Rect2D sc, ::vk::CommandBuffer cmd, window *win) {
-        cmd.setScissor(0, 1, &sc);
-    }
-
-    static void
-    bind_ibo_helper(::vk::Buffer ibo, ::vk::IndexType type, ::vk::DeviceSize offset, ::vk::CommandBuffer cmd,
-                    window *win) {
-        cmd.bindIndexBuffer(ibo, offset, type);
-    }
-
-    static void draw_indexed_helper(uint32_t num_indices, ::vk::CommandBuffer cmd, window *win) {
-        cmd.drawIndexed(num_indices, 1, 0, 0, 0);
-    }
-
     hp::vk::queue_family_indices build_queue_fam_indices(::vk::PhysicalDevice *dev, ::vk::SurfaceKHR surf) {
         std::vector<::vk::QueueFamilyProperties> queue_fams = dev->getQueueFamilyProperties();
         queue_family_indices ret = {};
@@ -91,7 +59,9 @@ namespace hp::vk {
                 ret.graphics_fam = i;
             }
 
-            if (dev->getSurfaceSupportKHR(i, surf)) {
+            if (!surf) {  // Headless; Nothing is presented, so the graphics queue stands in for the present queue.
+                ret.present_fam = ret.graphics_fam;
+            } else if (dev->getSurfaceSupportKHR(i, surf)) {
                 ret.present_fam = i;
             }
 
@@ -158,6 +128,8 @@ namespace hp::vk {
         queue_fam_indices = std::move(other.queue_fam_indices);
         devices = std::move(other.devices);
         log_dev = other.log_dev;
+        pipeline_cache = other.pipeline_cache;
+        other.pipeline_cache = ::vk::PipelineCache();  // So `other`'s destructor neither saves nor destroys it.
         inst = other.inst;
         supported_ext = std::move(other.supported_ext);
         uses_validation_layers = other.uses_validation_layers;
@@ -183,64 +155,166 @@ namespace hp::vk {
         swapchain_recreate_event = other.swapchain_recreate_event;
         mem_props = other.mem_props;
         child_bufs = std::move(other.child_bufs);
-        record_buffer = std::move(other.record_buffer);
+        commands = std::move(other.commands);
+        draw_lists = std::move(other.draw_lists);
+        draw_pools = std::move(other.draw_pools);
+        dynamic_recording = other.dynamic_recording;
         cmd_bufs = std::move(other.cmd_bufs);
         swap_recreate_callback = other.swap_recreate_callback;
         allocator = other.allocator;
         child_bufs = std::move(other.child_bufs);
         child_fences = std::move(other.child_fences);
+        gpu_prof = std::move(other.gpu_prof);
+        headless = other.headless;
+        offscreen_allocs = std::move(other.offscreen_allocs);
+        other.offscreen_allocs.clear();  // So `other`'s destructor neither destroys the images nor counts them freed.
+        offscreen_bytes = other.offscreen_bytes;
+        other.offscreen_bytes = 0;
+        last_img = other.last_img;
+        other.last_img = UINT32_MAX;
+        readback_buf = other.readback_buf;  // One of `child_bufs`, so owned by this window now.
+        other.readback_buf = nullptr;
 //        render_mtx = std::move(other.render_mtx);
         return *this;
     }
 
+    void draw_list::clear() {
+        stream.clear();
+    }
+
+    void draw_list::rec_bind_vbos(vertex_buffer *vbo) {
+        bind_vbos_cmd c;
+        c.count = 1;
+        c.bufs = &vbo->buf->buf;
+        c.offsets = &vbo->offset;
+        stream.push(c);
+    }
+
+    void draw_list::rec_draw(unsigned num_verts) {
+        draw_cmd c;
+        c.vertex_count = num_verts;
+        stream.push(c);
+    }
+
+    void draw_list::rec_bind_shader(shader_program *shader) {
+        bind_pipeline_cmd c;
+        c.pipeline = shader->pipeline;
+        stream.push(c);
+    }
+
+    void draw_list::rec_set_viewport(::vk::Viewport viewport) {
+        set_viewport_cmd c;
+        c.viewport = viewport;
+        stream.push(c);
+    }
+
+    void draw_list::rec_set_scissor(::vk::Rect2D scissor) {
+        set_scissor_cmd c;
+        c.scissor = scissor;
+        stream.push(c);
+    }
+
+    void draw_list::rec_bind_index_buffer(index_buffer ibo) {
+        bind_index_buffer_cmd c;
+        c.type = ibo.is32bit ? ::vk::IndexType::eUint32 : ::vk::IndexType::eUint16;
+        c.buf = ibo.buf->buf;
+        c.offset = ibo.offset;
+        stream.push(c);
+    }
+
+    void draw_list::rec_draw_indexed(::vk::DeviceSize num_indices) {
+        draw_indexed_cmd c;
+        c.index_count = static_cast<uint32_t>(num_indices);
+        stream.push(c);
+    }
+
+    void draw_list::rec_bind_vbos(vertex_bind_info *bi, uint32_t start) {
+        bind_vbos_cmd c;
+        c.first = start;
+        c.count = bi->n_vbos;
+        c.bufs = bi->vbos;
+        c.offsets = bi->offsets;
+        stream.push(c);
+    }
+
     void window::rec_bind_vbos(vertex_buffer *vbo) {
-        record_buffer.emplace_back(boost::bind(bind_vbo_helper, &vbo->buf->buf, 0, &vbo->offset, 1, _1, _2));
+        commands.rec_bind_vbos(vbo);
     }
 
     void window::rec_draw(unsigned num_verts) {
-        record_buffer.emplace_back(boost::bind(draw_cmd_helper, num_verts, _1, _2));
+        commands.rec_draw(num_verts);
     }
 
     void window::rec_bind_shader(shader_program *shader) {
-        record_buffer.emplace_back(boost::bind(bind_shader_helper, shader->pipeline, _1, _2));
+        commands.rec_bind_shader(shader);
     }
 
     void window::rec_set_viewport(::vk::Viewport viewport) {
-        record_buffer.emplace_back(boost::bind(set_viewport_helper, viewport, _1, _2));
+        commands.rec_set_viewport(viewport);
     }
 
     void window::rec_set_scissor(::vk::Rect2D scissor) {
-        record_buffer.emplace_back(boost::bind(set_scissor_helper, scissor, _1, _2));
+        commands.rec_set_scissor(scissor);
     }
 
     void window::rec_set_default_viewport() {
-        ::vk::Viewport viewport(0.0f, 0.0f, (float) swap_extent.width, (float) swap_extent.height, 0.0f,
-                                1.0f);
-        record_buffer.emplace_back(boost::bind(set_viewport_helper, viewport, _1, _2));
+        rec_set_viewport(::vk::Viewport(0.0f, 0.0f, (float) swap_extent.width, (float) swap_extent.height, 0.0f,
+                                        1.0f));
     }
 
     void window::rec_set_default_scissor() {
-        ::vk::Rect2D scissor(::vk::Offset2D(0, 0), swap_extent);
-        record_buffer.emplace_back(boost::bind(set_scissor_helper, scissor, _1, _2));
+        rec_set_scissor(::vk::Rect2D(::vk::Offset2D(0, 0), swap_extent));
     }
 
     void window::clear_recording() {
-        record_buffer.clear();
+        commands.clear();
+        gpu_prof.clear_zones();
     }
 
     void window::rec_bind_index_buffer(index_buffer ibo) {
-        record_buffer.emplace_back(boost::bind(bind_ibo_helper, ibo.buf->buf,
-                                               ibo.is32bit ? ::vk::IndexType::eUint32 : ::vk::IndexType::eUint16,
-                                               ibo.offset, _1,
-                                               _2));
+        commands.rec_bind_index_buffer(ibo);
     }
 
     void window::rec_draw_indexed(::vk::DeviceSize num_indices) {
-        record_buffer.emplace_back(boost::bind(draw_indexed_helper, num_indices, _1, _2));
+        commands.rec_draw_indexed(num_indices);
     }
 
     void window::rec_bind_vbos(vertex_bind_info *bi, uint32_t start) {
-        record_buffer.emplace_back(boost::bind(bind_vbo_helper, bi->vbos, start, bi->offsets, bi->n_vbos, _1, _2));
+        commands.rec_bind_vbos(bi, start);
+    }
+
+    void window::add_draw_list(draw_list *list) {
+        std::lock_guard<std::recursive_mutex> lg(render_mtx);
+        draw_lists.emplace_back(list);
+    }
+
+    void window::remove_draw_list(draw_list *list) {
+        std::lock_guard<std::recursive_mutex> lg(render_mtx);
+        boost::remove_erase(draw_lists, list);
+    }
+
+    void window::rec_gpu_zone_begin(const zone_desc *zone) {
+        uint32_t query = gpu_prof.begin_zone(zone);
+        if (query != UINT32_MAX) {
+            write_timestamp_cmd c;
+            c.query = query;
+            c.stage = ::vk::PipelineStageFlagBits::eTopOfPipe;
+            commands.stream.push(c);
+        }
+    }
+
+    void window::rec_gpu_zone_begin(const char *name) {
+        rec_gpu_zone_begin(gpu_prof.named_zone(name));
+    }
+
+    void window::rec_gpu_zone_end() {
+        uint32_t query = gpu_prof.end_zone();
+        if (query != UINT32_MAX) {
+            write_timestamp_cmd c;
+            c.query = query;
+            c.stage = ::vk::PipelineStageFlagBits::eBottomOfPipe;
+            commands.stream.push(c);
+        }
     }
 
     vertex_bind_info::vertex_bind_info(vertex_buffer *vbolist, uint32_t num_vbos) : n_vbos(num_vbos) {
@@ -0,0 +1,216 @@
+//
+// Recording and replaying draw commands with `command_stream`, against the `std::function` per command it replaced.
+// See `hp/vk/command_stream.hpp`.
+//
+
+#include "hp/vk/command_stream.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <boost/bind/bind.hpp>
+
+#include <functional>
+#include <vector>
+
+using namespace boost::placeholders;
+
+namespace {
+    /// Draws per benchmark iteration. Each is four commands, like a scene of that many meshes.
+    constexpr uint32_t num_draws = 100000;
+
+    /// What `window::record_buffer` held before `command_stream`: A bound call per command.
+    using recorded_fn = std::function<void(::vk::CommandBuffer)>;
+
+    void bind_shader_helper(::vk::Pipeline pipeline, ::vk::CommandBuffer cmd) {
+        cmd.bindPipeline(::vk::PipelineBindPoint::eGraphics, pipeline);
+    }
+
+    void bind_vbo_helper(const ::vk::Buffer *bufs, const ::vk::DeviceSize *offsets, ::vk::CommandBuffer cmd) {
+        cmd.bindVertexBuffers(0, 1, bufs, offsets);
+    }
+
+    void bind_ibo_helper(::vk::Buffer buf, ::vk::DeviceSize offset, ::vk::CommandBuffer cmd) {
+        cmd.bindIndexBuffer(buf, offset, ::vk::IndexType::eUint16);
+    }
+
+    void draw_indexed_helper(uint32_t count, ::vk::CommandBuffer cmd) {
+        cmd.drawIndexed(count, 1, 0, 0, 0);
+    }
+
+    void set_viewport_helper(::vk::Viewport viewport, ::vk::CommandBuffer cmd) {
+        cmd.setViewport(0, 1, &viewport);
+    }
+
+    void set_scissor_helper(::vk::Rect2D scissor, ::vk::CommandBuffer cmd) {
+        cmd.setScissor(0, 1, &scissor);
+    }
+
+    /**
+     * A command buffer to replay into, on the first device with a graphics queue. No window, no validation layers,
+     * and never submitted. `cmd` is null if there is no such device, like on CI machines without a GPU.
+     */
+    struct replay_target {
+        ::vk::Instance inst;
+        ::vk::Device dev;
+        ::vk::CommandPool pool;
+        ::vk::CommandBuffer cmd;
+
+        replay_target() {
+            ::vk::ApplicationInfo app_inf("Command Stream Benchmark", 1, "Hephaestus", 1, VK_API_VERSION_1_1);
+            ::vk::InstanceCreateInfo inst_ci(::vk::InstanceCreateFlags(), &app_inf);
+            if (::vk::createInstance(&inst_ci, nullptr, &inst) != ::vk::Result::eSuccess) {
+                return;
+            }
+
+            for (auto phys : inst.enumeratePhysicalDevices()) {
+                const auto fams = phys.getQueueFamilyProperties();
+                for (uint32_t i = 0; i < fams.size(); i++) {
+                    if (!(fams[i].queueFlags & ::vk::QueueFlagBits::eGraphics)) {
+                        continue;
+                    }
+
+                    const float priority = 1.0f;
+                    ::vk::DeviceQueueCreateInfo queue_ci(::vk::DeviceQueueCreateFlags(), i, 1, &priority);
+                    ::vk::DeviceCreateInfo dev_ci(::vk::DeviceCreateFlags(), 1, &queue_ci);
+                    if (phys.createDevice(&dev_ci, nullptr, &dev) != ::vk::Result::eSuccess) {
+                        continue;
+                    }
+
+                    ::vk::CommandPoolCreateInfo pool_ci(::vk::CommandPoolCreateFlags(), i);
+                    dev.createCommandPool(&pool_ci, nullptr, &pool);
+                    ::vk::CommandBufferAllocateInfo cmd_ai(pool, ::vk::CommandBufferLevel::ePrimary, 1);
+                    dev.allocateCommandBuffers(&cmd_ai, &cmd);
+                    return;
+                }
+            }
+        }
+
+        ~replay_target() {
+            if (dev) {
+                dev.destroyCommandPool(pool, nullptr);
+                dev.destroy();
+            }
+            if (inst) {
+                inst.destroy();
+            }
+        }
+
+        /// Record into `cmd` from scratch.
+        void begin() {
+            dev.resetCommandPool(pool, ::vk::CommandPoolResetFlags());
+            ::vk::CommandBufferBeginInfo cmd_bi(::vk::CommandBufferUsageFlagBits::eOneTimeSubmit, nullptr);
+            cmd.begin(&cmd_bi);
+        }
+    };
+
+    replay_target &bench_target() {
+        static replay_target target;
+        return target;
+    }
+
+    /// Handles are only copied around when recording, so null ones do.
+    const ::vk::Buffer fake_buf;
+    const ::vk::Pipeline fake_pipeline;
+    const ::vk::DeviceSize fake_offset = 0;
+}
+
+static void BM_record_functions(benchmark::State &state) {
+    std::vector<recorded_fn> recorded;
+    for (auto _ : state) {
+        recorded.clear();
+        for (uint32_t i = 0; i < num_draws; i++) {
+            recorded.emplace_back(boost::bind(bind_shader_helper, fake_pipeline, _1));
+            recorded.emplace_back(boost::bind(bind_vbo_helper, &fake_buf, &fake_offset, _1));
+            recorded.emplace_back(boost::bind(bind_ibo_helper, fake_buf, fake_offset, _1));
+            recorded.emplace_back(boost::bind(draw_indexed_helper, 6 + i, _1));
+        }
+        benchmark::DoNotOptimize(recorded.data());
+    }
+    state.SetItemsProcessed(state.iterations() * num_draws * 4);
+}
+BENCHMARK(BM_record_functions)->Unit(benchmark::kMillisecond);
+
+static void BM_record_command_stream(benchmark::State &state) {
+    hp::vk::command_stream stream;
+    for (auto _ : state) {
+        stream.clear();
+        for (uint32_t i = 0; i < num_draws; i++) {
+            hp::vk::bind_pipeline_cmd pipeline;
+            pipeline.pipeline = fake_pipeline;
+            stream.push(pipeline);
+
+            hp::vk::bind_vbos_cmd vbos;
+            vbos.count = 1;
+            vbos.bufs = &fake_buf;
+            vbos.offsets = &fake_offset;
+            stream.push(vbos);
+
+            hp::vk::bind_index_buffer_cmd ibo;
+            ibo.buf = fake_buf;
+            ibo.offset = fake_offset;
+            stream.push(ibo);
+
+            hp::vk::draw_indexed_cmd draw;
+            draw.index_count = 6 + i;
+            stream.push(draw);
+        }
+        benchmark::DoNotOptimize(stream.bytes());
+    }
+    state.counters["bytes_per_command"] = static_cast<double>(stream.bytes()) / static_cast<double>(stream.size());
+    state.SetItemsProcessed(state.iterations() * num_draws * 4);
+}
+BENCHMARK(BM_record_command_stream)->Unit(benchmark::kMillisecond);
+
+// Replays only set viewports and scissors: They need no pipeline or buffers, and are valid outside a render pass.
+
+static void BM_replay_functions(benchmark::State &state) {
+    auto &target = bench_target();
+    if (!target.cmd) {
+        state.SkipWithError("No Vulkan device with a graphics queue");
+        return;
+    }
+
+    std::vector<recorded_fn> recorded;
+    for (uint32_t i = 0; i < num_draws; i++) {
+        recorded.emplace_back(boost::bind(set_viewport_helper, ::vk::Viewport(0, 0, 640, 480, 0, 1), _1));
+        recorded.emplace_back(boost::bind(set_scissor_helper, ::vk::Rect2D({0, 0}, {640, 480}), _1));
+    }
+
+    for (auto _ : state) {
+        target.begin();
+        for (const auto &fn : recorded) {
+            fn(target.cmd);
+        }
+        target.cmd.end();
+    }
+    state.SetItemsProcessed(state.iterations() * num_draws * 2);
+}
+BENCHMARK(BM_replay_functions)->Unit(benchmark::kMillisecond);
+
+static void BM_replay_command_stream(benchmark::State &state) {
+    auto &target = bench_target();
+    if (!target.cmd) {
+        state.SkipWithError("No Vulkan device with a graphics queue");
+        return;
+    }
+
+    hp::vk::command_stream stream;
+    for (uint32_t i = 0; i < num_draws; i++) {
+        hp::vk::set_viewport_cmd viewport;
+        viewport.viewport = ::vk::Viewport(0, 0, 640, 480, 0, 1);
+        stream.push(viewport);
+
+        hp::vk::set_scissor_cmd scissor;
+        scissor.scissor = ::vk::Rect2D({0, 0}, {640, 480});
+        stream.push(scissor);
+    }
+
+    hp::vk::gpu_profiler prof;  // Unused: The stream has no timestamps.
+    for (auto _ : state) {
+        target.begin();
+        stream.replay(target.cmd, prof);
+        target.cmd.end();
+    }
+    state.SetItemsProcessed(state.iterations() * num_draws * 2);
+}
+BENCHMARK(BM_replay_command_stream)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,88 @@
+//
+// Cost of running many small jobs on the job system, against posting them to the old `io_service` thread pool. See
+// `hp/multithreading.hpp`.
+//
+
+#include "hp/multithreading.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+namespace {
+    /// Jobs submitted per benchmark iteration.
+    constexpr int batch_size = 1024;
+
+    /// One job system for every benchmark, so its workers are only started once.
+    hp::job_system &bench_jobs() {
+        static hp::job_system *jobs = new hp::job_system();
+        return *jobs;
+    }
+
+    /// What the engine used before the job system: An `io_service` run by twice as many threads as there are cores.
+    boost::asio::io_service &bench_io_service() {
+        static boost::asio::io_service *service = [] {
+            auto ret = new boost::asio::io_service();
+            new boost::asio::io_service::work(*ret);  // Never destroyed, so the threads never run out of work.
+            unsigned threads = std::max(2u, 2 * std::thread::hardware_concurrency());
+            for (unsigned i = 0; i < threads; i++) {
+                std::thread([ret] { ret->run(); }).detach();
+            }
+            return ret;
+        }();
+        return *service;
+    }
+
+    /// Work done by each job: `state.range(0)` rounds of an xorshift, so 0 is an empty job.
+    inline uint32_t job_work(int64_t rounds) {
+        uint32_t x = 2463534242u;
+        for (int64_t i = 0; i < rounds; i++) {
+            x ^= x << 13u;
+            x ^= x >> 17u;
+            x ^= x << 5u;
+        }
+        return x;
+    }
+}
+
+/// `job_system::submit()` into a `job_counter`, then `wait()` for the batch. The waiting thread helps out.
+static void BM_job_system(benchmark::State &state) {
+    auto &jobs = bench_jobs();
+    const int64_t rounds = state.range(0);
+
+    for (auto _ : state) {
+        hp::job_counter counter;
+        for (int i = 0; i < batch_size; i++) {
+            jobs.submit([rounds] { benchmark::DoNotOptimize(job_work(rounds)); }, &counter);
+        }
+        jobs.wait(counter);
+    }
+    state.SetItemsProcessed(state.iterations() * batch_size);
+}
+BENCHMARK(BM_job_system)->Arg(0)->Arg(1000)->UseRealTime();
+
+/// `io_service->post()`, then spin until every handler has decremented the shared count. The waiting thread only waits.
+static void BM_io_service_post(benchmark::State &state) {
+    auto &service = bench_io_service();
+    const int64_t rounds = state.range(0);
+
+    for (auto _ : state) {
+        std::atomic<int> pending{batch_size};
+        for (int i = 0; i < batch_size; i++) {
+            service.post([rounds, &pending] {
+                benchmark::DoNotOptimize(job_work(rounds));
+                pending.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        while (pending.load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch_size);
+}
+BENCHMARK(BM_io_service_post)->Arg(0)->Arg(1000)->UseRealTime();
@@ -0,0 +1,108 @@
+//
+// The parallel algorithms on transform, reduction and sort workloads, against their serial std counterparts. See
+// `hp/parallel.hpp`.
+//
+
+#include "hp/parallel.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+    /// Default sized job system, so the numbers match the engine's `hp::jobs`.
+    hp::job_system &bench_jobs() {
+        static hp::job_system *jobs = new hp::job_system();
+        return *jobs;
+    }
+
+    std::vector<float> random_floats(size_t count) {
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+        std::vector<float> ret(count);
+        for (auto &v : ret) {
+            v = dist(rng);
+        }
+        return ret;
+    }
+
+    /// A transform that is neither free nor memory bound.
+    inline float transform_op(float x) {
+        return std::sqrt(x) * 0.5f + std::sin(x);
+    }
+}
+
+static void BM_transform_serial(benchmark::State &state) {
+    auto v = random_floats(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::transform(v.begin(), v.end(), v.begin(), transform_op);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_transform_serial)->Arg(1 << 10)->Arg(1 << 20)->UseRealTime();
+
+/// `parallel_for_each()`, which splits on cache line boundaries.
+static void BM_transform_parallel(benchmark::State &state) {
+    auto v = random_floats(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        hp::parallel_for_each(bench_jobs(), v, [](float &x) { x = transform_op(x); });
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_transform_parallel)->Arg(1 << 10)->Arg(1 << 20)->UseRealTime();
+
+static void BM_reduce_serial(benchmark::State &state) {
+    const auto v = random_floats(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(std::accumulate(v.begin(), v.end(), 0.0));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_reduce_serial)->Arg(1 << 10)->Arg(1 << 20)->UseRealTime();
+
+static void BM_reduce_parallel(benchmark::State &state) {
+    const auto v = random_floats(static_cast<size_t>(state.range(0)));
+    const auto sum = [&v](size_t b, size_t e, double acc) {
+        for (; b < e; b++) {
+            acc += v[b];
+        }
+        return acc;
+    };
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(hp::parallel_reduce(bench_jobs(), 0, v.size(), 0.0, sum, std::plus<>()));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_reduce_parallel)->Arg(1 << 10)->Arg(1 << 20)->UseRealTime();
+
+static void BM_sort_serial(benchmark::State &state) {
+    const auto input = random_floats(static_cast<size_t>(state.range(0)));
+    std::vector<float> v;
+    for (auto _ : state) {
+        state.PauseTiming();
+        v = input;
+        state.ResumeTiming();
+        std::sort(v.begin(), v.end());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_sort_serial)->Arg(1 << 20)->UseRealTime();
+
+static void BM_sort_parallel(benchmark::State &state) {
+    const auto input = random_floats(static_cast<size_t>(state.range(0)));
+    std::vector<float> v;
+    for (auto _ : state) {
+        state.PauseTiming();
+        v = input;
+        state.ResumeTiming();
+        hp::parallel_sort(bench_jobs(), v.begin(), v.end());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_sort_parallel)->Arg(1 << 20)->UseRealTime();
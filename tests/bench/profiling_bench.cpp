@@ -0,0 +1,66 @@
+//
+// Cost of recording a profiler zone, by number of threads recording at once. See `hp/profiling.hpp`.
+//
+
+#include "hp/profiling.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+#include <queue>
+
+namespace {
+    /// One session for every benchmark, so its writer thread drains the thread buffers the whole time.
+    hp::profiler_session *bench_session() {
+        static hp::profiler_session *session = [] {
+            auto ret = new hp::profiler_session("Profiling Benchmark", "", hp::overflow_policy::drop,
+                                                hp::trace_format::none);
+            hp::profiler_session::default_session = ret;
+            return ret;
+        }();
+        return session;
+    }
+}
+
+/// `HP_PROFILE_SCOPE`: Each thread records into its own `event_buffer`. Should scale linearly with the threads.
+static void BM_scoped_zone(benchmark::State &state) {
+    bench_session();
+    static const hp::zone_desc *zone = hp::register_zone("Benchmark Zone", "bench");
+
+    for (auto _ : state) {
+        hp::scoped_zone scope(zone);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_scoped_zone)->ThreadRange(1, 16)->UseRealTime();
+
+/// `hp::profiler`, started and stopped by hand.
+static void BM_profiler_start_stop(benchmark::State &state) {
+    auto prof = bench_session()->new_profiler(hp::register_zone("Benchmark Profiler", "bench"));
+
+    for (auto _ : state) {
+        prof.start();
+        prof.stop();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_profiler_start_stop)->ThreadRange(1, 16)->UseRealTime();
+
+/// What every zone cost before the per-thread buffers: One mutex and one queue, shared by every thread.
+static void BM_mutex_queue_baseline(benchmark::State &state) {
+    static std::mutex mtx;
+    static std::queue<hp::profile_result> queue;
+
+    for (auto _ : state) {
+        uint64_t start = hp::clock::ticks();
+        hp::profile_result res{0, hp::profiler_session::current_frame(), start, hp::clock::ticks_ordered()};
+
+        std::lock_guard<std::mutex> lg(mtx);
+        queue.push(res);
+        if (queue.size() >= hp::event_buffer::capacity) {
+            std::queue<hp::profile_result>().swap(queue);  // Stands in for the flush.
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_mutex_queue_baseline)->ThreadRange(1, 16)->UseRealTime();
@@ -0,0 +1,112 @@
+//
+// The lock-free queues against a mutex and a `std::queue`: The MPMC queue by number of threads using it at once, and the
+// SPSC queue between one producer and one consumer. See `hp/queues.hpp`.
+//
+
+#include "hp/queues.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+#include <queue>
+#include <thread>
+
+/// Each thread pushes an item and pops one, so the queue never holds more than one item per thread.
+static void BM_mpmc_queue(benchmark::State &state) {
+    static hp::mpmc_queue<uint64_t> queue(1024);
+
+    uint64_t item = 0;
+    for (auto _ : state) {
+        while (!queue.try_push(item)) {
+            std::this_thread::yield();
+        }
+        while (!queue.try_pop(item)) {
+            std::this_thread::yield();
+        }
+    }
+    benchmark::DoNotOptimize(item);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_mpmc_queue)->ThreadRange(1, 16)->UseRealTime();
+
+/// The same push and pop, with every thread taking one mutex for each.
+static void BM_mutex_queue(benchmark::State &state) {
+    static std::mutex mtx;
+    static std::queue<uint64_t> queue;
+
+    uint64_t item = 0;
+    for (auto _ : state) {
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            queue.push(item);
+        }
+        std::lock_guard<std::mutex> lg(mtx);
+        item = queue.front();
+        queue.pop();
+    }
+    benchmark::DoNotOptimize(item);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_mutex_queue)->ThreadRange(1, 16)->UseRealTime();
+
+/// Thread 0 produces and thread 1 consumes. Both run the same number of iterations, so every item pushed is popped.
+static void BM_spsc_queue(benchmark::State &state) {
+    static hp::spsc_queue<uint64_t> queue(1024);
+
+    uint64_t item = 0;
+    if (state.thread_index() == 0) {
+        for (auto _ : state) {
+            while (!queue.try_push(item)) {
+                std::this_thread::yield();
+            }
+            item++;
+        }
+    } else {
+        for (auto _ : state) {
+            while (!queue.try_pop(item)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    benchmark::DoNotOptimize(item);
+    state.SetItemsProcessed(state.thread_index() == 1 ? state.iterations() : 0);  // Items passed through.
+}
+BENCHMARK(BM_spsc_queue)->Threads(2)->UseRealTime();
+
+/// The same producer and consumer, taking one mutex for every push and pop. Bounded like the SPSC queue.
+static void BM_mutex_spsc_queue(benchmark::State &state) {
+    static std::mutex mtx;
+    static std::queue<uint64_t> queue;
+
+    uint64_t item = 0;
+    if (state.thread_index() == 0) {
+        for (auto _ : state) {
+            while (true) {
+                std::unique_lock<std::mutex> lk(mtx);
+                if (queue.size() < 1024) {
+                    queue.push(item);
+                    break;
+                }
+                lk.unlock();
+                std::this_thread::yield();
+            }
+            item++;
+        }
+    } else {
+        for (auto _ : state) {
+            while (true) {
+                std::unique_lock<std::mutex> lk(mtx);
+                if (!queue.empty()) {
+                    item = queue.front();
+                    queue.pop();
+                    break;
+                }
+                lk.unlock();
+                std::this_thread::yield();
+            }
+        }
+    }
+    benchmark::DoNotOptimize(item);
+    state.SetItemsProcessed(state.thread_index() == 1 ? state.iterations() : 0);  // Items passed through.
+}
+BENCHMARK(BM_mutex_spsc_queue)->Threads(2)->UseRealTime();
@@ -0,0 +1,122 @@
+//
+// Live captures of a profiler session, over loopback TCP like `HephaestusTraceCapture`. See `hp/capture_server.hpp`.
+//
+
+#include "hp/profiling.hpp"
+#include "hp/capture_server.hpp"
+
+#include <gtest/gtest.h>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <sstream>
+#include <string>
+
+namespace {
+    /// A blocking client for the capture protocol.
+    struct capture_client {
+        boost::asio::io_context io;
+        boost::asio::ip::tcp::socket sock{io};
+
+        explicit capture_client(uint16_t port) {
+            sock.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+        }
+
+        void send(const std::string &command) {
+            boost::asio::write(sock, boost::asio::buffer(command + "\n"));
+        }
+
+        /// Read one frame, returning its type, with the payload in `payload`.
+        char read_frame(std::string &payload) {
+            unsigned char head[5];
+            boost::asio::read(sock, boost::asio::buffer(head));
+            size_t size = 0;
+            for (unsigned i = 0; i < 4; i++) {
+                size |= static_cast<size_t>(head[i + 1]) << (i * 8u);
+            }
+            payload.resize(size);
+            if (size > 0) {
+                boost::asio::read(sock, boost::asio::buffer(&payload[0], size));
+            }
+            return static_cast<char>(head[0]);
+        }
+
+        /// Send a command and return the reply to it. Only valid while no capture is streaming.
+        std::string command(const std::string &cmd) {
+            send(cmd);
+            std::string payload;
+            EXPECT_EQ(read_frame(payload), 'M') << "reply to " << cmd;
+            return payload;
+        }
+    };
+}
+
+TEST(capture_server, streams_filtered_capture_over_loopback) {
+    constexpr int events_per_zone = 100;
+    const hp::zone_desc *kept = hp::register_zone("Capture Kept", "capture_test");
+    const hp::zone_desc *filtered = hp::register_zone("Capture Filtered", "capture_test");
+
+    hp::profiler_session session("Capture Test", "capture_test.trace", hp::overflow_policy::block,
+                                 hp::trace_format::none);
+    ASSERT_TRUE(session.serve_live(0));
+    ASSERT_NE(session.live_port(), 0);
+
+    capture_client client(session.live_port());
+    EXPECT_EQ(client.command("filter Kept,nonexistent"), "ok filter");
+    EXPECT_EQ(client.command("start"), "ok start");
+    EXPECT_EQ(client.command("status"), "ok capturing=1 dropped=0 filters=Kept,nonexistent");
+    EXPECT_EQ(client.command("bogus"), "error unknown command 'bogus'");
+
+    session.flush_all();  // Has the writer pick up the start, so the events below are captured.
+    for (int i = 0; i < events_per_zone; i++) {
+        auto kept_prof = session.new_profiler(kept);
+        auto filtered_prof = session.new_profiler(filtered);
+        kept_prof.start();
+        filtered_prof.start();
+        filtered_prof.stop();
+        kept_prof.stop();
+    }
+    session.flush_all();
+
+    // Trace frames may arrive before the reply to `stop`, but the end frame only comes once the writer saw it.
+    client.send("stop");
+    std::string trace, payload, stop_reply;
+    bool ended = false;
+    while (!ended) {
+        const char type = client.read_frame(payload);
+        if (type == 'T') {
+            trace += payload;
+        } else if (type == 'M') {
+            stop_reply = payload;
+            session.flush_all();
+        } else {
+            ASSERT_EQ(type, 'E');
+            EXPECT_TRUE(payload.empty());
+            ended = true;
+        }
+    }
+    EXPECT_EQ(stop_reply, "ok stop");
+    EXPECT_EQ(client.command("status"), "ok capturing=0 dropped=0 filters=Kept,nonexistent");
+
+    std::istringstream in(trace);
+    hp::trace::reader rd(in);
+    hp::trace::header head;
+    ASSERT_TRUE(rd.read_header(head));
+    EXPECT_EQ(head.session_name, "Capture Test");
+    EXPECT_EQ(head.ts_unit_ns, 1u);
+
+    int events = 0;
+    hp::trace::event ev;
+    while (rd.next(ev)) {
+        EXPECT_EQ(rd.zone(ev.zone_id).name, "Capture Kept");
+        EXPECT_EQ(rd.zone(ev.zone_id).category, "capture_test");
+        EXPECT_LE(ev.start, ev.end);
+        events++;
+    }
+    EXPECT_FALSE(rd.failed());
+    EXPECT_EQ(events, events_per_zone);
+    EXPECT_EQ(session.dropped_events(), 0u);
+}
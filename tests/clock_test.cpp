@@ -0,0 +1,37 @@
+//
+// Tick conversion of `hp::clock`, across calibration. See `hp/clock.hpp`.
+//
+
+#include "hp/clock.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+
+namespace {
+    long long steady_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+TEST(clock, ticks_keep_their_meaning_across_calibration) {
+    // Nothing else in this test binary calibrates the clock, so these ticks are taken before it.
+    const long long before_ns = steady_ns();
+    const uint64_t before = hp::clock::ticks();
+
+    hp::clock::calibrate();
+
+    const long long after_ns = steady_ns();
+    const uint64_t after = hp::clock::ticks();
+
+    EXPECT_LT(std::llabs(hp::clock::to_ns(before) - before_ns), 1000000);
+    EXPECT_LT(std::llabs(hp::clock::to_ns(after) - after_ns), 1000000);
+    EXPECT_LE(hp::clock::to_ns(before), hp::clock::to_ns(after));
+}
+
+TEST(clock, from_ns_inverts_to_ns) {
+    hp::clock::calibrate();
+    const long long ns = steady_ns();
+    EXPECT_LT(std::llabs(hp::clock::to_ns(hp::clock::from_ns(ns)) - ns), 10);
+}
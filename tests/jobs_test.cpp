@@ -0,0 +1,233 @@
+//
+// Work-stealing deque under contention, job submission and shutdown, and fibers waiting in jobs. See
+// `hp/multithreading.hpp`.
+//
+
+#include "hp/multithreading.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+    /// Block every worker of a job system until released, so jobs submitted meanwhile pile up in the queues.
+    struct worker_blocker {
+        std::atomic<unsigned> blocked{0};
+        std::atomic<bool> released{false};
+
+        void block(hp::job_system &js) {
+            for (unsigned i = 0; i < js.worker_count(); i++) {
+                js.submit([this]() {
+                    blocked++;
+                    while (!released.load()) {
+                        std::this_thread::yield();
+                    }
+                });
+            }
+            while (blocked.load() < js.worker_count()) {
+                std::this_thread::yield();
+            }
+        }
+
+        void release() {
+            released = true;
+        }
+    };
+}
+
+TEST(jobs, deque_items_taken_once_while_growing) {
+    // Items are 1..count, as 0 means "nothing". The owner pushes in bursts bigger than the deque, so it grows while
+    // thieves read from it, and pops some back itself.
+    constexpr uint64_t count = 200000;
+    constexpr int num_thieves = 3;
+    hp::work_stealing_deque<uint64_t> deque(2);
+    std::unique_ptr<std::atomic<uint8_t>[]> taken(new std::atomic<uint8_t>[count + 1]);
+    for (uint64_t i = 0; i <= count; i++) {
+        taken[i].store(0, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> done{0};
+    std::atomic<bool> pushing{true};
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < num_thieves; t++) {
+        thieves.emplace_back([&]() {
+            while (pushing.load() || !deque.empty()) {
+                if (uint64_t item = deque.steal()) {
+                    taken[item]++;
+                    done++;
+                }
+            }
+        });
+    }
+
+    uint64_t next = 1;
+    while (next <= count) {
+        const uint64_t burst = std::min<uint64_t>(count - next + 1, 1 + next % 300);
+        for (uint64_t i = 0; i < burst; i++) {
+            deque.push(next++);
+        }
+        for (uint64_t i = 0; i < burst / 2; i++) {
+            if (uint64_t item = deque.pop()) {
+                taken[item]++;
+                done++;
+            }
+        }
+    }
+    while (uint64_t item = deque.pop()) {
+        taken[item]++;
+        done++;
+    }
+    pushing = false;
+    for (auto &t : thieves) {
+        t.join();
+    }
+
+    EXPECT_EQ(done.load(), count);
+    EXPECT_TRUE(deque.empty());
+    uint64_t wrong = 0;
+    for (uint64_t i = 1; i <= count; i++) {
+        wrong += taken[i].load() != 1;
+    }
+    EXPECT_EQ(wrong, 0u);
+}
+
+TEST(jobs, submit_from_other_threads_overflows) {
+    // With every worker blocked, nothing drains the shared queue, so most of these go to the overflow deque.
+    constexpr int num_submitters = 4;
+    constexpr uint32_t jobs_per_submitter = 5000;
+    worker_blocker blocker;  // Outlives the system, whose destructor the blocked jobs may return into.
+    hp::job_system js(2);
+    blocker.block(js);
+
+    std::unique_ptr<std::atomic<uint8_t>[]> ran(new std::atomic<uint8_t>[num_submitters * jobs_per_submitter]);
+    for (uint32_t i = 0; i < num_submitters * jobs_per_submitter; i++) {
+        ran[i].store(0, std::memory_order_relaxed);
+    }
+
+    hp::job_counter counter;
+    std::vector<std::thread> submitters;
+    for (int s = 0; s < num_submitters; s++) {
+        submitters.emplace_back([&, s]() {
+            for (uint32_t i = 0; i < jobs_per_submitter; i++) {
+                const uint32_t index = s * jobs_per_submitter + i;
+                js.submit([&ran, index]() { ran[index]++; }, &counter);
+            }
+        });
+    }
+    for (auto &t : submitters) {
+        t.join();
+    }
+    EXPECT_EQ(counter.count(), num_submitters * jobs_per_submitter);
+
+    blocker.release();
+    js.wait(counter);
+    uint32_t wrong = 0;
+    for (uint32_t i = 0; i < num_submitters * jobs_per_submitter; i++) {
+        wrong += ran[i].load() != 1;
+    }
+    EXPECT_EQ(wrong, 0u);
+}
+
+TEST(jobs, shutdown_runs_queued_jobs) {
+    // Queued from outside, in the overflow deque as well, and from jobs into the workers' own deques.
+    constexpr uint32_t outer = 6000;
+    std::atomic<uint32_t> ran{0};
+    worker_blocker blocker;
+    {
+        hp::job_system js(3);
+        blocker.block(js);
+
+        for (uint32_t i = 0; i < outer; i++) {
+            js.submit([&js, &ran]() {
+                ran++;
+                js.submit([&ran]() { ran++; });
+            });
+        }
+        blocker.release();
+    }
+    EXPECT_EQ(ran.load(), 2 * outer);
+}
+
+TEST(jobs, fibers_resume_after_waiting) {
+    // Every fiber waits on a counter, on a condition, and now and then on IO, again and again. They are resumed by
+    // whichever worker polls first, so most of them move between workers on the way.
+    constexpr uint64_t num_fibers = 64, rounds = 50;
+    boost::asio::io_service io;
+    auto work = std::make_unique<boost::asio::io_service::work>(io);
+    std::thread io_thread([&io]() { io.run(); });
+    hp::io_service = &io;
+
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> ticks{0};
+    std::atomic<uint32_t> moves{0};
+    {
+        hp::job_system js(4);
+        hp::job_counter fibers;
+        for (uint64_t f = 0; f < num_fibers; f++) {
+            js.submit_fiber([&, f]() {
+                uint64_t local = 0;
+                for (uint64_t r = 0; r < rounds; r++) {
+                    // Not the thread id: `pthread_self()` is a const function, so it may be cached across the waits.
+                    const int before = js.current_worker();
+
+                    hp::job_counter child;
+                    uint64_t value = 0;  // On the fiber's stack, which stays put while it is suspended.
+                    js.submit([&value, index = f * rounds + r]() { value = index; }, &child);
+                    js.wait(child);
+                    local += value;
+
+                    const uint64_t target = ticks.load() + 1;
+                    js.submit([&ticks]() { ticks++; });
+                    js.wait_until([&ticks, target]() { return ticks.load() >= target; });
+
+                    if (r % 10 == 0) {
+                        hp::wait_io(js, [&value]() { value = 1; });
+                        local += value;
+                    }
+                    if (js.current_worker() != before) {
+                        moves++;
+                    }
+                }
+                sum += local;
+            }, &fibers);
+        }
+        js.wait(fibers);
+    }
+
+    hp::io_service = nullptr;
+    work.reset();
+    io_thread.join();
+
+    const uint64_t n = num_fibers * rounds;
+    EXPECT_EQ(sum.load(), n * (n - 1) / 2 + num_fibers * (rounds / 10));
+    EXPECT_EQ(ticks.load(), n);
+    EXPECT_GT(moves.load(), 0u);
+}
+
+TEST(jobs, parked_waiter_resumes_once_ready) {
+    struct flag_waiter : hp::job_waiter {
+        std::atomic<bool> flag{false};
+        std::atomic<int> resumed{0};
+    };
+
+    hp::job_system js(2);
+    flag_waiter w;
+    w.ready = [](hp::job_waiter &self) { return static_cast<flag_waiter &>(self).flag.load(); };
+    w.resume = [](hp::job_waiter &self) { static_cast<flag_waiter &>(self).resumed++; };
+    js.park(w);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));  // Polled plenty of times meanwhile.
+    EXPECT_EQ(w.resumed.load(), 0);
+    w.flag = true;
+    while (w.resumed.load() == 0) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_EQ(w.resumed.load(), 1);
+}
@@ -0,0 +1,73 @@
+//
+// Deferred formatting of log messages on the logging thread, and the rate limit. See `hp/logging.hpp`.
+//
+
+#include "hp/logging.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static_assert(hp::detail::is_literal_format("\"Value: {}\", 1"));
+static_assert(!hp::detail::is_literal_format("buf, 1"));
+static_assert(!hp::detail::is_literal_format("(\"Value: {}\"), 1"));
+
+namespace {
+    /// Once for the whole test binary; spdlog refuses to register the logger twice.
+    void init_test_logging() {
+        static bool initialized = [] {
+            hp::init_logging(true, false);
+            return true;
+        }();
+        (void) initialized;
+    }
+
+    std::string read_latest_log() {
+        hp::flush_logs();
+        std::ifstream file("latest.log");
+        std::stringstream ss;
+        ss << file.rdbuf();
+        return ss.str();
+    }
+}
+
+#ifdef HP_LOGGING_ENABLED
+
+TEST(logging, formats_from_buffers_before_they_change) {
+    init_test_logging();
+
+    // Only the format's pointer is kept for deferred messages, so one from a reused buffer must not be deferred.
+    char buf[64];
+    std::strcpy(buf, "From a buffer: {}");
+    HP_WARN(buf, 42);
+    std::strcpy(buf, "Overwritten: {}");
+    HP_WARN("From a literal: {}", 43);
+
+    const std::string log = read_latest_log();
+    EXPECT_NE(log.find("From a buffer: 42"), std::string::npos);
+    EXPECT_EQ(log.find("Overwritten"), std::string::npos);
+    EXPECT_NE(log.find("From a literal: 43"), std::string::npos);
+}
+
+TEST(logging, rate_limit_spares_fatal_messages) {
+    init_test_logging();
+    hp::set_log_rate_limit(1);
+
+    for (int i = 0; i < 5; i++) {
+        HP_WARN("Limited warning {}", i);
+        HP_FATAL("Unlimited fatal {}", i);
+    }
+    hp::set_log_rate_limit(10);
+
+    const std::string log = read_latest_log();
+    EXPECT_NE(log.find("Limited warning 0"), std::string::npos);
+    EXPECT_EQ(log.find("Limited warning 4"), std::string::npos);
+    for (int i = 0; i < 5; i++) {
+        EXPECT_NE(log.find("Unlimited fatal " + std::to_string(i)), std::string::npos);
+    }
+}
+
+#endif
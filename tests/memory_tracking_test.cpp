@@ -0,0 +1,96 @@
+//
+// Live and peak bytes of memory counters, and the samples they leave in traces. See `hp/memory_tracking.hpp`.
+//
+
+#include "hp/memory_tracking.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <vector>
+
+namespace {
+    /// Every sample of the counter named `name` in a binary trace file.
+    std::vector<hp::trace::counter> read_samples(const char *path, const std::string &name) {
+        std::ifstream in(path, std::ios::binary);
+        hp::trace::reader rd(in);
+        hp::trace::header head;
+        EXPECT_TRUE(rd.read_header(head));
+
+        std::vector<hp::trace::counter> ret;
+        hp::trace::event ev;
+        hp::trace::counter ctr;
+        hp::trace::record_kind kind;
+        while (rd.next_record(ev, ctr, kind)) {
+            if (kind == hp::trace::record_kind::counter && rd.zone(ctr.zone_id).name == name) {
+                ret.push_back(ctr);
+            }
+        }
+        EXPECT_FALSE(rd.failed());
+        return ret;
+    }
+}
+
+TEST(memory_tracking, interned_counters_are_shared) {
+    auto &a = hp::intern_memory_counter("memory_test shared", "test");
+    auto &b = hp::intern_memory_counter("memory_test shared", "other");
+    EXPECT_EQ(&a, &b);
+    EXPECT_STREQ(b.category, "test");  // The first call sets it.
+
+    a.on_alloc(64);
+    EXPECT_EQ(b.bytes(), 64);
+    b.on_free(64);
+    EXPECT_EQ(a.bytes(), 0);
+}
+
+TEST(memory_tracking, samples_current_and_peak_bytes) {
+    constexpr const char *path = "memory_tracking_test.trace";
+    auto &ctr = hp::intern_memory_counter("memory_test sampled", "test");
+    hp::sample_memory_counters(nullptr, 0, 0);  // Start every counter on a fresh frame.
+
+    {
+        hp::profiler_session session("Memory Test", path, hp::overflow_policy::block, hp::trace_format::binary);
+
+        // Frame 1: 150 bytes at the peak, 50 left.
+        ctr.on_alloc(100);
+        ctr.on_alloc(50);
+        ctr.on_free(100);
+        EXPECT_EQ(ctr.bytes(), 50);
+        hp::sample_memory_counters(&session, 1, hp::clock::ticks());
+
+        // Frame 2: Nothing happened, but the peak is back down to what is left.
+        hp::sample_memory_counters(&session, 2, hp::clock::ticks());
+
+        // Frame 3: Unchanged since the last sample, so there is none.
+        hp::sample_memory_counters(&session, 3, hp::clock::ticks());
+
+        // Frame 4: Allocated and freed again within the frame.
+        ctr.on_alloc(30);
+        ctr.on_free(30);
+        hp::sample_memory_counters(&session, 4, hp::clock::ticks());
+
+        // Without a session nothing is recorded, but the frame still ends.
+        ctr.on_alloc(1000);
+        ctr.on_free(1000);
+        hp::sample_memory_counters(nullptr, 5, hp::clock::ticks());
+        hp::sample_memory_counters(&session, 6, hp::clock::ticks());
+    }
+
+    const auto samples = read_samples(path, "memory_test sampled");
+    ASSERT_EQ(samples.size(), 4u);
+
+    const struct {
+        uint32_t frame;
+        long long bytes, peak_bytes;
+        unsigned long long allocations;
+    } expected[] = {{1, 50, 150, 2}, {2, 50, 50, 0}, {4, 50, 80, 1}, {6, 50, 50, 0}};
+    for (size_t i = 0; i < samples.size(); i++) {
+        EXPECT_EQ(samples[i].frame, expected[i].frame) << "sample " << i;
+        EXPECT_EQ(samples[i].bytes, expected[i].bytes) << "sample " << i;
+        EXPECT_EQ(samples[i].peak_bytes, expected[i].peak_bytes) << "sample " << i;
+        EXPECT_EQ(samples[i].allocations, expected[i].allocations) << "sample " << i;
+        if (i > 0) {
+            EXPECT_LE(samples[i - 1].time, samples[i].time);
+        }
+    }
+}
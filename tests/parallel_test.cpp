@@ -0,0 +1,117 @@
+//
+// Results of the parallel algorithms, against their serial std counterparts. See `hp/parallel.hpp`.
+//
+
+#include "hp/parallel.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    /// More workers than this machine might have cores, so chunks really do run concurrently and out of order.
+    hp::job_system &test_jobs() {
+        static hp::job_system *jobs = new hp::job_system(4);
+        return *jobs;
+    }
+
+    std::vector<uint32_t> random_values(size_t count, uint32_t max) {
+        std::mt19937 rng(1234);
+        std::uniform_int_distribution<uint32_t> dist(0, max);
+        std::vector<uint32_t> ret(count);
+        for (auto &v : ret) {
+            v = dist(rng);
+        }
+        return ret;
+    }
+}
+
+TEST(parallel, for_each_visits_every_element_once) {
+    std::vector<uint32_t> v(100003, 0);
+    hp::parallel_for_each(test_jobs(), v, [](uint32_t &x) { x++; }, 7);
+    EXPECT_EQ(std::count(v.begin(), v.end(), 1u), static_cast<long>(v.size()));
+}
+
+TEST(parallel, for_each_small_misaligned_ranges) {
+    // Elements starting part way into a cache line, in ranges just above the grain size, where a split point rounded
+    // down to a cache line would fall before the range.
+    struct view {
+        uint32_t *ptr;
+        size_t count;
+
+        uint32_t *data() const { return ptr; }
+        size_t size() const { return count; }
+    };
+
+    alignas(64) uint32_t buf[96];
+    for (size_t offset = 0; offset < 16; offset++) {
+        for (size_t count = 1; count <= 48; count++) {
+            std::fill(std::begin(buf), std::end(buf), 0u);
+            view v{buf + offset, count};
+            hp::parallel_for_each(test_jobs(), v, [](uint32_t &x) { x++; }, 16);
+
+            for (size_t i = 0; i < std::size(buf); i++) {
+                const bool inside = i >= offset && i < offset + count;
+                ASSERT_EQ(buf[i], inside ? 1u : 0u) << "offset " << offset << ", count " << count << ", index " << i;
+            }
+        }
+    }
+}
+
+TEST(parallel, reduce_matches_accumulate) {
+    const auto v = random_values(1000003, 1000);
+    const uint64_t expected = std::accumulate(v.begin(), v.end(), uint64_t{0});
+    const auto sum = [&v](size_t b, size_t e, uint64_t acc) {
+        for (; b < e; b++) {
+            acc += v[b];
+        }
+        return acc;
+    };
+
+    for (size_t grain : {size_t{0}, size_t{1}, size_t{1000}, v.size()}) {
+        EXPECT_EQ(hp::parallel_reduce(test_jobs(), 0, v.size(), uint64_t{0}, sum, std::plus<>(), grain), expected)
+                << "grain " << grain;
+    }
+    EXPECT_EQ(hp::parallel_reduce(test_jobs(), 5, 5, uint64_t{42}, sum, std::plus<>()), 42u);
+}
+
+TEST(parallel, reduce_combines_in_order) {
+    // Concatenation isn't commutative, so any chunk combined out of order shows up in the result.
+    const auto digits = [](size_t b, size_t e, std::string acc) {
+        for (; b < e; b++) {
+            acc += static_cast<char>('0' + b % 10);
+        }
+        return acc;
+    };
+    std::string expected = digits(0, 5000, "");
+    EXPECT_EQ(hp::parallel_reduce(test_jobs(), 0, 5000, std::string(), digits, std::plus<>(), 13), expected);
+}
+
+TEST(parallel, sort_matches_std_sort) {
+    // Few distinct values as well, for long runs of elements equal to the pivot.
+    for (uint32_t max : {1u, 16u, 0xffffffffu}) {
+        auto v = random_values(200003, max);
+        auto expected = v;
+        std::sort(expected.begin(), expected.end());
+
+        hp::parallel_sort(test_jobs(), v.begin(), v.end(), std::less<>(), 64);
+        EXPECT_EQ(v, expected) << "max " << max;
+    }
+}
+
+TEST(parallel, sort_with_comparator_and_tiny_ranges) {
+    auto v = random_values(50000, 1000000);
+    auto expected = v;
+    std::sort(expected.begin(), expected.end(), std::greater<>());
+    hp::parallel_sort(test_jobs(), v.begin(), v.end(), std::greater<>());
+    EXPECT_EQ(v, expected);
+
+    std::vector<uint32_t> one{3};
+    hp::parallel_sort(test_jobs(), one.begin(), one.end());
+    EXPECT_EQ(one, std::vector<uint32_t>{3});
+    hp::parallel_sort(test_jobs(), one.begin(), one.begin());
+}
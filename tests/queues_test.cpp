@@ -0,0 +1,181 @@
+//
+// Ordering, capacity and index wraparound of the lock-free queues, under contention. See `hp/queues.hpp`.
+//
+
+#include "hp/queues.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    constexpr int num_producers = 4;
+    constexpr int num_consumers = 4;
+    constexpr uint64_t items_per_producer = 100000;
+
+    /// Items carry their producer in the high bits and a sequence number starting at 1 in the low bits.
+    inline uint64_t make_item(uint64_t producer, uint64_t seq) {
+        return producer << 32u | seq;
+    }
+
+    /**
+     * Push `items_per_producer` items from each of `num_producers` threads, and pop them on `num_consumers` threads.
+     * Every consumer must see each producer's items in order, and all of them exactly once between them.
+     */
+    void mpmc_stress(hp::mpmc_queue<uint64_t> &queue) {
+        std::atomic<uint64_t> popped{0};
+        std::atomic<uint64_t> sum{0};
+        std::atomic<int> order_errors{0};
+
+        std::vector<std::thread> threads;
+        for (int p = 0; p < num_producers; p++) {
+            threads.emplace_back([&queue, p] {
+                for (uint64_t i = 1; i <= items_per_producer; i++) {
+                    while (!queue.try_push(make_item(p, i))) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (int c = 0; c < num_consumers; c++) {
+            threads.emplace_back([&] {
+                uint64_t last[num_producers] = {};
+                uint64_t local_sum = 0, item;
+                while (popped.load(std::memory_order_relaxed) < num_producers * items_per_producer) {
+                    if (!queue.try_pop(item)) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    const uint64_t producer = item >> 32u, seq = item & 0xffffffffu;
+                    if (producer >= num_producers || seq <= last[producer]) {
+                        order_errors++;
+                    } else {
+                        last[producer] = seq;
+                    }
+                    local_sum += seq;
+                    popped++;
+                }
+                sum += local_sum;
+            });
+        }
+        for (auto &t : threads) {
+            t.join();
+        }
+
+        EXPECT_EQ(order_errors.load(), 0);
+        EXPECT_EQ(popped.load(), num_producers * items_per_producer);
+        EXPECT_EQ(sum.load(), num_producers * items_per_producer * (items_per_producer + 1) / 2);
+        uint64_t item;
+        EXPECT_FALSE(queue.try_pop(item));
+        EXPECT_EQ(queue.size(), 0u);
+    }
+}
+
+TEST(queues, mpmc_stress) {
+    hp::mpmc_queue<uint64_t> queue(1024);
+    mpmc_stress(queue);
+}
+
+TEST(queues, mpmc_stress_small_queue) {
+    // Full and empty nearly all the time, so the lap checks on both sides get exercised.
+    hp::mpmc_queue<uint64_t> queue(2);
+    mpmc_stress(queue);
+}
+
+TEST(queues, mpmc_stress_across_index_wraparound) {
+    hp::mpmc_queue<uint64_t> queue(64, SIZE_MAX - num_producers * items_per_producer / 2);
+    mpmc_stress(queue);
+}
+
+TEST(queues, mpmc_full_and_empty) {
+    hp::mpmc_queue<std::string> queue(4);
+    std::string out;
+    EXPECT_FALSE(queue.try_pop(out));
+
+    for (int i = 0; i < 4; i++) {
+        EXPECT_TRUE(queue.try_push(std::to_string(i)));
+    }
+    EXPECT_EQ(queue.size(), 4u);
+
+    std::string rejected = "rejected";
+    EXPECT_FALSE(queue.try_push(std::move(rejected)));
+    EXPECT_EQ(rejected, "rejected");  // Left untouched when full.
+
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(queue.try_pop(out));
+        EXPECT_EQ(out, std::to_string(i));
+    }
+    EXPECT_FALSE(queue.try_pop(out));
+    EXPECT_EQ(queue.size(), 0u);
+}
+
+TEST(queues, mpmc_wraps_past_size_max) {
+    // Every fill level, across several laps either side of the wraparound.
+    hp::mpmc_queue<uint64_t> queue(4, SIZE_MAX - 10);
+    uint64_t next_push = 0, next_pop = 0, item;
+    for (int round = 0; round < 40; round++) {
+        const int fill = round % 5;
+        for (int i = 0; i < fill; i++) {
+            ASSERT_TRUE(queue.try_push(next_push++));
+        }
+        EXPECT_EQ(queue.size(), static_cast<size_t>(fill));
+        if (fill == 4) {
+            EXPECT_FALSE(queue.try_push(next_push));
+        }
+        for (int i = 0; i < fill; i++) {
+            ASSERT_TRUE(queue.try_pop(item));
+            EXPECT_EQ(item, next_pop++);
+        }
+        EXPECT_FALSE(queue.try_pop(item));
+    }
+}
+
+TEST(queues, spsc_full_and_empty) {
+    hp::spsc_queue<std::string> queue(2);
+    std::string out;
+    EXPECT_FALSE(queue.try_pop(out));
+    EXPECT_TRUE(queue.try_push("a"));
+    EXPECT_TRUE(queue.try_push("b"));
+
+    std::string rejected = "rejected";
+    EXPECT_FALSE(queue.try_push(std::move(rejected)));
+    EXPECT_EQ(rejected, "rejected");
+
+    ASSERT_TRUE(queue.try_pop(out));
+    EXPECT_EQ(out, "a");
+    ASSERT_TRUE(queue.try_pop(out));
+    EXPECT_EQ(out, "b");
+    EXPECT_FALSE(queue.try_pop(out));
+}
+
+TEST(queues, spsc_keeps_order_across_index_wraparound) {
+    constexpr uint64_t count = 1000000;
+    hp::spsc_queue<uint64_t> queue(16, SIZE_MAX - count / 2);
+
+    std::thread producer([&queue] {
+        for (uint64_t i = 0; i < count; i++) {
+            while (!queue.try_push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint64_t expected = 0, item;
+    bool in_order = true;
+    while (expected < count) {
+        if (!queue.try_pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        in_order = in_order && item == expected;
+        expected++;
+    }
+    producer.join();
+
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(queue.size(), 0u);
+}
@@ -0,0 +1,176 @@
+//
+// Ordering, reuse and lifetime of task graphs. See `hp/task_graph.hpp`.
+//
+
+#include "hp/task_graph.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+    hp::job_system &test_jobs() {
+        static hp::job_system *jobs = new hp::job_system(4);
+        return *jobs;
+    }
+
+    /// Order in which tasks ran, across threads.
+    struct run_log {
+        std::mutex mtx;
+        std::vector<int> order;
+
+        void ran(int id) {
+            std::lock_guard<std::mutex> lg(mtx);
+            order.push_back(id);
+        }
+
+        size_t position(int id) {
+            std::lock_guard<std::mutex> lg(mtx);
+            for (size_t i = 0; i < order.size(); i++) {
+                if (order[i] == id) {
+                    return i;
+                }
+            }
+            return SIZE_MAX;
+        }
+    };
+}
+
+TEST(task_graph, diamond_runs_in_dependency_order) {
+    run_log log;
+    hp::task_graph graph;
+    auto top = graph.add("Top", [&]() { log.ran(0); });
+    auto left = graph.add("Left", [&]() { log.ran(1); }, {top});
+    auto right = graph.add("Right", [&]() { log.ran(2); }, {top});
+    graph.add("Bottom", [&]() { log.ran(3); }, {left, right});
+    EXPECT_EQ(graph.size(), 4u);
+
+    graph.run_and_wait(test_jobs());
+    EXPECT_TRUE(graph.done());
+    ASSERT_EQ(log.order.size(), 4u);
+    EXPECT_EQ(log.position(0), 0u);
+    EXPECT_LT(log.position(1), log.position(3));
+    EXPECT_LT(log.position(2), log.position(3));
+}
+
+TEST(task_graph, chain_runs_in_order) {
+    constexpr int length = 100;
+    run_log log;
+    hp::task_graph graph;
+    hp::task_graph::task prev = graph.add("Link", [&]() { log.ran(0); });
+    for (int i = 1; i < length; i++) {
+        prev = graph.add("Link", [&log, i]() { log.ran(i); }, {prev});
+    }
+
+    graph.run_and_wait(test_jobs());
+    ASSERT_EQ(log.order.size(), static_cast<size_t>(length));
+    for (int i = 0; i < length; i++) {
+        EXPECT_EQ(log.order[i], i);
+    }
+}
+
+TEST(task_graph, runs_again_after_finishing) {
+    // Many roots and a wide fan-in, so every run resets plenty of counters.
+    constexpr int width = 64;
+    std::atomic<int> leaves{0}, joins{0};
+    hp::task_graph graph;
+    std::vector<hp::task_graph::task> roots;
+    for (int i = 0; i < width; i++) {
+        roots.push_back(graph.add("Leaf", [&]() { leaves++; }));
+    }
+    auto join = graph.add("Join", [&]() {
+        EXPECT_EQ(leaves.load() % width, 0);
+        joins++;
+    });
+    for (auto root : roots) {
+        graph.precede(root, join);
+    }
+
+    for (int run = 1; run <= 50; run++) {
+        ASSERT_TRUE(graph.run(test_jobs()));
+        graph.wait();
+        EXPECT_EQ(leaves.load(), run * width);
+        EXPECT_EQ(joins.load(), run);
+    }
+}
+
+TEST(task_graph, rejects_cycles) {
+    std::atomic<int> ran{0};
+    hp::task_graph graph;
+    auto a = graph.add("A", [&]() { ran++; });
+    auto b = graph.add("B", [&]() { ran++; }, {a});
+    graph.add("C", [&]() { ran++; });
+    graph.precede(b, a);
+
+    EXPECT_FALSE(graph.run(test_jobs()));
+    EXPECT_FALSE(graph.run(test_jobs()));  // Still rejected once compiled.
+    EXPECT_TRUE(graph.done());
+    graph.wait();
+    EXPECT_EQ(ran.load(), 0);
+}
+
+TEST(task_graph, continues_with_last_ready_successor) {
+    // A task runs on the thread that made it ready last, so a chain never leaves the thread it started on, and of
+    // several successors made ready at once, the last one stays on that thread.
+    std::thread::id first_id, second_id, third_id, fork_id;
+    hp::task_graph graph;
+    auto first = graph.add("First", [&]() { first_id = std::this_thread::get_id(); });
+    auto second = graph.add("Second", [&]() { second_id = std::this_thread::get_id(); }, {first});
+    auto third = graph.add("Third", [&]() { third_id = std::this_thread::get_id(); }, {second});
+    graph.add("Submitted", []() {}, {third});
+    graph.add("Continued", [&]() { fork_id = std::this_thread::get_id(); }, {third});
+
+    for (int run = 0; run < 20; run++) {
+        graph.run_and_wait(test_jobs());
+        EXPECT_EQ(second_id, first_id);
+        EXPECT_EQ(third_id, first_id);
+        EXPECT_EQ(fork_id, first_id);
+    }
+}
+
+TEST(task_graph, wait_and_destroy_while_running) {
+    std::atomic<bool> release{false}, finished{false};
+    const auto blocking = [&]() {
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+        finished = true;
+    };
+
+    {
+        hp::task_graph graph;
+        graph.add("Blocking", blocking);
+        ASSERT_TRUE(graph.run(test_jobs()));
+        EXPECT_FALSE(graph.done());
+        EXPECT_FALSE(graph.run(test_jobs()));  // Still running.
+
+        std::thread releaser([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            release = true;
+        });
+        graph.wait();
+        EXPECT_TRUE(graph.done());
+        EXPECT_TRUE(finished.load());
+        releaser.join();
+    }
+
+    release = false;
+    finished = false;
+    auto graph = std::make_unique<hp::task_graph>();
+    auto first = graph->add("Blocking", blocking);
+    graph->add("After", []() {}, {first});
+    ASSERT_TRUE(graph->run(test_jobs()));
+
+    std::thread releaser([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        release = true;
+    });
+    graph.reset();  // Waits for both tasks, so they never touch a destroyed graph.
+    EXPECT_TRUE(finished.load());
+    releaser.join();
+}
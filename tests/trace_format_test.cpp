@@ -0,0 +1,123 @@
+//
+// Encoding and decoding of binary traces, including corrupt input. See `hp/trace_format.hpp`.
+//
+
+#include "hp/trace_format.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+namespace {
+    std::string encode_trace() {
+        hp::trace::encoder enc;
+        fmt::memory_buffer buf;
+        hp::trace::header head;
+        head.session_name = "Test Session";
+        enc.write_header(buf, head);
+
+        hp::trace::zone_info zone;
+        zone.name = "zone";
+        zone.category = "scope";
+        zone.file = "trace_format_test.cpp";
+        zone.line = 42;
+        enc.write_zone(buf, 3, zone);
+        enc.write_event(buf, 3, 7, 100, 200, 1000, 1500);
+        enc.write_event(buf, 3, 8, 100, 200, 2000, 2100);
+        return std::string(buf.data(), buf.size());
+    }
+
+    /// Bytes of a trace with just a header, to append hand made records to.
+    std::string header_only() {
+        fmt::memory_buffer buf;
+        hp::trace::encoder().write_header(buf, hp::trace::header());
+        return std::string(buf.data(), buf.size());
+    }
+
+    std::string varint(uint64_t val) {
+        fmt::memory_buffer buf;
+        hp::trace::put_varint(buf, val);
+        return std::string(buf.data(), buf.size());
+    }
+
+    /// Read every record, and report whether the reader failed.
+    bool read_fails(const std::string &bytes) {
+        std::istringstream in(bytes);
+        hp::trace::reader rd(in);
+        hp::trace::header head;
+        if (!rd.read_header(head)) {
+            return true;
+        }
+
+        hp::trace::event ev;
+        while (rd.next(ev)) {}
+        return rd.failed();
+    }
+}
+
+TEST(trace_format, round_trip) {
+    std::istringstream in(encode_trace());
+    hp::trace::reader rd(in);
+    hp::trace::header head;
+    ASSERT_TRUE(rd.read_header(head));
+    EXPECT_EQ(head.session_name, "Test Session");
+
+    hp::trace::event ev;
+    ASSERT_TRUE(rd.next(ev));
+    EXPECT_EQ(ev.zone_id, 3u);
+    EXPECT_EQ(ev.frame, 7u);
+    EXPECT_EQ(ev.start, 1000);
+    EXPECT_EQ(ev.end, 1500);
+    EXPECT_EQ(rd.zone(3).name, "zone");
+    EXPECT_EQ(rd.zone(3).line, 42u);
+    EXPECT_EQ(rd.thread(ev.thread_index).thread, 200u);
+
+    ASSERT_TRUE(rd.next(ev));
+    EXPECT_EQ(ev.frame, 8u);
+    EXPECT_EQ(ev.start, 2000);
+    EXPECT_EQ(ev.end, 2100);
+
+    EXPECT_FALSE(rd.next(ev));
+    EXPECT_FALSE(rd.failed());
+}
+
+TEST(trace_format, truncated_trace_fails) {
+    std::string bytes = encode_trace();
+    for (size_t len = sizeof(hp::trace::magic); len < bytes.size(); len++) {
+        std::istringstream in(bytes.substr(0, len));
+        hp::trace::reader rd(in);
+        hp::trace::header head;
+        if (!rd.read_header(head)) {
+            continue;
+        }
+
+        hp::trace::event ev;
+        size_t events = 0;
+        while (rd.next(ev)) {
+            events++;
+        }
+        EXPECT_LT(events, 2u) << "at length " << len;
+    }
+}
+
+TEST(trace_format, huge_string_length_fails) {
+    // A zone name claiming to be 2^62 bytes long, followed by nothing.
+    std::string bytes = header_only() + static_cast<char>(hp::trace::record_type::name_def) + varint(1) +
+                        varint(1ull << 62u);
+    EXPECT_TRUE(read_fails(bytes));
+
+    // Short enough to pass the limit, but longer than what follows.
+    bytes = header_only() + static_cast<char>(hp::trace::record_type::name_def) + varint(1) +
+            varint(hp::trace::reader::max_string_size) + "abc";
+    EXPECT_TRUE(read_fails(bytes));
+}
+
+TEST(trace_format, huge_ids_fail) {
+    std::string bytes = header_only() + static_cast<char>(hp::trace::record_type::name_def) +
+                        varint(hp::trace::reader::max_id + 1) + varint(1) + "a";
+    EXPECT_TRUE(read_fails(bytes));
+
+    bytes = header_only() + static_cast<char>(hp::trace::record_type::thread_def) + varint(1ull << 40u) + varint(1) +
+            varint(1);
+    EXPECT_TRUE(read_fails(bytes));
+}
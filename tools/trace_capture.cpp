@@ -0,0 +1,219 @@
+//
+// HephaestusTraceCapture: Captures a trace from a running program over loopback, see `hp/capture_server.hpp`.
+// Writes a binary trace, or Chrome trace JSON if the output file ends in ".json".
+//
+
+#include "hp/trace_format.hpp"
+#include "trace_json.hpp"
+
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using boost::asio::ip::tcp;
+
+static void print_usage(const char *argv0) {
+    std::cerr << "Usage: " << argv0 << " <out.hptrace|out.json> [--port <port>] [--filter <a>,<b>,...] [--seconds <n>]"
+              << std::endl;
+}
+
+/// Reads frames until the server ends the capture. Everything runs on one thread, so no locking is needed.
+class capture_client {
+public:
+    capture_client(boost::asio::io_context &io, tcp::socket &sock, std::ostream &trace)
+            : io(io), sock(sock), trace(trace), signals(io, SIGINT, SIGTERM), timer(io) {}
+
+    void run(int seconds) {
+        signals.async_wait([this](const boost::system::error_code &ec, int) {
+            if (!ec) {
+                on_interrupt();
+            }
+        });
+
+        if (seconds > 0) {
+            timer.expires_after(std::chrono::seconds(seconds));
+            timer.async_wait([this](const boost::system::error_code &ec) {
+                if (!ec) {
+                    stop();
+                }
+            });
+        }
+
+        read_frame();
+        io.run();
+    }
+
+    bool ended = false;
+    unsigned long long trace_bytes = 0;
+
+private:
+    void on_interrupt() {
+        if (stopping) {  // Second interrupt: Don't wait for the server.
+            finish();
+            return;
+        }
+        stop();
+        signals.async_wait([this](const boost::system::error_code &ec, int) {
+            if (!ec) {
+                on_interrupt();
+            }
+        });
+    }
+
+    void stop() {
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+        std::cerr << "Stopping capture..." << std::endl;
+        boost::asio::async_write(sock, boost::asio::buffer(stop_cmd), [](const boost::system::error_code &, size_t) {});
+    }
+
+    void finish() {
+        boost::system::error_code ec;
+        timer.cancel();
+        signals.cancel(ec);
+        sock.close(ec);
+    }
+
+    void read_frame() {
+        boost::asio::async_read(sock, boost::asio::buffer(frame_head), [this](const boost::system::error_code &ec,
+                                                                              size_t) {
+            if (ec) {
+                if (!ended && ec != boost::asio::error::operation_aborted) {
+                    std::cerr << "Lost connection: " << ec.message() << std::endl;
+                }
+                finish();
+                return;
+            }
+
+            size_t len = 0;
+            for (unsigned i = 0; i < 4; i++) {
+                len |= static_cast<size_t>(static_cast<unsigned char>(frame_head[i + 1])) << (i * 8u);
+            }
+            payload.resize(len);
+            boost::asio::async_read(sock, boost::asio::buffer(payload), [this](const boost::system::error_code &ec,
+                                                                               size_t) {
+                if (ec) {
+                    std::cerr << "Lost connection: " << ec.message() << std::endl;
+                    finish();
+                    return;
+                }
+                handle_frame();
+            });
+        });
+    }
+
+    void handle_frame() {
+        switch (frame_head[0]) {
+            case ('T'): {
+                trace.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+                trace_bytes += payload.size();
+                break;
+            }
+            case ('M'): {
+                std::cerr << "Server: " << payload << std::endl;
+                break;
+            }
+            case ('E'): {
+                ended = true;
+                finish();
+                return;
+            }
+            default: {
+                std::cerr << "Unknown frame type '" << frame_head[0] << "'!" << std::endl;
+                break;
+            }
+        }
+        read_frame();
+    }
+
+    boost::asio::io_context &io;
+    tcp::socket &sock;
+    std::ostream &trace;
+    boost::asio::signal_set signals;
+    boost::asio::steady_timer timer;
+    std::array<char, 5> frame_head{};
+    std::string payload;
+    bool stopping = false;
+    const std::string stop_cmd = "stop\n";
+};
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc % 2 != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::string out_path = argv[1];
+    std::string port = "28077";  // `hp::profiler_session::default_live_port`
+    std::string filter;
+    int seconds = 0;
+    for (int i = 2; i < argc; i += 2) {
+        std::string opt = argv[i];
+        if (opt == "--port") {
+            port = argv[i + 1];
+        } else if (opt == "--filter") {
+            filter = argv[i + 1];
+        } else if (opt == "--seconds") {
+            seconds = std::atoi(argv[i + 1]);
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    bool json = out_path.size() >= 5 && out_path.compare(out_path.size() - 5, 5, ".json") == 0;
+    std::ofstream out(out_path, json ? std::ios::out : std::ios::out | std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Cannot open '" << out_path << "' for writing!" << std::endl;
+        return 1;
+    }
+
+    boost::asio::io_context io;
+    tcp::socket sock(io);
+    boost::system::error_code ec;
+    tcp::resolver resolver(io);
+    boost::asio::connect(sock, resolver.resolve("127.0.0.1", port, ec), ec);
+    if (ec) {
+        std::cerr << "Cannot connect to 127.0.0.1:" << port << ": " << ec.message() << std::endl;
+        return 1;
+    }
+
+    std::string cmds = "filter " + filter + "\nstart\n";
+    boost::asio::write(sock, boost::asio::buffer(cmds), ec);
+    if (ec) {
+        std::cerr << "Cannot send commands: " << ec.message() << std::endl;
+        return 1;
+    }
+
+    std::cerr << "Capturing from 127.0.0.1:" << port << (seconds > 0 ? "" : ". Press Ctrl+C to stop.") << std::endl;
+
+    std::stringstream captured;  // Only used for JSON, which is converted once the capture is complete.
+    capture_client client(io, sock, json ? static_cast<std::ostream &>(captured) : out);
+    client.run(seconds);
+
+    if (json) {
+        hp::trace::reader reader(captured);
+        hp::trace::header head;
+        if (!reader.read_header(head)) {
+            std::cerr << "Nothing was captured!" << std::endl;
+            return 2;
+        }
+        unsigned long long n_events = write_chrome_json(reader, head, out, nullptr);
+        std::cout << "Captured " << n_events << " events to '" << out_path << "'" << std::endl;
+    } else {
+        std::cout << "Captured " << client.trace_bytes << " bytes to '" << out_path << "'" << std::endl;
+    }
+
+    return client.ended ? 0 : 2;
+}
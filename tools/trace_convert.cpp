@@ -0,0 +1,86 @@
+//
+// HephaestusTraceConvert: Converts binary profiler traces (see `hp/trace_format.hpp`) to Chrome trace JSON,
+// and optionally summarizes them per zone as CSV.
+//
+
+#include "hp/trace_format.hpp"
+#include "trace_json.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+static void print_usage(const char *argv0) {
+    std::cerr << "Usage: " << argv0 << " <trace.hptrace> <out.json> [--csv <summary.csv>]" << std::endl;
+}
+
+static std::string escape(std::string str) {
+    std::replace(str.begin(), str.end(), '"', '\'');
+    return str;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3 && argc != 5) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const char *csv_path = nullptr;
+    if (argc == 5) {
+        if (std::string(argv[3]) != "--csv") {
+            print_usage(argv[0]);
+            return 1;
+        }
+        csv_path = argv[4];
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Cannot open '" << argv[1] << "'!" << std::endl;
+        return 1;
+    }
+
+    hp::trace::reader reader(in);
+    hp::trace::header head;
+    if (!reader.read_header(head)) {
+        std::cerr << "'" << argv[1] << "' is not a binary trace, or was written by a newer version!" << std::endl;
+        return 1;
+    }
+
+    std::ofstream out(argv[2]);
+    if (!out.is_open()) {
+        std::cerr << "Cannot open '" << argv[2] << "' for writing!" << std::endl;
+        return 1;
+    }
+
+    // The CSV summary is in microseconds.
+    const double to_us = static_cast<double>(head.ts_unit_ns) / 1000.0;
+
+    std::map<uint32_t, zone_summary> summary;
+    unsigned long long n_events = write_chrome_json(reader, head, out, csv_path != nullptr ? &summary : nullptr);
+
+    if (reader.failed()) {
+        std::cerr << "Warning: '" << argv[1] << "' is truncated or malformed! Converted the first " << n_events
+                  << " events." << std::endl;
+    }
+
+    if (csv_path != nullptr) {
+        std::ofstream csv(csv_path);
+        if (!csv.is_open()) {
+            std::cerr << "Cannot open '" << csv_path << "' for writing!" << std::endl;
+            return 1;
+        }
+
+        csv << "name,category,file,line,count,total_us,min_us,avg_us,max_us\n";
+        for (const auto &entry : summary) {
+            const auto &zone = reader.zone(entry.first);
+            const auto &sum = entry.second;
+            csv << fmt::format("\"{}\",\"{}\",\"{}\",{},{},{},{},{},{}\n", escape(zone.name), escape(zone.category),
+                               escape(zone.file), zone.line, sum.count, sum.total * to_us, sum.min * to_us,
+                               static_cast<double>(sum.total) / sum.count * to_us, sum.max * to_us);
+        }
+    }
+
+    std::cout << "Converted " << n_events << " events from '" << argv[1] << "' to '" << argv[2] << "'" << std::endl;
+    return reader.failed() ? 2 : 0;
+}
@@ -0,0 +1,104 @@
+//
+// Conversion of binary profiler traces to Chrome trace JSON. See `trace_json.hpp`.
+//
+
+#include "trace_json.hpp"
+
+#include <algorithm>
+
+/// Chrome traces are in microseconds; Print exactly, without trailing zeroes for whole microseconds.
+static void put_us(fmt::memory_buffer &buf, long long ticks, uint64_t ts_unit_ns) {
+    long long ns = ticks * static_cast<long long>(ts_unit_ns);
+    if (ns % 1000 == 0) {
+        fmt::format_to(std::back_inserter(buf), "{}", ns / 1000);
+    } else {
+        fmt::format_to(std::back_inserter(buf), "{}.{:03}", ns / 1000, ns % 1000);
+    }
+}
+
+static std::string escape(std::string str) {
+    std::replace(str.begin(), str.end(), '"', '\'');
+    return str;
+}
+
+unsigned long long write_chrome_json(hp::trace::reader &reader, const hp::trace::header &head, std::ostream &out,
+                                     std::map<uint32_t, zone_summary> *summary) {
+    fmt::memory_buffer buf;
+    fmt::format_to(std::back_inserter(buf),
+                   R"({{"name": "{0}", "compile-datetime": "{1}", "current-datetime": "{2}", "traceEvents":[)",
+                   escape(head.session_name), escape(head.compile_datetime), escape(head.current_datetime));
+
+    std::vector<std::string> prefixes;
+    hp::trace::event ev;
+    hp::trace::counter ctr;
+    hp::trace::record_kind kind;
+    bool first = true;
+    unsigned long long n_events = 0;
+
+    while (reader.next_record(ev, ctr, kind)) {
+        if (kind == hp::trace::record_kind::counter) {
+            const auto &zone = reader.zone(ctr.zone_id);
+            const std::string name = escape(zone.name), cat = escape(zone.category);
+            const char *series[3] = {"bytes", "peak", "allocations"};
+            const long long values[3] = {ctr.bytes, ctr.peak_bytes, static_cast<long long>(ctr.allocations)};
+            for (unsigned i = 0; i < 3; i++) {  // One track per value, as `profiler_session` writes them.
+                fmt::format_to(std::back_inserter(buf), R"({}{{"name": "{} {}", "cat": "{}", "ph": "C", "pid": {}, "ts": )",
+                               first ? "" : ", ", name, series[i], cat, ctr.pid);
+                put_us(buf, ctr.time, head.ts_unit_ns);
+                fmt::format_to(std::back_inserter(buf), R"(, "args": {{"{}": {}}}}})", i == 2 ? "count" : "bytes",
+                               values[i]);
+                first = false;
+            }
+            continue;
+        }
+
+        if (ev.zone_id >= prefixes.size()) {
+            prefixes.resize(ev.zone_id + 1);
+        }
+        if (prefixes[ev.zone_id].empty()) {
+            const auto &zone = reader.zone(ev.zone_id);
+            prefixes[ev.zone_id] = fmt::format(R"({{"name": "{}", "cat": "{}", "ph": "X", "dur": )",
+                                               escape(zone.name), escape(zone.category));
+        }
+
+        const auto &th = reader.thread(ev.thread_index);
+        if (!first) {
+            buf.append(fmt::string_view(", "));
+        }
+        buf.append(prefixes[ev.zone_id].data(), prefixes[ev.zone_id].data() + prefixes[ev.zone_id].size());
+        put_us(buf, ev.end - ev.start, head.ts_unit_ns);
+        fmt::format_to(std::back_inserter(buf), R"(, "pid": {}, "tid": {}, "ts": )", th.pid, th.thread);
+        put_us(buf, ev.start, head.ts_unit_ns);
+        fmt::format_to(std::back_inserter(buf), R"(, "args": {{"frame": {}}}}})", ev.frame);
+        first = false;
+        n_events++;
+
+        if (summary != nullptr) {
+            auto &sum = (*summary)[ev.zone_id];
+            long long dur = ev.end - ev.start;
+            sum.count++;
+            sum.total += dur;
+            sum.min = std::min(sum.min, dur);
+            sum.max = std::max(sum.max, dur);
+        }
+
+        if (buf.size() >= (1u << 20u)) {
+            out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+            buf.clear();
+        }
+    }
+
+    for (uint32_t i = 0; i < reader.thread_count(); i++) {  // Metadata events can go anywhere in the trace.
+        const auto &th = reader.thread(i);
+        if (!th.name.empty()) {
+            fmt::format_to(std::back_inserter(buf),
+                           R"({}{{"name": "thread_name", "ph": "M", "pid": {}, "tid": {}, "args": {{"name": "{}"}}}})",
+                           first ? "" : ", ", th.pid, th.thread, escape(th.name));
+            first = false;
+        }
+    }
+
+    buf.append(fmt::string_view("]}"));
+    out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+    return n_events;
+}
@@ -0,0 +1,25 @@
+//
+// Conversion of binary profiler traces to Chrome trace JSON, shared by the trace tools.
+//
+
+#pragma once
+
+#include "hp/trace_format.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <ostream>
+
+/// Durations of one zone, in ticks of the trace's `ts_unit_ns`.
+struct zone_summary {
+    unsigned long long count = 0;
+    long long total = 0;
+    long long min = std::numeric_limits<long long>::max();
+    long long max = 0;
+};
+
+/// Write every remaining event and counter sample of `reader` as Chrome trace JSON, followed by the thread names.
+/// Fills `summary` per zone id if it isn't null. Returns the number of events written, not counting counters.
+unsigned long long write_chrome_json(hp::trace::reader &reader, const hp::trace::header &head, std::ostream &out,
+                                     std::map<uint32_t, zone_summary> *summary);